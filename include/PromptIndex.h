@@ -0,0 +1,13 @@
+// Generated by scripts/pack_prompts.py from prompts/*.wav, do not edit.
+#ifndef PROMPT_INDEX_H
+#define PROMPT_INDEX_H
+
+#include <stdint.h>
+
+#define PROMPT_BANK_HASH 0x811C9DC5UL
+
+namespace Prompt {
+constexpr uint16_t COUNT = 0;
+}
+
+#endif // PROMPT_INDEX_H
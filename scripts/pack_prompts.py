@@ -0,0 +1,281 @@
+"""Packs the UI prompts into the flash prompt bank.
+
+Every WAV file in prompts/ (PCM 8/16/24-bit or IMA-ADPCM, mono or stereo, at
+AUDIO_OUTPUT_RATE or at the bank rate AUDIO_OUTPUT_RATE >> PROMPT_RATE_SHIFT) is
+converted to 16-bit mono at the bank rate and packed, in file name order, into
+<build dir>/prompts.bin for the "prompts" partition. The mixer plays the stored
+samples on both channels and interpolates them back up to the output rate. The matching ids are
+written to include/PromptIndex.h, which is only rewritten when it changes so an
+unchanged bank does not rebuild the firmware.
+
+As a PlatformIO pre-script it runs before every build and adds the
+"uploadprompts" target, which writes the bank at the partition offset:
+
+    pio run -t uploadprompts
+
+It can also be run by hand: python scripts/pack_prompts.py [output.bin]
+"""
+
+import csv
+import os
+import re
+import struct
+import sys
+
+BANK_MAGIC = 0x544D5250      # "PRMT", PROMPT_BANK_MAGIC in PromptPlayer.h
+BANK_VERSION = 2             # PROMPT_BANK_VERSION
+NAME_MAX = 24                # PROMPT_NAME_MAX in Config.h
+HEADER = struct.Struct("<IHHIIBBH")
+ENTRY = struct.Struct("<%dsII" % NAME_MAX)
+PARTITION_LABEL = "prompts"  # PROMPT_PARTITION_LABEL
+
+WAVE_FORMAT_PCM = 0x0001
+WAVE_FORMAT_IMA_ADPCM = 0x0011
+
+IMA_INDEX = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+IMA_STEP = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+]
+
+
+class PromptError(Exception):
+    pass
+
+
+def fnv1a(data, value=2166136261):
+    for byte in bytearray(data):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def config_value(project_dir, name):
+    """Reads a numeric #define from Config.h, so the bank always matches the engine."""
+    with open(os.path.join(project_dir, "src", "Config.h")) as config:
+        match = re.search(r"#define\s+%s\s+(\d+)" % name, config.read())
+    if not match:
+        raise PromptError("%s not found in src/Config.h" % name)
+    return int(match.group(1))
+
+
+def read_wav(path):
+    """Returns (format tag, channels, rate, bits, block align, data) of a WAV file."""
+    with open(path, "rb") as wav:
+        blob = wav.read()
+    if len(blob) < 12 or blob[0:4] != b"RIFF" or blob[8:12] != b"WAVE":
+        raise PromptError("not a WAV file")
+    fmt = None
+    data = None
+    pos = 12
+    while pos + 8 <= len(blob):
+        chunk_id, size = struct.unpack_from("<4sI", blob, pos)
+        body = blob[pos + 8:pos + 8 + size]
+        if chunk_id == b"fmt " and len(body) >= 16:
+            fmt = struct.unpack_from("<HHIIHH", body)
+        elif chunk_id == b"data":
+            data = body
+        pos += 8 + size + (size & 1)
+    if fmt is None or data is None:
+        raise PromptError("no fmt or data chunk")
+    tag, channels, rate, _, align, bits = fmt
+    return tag, channels, rate, bits, align, data
+
+
+def decode_pcm(data, bits):
+    if bits == 8:
+        return [(b - 128) << 8 for b in bytearray(data)]
+    if bits == 16:
+        return list(struct.unpack("<%dh" % (len(data) // 2), data[:len(data) // 2 * 2]))
+    if bits == 24:
+        return [struct.unpack_from("<i", b"\0" + data[i:i + 3])[0] >> 16
+                for i in range(0, len(data) - 2, 3)]
+    raise PromptError("%d-bit PCM is not supported" % bits)
+
+
+def decode_ima_adpcm(data, channels, align):
+    """Decodes IMA-ADPCM blocks to interleaved 16-bit samples, like ImaAdpcmDecoder."""
+    samples = []
+    for start in range(0, len(data), align):
+        block = data[start:start + align]
+        if len(block) < 4 * channels:
+            break
+        predictor = []
+        index = []
+        for c in range(channels):
+            value, step_index = struct.unpack_from("<hB", block, 4 * c)
+            predictor.append(value)
+            index.append(min(step_index, 88))
+        frames = [[p] for p in predictor]
+        body = bytearray(block[4 * channels:])
+        # Each channel has 4 bytes (8 nibbles) in turn
+        for group in range(0, len(body) - 4 * channels + 1, 4 * channels):
+            for c in range(channels):
+                for byte in body[group + 4 * c:group + 4 * c + 4]:
+                    for nibble in (byte & 0x0F, byte >> 4):
+                        step = IMA_STEP[index[c]]
+                        diff = step >> 3
+                        if nibble & 4:
+                            diff += step
+                        if nibble & 2:
+                            diff += step >> 1
+                        if nibble & 1:
+                            diff += step >> 2
+                        value = predictor[c] - diff if nibble & 8 else predictor[c] + diff
+                        predictor[c] = max(-32768, min(32767, value))
+                        index[c] = max(0, min(88, index[c] + IMA_INDEX[nibble]))
+                        frames[c].append(predictor[c])
+        for i in range(min(len(f) for f in frames)):
+            for c in range(channels):
+                samples.append(frames[c][i])
+    return samples
+
+
+def halve_rate(samples):
+    """Halves the rate of mono samples, low-passing them with a [1 2 1] / 4 filter first."""
+    last = len(samples) - 1
+    return [(samples[max(i - 1, 0)] + 2 * samples[i] + samples[min(i + 1, last)] + 2) >> 2
+            for i in range(0, len(samples), 2)]
+
+
+def load_prompt(path, rate, shift):
+    """Returns the prompt as 16-bit mono samples at rate >> shift."""
+    tag, channels, file_rate, bits, align, data = read_wav(path)
+    bank_rate = rate >> shift
+    if file_rate not in (rate, bank_rate):
+        raise PromptError("%d Hz, prompts must be at the output rate of %d Hz or the bank rate of %d Hz"
+                          % (file_rate, rate, bank_rate))
+    if channels not in (1, 2):
+        raise PromptError("%d channels, only mono and stereo are supported" % channels)
+    if tag == WAVE_FORMAT_PCM:
+        samples = decode_pcm(data, bits)
+    elif tag == WAVE_FORMAT_IMA_ADPCM:
+        samples = decode_ima_adpcm(data, channels, align)
+    else:
+        raise PromptError("format tag 0x%04X is not supported" % tag)
+    if channels == 2:
+        samples = [(samples[i] + samples[i + 1]) >> 1 for i in range(0, len(samples) - 1, 2)]
+    while file_rate > bank_rate:
+        samples = halve_rate(samples)
+        file_rate >>= 1
+    return samples
+
+
+def identifier(name):
+    ident = re.sub(r"[^A-Za-z0-9]", "_", name).upper()
+    return "P_" + ident if ident[0].isdigit() else ident
+
+
+def pack(project_dir, output):
+    """Packs prompts/*.wav into output and regenerates include/PromptIndex.h."""
+    rate = config_value(project_dir, "AUDIO_OUTPUT_RATE")
+    shift = config_value(project_dir, "PROMPT_RATE_SHIFT")
+    source_dir = os.path.join(project_dir, "prompts")
+    files = sorted(f for f in os.listdir(source_dir) if f.lower().endswith(".wav")) \
+        if os.path.isdir(source_dir) else []
+
+    names = []
+    clips = []
+    for file_name in files:
+        name = os.path.splitext(file_name)[0]
+        if len(name.encode()) >= NAME_MAX:
+            raise PromptError("%s: name longer than %d characters" % (file_name, NAME_MAX - 1))
+        if identifier(name) in (identifier(n) for n in names):
+            raise PromptError("%s: id %s is already used" % (file_name, identifier(name)))
+        try:
+            clips.append(load_prompt(os.path.join(source_dir, file_name), rate, shift))
+        except PromptError as error:
+            raise PromptError("%s: %s" % (file_name, error))
+        names.append(name)
+
+    offset = HEADER.size + ENTRY.size * len(names)
+    offset = (offset + 3) & ~3
+    entries = b""
+    body = b""
+    index_hash = 2166136261
+    for name, samples in zip(names, clips):
+        encoded = name.encode().ljust(NAME_MAX, b"\0")
+        index_hash = fnv1a(encoded, index_hash)
+        entries += ENTRY.pack(encoded, offset + len(body), len(samples))
+        body += struct.pack("<%dh" % len(samples), *samples)
+        body += b"\0" * (-len(body) & 3)
+    bank = entries.ljust(offset - HEADER.size, b"\0") + body
+    bank = HEADER.pack(BANK_MAGIC, BANK_VERSION, len(names), index_hash, HEADER.size + len(bank), 1, shift, 0) + bank
+
+    with open(output, "wb") as out:
+        out.write(bank)
+
+    lines = [
+        "// Generated by scripts/pack_prompts.py from prompts/*.wav, do not edit.",
+        "#ifndef PROMPT_INDEX_H",
+        "#define PROMPT_INDEX_H",
+        "",
+        "#include <stdint.h>",
+        "",
+        "#define PROMPT_BANK_HASH 0x%08XUL" % index_hash,
+        "",
+        "namespace Prompt {",
+    ]
+    for i, name in enumerate(names):
+        lines.append("constexpr uint16_t %s = %d;" % (identifier(name), i))
+    lines += [
+        "constexpr uint16_t COUNT = %d;" % len(names),
+        "}",
+        "",
+        "#endif // PROMPT_INDEX_H",
+        "",
+    ]
+    header_path = os.path.join(project_dir, "include", "PromptIndex.h")
+    header = "\n".join(lines)
+    current = open(header_path).read() if os.path.exists(header_path) else None
+    if current != header:
+        with open(header_path, "w") as out:
+            out.write(header)
+    return len(names), len(bank)
+
+
+def partition_offset(partitions_csv):
+    with open(partitions_csv) as table:
+        for row in csv.reader(table):
+            if row and row[0].strip() == PARTITION_LABEL:
+                return row[3].strip()
+    raise PromptError("no %s partition in %s" % (PARTITION_LABEL, partitions_csv))
+
+
+if __name__ == "__main__":
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    try:
+        count, size = pack(root, sys.argv[1] if len(sys.argv) > 1 else "prompts.bin")
+    except PromptError as error:
+        sys.exit("pack_prompts: %s" % error)
+    print("pack_prompts: %d prompt(s), %d bytes" % (count, size))
+else:
+    Import("env")  # noqa: F821, provided by PlatformIO
+
+    project_dir = env.subst("$PROJECT_DIR")
+    bank_path = os.path.join(env.subst("$BUILD_DIR"), "prompts.bin")
+    if not os.path.isdir(os.path.dirname(bank_path)):
+        os.makedirs(os.path.dirname(bank_path))
+    try:
+        count, size = pack(project_dir, bank_path)
+        offset = partition_offset(os.path.join(project_dir, env.GetProjectOption("board_build.partitions")))
+    except PromptError as error:
+        sys.stderr.write("pack_prompts: %s\n" % error)
+        env.Exit(1)
+    print("pack_prompts: %d prompt(s), %d bytes" % (count, size))
+
+    port = ' --port "$UPLOAD_PORT"' if env.subst("$UPLOAD_PORT") else ""  # esptool finds the board otherwise
+    env.AddCustomTarget(
+        name="uploadprompts",
+        dependencies=None,
+        actions=[
+            '"$PYTHONEXE" "$UPLOADER" --chip %s%s --baud $UPLOAD_SPEED write_flash %s "%s"'
+            % (env.BoardConfig().get("build.mcu"), port, offset, bank_path)
+        ],
+        title="Upload prompts",
+        description="Write the prompt bank to the prompts partition",
+    )
@@ -0,0 +1,290 @@
+#include "AudioMixer.h"
+#include <esp_timer.h>
+
+/**
+ * @brief Constructor, every voice starts idle and the narration at unity gain.
+ */
+AudioMixer::AudioMixer() {
+    for (size_t v = 0; v < MIXER_VOICES; v++) {
+        m_voices[v].samples = nullptr;
+        m_voices[v].count = 0;
+        m_voices[v].position = 0;
+        m_voices[v].channels = AUDIO_OUTPUT_CHANNELS;
+        m_voices[v].rateShift = 0;
+        m_voices[v].gain = GAIN_UNITY;
+        m_voices[v].stopRequested = false;
+        m_voices[v].playUs = 0;
+        m_voices[v].active.store(false);
+    }
+    m_startedUs = 0;
+}
+
+/**
+ * @brief Starts an effect on an idle voice.
+ *
+ * The sound must stay allocated until the voice has ended or `stopAll()` has returned.
+ *
+ * @param sound Samples in the output format, or mono and/or at a lower rate.
+ * @param gain Q15 gain of the voice (GAIN_UNITY plays it unchanged).
+ * @return The voice number, or -1 if every voice is busy or the sound is empty or unsupported.
+ */
+int AudioMixer::play(const Sound& sound, int32_t gain) {
+    if (!sound.samples || sound.rateShift > MIXER_MAX_RATE_SHIFT) {
+        return -1;
+    }
+    const uint8_t channels = sound.mono ? 1 : AUDIO_OUTPUT_CHANNELS;
+    const size_t count = channels == AUDIO_OUTPUT_CHANNELS && sound.rateShift == 0 ? sound.count
+        : ((sound.count / channels) << sound.rateShift) * AUDIO_OUTPUT_CHANNELS;
+    if (count == 0) {
+        return -1;
+    }
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        Voice& voice = m_voices[v];
+        if (voice.active.load(std::memory_order_acquire)) {
+            continue;
+        }
+        voice.samples = sound.samples;
+        voice.count = count;
+        voice.position = 0;
+        voice.channels = channels;
+        voice.rateShift = sound.rateShift;
+        voice.gain = constrain(gain, 0, GAIN_UNITY);
+        voice.stopRequested = false;
+        voice.playUs = micros();
+        voice.active.store(true, std::memory_order_release); // Hand the slot to the writer task
+        return v;
+    }
+    return -1;
+}
+
+/**
+ * @brief Changes the gain of a playing voice from the next block on.
+ */
+void AudioMixer::setGain(int voice, int32_t gain) {
+    if (voice >= 0 && voice < MIXER_VOICES) {
+        m_voices[voice].gain = constrain(gain, 0, GAIN_UNITY);
+    }
+}
+
+/**
+ * @brief Asks the writer task to silence a voice at the next block.
+ */
+void AudioMixer::stop(int voice) {
+    if (voice >= 0 && voice < MIXER_VOICES && m_voices[voice].active.load(std::memory_order_acquire)) {
+        m_voices[voice].stopRequested = true;
+    }
+}
+
+/**
+ * @brief Silences every voice and waits until the writer task has retired them.
+ *
+ * After this returns no sound is referenced any more and the effect memory may be freed.
+ */
+void AudioMixer::stopAll() {
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        stop(v);
+    }
+    TickType_t start = xTaskGetTickCount();
+    while (isActive() && (xTaskGetTickCount() - start) < pdMS_TO_TICKS(AUDIO_TASK_POLL_MS * 10)) {
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @brief Returns true while at least one effect voice is playing.
+ */
+bool AudioMixer::isActive() {
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        if (m_voices[v].active.load(std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Retires the voices stopped with `stop()`.
+ *
+ * Called by the writer task before each block, and while the engine is paused or
+ * stopped so that `stopAll()` still returns.
+ */
+void AudioMixer::service() {
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        Voice& voice = m_voices[v];
+        if (voice.stopRequested && voice.active.load(std::memory_order_acquire)) {
+            voice.active.store(false, std::memory_order_release);
+        }
+    }
+}
+
+/**
+ * @brief Returns the `play()` time of a voice that was mixed for the first time since the
+ * previous call, and forgets it. Called by the writer task once the block is in DMA.
+ *
+ * @return micros() at `play()`, or 0 if no voice started (the oldest one if several did).
+ */
+uint32_t AudioMixer::takeStartedUs() {
+    uint32_t startedUs = m_startedUs;
+    m_startedUs = 0;
+    return startedUs;
+}
+
+/**
+ * @brief Mixes the playing effects over a narration block, in place.
+ *
+ * The narration is ducked while any effect plays. With no effect playing the block is
+ * only run through the duck stage, which is bypassed once it is back at unity.
+ */
+void AudioMixer::mix(int16_t* samples, size_t count) {
+    service();
+    bool effects = isActive();
+    m_duck.setTarget(effects ? MIXER_DUCK_GAIN : GAIN_UNITY);
+    if (!effects) {
+        m_duck.process(samples, count);
+        return;
+    }
+    while (count > 0) {
+        size_t n = count < MIXER_BLOCK_SAMPLES ? count : MIXER_BLOCK_SAMPLES;
+        mixBlock(samples, n, true);
+        samples += n;
+        count -= n;
+    }
+}
+
+/**
+ * @brief Mixes the playing effects over silence, for when no narration is queued.
+ *
+ * @param count In: samples wanted. Out: samples rendered, at most `MIXER_BLOCK_SAMPLES`.
+ * @return The mixed block, valid until the next call.
+ */
+int16_t* AudioMixer::render(size_t& count) {
+    service();
+    if (count > MIXER_BLOCK_SAMPLES) count = MIXER_BLOCK_SAMPLES;
+    mixBlock(m_out, count, false);
+    return m_out;
+}
+
+/**
+ * @brief Mixes one pass of at most `MIXER_BLOCK_SAMPLES` samples.
+ *
+ * Each voice is scaled to Q15 and added to the 32-bit accumulator, which cannot
+ * overflow for any number of voices; the sum is saturated to 16 bits once.
+ *
+ * @param samples Narration block, overwritten with the mix.
+ * @param count Number of samples.
+ * @param narration false to mix over silence, `samples` is then output only.
+ */
+void AudioMixer::mixBlock(int16_t* samples, size_t count, bool narration) {
+    if (narration) {
+        m_duck.process(samples, count);
+        for (size_t i = 0; i < count; i++) {
+            m_acc[i] = samples[i];
+        }
+    } else {
+        memset(m_acc, 0, count * sizeof(int32_t));
+    }
+
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        Voice& voice = m_voices[v];
+        if (!voice.active.load(std::memory_order_acquire)) {
+            continue;
+        }
+        if (voice.position == 0 && (m_startedUs == 0 || (int32_t)(voice.playUs - m_startedUs) < 0)) {
+            m_startedUs = voice.playUs | 1; // Never store 0, it means "no start"
+        }
+        size_t left = voice.count - voice.position;
+        size_t n = count < left ? count : left;
+        if (voice.channels == AUDIO_OUTPUT_CHANNELS && voice.rateShift == 0) {
+            const int16_t* src = voice.samples + voice.position;
+            const int32_t gain = voice.gain;
+            for (size_t i = 0; i < n; i++) {
+                m_acc[i] += ((int32_t)src[i] * gain) >> 15;
+            }
+        } else {
+            mixExpanded(voice, n);
+        }
+        voice.position += n;
+        if (voice.position >= voice.count) {
+            voice.active.store(false, std::memory_order_release); // Sound ended
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t v = m_acc[i];
+        samples[i] = (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+    }
+}
+
+/**
+ * @brief Adds the next `count` output samples of a mono or low-rate voice to the accumulator.
+ *
+ * Output frame `f` falls `f & mask` steps after stored frame `f >> rateShift`, so it is
+ * interpolated between that frame and the next one; the last stored frame is held. A mono
+ * frame reads the same sample for both channels.
+ */
+void AudioMixer::mixExpanded(const Voice& voice, size_t count) {
+    const uint8_t shift = voice.rateShift;
+    const size_t mask = ((size_t)1 << shift) - 1;
+    const size_t last = (voice.count / AUDIO_OUTPUT_CHANNELS - 1) >> shift; // Last stored frame
+    const size_t right = voice.channels - 1;        // Offset of the right sample in a stored frame
+    const int32_t gain = voice.gain;
+    size_t frame = voice.position / AUDIO_OUTPUT_CHANNELS;
+    for (size_t i = 0; i + 1 < count; i += AUDIO_OUTPUT_CHANNELS, frame++) {
+        size_t stored = frame >> shift;
+        const int16_t* a = voice.samples + stored * voice.channels;
+        const int16_t* b = stored < last ? a + voice.channels : a;
+        const int32_t step = (int32_t)(frame & mask);
+        int32_t l = a[0] + (((b[0] - a[0]) * step) >> shift);
+        int32_t r = a[right] + (((b[right] - a[right]) * step) >> shift);
+        m_acc[i] += (l * gain) >> 15;
+        m_acc[i + 1] += (r * gain) >> 15;
+    }
+}
+
+/**
+ * @brief Prints the mix cost of one playback block at 1, 4 and 8 voices.
+ *
+ * Runs on the calling core with a private mixer and a full-scale test sound. The cost
+ * is reported per block and as a share of the block's playing time.
+ */
+void AudioMixer::benchmark() {
+    const int rounds = 32;
+    const int voiceCounts[] = { 1, 4, 8 };
+    AudioMixer* mixer = new AudioMixer();
+    int16_t* sound = new int16_t[MIXER_BLOCK_SAMPLES];
+    int16_t* block = new int16_t[MIXER_BLOCK_SAMPLES];
+    if (!mixer || !sound || !block) {
+        delete mixer;
+        delete[] sound;
+        delete[] block;
+        return;
+    }
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < MIXER_BLOCK_SAMPLES; i++) {
+        seed = seed * 1664525UL + 1013904223UL;
+        sound[i] = (int16_t)(seed >> 16);
+    }
+    Sound test = { sound, MIXER_BLOCK_SAMPLES, false, 0 };
+    const uint32_t blockUs = (uint32_t)((uint64_t)MIXER_BLOCK_SAMPLES / AUDIO_OUTPUT_CHANNELS * 1000000ULL / AUDIO_OUTPUT_RATE);
+
+    for (size_t c = 0; c < sizeof(voiceCounts) / sizeof(voiceCounts[0]); c++) {
+        int voices = voiceCounts[c] < MIXER_VOICES ? voiceCounts[c] : MIXER_VOICES;
+        int64_t totalUs = 0;
+        for (int r = 0; r < rounds; r++) {
+            for (int v = 0; v < voices; v++) {
+                mixer->play(test, 23170);
+            }
+            memcpy(block, sound, MIXER_BLOCK_SAMPLES * sizeof(int16_t));
+            int64_t start = esp_timer_get_time();
+            mixer->mix(block, MIXER_BLOCK_SAMPLES); // Every voice ends with this block
+            totalUs += esp_timer_get_time() - start;
+        }
+        uint32_t us = (uint32_t)(totalUs / rounds);
+        Serial.printf("AudioMixer: %d voice(s) %u us per %u-sample block, %u%% of real time\n",
+                      voices, us, (unsigned)MIXER_BLOCK_SAMPLES, (unsigned)(us * 100 / blockUs));
+    }
+
+    delete mixer;
+    delete[] sound;
+    delete[] block;
+}
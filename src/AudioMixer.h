@@ -0,0 +1,92 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "Config.h"
+#include "GainStage.h"
+
+/**
+ * @file AudioMixer.h
+ * @brief N-voice mixer layering preloaded sound effects over the narration.
+ *
+ * The narration (the story or response streamed through the playback ring) is one voice;
+ * up to `MIXER_VOICES` effect voices play over it. Effects are decoded into RAM ahead of time
+ * in the output format (16-bit stereo at `AUDIO_OUTPUT_RATE`), so starting one costs no SD
+ * access and mixing it costs no decoding.
+ *
+ * The I2S writer task calls `mix()` on each narration block just before it goes to DMA, or
+ * `render()` when no narration is queued. Samples are summed into a 32-bit accumulator (each
+ * voice scaled by its own Q15 gain) and saturated to 16 bits once per block. While any effect
+ * plays, the narration is ducked to `MIXER_DUCK_GAIN` through a `GainStage`, so it dips and
+ * recovers without clicks.
+ *
+ * The voices are fixed slots and the block size is fixed, so the cost of a block is bounded:
+ * one pass for the narration, one pass per playing voice and one saturating pass. Nothing is
+ * allocated or locked while mixing: `play()` only fills idle slots and only the writer task
+ * retires playing ones, so the two tasks never write the same voice. `benchmark()` reports the
+ * cost at 1, 4 and 8 voices.
+ *
+ * Sounds are only referenced, never copied: a voice reads its samples wherever they are, PSRAM
+ * for the loaded effects or memory-mapped flash for the prompt bank. `takeStartedUs()` lets the
+ * writer task time each start from `play()` to the block it went to DMA in.
+ *
+ * A sound may also be mono and stored at `AUDIO_OUTPUT_RATE >> rateShift` (the prompt bank is
+ * mono at half rate, a quarter of the flash of the output format). Such a voice is expanded
+ * while it is mixed: each frame goes to both channels and the frames between two stored ones
+ * are interpolated linearly. Sounds in the output format keep the plain one-pass loop.
+ *
+ * ## Example:
+ * ```cpp
+ * AudioMixer::Sound chime = { samples, count, false, 0 };  // Decoded by WAVFileReader::decodeAll()
+ * int voice = engine.mixer().play(chime, GainStage::volumeToGain(80));
+ * engine.mixer().stop(voice);
+ * ```
+ */
+
+#define MIXER_BLOCK_SAMPLES (AUDIO_BLOCK_SIZE / sizeof(int16_t))   ///< Samples mixed per pass, one playback block
+
+class AudioMixer {
+public:
+    struct Sound {
+        const int16_t* samples;         // Interleaved stereo at AUDIO_OUTPUT_RATE, in RAM or mapped flash
+        size_t count;                   // Number of samples
+        bool mono;                      // One sample per frame, played on both channels
+        uint8_t rateShift;              // Stored at AUDIO_OUTPUT_RATE >> rateShift, up to MIXER_MAX_RATE_SHIFT
+    };
+
+    AudioMixer();
+    int play(const Sound& sound, int32_t gain); // Start an effect voice, returns the voice or -1
+    void setGain(int voice, int32_t gain); // Change the Q15 gain of a playing voice
+    void stop(int voice);               // Silence one voice
+    void stopAll();                     // Silence every effect voice and wait until none is mixed
+    bool isActive();                    // At least one effect voice is playing
+    void service();                     // Retire stopped voices, called by the writer task while idle
+    uint32_t takeStartedUs();           // play() time of a voice first mixed since the last call, 0 if none
+    void mix(int16_t* samples, size_t count); // Mix the effects over a narration block in place
+    int16_t* render(size_t& count);     // Mix the effects over silence, returns the block
+    static void benchmark();            // Print the cost of a block at 1, 4 and 8 voices
+
+private:
+    struct Voice {
+        const int16_t* samples;         // Sound data, owned by the caller
+        size_t count;                   // Output samples the sound plays for
+        size_t position;                // Next output sample to mix
+        uint8_t channels;               // Stored samples per frame, 1 or 2
+        uint8_t rateShift;              // Output frames per stored frame, as a power of two
+        volatile int32_t gain;          // Q15 gain of the voice
+        volatile bool stopRequested;    // Set by stop(), the writer task then retires the voice
+        uint32_t playUs;                // micros() at play(), for the start latency
+        std::atomic<bool> active;       // Set by play(), cleared by the writer task only
+    };
+
+    void mixBlock(int16_t* samples, size_t count, bool narration); // Mix one pass of at most MIXER_BLOCK_SAMPLES
+    void mixExpanded(const Voice& voice, size_t count); // Add a mono or low-rate voice to the accumulator
+    Voice m_voices[MIXER_VOICES];       // Effect voice slots
+    GainStage m_duck;                   // Narration gain, ducked while effects play
+    uint32_t m_startedUs;               // play() time of a voice first mixed, writer task only
+    int32_t m_acc[MIXER_BLOCK_SAMPLES]; // 32-bit mix accumulator
+    int16_t m_out[MIXER_BLOCK_SAMPLES]; // Output of render()
+};
+
+#endif // AUDIO_MIXER_H
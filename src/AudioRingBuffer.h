@@ -0,0 +1,221 @@
+#ifndef AUDIO_RING_BUFFER_H
+#define AUDIO_RING_BUFFER_H
+
+/**
+ * @file AudioRingBuffer.h
+ * @brief Lock-free single-producer/single-consumer ring buffer for audio streams.
+ *
+ * The `AudioRingBuffer` template moves audio between exactly two tasks (for example the SD
+ * reader and the I2S writer) without mutexes, semaphores or intermediate copies. The producer
+ * asks for a contiguous writable span with `reserve()`, fills it in place (straight from
+ * `File::read`, a decoder or a DSP stage) and publishes it with `commit()`. The consumer gets a
+ * contiguous readable span with `peek()`, uses it in place (for example as the source of
+ * `i2s_write`) and releases it with `consume()`.
+ *
+ * ## Design Notes:
+ * - The capacity is a compile-time power of two, so wrapping is a single mask.
+ * - Head and tail are free-running counters; their difference is the fill level.
+ * - Each side keeps its own index, plus a cached copy of the other side's index, on a separate
+ *   (padded) cache line, so the hot path of one task never touches a line written by the other task
+ *   unless it has run out of cached space/data.
+ * - Only one task may call the producer methods and only one task may call the consumer methods.
+ *   `reset()` may only be called while neither side is active.
+ *
+ * ## Example:
+ * ```cpp
+ * AudioRingBuffer<int16_t, 8192> ring;
+ *
+ * // Producer task
+ * size_t count = 512;
+ * int16_t* span = ring.reserve(count);  // count is clamped to the contiguous free space
+ * count = fillSamples(span, count);
+ * ring.commit(count);
+ *
+ * // Consumer task
+ * size_t available = 512;
+ * const int16_t* data = ring.peek(available);
+ * i2s_write(I2S_NUM_0, data, available * sizeof(int16_t), &written, portMAX_DELAY);
+ * ring.consume(available);
+ * ```
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+#ifndef AUDIO_CACHE_LINE_SIZE
+#define AUDIO_CACHE_LINE_SIZE 64                             ///< Padding between producer and consumer state
+#endif
+
+template <typename T, size_t Capacity>
+class AudioRingBuffer {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "AudioRingBuffer capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "AudioRingBuffer elements must be trivially copyable");
+
+public:
+    AudioRingBuffer() : m_head(0), m_cachedTail(0), m_tail(0), m_cachedHead(0) {}
+
+    /**
+     * @brief Total number of elements the ring can hold.
+     */
+    static constexpr size_t capacity() { return Capacity; }
+
+    /**
+     * @brief Number of elements that can currently be written. Safe to call from either side.
+     */
+    size_t writeAvailable() const {
+        return Capacity - (m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire));
+    }
+
+    /**
+     * @brief Number of elements that can currently be read. Safe to call from either side.
+     */
+    size_t readAvailable() const {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Elements committed since the ring was created or reset, wrapping at the range of
+     * size_t. Compare two positions by their difference, never with `<`.
+     */
+    size_t writePosition() const {
+        return m_head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Elements consumed since the ring was created or reset, see `writePosition()`.
+     */
+    size_t readPosition() const {
+        return m_tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Producer: get a contiguous writable span.
+     *
+     * @param count In: the number of elements wanted. Out: the number of elements available
+     *              in the returned span (may be 0 when the ring is full).
+     * @return Pointer to the first writable element.
+     */
+    T* reserve(size_t& count) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t free = Capacity - (head - m_cachedTail);
+        if (free < count) {
+            m_cachedTail = m_tail.load(std::memory_order_acquire); // Refresh only when the cached view runs short
+            free = Capacity - (head - m_cachedTail);
+        }
+
+        size_t offset = head & kMask;
+        size_t contiguous = Capacity - offset;
+        if (count > free) count = free;
+        if (count > contiguous) count = contiguous;
+        return m_data + offset;
+    }
+
+    /**
+     * @brief Producer: publish elements previously written into a reserved span.
+     */
+    void commit(size_t count) {
+        m_head.store(m_head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * @brief Producer: copy elements into the ring.
+     *
+     * @return The number of elements written, less than `count` when the ring fills up.
+     */
+    size_t write(const T* src, size_t count) {
+        size_t total = 0;
+        while (total < count) {
+            size_t span = count - total;
+            T* dst = reserve(span);
+            if (span == 0) break;
+            memcpy(dst, src + total, span * sizeof(T));
+            commit(span);
+            total += span;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Consumer: get a contiguous readable span.
+     *
+     * The span is mutable so that a consumer may process it in place before releasing it.
+     *
+     * @param count In: the number of elements wanted. Out: the number of elements available
+     *              in the returned span (may be 0 when the ring is empty).
+     * @return Pointer to the first readable element.
+     */
+    T* peek(size_t& count) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t used = m_cachedHead - tail;
+        if (used < count) {
+            m_cachedHead = m_head.load(std::memory_order_acquire); // Refresh only when the cached view runs short
+            used = m_cachedHead - tail;
+        }
+
+        size_t offset = tail & kMask;
+        size_t contiguous = Capacity - offset;
+        if (count > used) count = used;
+        if (count > contiguous) count = contiguous;
+        return m_data + offset;
+    }
+
+    /**
+     * @brief Consumer: release elements previously obtained with `peek()`.
+     */
+    void consume(size_t count) {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * @brief Consumer: copy elements out of the ring.
+     *
+     * @return The number of elements read, less than `count` when the ring runs empty.
+     */
+    size_t read(T* dst, size_t count) {
+        size_t total = 0;
+        while (total < count) {
+            size_t span = count - total;
+            const T* src = peek(span);
+            if (span == 0) break;
+            memcpy(dst + total, src, span * sizeof(T));
+            consume(span);
+            total += span;
+        }
+        return total;
+    }
+
+    /**
+     * @brief Empty the ring. Only valid while neither the producer nor the consumer is active.
+     */
+    void reset() {
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+        m_cachedTail = 0;
+        m_cachedHead = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+private:
+    static const size_t kMask = Capacity - 1;
+
+    // Explicit padding rather than alignas: heap allocation does not honour extended
+    // alignment before C++17, but padding keeps each side's state on its own line anyway.
+    uint8_t m_padLeading[AUDIO_CACHE_LINE_SIZE];
+
+    // Producer cache line
+    std::atomic<size_t> m_head;     // Next element to write, written by the producer only
+    size_t m_cachedTail;            // Producer's last view of m_tail
+    uint8_t m_padProducer[AUDIO_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+    // Consumer cache line
+    std::atomic<size_t> m_tail;     // Next element to read, written by the consumer only
+    size_t m_cachedHead;            // Consumer's last view of m_head
+    uint8_t m_padConsumer[AUDIO_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+    T m_data[Capacity];             // Element storage
+};
+
+#endif // AUDIO_RING_BUFFER_H
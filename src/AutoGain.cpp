@@ -0,0 +1,397 @@
+#include "AutoGain.h"
+#include <esp_timer.h>
+#include <math.h>
+
+#define AGC_RAMP_STEPS 8                                     ///< Steps of a digital gain ramp
+#define AGC_RAMP_STEP_SAMPLES 8                              ///< Samples per ramp step, 8 ms per ramp at 8 kHz
+#define AGC_CLIP_LEVEL (WAV_RESOLUTION_MAX - WAV_RESOLUTION_MAX / 32) ///< Input peaks from here on count as clipped
+
+/**
+ * @brief Constructor, starts at `MIC_GAIN_DEFAULT_LEVEL` with no digital gain.
+ */
+AutoGain::AutoGain()
+    : m_gain(AGC_RAMP_STEPS, AGC_RAMP_STEP_SAMPLES), m_level(MIC_GAIN_DEFAULT_LEVEL), m_digitalDb(0) {
+    static_assert(MIC_GAIN_DEFAULT_LEVEL < MIC_GAIN_LEVELS, "MIC_GAIN_DEFAULT_LEVEL must be a hardware level");
+    static_assert(AGC_MAX_CUT_DB < 128, "The digital gain is logged as int8_t");
+    reset(SAMPLE_RATE);
+}
+
+/**
+ * @brief Starts a new stream.
+ *
+ * The hardware level and the digital gain are those the last stream ended at (the same child
+ * is likely to speak again), and the speech level is set to match them, so nothing moves
+ * before the first speech. The log starts with that gain at position 0.
+ *
+ * @param sampleRate Rate of the stream.
+ */
+void AutoGain::reset(uint32_t sampleRate) {
+    m_frameSamples = sampleRate * AGC_FRAME_MS / 1000;
+    if (m_frameSamples == 0) {
+        m_frameSamples = 1;
+    }
+    m_releaseSamples = sampleRate * AGC_RELEASE_MS / 1000;
+    m_holdSamples = sampleRate * AGC_SWITCH_HOLD_MS / 1000;
+    m_average = (float)AGC_FRAME_MS / AGC_AVERAGE_MS;
+    m_fill = 0;
+    m_energy = 0;
+    m_peak = 0;
+    m_position = 0;
+    m_speechDb = AGC_TARGET_DBFS - m_digitalDb - (float)m_level * MIC_GAIN_STEP_DB;
+    m_peakDb = -100.0f;
+    m_rising = false;
+    m_riseLeft = 0;
+    m_sinceSwitch = 0;
+    m_landing = false;
+    m_landingAt = 0;
+    m_logCount = 0;
+    m_logLost = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_gain.jumpTo(dbToGain(m_digitalDb));
+    log();
+}
+
+/**
+ * @brief Measures a block, updates the loop and applies the digital gain in place.
+ *
+ * @param samples Mono samples, scaled in place.
+ * @param count Number of samples.
+ * @param speech true while the voice detector hears speech; only speech moves the level.
+ * @param delay Samples between the end of this block and the first one captured after a
+ *              hardware switch made now.
+ * @return true if the hardware level changed: set `getLevel()` on the amplifier now.
+ */
+bool AutoGain::process(int16_t* samples, size_t count, bool speech, size_t delay) {
+    const uint32_t landingAt = m_position + count + delay;
+    bool switched = false;
+    while (count > 0) {
+        if (m_landing && m_position == m_landingAt) {
+            if (m_fill > 0) {
+                completeFrame(speech, landingAt); // Frames never mix two hardware levels
+            }
+            land();
+        }
+        size_t n = m_frameSamples - m_fill;
+        if (n > count) {
+            n = count;
+        }
+        if (m_landing && m_landingAt - m_position < n) {
+            n = m_landingAt - m_position;
+        }
+        uint64_t energy = 0;
+        int32_t peak = m_peak;
+        for (size_t i = 0; i < n; i++) {
+            int32_t x = samples[i];
+            energy += (uint32_t)(x * x);
+            int32_t magnitude = x < 0 ? -x : x;
+            if (magnitude > peak) peak = magnitude;
+        }
+        m_energy += energy;
+        m_peak = peak;
+        m_gain.process(samples, n);
+        m_position += n;
+        m_fill += n;
+        samples += n;
+        count -= n;
+        if (m_fill == m_frameSamples && completeFrame(speech, landingAt)) {
+            switched = true;
+        }
+    }
+    return switched;
+}
+
+/**
+ * @brief Updates the speech level, the peak follower and the gains with the completed frame.
+ *
+ * @param speech true while the voice detector hears speech.
+ * @param landingAt Stream sample a hardware switch made now is expected at.
+ * @return true if the hardware level changed.
+ */
+bool AutoGain::completeFrame(bool speech, uint32_t landingAt) {
+    const float fullScale = 32768.0f * 32768.0f;
+    float rmsDb = 10.0f * log10f((float)m_energy / m_fill / fullScale + 1e-12f);
+    float peakDb = 20.0f * log10f((m_peak > 0 ? m_peak : 1) / 32768.0f);
+    bool clipped = m_peak >= AGC_CLIP_LEVEL;
+    uint32_t frameSamples = m_fill;
+    m_energy = 0;
+    m_peak = 0;
+    m_fill = 0;
+    m_stats.frames++;
+    if (clipped) {
+        m_stats.clippedFrames++;
+    }
+
+    // Peak follower: instant attack, released at the rate the gain may rise
+    float release = (float)frameSamples / m_releaseSamples;
+    m_peakDb = peakDb > m_peakDb - release ? peakDb : m_peakDb - release;
+    if (m_landing) {
+        return false; // Frozen until the last switch shows in the stream
+    }
+
+    const float levelDb = (float)m_level * MIC_GAIN_STEP_DB;
+    if (speech && rmsDb > AGC_GATE_DBFS) {
+        m_speechDb += (rmsDb - levelDb - m_speechDb) * m_average;
+        m_stats.speechFrames++;
+    }
+    float wanted = AGC_TARGET_DBFS - (m_speechDb + levelDb); // Digital gain that reaches the target
+
+    // Hardware level, with hysteresis around the digital range
+    m_sinceSwitch += frameSamples;
+    if (m_sinceSwitch >= m_holdSamples || clipped) {
+        int level = m_level;
+        const float clipDb = 20.0f * log10f(AGC_CLIP_LEVEL / 32768.0f);
+        if ((clipped || wanted < -(MIC_GAIN_STEP_DB + AGC_HYSTERESIS_DB)) && level > 0) {
+            level--;
+        } else if (wanted > AGC_HYSTERESIS_DB && level < MIC_GAIN_LEVELS - 1 &&
+                   m_peakDb + MIC_GAIN_STEP_DB < clipDb) {
+            level++;
+        }
+        if (level != m_level) {
+            int step = (level - m_level) * MIC_GAIN_STEP_DB;
+            int digital = m_digitalDb - step;
+            digital = digital > 0 ? 0 : (digital < -AGC_MAX_CUT_DB ? -AGC_MAX_CUT_DB : digital);
+            m_level = (uint8_t)level;
+            m_digitalDb = (int8_t)digital; // Applied when the switch lands
+            m_peakDb += step;
+            m_rising = false;
+            m_sinceSwitch = 0;
+            m_landing = true;
+            m_landingAt = landingAt;
+            m_stats.switches++;
+            return true;
+        }
+    }
+
+    // Digital gain in 1 dB steps: falls at once, rises one step per AGC_RELEASE_MS
+    int target = (int)lrintf(wanted);
+    int cap = (int)floorf(AGC_PEAK_DBFS - m_peakDb);
+    if (target > cap) target = cap;
+    if (target > 0) target = 0;
+    if (target < -AGC_MAX_CUT_DB) target = -AGC_MAX_CUT_DB;
+    if (target <= m_digitalDb - AGC_DEADBAND_DB || (target < m_digitalDb && target == cap)) {
+        m_rising = false;
+        setDigital(target);
+    } else if (target >= m_digitalDb + AGC_DEADBAND_DB && !m_rising) {
+        m_rising = true;
+        m_riseLeft = 0;
+    }
+    if (m_rising) {
+        if (target <= m_digitalDb) {
+            m_rising = false;
+        } else if (m_riseLeft <= frameSamples) {
+            m_riseLeft = m_releaseSamples;
+            setDigital(m_digitalDb + 1);
+        } else {
+            m_riseLeft -= frameSamples;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Ramps the digital gain to a new value from the next sample and logs the step.
+ */
+void AutoGain::setDigital(int db) {
+    if (db == m_digitalDb) {
+        return;
+    }
+    m_digitalDb = (int8_t)db;
+    m_gain.setTarget(dbToGain(db));
+    m_stats.steps++;
+    log();
+}
+
+/**
+ * @brief Called on the sample a hardware switch is expected at: the digital gain moves by the
+ *        opposite step from here on.
+ */
+void AutoGain::land() {
+    m_landing = false;
+    m_gain.setTarget(dbToGain(m_digitalDb));
+    log();
+}
+
+/**
+ * @brief Logs the gain of the next sample; a step at the same position replaces the last one.
+ */
+void AutoGain::log() {
+    if (m_logCount > 0 && m_log[m_logCount - 1].position == m_position) {
+        m_logCount--;
+    } else if (m_logCount == AGC_LOG_STEPS) {
+        m_logLost++;
+        return;
+    }
+    Step& step = m_log[m_logCount++];
+    step.position = m_position;
+    step.level = m_level;
+    step.digitalDb = m_digitalDb;
+}
+
+/**
+ * @brief Returns the hardware level the amplifier should be at.
+ */
+uint8_t AutoGain::getLevel() {
+    return m_level;
+}
+
+/**
+ * @brief Returns the digital gain of new samples, in dB (0 or below).
+ */
+int8_t AutoGain::getDigitalDb() {
+    return m_digitalDb;
+}
+
+/**
+ * @brief Returns the counters since `reset()`.
+ */
+AutoGain::Stats AutoGain::getStats() {
+    return m_stats;
+}
+
+/**
+ * @brief Returns the log of the stream as text, for the comment of a WAV file.
+ *
+ * The text is `AGC dB at sample (microphone+digital):` followed by one `position:mic±digital`
+ * entry per step, for example `0:50-3 12480:60-13`. Positions are in samples of the file:
+ * the stream position less `skip` (samples dropped before the file started), at least 0.
+ * Steps from `length` on never reached the file and are left out; steps that fell on the same
+ * sample keep the last one.
+ *
+ * @param skip Stream samples dropped before the first sample of the file.
+ * @param length Samples in the file.
+ */
+String AutoGain::describe(uint32_t skip, uint32_t length) {
+    String text = "AGC dB at sample (microphone+digital):";
+    text.reserve(text.length() + m_logCount * 16 + 16);
+    for (size_t i = 0; i < m_logCount; i++) {
+        uint32_t position = m_log[i].position > skip ? m_log[i].position - skip : 0;
+        if (position >= length && position > 0) {
+            break;
+        }
+        if (i + 1 < m_logCount) {
+            uint32_t next = m_log[i + 1].position > skip ? m_log[i + 1].position - skip : 0;
+            if (next == position) {
+                continue; // Replaced before any sample of the file
+            }
+        }
+        char entry[24];
+        snprintf(entry, sizeof(entry), " %u:%d%+d", (unsigned)position,
+                 MIC_GAIN_MIN_DB + m_log[i].level * MIC_GAIN_STEP_DB, m_log[i].digitalDb);
+        text += entry;
+    }
+    if (m_logLost > 0) {
+        text += " (";
+        text += m_logLost;
+        text += " more steps not logged)";
+    }
+    return text;
+}
+
+/**
+ * @brief Converts a digital gain in dB (0 down to -`AGC_MAX_CUT_DB`) to a Q15 gain.
+ */
+int32_t AutoGain::dbToGain(int db) {
+    int32_t gain = (int32_t)lrintf(GAIN_UNITY * powf(10.0f, db / 20.0f));
+    return gain > GAIN_UNITY ? GAIN_UNITY : gain;
+}
+
+/**
+ * @brief Prints the levels reached on a synthetic voice and the cost per sample.
+ *
+ * A voice (a 160 Hz harmonic series in 250 ms syllables) at `SAMPLE_RATE` speaks at a normal,
+ * a quiet, a loud and again a normal level, through a model of the amplifier: the hardware
+ * gain applies `MIC_FRAME_SAMPLES` after each switch and the input clips at the WAV range.
+ * For each part the RMS of the output syllables over its last second is printed against
+ * `AGC_TARGET_DBFS`, with the share of clipped input samples.
+ */
+void AutoGain::benchmark() {
+    struct Part {
+        int16_t speechDb;               // Syllable RMS at the lowest hardware level, dBFS
+        uint16_t ms;                    // Length
+    };
+    const Part script[] = { { -45, 4000 }, { -60, 5000 }, { -26, 5000 }, { -45, 4000 } };
+    const uint32_t rate = SAMPLE_RATE;
+    const size_t block = MIC_FRAME_SAMPLES;
+    const size_t delay = MIC_FRAME_SAMPLES;
+    AutoGain* agc = new AutoGain();
+    int16_t* frame = new int16_t[block];
+    if (!agc || !frame) {
+        delete agc;
+        delete[] frame;
+        return;
+    }
+    agc->m_level = MIC_GAIN_DEFAULT_LEVEL;
+    agc->m_digitalDb = 0;
+    agc->reset(rate);
+
+    const float pi = 3.14159265f;
+    const uint32_t syllable = rate / 4;
+    int hardwareLevel = agc->getLevel();
+    int pendingLevel = -1;
+    size_t pendingLeft = 0;
+    uint32_t seed = 12345;
+    uint32_t position = 0;
+    uint32_t clippedSamples = 0;
+    int64_t busyUs = 0;
+    float outDb[sizeof(script) / sizeof(script[0])];
+
+    for (size_t p = 0; p < sizeof(script) / sizeof(script[0]); p++) {
+        const uint32_t length = (uint32_t)script[p].ms * rate / 1000;
+        const float amplitude = sqrtf(2.0f / 1.46f) * 32768.0f * powf(10.0f, script[p].speechDb / 20.0f); // 5 harmonics, RMS 1.46/2
+        double energy = 0.0;
+        uint32_t measured = 0;
+        for (uint32_t t = 0; t < length; t += block) {
+            size_t n = length - t < block ? length - t : block;
+            bool voiced = ((t / syllable) % 2) == 0;
+            float hardwareGain = powf(10.0f, hardwareLevel * MIC_GAIN_STEP_DB / 20.0f);
+            for (size_t i = 0; i < n; i++) {
+                if (pendingLevel >= 0 && pendingLeft-- == 0) {
+                    hardwareLevel = pendingLevel; // The amplifier switches mid-block
+                    hardwareGain = powf(10.0f, hardwareLevel * MIC_GAIN_STEP_DB / 20.0f);
+                    pendingLevel = -1;
+                }
+                seed = seed * 1664525UL + 1013904223UL;
+                float v = (int16_t)(seed >> 16) / 2000.0f; // Microphone noise, about -70 dBFS
+                if (voiced) {
+                    for (int h = 1; h <= 5; h++) {
+                        v += amplitude / h * sinf(2.0f * pi * 160.0f * h * (position + i) / rate);
+                    }
+                }
+                v *= hardwareGain;
+                if (v >= WAV_RESOLUTION_MAX || v <= WAV_RESOLUTION_MIN) {
+                    clippedSamples++;
+                    v = v > 0 ? WAV_RESOLUTION_MAX : WAV_RESOLUTION_MIN;
+                }
+                frame[i] = (int16_t)v;
+            }
+
+            int64_t start = esp_timer_get_time();
+            if (agc->process(frame, n, voiced, delay)) {
+                pendingLevel = agc->getLevel();
+                pendingLeft = delay;
+            }
+            busyUs += esp_timer_get_time() - start;
+
+            if (voiced && t + rate >= length) {
+                for (size_t i = 0; i < n; i++) {
+                    energy += (double)frame[i] * frame[i];
+                }
+                measured += n;
+            }
+            position += n;
+        }
+        outDb[p] = (float)(10.0 * log10(energy / (measured ? measured : 1) / (32768.0 * 32768.0) + 1e-12));
+    }
+
+    Stats stats = agc->getStats();
+    String log = agc->describe(0, position);
+    delete agc;
+    delete[] frame;
+
+    Serial.printf("AutoGain: speech at %d/%d/%d/%d dBFS ends at %.1f/%.1f/%.1f/%.1f dBFS (target %d), "
+                  "%u switches, %u steps, %u clipped samples, %u ns per sample\n",
+                  script[0].speechDb, script[1].speechDb, script[2].speechDb, script[3].speechDb,
+                  outDb[0], outDb[1], outDb[2], outDb[3], AGC_TARGET_DBFS, stats.switches, stats.steps,
+                  clippedSamples, (uint32_t)(busyUs * 1000 / (position ? position : 1)));
+    Serial.printf("AutoGain: %s\n", log.c_str());
+}
@@ -0,0 +1,104 @@
+#ifndef AUTO_GAIN_H
+#define AUTO_GAIN_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "GainStage.h"
+
+/**
+ * @file AutoGain.h
+ * @brief Closed-loop gain control of the microphone recordings.
+ *
+ * The microphone amplifier has `MIC_GAIN_LEVELS` hardware gains `MIC_GAIN_STEP_DB` apart, too
+ * coarse on their own: a quiet child comes out inaudible at one level and a loud one clips at
+ * the next. The recording writer task runs every captured block through an `AutoGain`, which
+ * picks the hardware level and fills the steps between levels with a digital gain.
+ *
+ * The stream is measured in frames of `AGC_FRAME_MS`, RMS and peak:
+ * - the speech level is the RMS of the speech frames (louder than `AGC_GATE_DBFS`), averaged
+ *   over `AGC_AVERAGE_MS` and referred to the microphone, so it does not jump with the level;
+ * - the digital gain (0 down to -`AGC_MAX_CUT_DB`, in 1 dB steps) brings that level to
+ *   `AGC_TARGET_DBFS` and keeps the peaks below `AGC_PEAK_DBFS`. It falls at once and rises
+ *   1 dB per `AGC_RELEASE_MS`, and ignores errors within `AGC_DEADBAND_DB`;
+ * - when the digital gain would have to go `AGC_HYSTERESIS_DB` past its range, or the input
+ *   clips, the hardware level switches, at most once per `AGC_SWITCH_HOLD_MS`. The digital gain
+ *   moves by the same step the other way, so the level of the file stays put.
+ *
+ * A hardware switch only shows in the samples captured after it, which reach `process()` later
+ * (capture ring, noise suppressor). The caller gives that delay, and the digital gain changes
+ * on the sample the switch is expected at. Until then the loop is frozen.
+ *
+ * Every step (hardware or digital) is logged with its position in the stream. `describe()`
+ * turns the log into the text the recording stores in its WAV file, so speech recognition can
+ * tell a gain step from the speaker getting louder.
+ *
+ * `benchmark()` records a synthetic voice that gets quieter and louder through a model of the
+ * amplifier and prints how close each part ends to the target, the steps and the cost.
+ *
+ * ## Example:
+ * ```cpp
+ * AutoGain agc;
+ * agc.reset(SAMPLE_RATE);
+ * mic.setGain(agc.getLevel());
+ * if (agc.process(block, count, vad.isSpeech(), captureDelay)) {
+ *     mic.setGain(agc.getLevel()); // Switch the amplifier now
+ * }
+ * ```
+ */
+
+class AutoGain {
+public:
+    struct Step {
+        uint32_t position;              // Stream sample the gain applies from
+        uint8_t level;                  // Hardware level
+        int8_t digitalDb;               // Digital gain
+    };
+
+    struct Stats {
+        uint32_t frames;                // Frames analysed since reset()
+        uint32_t speechFrames;          // Frames that moved the speech level
+        uint32_t clippedFrames;         // Frames whose input reached full scale
+        uint32_t switches;              // Hardware level switches
+        uint32_t steps;                 // Digital gain steps
+    };
+
+    AutoGain();
+    void reset(uint32_t sampleRate);    // New stream, starts from the gain the last one ended at
+    bool process(int16_t* samples, size_t count, bool speech, size_t delay); // Measure and scale in place, true to switch the hardware
+    uint8_t getLevel();                 // Hardware level to set
+    int8_t getDigitalDb();              // Digital gain of new samples
+    Stats getStats();                   // Counters
+    String describe(uint32_t skip, uint32_t length); // Log as text, positions shifted by skip and cut at length
+    static int32_t dbToGain(int db);    // Q15 gain of 0..-AGC_MAX_CUT_DB
+    static void benchmark();            // Print the levels reached on a synthetic voice and the cost
+
+private:
+    bool completeFrame(bool speech, uint32_t landingAt); // Update the loop, true on a hardware switch
+    void setDigital(int db);            // Step the digital gain from the next sample
+    void land();                        // The hardware switch reaches the stream
+    void log();                         // Record the gain of the next sample
+    GainStage m_gain;                   // Applies the digital gain with a short ramp
+    size_t m_frameSamples;              // Samples per frame
+    size_t m_fill;                      // Samples of the current frame so far
+    uint64_t m_energy;                  // Sum of squares of the current frame
+    int32_t m_peak;                     // Largest magnitude of the current frame
+    uint32_t m_position;                // Stream samples processed
+    uint8_t m_level;                    // Hardware level
+    int8_t m_digitalDb;                 // Digital gain
+    float m_speechDb;                   // Speech level referred to the lowest hardware level
+    float m_peakDb;                     // Peak follower, dBFS at the input
+    float m_average;                    // Share of a frame in the speech level average
+    bool m_rising;                      // The digital gain is rising towards its target
+    uint32_t m_riseLeft;                // Samples before the next rising step
+    uint32_t m_releaseSamples;          // AGC_RELEASE_MS in samples
+    uint32_t m_holdSamples;             // AGC_SWITCH_HOLD_MS in samples
+    uint32_t m_sinceSwitch;             // Samples since the last switch or reset()
+    bool m_landing;                     // A hardware switch has not reached the stream yet
+    uint32_t m_landingAt;               // Stream sample it is expected at
+    Step m_log[AGC_LOG_STEPS];          // Steps of the stream
+    size_t m_logCount;                  // Steps logged
+    uint32_t m_logLost;                 // Steps that did not fit
+    Stats m_stats;                      // Counters
+};
+
+#endif // AUTO_GAIN_H
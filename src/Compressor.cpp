@@ -0,0 +1,269 @@
+#include "Compressor.h"
+#include <esp_timer.h>
+#include <math.h>
+
+/**
+ * @brief Constructor, configures the defaults from Config.h with an empty delay.
+ */
+Compressor::Compressor() : m_active(0) {
+    m_ceiling = (int32_t)(32768.0f * powf(10.0f, COMP_CEILING_DB / 20.0f));
+    memset(m_curves, 0, sizeof(m_curves));
+    Settings defaults = { COMP_DEFAULT_THRESHOLD_DB, COMP_DEFAULT_ATTACK_MS, COMP_DEFAULT_RELEASE_MS };
+    configure(defaults);
+    reset();
+}
+
+/**
+ * @brief Sets the threshold and the attack and release times.
+ *
+ * Builds the gain curve and coefficients into the copy the processing task is not using,
+ * then switches to it; the new settings apply from the next sub-block. The floating-point
+ * math happens here only, never on the audio path.
+ *
+ * @param settings Threshold in dBFS, clamped to COMP_THRESHOLD_MIN_DB..0; attack 0..1000 ms;
+ *                 release 1..5000 ms.
+ */
+void Compressor::configure(const Settings& settings) {
+    m_settings.thresholdDb = constrain(settings.thresholdDb, COMP_THRESHOLD_MIN_DB, 0);
+    m_settings.attackMs = constrain(settings.attackMs, 0, 1000);
+    m_settings.releaseMs = constrain(settings.releaseMs, 1, 5000);
+
+    Curve& curve = m_curves[m_active ^ 1];
+    const float threshold = 32768.0f * powf(10.0f, m_settings.thresholdDb / 20.0f);
+    const float ceiling = 32768.0f * powf(10.0f, COMP_CEILING_DB / 20.0f);
+    for (int i = 0; i < COMP_CURVE_POINTS; i++) {
+        float level = (float)(i * 256);
+        float out = level;
+        if (level > threshold) {
+            out = threshold * powf(level / threshold, 1.0f / COMP_RATIO); // Above the knee
+        }
+        if (out > ceiling) {
+            out = ceiling;
+        }
+        curve.gain[i] = level > 0.0f ? (int32_t)(GAIN_UNITY * out / level) : GAIN_UNITY;
+        if (curve.gain[i] > GAIN_UNITY) curve.gain[i] = GAIN_UNITY;
+    }
+    curve.attack = msToCoefficient(m_settings.attackMs);
+    curve.release = msToCoefficient(m_settings.releaseMs);
+    m_active ^= 1; // Hand the new curve to the processing task
+}
+
+/**
+ * @brief Returns the settings in use, after clamping.
+ */
+Compressor::Settings Compressor::getSettings() {
+    return m_settings;
+}
+
+/**
+ * @brief Converts a time constant into the share of the gap to the target closed per
+ * sub-block, `1 - exp(-T / tau)` in Q15. 0 ms closes it at once.
+ */
+int32_t Compressor::msToCoefficient(int ms) {
+    if (ms <= 0) {
+        return GAIN_UNITY;
+    }
+    const float subBlockMs = 1000.0f * COMP_SUBBLOCK_FRAMES / AUDIO_OUTPUT_RATE;
+    int32_t coefficient = (int32_t)(GAIN_UNITY * (1.0f - expf(-subBlockMs / ms)));
+    return coefficient > 0 ? coefficient : 1;
+}
+
+/**
+ * @brief Compresses a block in place.
+ *
+ * Each input sample is swapped with the sample `latency()` samples older, which was scaled
+ * when its slot became the next to leave the delay. The block may be any even length; the
+ * sub-block grid follows the stream, not the block boundaries.
+ *
+ * @param samples Interleaved stereo samples, replaced by the delayed, compressed stream.
+ * @param count Number of samples.
+ */
+void Compressor::process(int16_t* samples, size_t count) {
+    if (count > 0) {
+        m_holding = true;
+    }
+    while (count > 0) {
+        int16_t* slot = m_delay + m_slot * COMP_SUBBLOCK_SAMPLES + m_pos;
+        size_t n = COMP_SUBBLOCK_SAMPLES - m_pos;
+        if (n > count) n = count;
+        for (size_t i = 0; i < n; i++) {
+            int16_t delayed = slot[i];
+            slot[i] = samples[i];
+            samples[i] = delayed;
+        }
+        samples += n;
+        count -= n;
+        m_pos += n;
+        if (m_pos == COMP_SUBBLOCK_SAMPLES) {
+            completeSubBlock();
+        }
+    }
+}
+
+/**
+ * @brief Called when a slot is full of new input: records its peak, then computes the gain
+ * of the next slot, the oldest in the delay, from the peaks of every slot, and scales it.
+ */
+void Compressor::completeSubBlock() {
+    const int16_t* filled = m_delay + m_slot * COMP_SUBBLOCK_SAMPLES;
+    int32_t peak = 0;
+    for (size_t i = 0; i < COMP_SUBBLOCK_SAMPLES; i++) {
+        int32_t v = filled[i];
+        if (v < 0) v = -v;
+        if (v > peak) peak = v;
+    }
+    m_peaks[m_slot] = peak;
+
+    m_slot = m_slot == COMP_LOOKAHEAD_BLOCKS ? 0 : m_slot + 1;
+    m_pos = 0;
+
+    // Look-ahead peak: the slot about to leave and every slot after it
+    int32_t ahead = 0;
+    for (size_t s = 0; s <= COMP_LOOKAHEAD_BLOCKS; s++) {
+        if (m_peaks[s] > ahead) ahead = m_peaks[s];
+    }
+
+    const Curve& curve = m_curves[m_active];
+    int32_t target = curveGain(curve, ahead);
+    if (target < m_gain) {
+        m_gain -= (int32_t)(((int64_t)(m_gain - target) * curve.attack) >> 15);
+    } else {
+        m_gain += (int32_t)(((int64_t)(target - m_gain) * curve.release + 32767) >> 15);
+    }
+
+    // Whatever the attack, the slot's own peak never passes the ceiling
+    int32_t gain = m_gain;
+    if (m_peaks[m_slot] > m_ceiling) {
+        int32_t cap = (m_ceiling << 15) / m_peaks[m_slot];
+        if (cap < gain) gain = cap;
+    }
+    if (gain < GAIN_UNITY) {
+        GainStage::scale(m_delay + m_slot * COMP_SUBBLOCK_SAMPLES, COMP_SUBBLOCK_SAMPLES, (int16_t)gain);
+    }
+}
+
+/**
+ * @brief Returns the Q15 gain of the curve for a peak level, interpolated between points.
+ */
+int32_t Compressor::curveGain(const Curve& curve, int32_t peak) {
+    if (peak >= 32768) {
+        return curve.gain[COMP_CURVE_POINTS - 1];
+    }
+    int32_t index = peak >> 8;
+    int32_t fraction = peak & 255;
+    return curve.gain[index] + (((curve.gain[index + 1] - curve.gain[index]) * fraction) >> 8);
+}
+
+/**
+ * @brief Pushes the samples still in the delay out with silence, for when the stream stops.
+ *
+ * @param count Out: samples in the returned block, `latency()`.
+ * @return The tail of the stream, valid until the next call.
+ */
+int16_t* Compressor::drain(size_t& count) {
+    memset(m_tail, 0, sizeof(m_tail));
+    process(m_tail, COMP_DELAY_SAMPLES);
+    m_holding = false;
+    count = COMP_DELAY_SAMPLES;
+    return m_tail;
+}
+
+/**
+ * @brief Returns true if audio went in since the delay was last drained or reset.
+ */
+bool Compressor::holdsAudio() {
+    return m_holding;
+}
+
+/**
+ * @brief Drops the delayed samples and returns to unity gain. Processing task only.
+ */
+void Compressor::reset() {
+    memset(m_delay, 0, sizeof(m_delay));
+    memset(m_peaks, 0, sizeof(m_peaks));
+    m_slot = 0;
+    m_pos = 0;
+    m_gain = GAIN_UNITY;
+    m_holding = false;
+}
+
+/**
+ * @brief Returns the delay the stage adds to the stream, in samples.
+ */
+size_t Compressor::latency() {
+    return COMP_DELAY_SAMPLES;
+}
+
+/**
+ * @brief Returns the smoothed Q15 gain, GAIN_UNITY when no compression is applied.
+ */
+int32_t Compressor::getGain() {
+    return m_gain;
+}
+
+/**
+ * @brief Checks the ceiling and prints the cost of one playback block.
+ *
+ * Runs on the calling core with a private stage at the default settings. Full-scale noise
+ * with bursts must come out with no sample above `COMP_CEILING_DB`, and a tone below the
+ * threshold must come out unchanged (only delayed). The cost is reported per block and as a
+ * share of the block's playing time, against `COMP_CPU_BUDGET_PERCENT`.
+ */
+void Compressor::benchmark() {
+    const size_t samples = AUDIO_BLOCK_SIZE / sizeof(int16_t);
+    const int rounds = 64;
+    Compressor* stage = new Compressor();
+    int16_t* block = new int16_t[samples];
+    int16_t* quiet = new int16_t[samples * 2];
+    if (!stage || !block || !quiet) {
+        delete stage;
+        delete[] block;
+        delete[] quiet;
+        return;
+    }
+
+    // Ceiling: loud noise, every other block at full scale
+    const int32_t ceiling = stage->m_ceiling;
+    bool ceilingHeld = true;
+    uint32_t seed = 12345;
+    int64_t totalUs = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < samples; i++) {
+            seed = seed * 1664525UL + 1013904223UL;
+            int32_t v = (int16_t)(seed >> 16);
+            block[i] = (int16_t)((r & 1) ? v : v / 4);
+        }
+        int64_t start = esp_timer_get_time();
+        stage->process(block, samples);
+        totalUs += esp_timer_get_time() - start;
+        for (size_t i = 0; i < samples; i++) {
+            if (block[i] > ceiling || block[i] < -ceiling) {
+                ceilingHeld = false;
+            }
+        }
+    }
+
+    // Transparency: a tone 6 dB below the threshold is only delayed
+    stage->reset();
+    const float amplitude = 16384.0f * powf(10.0f, COMP_DEFAULT_THRESHOLD_DB / 20.0f);
+    for (size_t i = 0; i < samples * 2; i++) {
+        quiet[i] = (int16_t)(amplitude * sinf(2.0f * 3.14159265f * 440.0f * (i / 2) / AUDIO_OUTPUT_RATE));
+    }
+    memcpy(block, quiet, samples * sizeof(int16_t));
+    stage->process(block, samples);
+    memcpy(block, quiet + samples, samples * sizeof(int16_t));
+    stage->process(block, samples);
+    bool transparent = memcmp(block, quiet + samples - COMP_DELAY_SAMPLES, samples * sizeof(int16_t)) == 0;
+
+    delete stage;
+    delete[] block;
+    delete[] quiet;
+
+    const uint32_t blockUs = (uint32_t)((uint64_t)samples / AUDIO_OUTPUT_CHANNELS * 1000000ULL / AUDIO_OUTPUT_RATE);
+    uint32_t us = (uint32_t)(totalUs / rounds);
+    uint32_t permille = us * 1000 / blockUs;
+    Serial.printf("Compressor: %u us per %u-sample block, %u.%u%% of a core (budget %u%%, %s), ceiling %s, %s below threshold\n",
+                  us, (unsigned)samples, (unsigned)(permille / 10), (unsigned)(permille % 10), COMP_CPU_BUDGET_PERCENT,
+                  permille <= COMP_CPU_BUDGET_PERCENT * 10 ? "met" : "EXCEEDED",
+                  ceilingHeld ? "held" : "EXCEEDED", transparent ? "transparent" : "ALTERED");
+}
@@ -0,0 +1,87 @@
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "GainStage.h"
+
+/**
+ * @file Compressor.h
+ * @brief Streaming look-ahead compressor and peak limiter for the playback blocks.
+ *
+ * Stories, TTS responses and the kids' own recordings arrive at very different levels, and
+ * peaks above what the small speaker handles clip. This stage compresses everything above
+ * a threshold by `COMP_RATIO` and then limits the peaks to `COMP_CEILING_DB`.
+ *
+ * The audio is handled in sub-blocks of `COMP_SUBBLOCK_FRAMES` frames. For each sub-block the
+ * peak of both channels is taken once, and the gain is computed once from the highest peak of
+ * the next `COMP_LOOKAHEAD_BLOCKS` sub-blocks: the output is delayed by that look-ahead, so the
+ * gain is already down when a transient arrives. The gain follows its target with separate
+ * attack and release coefficients (one multiply per sub-block, the block envelope follower)
+ * and is then capped so the sub-block's own peak never exceeds the ceiling. It is applied with
+ * the `GainStage` kernel and skipped at unity.
+ *
+ * Everything on the audio path is fixed point. The gain curve is a 129-point Q15 table
+ * interpolated on the peak level, rebuilt by `configure()`, which also converts the attack
+ * and release times into Q15 coefficients. `configure()` fills the inactive copy of the table
+ * and switches to it, so it may be called from any task while the writer task processes.
+ *
+ * The added latency is `latency()` samples (about 3.6 ms at 44.1 kHz). `drain()` pushes the
+ * delayed tail out with silence when the stream stops; `reset()` drops it. `benchmark()`
+ * checks the ceiling on loud noise and prints the cost of a playback block.
+ *
+ * ## Example:
+ * ```cpp
+ * Compressor::Settings settings = { -12, 2, 150 }; // Threshold dBFS, attack ms, release ms
+ * compressor.configure(settings);
+ * compressor.process(samples, count); // Called by the I2S writer task on every block
+ * ```
+ */
+
+#define COMP_SUBBLOCK_SAMPLES (COMP_SUBBLOCK_FRAMES * AUDIO_OUTPUT_CHANNELS) ///< Samples per envelope step
+#define COMP_DELAY_SAMPLES ((COMP_LOOKAHEAD_BLOCKS + 1) * COMP_SUBBLOCK_SAMPLES) ///< Samples held by the look-ahead delay
+#define COMP_CURVE_POINTS 129                                ///< Points of the gain curve, one per 256 levels
+
+class Compressor {
+public:
+    struct Settings {
+        int thresholdDb;                // Level compression starts at, dBFS (COMP_THRESHOLD_MIN_DB..0)
+        int attackMs;                   // Time constant of gain reduction, 0 for instant
+        int releaseMs;                  // Time constant of gain recovery
+    };
+
+    Compressor();
+    void configure(const Settings& settings); // Rebuild the curve and coefficients, any task
+    Settings getSettings();             // Settings in use
+    void process(int16_t* samples, size_t count); // Compress a block in place (delayed by latency())
+    int16_t* drain(size_t& count);      // Push the delayed tail out with silence, returns it
+    bool holdsAudio();                  // The delay holds samples not yet drained
+    void reset();                       // Drop the delayed samples and return to unity gain
+    size_t latency();                   // Delay added to the stream, in samples
+    int32_t getGain();                  // Current Q15 gain, for metering
+    static void benchmark();            // Check the ceiling and print the cost of a block
+
+private:
+    struct Curve {
+        int32_t gain[COMP_CURVE_POINTS]; // Q15 gain for peak levels 0, 256, ... 32768
+        int32_t attack;                 // Q15 share of the gap closed per sub-block going down
+        int32_t release;                // Q15 share of the gap closed per sub-block going up
+    };
+
+    void completeSubBlock();            // Peak the filled slot and scale the next one to output
+    int32_t curveGain(const Curve& curve, int32_t peak); // Interpolated target gain for a peak
+    static int32_t msToCoefficient(int ms); // Time constant to a per-sub-block Q15 coefficient
+    Curve m_curves[2];                  // Active and staging copy of the curve
+    volatile uint8_t m_active;          // Index of the curve the processing task uses
+    Settings m_settings;                // Settings of the active curve
+    int16_t m_delay[COMP_DELAY_SAMPLES]; // Look-ahead delay, COMP_LOOKAHEAD_BLOCKS + 1 slots
+    int32_t m_peaks[COMP_LOOKAHEAD_BLOCKS + 1]; // Peak of each slot when it was filled
+    size_t m_slot;                      // Slot being filled (and emptied)
+    size_t m_pos;                       // Next sample in that slot
+    int32_t m_gain;                     // Smoothed Q15 gain
+    int32_t m_ceiling;                  // COMP_CEILING_DB as a sample value
+    bool m_holding;                     // Audio went in since the last drain() or reset()
+    int16_t m_tail[COMP_DELAY_SAMPLES]; // Output of drain()
+};
+
+#endif // COMPRESSOR_H
@@ -38,6 +38,9 @@
 #define WIFIPASS "WIFPASS"                                   ///< Wi-Fi password
 #define RESET_FLAG "RST"                                     ///< Reset flag
 #define FIRMWARE_VERSION "FIRVER"
+#define COMP_THRESHOLD_KEY "CMPTHR"                          ///< Compressor threshold, dBFS
+#define COMP_ATTACK_KEY "CMPATK"                             ///< Compressor attack, ms
+#define COMP_RELEASE_KEY "CMPREL"                            ///< Compressor release, ms
 // ==================================================
 // File Paths and Naming
 // ==================================================
@@ -93,7 +96,7 @@
 // ==================================================
 #define MIC_OUT_PIN 38                                       ///< Microphone output pin
 #define MIC_GAIN_PIN 47                                      ///< Microphone gain control pin
-#define MIC_AR_PIN 21                                        ///< Microphone auto gain control pin
+#define MIC_AR_PIN 21                                        ///< Microphone AGC attack/release ratio pin
 #define MIC_RESOLUTION 10                                    ///< Resolution of adc  microphone
 #define MIC_RESOLUTION_MIN 0                                 ///< Minimum resolution for microphone
 #define MIC_RESOLUTION_MAX 1024                              ///< Maximum resolution for microphone
@@ -189,6 +192,119 @@
 #define RECORDING_LENGTH 2100                                ///< Recording length in milliseconds
 #define SAMPLE_RATE 8000                                     ///< Sample rate in Hz
 #define CHANNEL 1                                            ///< Mono channel
+#define MIC_FRAME_SAMPLES 256                                ///< Samples per capture frame delivered by MicManager (divides RECORD_RING_SAMPLES)
+#define MIC_ADC_BITS 12                                      ///< ADC resolution used by the continuous capture mode
+#define MIC_ADC_ATTEN ADC_ATTEN_DB_11                        ///< ADC attenuation of the microphone channel
+#define MIC_CAPTURE_POLLING 0                                ///< 1 captures with the timed analogRead loop even on an ADC1 pin, to compare it with DMA capture
+#define MIC_DC_SHIFT 7                                       ///< DC blocker time constant, 2^shift samples (16 ms, about 10 Hz at 8 kHz)
+#define MIC_GAIN_LEVELS 3                                    ///< Hardware gain levels of the microphone amplifier
+#define MIC_GAIN_MIN_DB 40                                   ///< Gain of the lowest hardware level
+#define MIC_GAIN_STEP_DB 10                                  ///< Gain between two hardware levels
+#define MIC_GAIN_DEFAULT_LEVEL 1                             ///< Hardware level set by begin() (50 dB)
+#define MIC_DMA_POOL_SIZE 4096                               ///< Bytes of ADC DMA results the driver can hold before it overflows
+#define MIC_CAPTURE_TASK_PRIORITY 6                          ///< Priority of the microphone capture task
+#define MIC_CAPTURE_STACK_SIZE 4096                          ///< Stack size of the microphone capture task
+#define RECORD_WRITER_TASK_PRIORITY 4                        ///< Priority of the recording SD writer task
+#define RECORD_WRITER_STACK_SIZE 4096                        ///< Stack size of the recording SD writer task
+#define NOISE_FFT_SIZE 256                                   ///< Noise suppressor frame in samples (power of two, 32 ms at 8 kHz)
+#define NOISE_LEARN_MS 300                                   ///< Opening span of a recording the noise profile is learnt from
+#define NOISE_OVERSUBTRACT_DB 3                              ///< Scale of the noise profile in the subtraction (over-subtraction)
+#define NOISE_FLOOR_DB -18                                   ///< Strongest attenuation of a frequency bin, keeps residual noise smooth
+#define NOISE_UPDATE_DB 3                                    ///< Frames within this of the noise profile keep refining it
+#define NOISE_TRACK_SHIFT 4                                  ///< Each such frame moves the profile 1/2^shift of the way
+#define NOISE_CPU_BUDGET_PERCENT 5                           ///< Share of a core the suppressor may use, checked per frame
+#define VAD_FRAME_MS 10                                      ///< Voice detector analysis frame
+#define VAD_ENERGY_DB 9                                      ///< Frames this far above the noise floor are speech if their zero-crossing rate is low
+#define VAD_STRONG_DB 18                                     ///< Frames this far above the noise floor are speech whatever their zero-crossing rate
+#define VAD_ZCR_MAX_HZ 1500                                  ///< Zero-crossing rate (as a frequency) above which a frame counts as hiss
+#define VAD_ONSET_FRAMES 3                                   ///< Speech frames in a row that start speech
+#define VAD_HANGOVER_MS 300                                  ///< Speech is held this long after its last frame
+#define VAD_FLOOR_SHIFT 4                                    ///< Noise floor rises 1/2^shift of the way per silent frame
+#define VAD_PREROLL_MS 200                                   ///< Audio kept before the first speech of a recording
+#define VAD_TAIL_MS 200                                      ///< Silence kept after the last speech (after the hangover)
+#define VAD_STOP_MS 2000                                     ///< Silence after speech that ends a recording
+#define AGC_FRAME_MS 20                                      ///< Recording AGC analysis frame
+#define AGC_TARGET_DBFS -28                                  ///< RMS level of speech the AGC aims for
+#define AGC_PEAK_DBFS -12                                    ///< Peaks of the recording are kept below this
+#define AGC_GATE_DBFS -60                                    ///< Frames quieter than this never raise the gain
+#define AGC_AVERAGE_MS 400                                   ///< Time constant of the speech level the AGC follows
+#define AGC_DEADBAND_DB 2                                    ///< Level error the digital gain tolerates before it moves
+#define AGC_HYSTERESIS_DB 3                                  ///< Error beyond the digital range before the hardware level switches
+#define AGC_RELEASE_MS 150                                   ///< Time per 1 dB step of rising gain (falling gain steps at once)
+#define AGC_SWITCH_HOLD_MS 1000                              ///< Least time between hardware level switches, and after a start
+#define AGC_MAX_CUT_DB 24                                    ///< Strongest digital attenuation
+#define AGC_LOG_STEPS 96                                     ///< Gain steps of a recording logged in its WAV file
+#define PRETRIGGER_MS 500                                    ///< Audio kept in the capture ring while armed, prepended to the next recording
+
+// ==================================================
+// Audio Playback Pipeline
+// ==================================================
+#define AUDIO_SECTOR_SIZE 512                                ///< SD card sector size in bytes, reads are aligned to it
+#define AUDIO_BLOCK_SIZE 4096                                ///< Bytes per playback block (multiple of AUDIO_SECTOR_SIZE)
+#define AUDIO_RING_SAMPLES 16384                             ///< Playback ring capacity in 16-bit samples (power of two)
+#define RECORD_RING_SAMPLES 8192                             ///< Capture ring capacity in 16-bit samples (power of two, PRETRIGGER_MS plus 4096 of headroom)
+#define AUDIO_READER_TASK_PRIORITY 4                         ///< Priority of the SD reader task
+#define AUDIO_WRITER_TASK_PRIORITY 5                         ///< Priority of the I2S writer task
+#define AUDIO_TASK_POLL_MS 20                                ///< Max wait in a pipeline task before re-checking the playback state
+#define AUDIO_OUTPUT_RATE 44100                              ///< Single rate the output engine runs at, lower rates are resampled to it
+#define I2S_DEFAULT_SAMPLE_RATE AUDIO_OUTPUT_RATE            ///< Sample rate the output engine starts with
+#define AUDIO_OUTPUT_CHANNELS 2                              ///< Channels of the output engine (16-bit interleaved stereo)
+#define RESAMPLER_STAGE_SAMPLES 1024                         ///< Decoded samples staged per step before resampling
+#define I2S_DMA_BUF_COUNT 4                                  ///< Number of I2S DMA descriptors, kept allocated across tracks
+#define I2S_DMA_BUF_LEN 512                                  ///< Frames per I2S DMA descriptor
+#define I2S_WRITER_STACK_SIZE 4096                           ///< Stack size of the I2S writer task
+#define PLAYBACK_QUEUE_LENGTH 16                             ///< Maximum number of segments waiting in the playback queue
+#define PLAYBACK_PATH_MAX 128                                ///< Maximum path length of a queued segment, including the terminator
+#define SEQUENCER_STACK_SIZE 4096                            ///< Stack size of the playback sequencer task
+#define SEQUENCER_TASK_PRIORITY 3                            ///< Priority of the playback sequencer task
+#define MP3_INPUT_BUFFER_SIZE 4096                           ///< MP3 decoder input buffer, holds at least two maximum-size frames
+#define MP3_READER_STACK_SIZE 8192                           ///< Stack size of the reader task when it runs the MP3 decoder
+#define GAIN_STEP_SAMPLES 16                                 ///< Samples per step of a volume ramp (even, so stereo frames share a gain)
+#define GAIN_RAMP_STEPS 64                                   ///< Steps of a volume ramp, 1024 samples (~12 ms of stereo at 44.1 kHz)
+#define AUDIO_FADE_MS 10                                     ///< Fade-out on pause and stop, fade-in on resume
+#define AUDIO_FADE_STEPS 32                                  ///< Gain steps of a fade
+#define MIXER_VOICES 8                                       ///< Sound effect voices mixed over the narration
+#define MIXER_DUCK_GAIN 10362                                ///< Q15 narration gain while an effect plays (-10 dB)
+#define MIXER_EFFECT_SLOTS 16                                ///< Sound effects that can be preloaded at once
+#define MIXER_EFFECT_MAX_SAMPLES (AUDIO_OUTPUT_RATE * AUDIO_OUTPUT_CHANNELS * 3) ///< Longest preloaded effect, 3 s
+#define MIXER_MAX_RATE_SHIFT 2                               ///< Sounds may be stored at down to AUDIO_OUTPUT_RATE >> MIXER_MAX_RATE_SHIFT
+#define SEEK_INDEX_EXTENSION ".idx"                          ///< Suffix of the seek index sidecar stored next to each audio file
+#define SEEK_MP3_POINT_FRAMES 38                             ///< MPEG frames between two MP3 seek points (~1 s at 44.1 kHz)
+#define SEEK_MP3_PREROLL_FRAMES 2                            ///< MPEG frames decoded ahead of a seek target to refill the bit reservoir
+#define RIFF_CACHE_SLOTS 16                                  ///< Parsed WAV headers kept in RAM, keyed by path, size and time stamp
+#define RIFF_MAX_CHUNKS 32                                   ///< Chunks visited at most when walking a WAV header
+#define PREFETCH_CACHE_BYTES (2 * 1024 * 1024)               ///< PSRAM read-ahead pool for the audio being played
+#define PREFETCH_BLOCK_BYTES 16384                           ///< Bytes per read-ahead block (multiple of AUDIO_SECTOR_SIZE)
+#define PREFETCH_AHEAD_MS 4000                               ///< Audio kept cached ahead of each play head
+#define PREFETCH_STREAMS 4                                   ///< Files read ahead at once (current and upcoming segments)
+#define PREFETCH_MP3_BYTE_RATE 40000                         ///< Bytes per second assumed for MP3 read-ahead (320 kbps)
+#define PREFETCH_TASK_PRIORITY 1                             ///< Priority of the read-ahead task, below every playback task
+#define PREFETCH_STACK_SIZE 4096                             ///< Stack size of the read-ahead task
+#define PROMPT_PARTITION_LABEL "prompts"                     ///< Flash partition holding the packed prompt bank
+#define PROMPT_PARTITION_SUBTYPE 0x40                        ///< Data subtype of the prompt bank partition (custom range)
+#define PROMPT_NAME_MAX 24                                   ///< Bytes of a prompt name in the bank index, terminator included
+#define PROMPT_RATE_SHIFT 1                                  ///< Prompts are stored mono at AUDIO_OUTPUT_RATE >> PROMPT_RATE_SHIFT (22.05 kHz)
+#define COMP_SUBBLOCK_FRAMES 32                              ///< Frames per step of the compressor envelope (~0.7 ms)
+#define COMP_LOOKAHEAD_BLOCKS 4                              ///< Sub-blocks the compressor looks ahead, the output is delayed by that much
+#define COMP_RATIO 4                                         ///< Compression ratio above the threshold
+#define COMP_CEILING_DB -1                                   ///< Limiter ceiling in dBFS, no output sample goes above it
+#define COMP_THRESHOLD_MIN_DB -30                            ///< Lowest threshold accepted
+#define COMP_DEFAULT_THRESHOLD_DB -12                        ///< Compressor threshold in dBFS until one is saved
+#define COMP_DEFAULT_ATTACK_MS 2                             ///< Compressor attack time constant until one is saved
+#define COMP_DEFAULT_RELEASE_MS 150                          ///< Compressor release time constant until one is saved
+#define COMP_CPU_BUDGET_PERCENT 2                            ///< Share of one core the compressor may take at AUDIO_OUTPUT_RATE, checked by its benchmark
+#define LOUDNESS_EXTENSION ".lnd"                            ///< Suffix of the loudness sidecar stored next to each audio file
+#define LOUDNESS_TARGET_LUFS -18                             ///< Integrated loudness every narration track is brought down to
+#define LOUDNESS_MAX_CUT_DB 20                               ///< Largest normalization cut, for files far louder than the target
+#define LOUDNESS_SCAN_ROOT "/"                               ///< Directory the loudness scanner walks
+#define LOUDNESS_SCAN_DEPTH 4                                ///< Directory levels below LOUDNESS_SCAN_ROOT the scanner enters
+#define LOUDNESS_JOB_PATH "/loudness.job"                    ///< Progress of the file being analyzed, to resume after a reboot
+#define LOUDNESS_CHECKPOINT_MS 10000                         ///< Audio analyzed between two saves of the job file
+#define LOUDNESS_RESCAN_MS 300000                            ///< Time between two scans for new or changed files
+#define LOUDNESS_TASK_PRIORITY 1                             ///< Priority of the loudness scanner task, idle work only
+#define LOUDNESS_STACK_SIZE 10240                            ///< Stack size of the loudness scanner task (decodes MP3)
+#define LOUDNESS_IDLE_POLL_MS 500                            ///< Interval at which a held or waiting scanner checks for idle time
+#define AUDIO_TRACK_GAIN_SLOTS 4                             ///< Track normalization gains queued ahead of the writer task
 
 // ==================================================
 // LED and Button Pin Definitions
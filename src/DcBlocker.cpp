@@ -0,0 +1,141 @@
+#include "DcBlocker.h"
+#include <esp_timer.h>
+#include <math.h>
+
+/**
+ * @brief Constructor, the first sample processed seeds the offset.
+ */
+DcBlocker::DcBlocker() {
+    static_assert(MIC_DC_SHIFT > 3 && MIC_DC_SHIFT < 16, "MIC_DC_SHIFT must be 4..15");
+    static_assert(MIC_FRAME_SAMPLES % DC_BLOCKER_SUBBLOCK == 0, "Capture frames must hold whole sub-blocks");
+    reset();
+}
+
+/**
+ * @brief Forgets the offset estimate; the next sample processed seeds it.
+ */
+void DcBlocker::reset() {
+    m_dc = 0;
+    m_offset = 0;
+    m_sum = 0;
+    m_fill = 0;
+    m_seeded = false;
+}
+
+/**
+ * @brief Returns the offset currently subtracted, in sample units.
+ */
+int16_t DcBlocker::getOffset() {
+    return m_offset;
+}
+
+/**
+ * @brief Starts the estimate at the first sample of the stream.
+ */
+void DcBlocker::seed(int16_t first) {
+    m_dc = (int32_t)first << DC_BLOCKER_Q;
+    m_offset = first;
+    m_seeded = true;
+}
+
+/**
+ * @brief Moves the estimate towards the mean of the completed sub-block.
+ *
+ * The sum of 8 samples shifted left by Q - 3 is the mean in Q format; the estimate closes
+ * 2^-(MIC_DC_SHIFT - 3) of the gap per sub-block, i.e. 2^-MIC_DC_SHIFT per sample.
+ */
+void DcBlocker::update() {
+    m_dc += ((m_sum << (DC_BLOCKER_Q - 3)) - m_dc) >> (MIC_DC_SHIFT - 3);
+    m_offset = (int16_t)((m_dc + (1 << (DC_BLOCKER_Q - 1))) >> DC_BLOCKER_Q);
+    m_sum = 0;
+    m_fill = 0;
+}
+
+/**
+ * @brief Removes the offset in place: `x = sat(x - offset)` with the offset updated every sub-block.
+ *
+ * Blocks may have any length; a partial sub-block is carried over to the next call.
+ */
+void DcBlocker::process(int16_t* samples, size_t count) {
+    if (count > 0 && !m_seeded) {
+        seed(samples[0]);
+    }
+    for (size_t i = 0; i < count; i++) {
+        int32_t x = samples[i];
+        int32_t v = x - m_offset;
+        samples[i] = (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+        m_sum += x;
+        if (++m_fill == DC_BLOCKER_SUBBLOCK) {
+            update();
+        }
+    }
+}
+
+/**
+ * @brief Prints the throughput of the blocker and its frequency response.
+ *
+ * Runs on the calling core. The gain of the filter is measured on tones from 5 Hz to 3 kHz at
+ * `SAMPLE_RATE`, after the offset has settled, with the worst residue of the block-wise updates
+ * (everything but the tone) against the tone.
+ */
+void DcBlocker::benchmark() {
+    const size_t samples = MIC_FRAME_SAMPLES * 4;
+    const int rounds = 64;
+    int16_t* vec = new int16_t[samples];
+    DcBlocker* blocker = new DcBlocker();
+    if (!vec || !blocker) {
+        delete[] vec;
+        delete blocker;
+        return;
+    }
+
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < samples; i++) {
+        seed = seed * 1664525UL + 1013904223UL;
+        vec[i] = (int16_t)(((int16_t)(seed >> 16) >> 2) + 2000);
+    }
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        blocker->process(vec, samples);
+    }
+    int64_t elapsedUs = esp_timer_get_time() - start;
+    const uint64_t total = (uint64_t)samples * rounds * 1000000ULL;
+    Serial.printf("DcBlocker: %u samples/s per core\n", (uint32_t)(total / (elapsedUs > 0 ? elapsedUs : 1)));
+
+    // Frequency response: 1 s of settling on a 3000 offset, then 1 s measured
+    const int frequencies[] = { 5, 10, 20, 50, 100, 300, 1000, 3000 };
+    const uint32_t rate = SAMPLE_RATE;
+    Serial.print("DcBlocker: response");
+    float worstResidueDb = -200.0f;
+    for (size_t f = 0; f < sizeof(frequencies) / sizeof(frequencies[0]); f++) {
+        const double w = 2.0 * 3.14159265358979 * frequencies[f] / rate;
+        double energy = 0.0, sinSum = 0.0, cosSum = 0.0;
+        blocker->reset();
+        for (uint32_t done = 0; done < rate * 2; done += samples) {
+            size_t n = rate * 2 - done < samples ? rate * 2 - done : samples;
+            for (size_t i = 0; i < n; i++) {
+                vec[i] = (int16_t)lrint(3000.0 + 8000.0 * sin(w * (done + i)));
+            }
+            blocker->process(vec, n);
+            for (size_t i = 0; i < n; i++) {
+                if (done + i < rate) {
+                    continue; // Settling
+                }
+                double s = sin(w * (done + i)), c = cos(w * (done + i));
+                energy += (double)vec[i] * vec[i];
+                sinSum += vec[i] * s;
+                cosSum += vec[i] * c;
+            }
+        }
+        double tone = 2.0 * (sinSum * sinSum + cosSum * cosSum) / rate; // Fitted tone energy
+        double input = 8000.0 * 8000.0 / 2.0 * rate;
+        double residue = energy - tone;
+        float residueDb = (float)(10.0 * log10((residue > 1.0 ? residue : 1.0) / (tone > 1.0 ? tone : 1.0)));
+        if (residueDb > worstResidueDb) worstResidueDb = residueDb;
+        Serial.printf(" %d Hz %.1f dB,", frequencies[f], 10.0 * log10((tone > 1.0 ? tone : 1.0) / input));
+    }
+    Serial.printf(" residue %.1f dB worst\n", worstResidueDb);
+
+    delete[] vec;
+    delete blocker;
+}
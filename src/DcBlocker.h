@@ -0,0 +1,54 @@
+#ifndef DC_BLOCKER_H
+#define DC_BLOCKER_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * @file DcBlocker.h
+ * @brief Fixed-point DC blocker applied in place to the microphone capture frames.
+ *
+ * The analog microphone sits on a bias voltage, so the raw ADC readings carry a large offset
+ * that drifts with temperature and supply. The `DcBlocker` tracks that offset and subtracts
+ * it, which makes it a first-order high-pass with a time constant of 2^`MIC_DC_SHIFT`
+ * samples (about 10 Hz at 8 kHz).
+ *
+ * The stream is handled in sub-blocks of `DC_BLOCKER_SUBBLOCK` samples. Within a sub-block the offset is constant: every sample has the same value
+ * subtracted (with saturation), and the sum of the sub-block then moves the offset estimate
+ * towards the sub-block mean by 2^-(`MIC_DC_SHIFT` - 3). The estimate is Q`DC_BLOCKER_Q`, so
+ * slow drifts are followed without rounding stalls. The first sample after `reset()` seeds it,
+ * so a recording does not start with a thump.
+ *
+ * `benchmark()` prints the throughput and the frequency response of the filter; the
+ * `test_target_dsp` suite runs it on the board.
+ *
+ * ## Example:
+ * ```cpp
+ * DcBlocker dcBlocker;
+ * dcBlocker.reset();                  // New capture
+ * dcBlocker.process(frame, count);    // Each capture frame, in place
+ * ```
+ */
+
+#define DC_BLOCKER_SUBBLOCK 8                                ///< Samples per offset update
+#define DC_BLOCKER_Q 12                                      ///< Fraction bits of the offset estimate
+
+class DcBlocker {
+public:
+    DcBlocker();
+    void reset();                       // Forget the offset, the next sample seeds it
+    void process(int16_t* samples, size_t count); // Remove the offset in place
+    int16_t getOffset();                // Offset being subtracted
+    static void benchmark();            // Print throughput and response
+
+private:
+    void seed(int16_t first);           // Start the estimate at the first sample
+    void update();                      // Move the estimate with the completed sub-block
+    int32_t m_dc;                       // Offset estimate, Q DC_BLOCKER_Q
+    int16_t m_offset;                   // m_dc rounded, subtracted from the current sub-block
+    int32_t m_sum;                      // Sum of the current sub-block so far
+    size_t m_fill;                      // Samples of the current sub-block so far
+    bool m_seeded;                      // The estimate has been seeded since reset()
+};
+
+#endif // DC_BLOCKER_H
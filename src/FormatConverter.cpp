@@ -0,0 +1,114 @@
+#include "FormatConverter.h"
+
+// Little-endian sample readers, each returns the top 16 bits of one sample
+struct Pcm8 {
+    static const size_t bytes = 1;
+    static inline int16_t read(const uint8_t* p) { return (int16_t)((p[0] - 128) << 8); } // Unsigned, offset 128
+};
+struct Pcm16 {
+    static const size_t bytes = 2;
+    static inline int16_t read(const uint8_t* p) { return (int16_t)(p[0] | (p[1] << 8)); }
+};
+struct Pcm24 {
+    static const size_t bytes = 3;
+    static inline int16_t read(const uint8_t* p) { return (int16_t)(p[1] | (p[2] << 8)); }
+};
+struct Pcm32 {
+    static const size_t bytes = 4;
+    static inline int16_t read(const uint8_t* p) { return (int16_t)(p[2] | (p[3] << 8)); }
+};
+
+/**
+ * @brief Converts a block of frames for one sample width and channel mapping.
+ *
+ * `In` and `Out` are template constants, so the channel mapping is resolved at compile time
+ * and each instance is a single loop.
+ */
+template <class Sample, int In, int Out>
+static void convertFrames(const uint8_t* in, int16_t* out, size_t frames) {
+    for (size_t i = 0; i < frames; i++, in += Sample::bytes * In) {
+        if (In == Out) {
+            for (int c = 0; c < In; c++) {
+                out[c] = Sample::read(in + c * Sample::bytes);
+            }
+            out += Out;
+        } else if (In == 1) {
+            int16_t s = Sample::read(in); // Mono to stereo: same sample on both channels
+            out[0] = s;
+            out[1] = s;
+            out += 2;
+        } else {
+            int32_t sum = (int32_t)Sample::read(in) + Sample::read(in + Sample::bytes); // Stereo to mono
+            *out++ = (int16_t)(sum >> 1);
+        }
+    }
+}
+
+// Indexed by [bytes per sample - 1][input channels - 1][output channels - 1]
+static const FormatConverter::Kernel kKernels[4][2][2] = {
+    { { convertFrames<Pcm8, 1, 1>,  convertFrames<Pcm8, 1, 2>  }, { convertFrames<Pcm8, 2, 1>,  convertFrames<Pcm8, 2, 2>  } },
+    { { convertFrames<Pcm16, 1, 1>, convertFrames<Pcm16, 1, 2> }, { convertFrames<Pcm16, 2, 1>, convertFrames<Pcm16, 2, 2> } },
+    { { convertFrames<Pcm24, 1, 1>, convertFrames<Pcm24, 1, 2> }, { convertFrames<Pcm24, 2, 1>, convertFrames<Pcm24, 2, 2> } },
+    { { convertFrames<Pcm32, 1, 1>, convertFrames<Pcm32, 1, 2> }, { convertFrames<Pcm32, 2, 1>, convertFrames<Pcm32, 2, 2> } },
+};
+
+/**
+ * @brief Constructor, defaults to 16-bit stereo passthrough.
+ */
+FormatConverter::FormatConverter()
+    : m_kernel(kKernels[1][1][1]), m_bits(16), m_inChannels(2), m_outChannels(2) {}
+
+/**
+ * @brief Selects the kernel for a file's sample format.
+ *
+ * @param bits Bits per input sample: 8 (unsigned), 16, 24 or 32 (signed).
+ * @param inChannels Input channels, 1 or 2.
+ * @param outChannels Output channels, 1 or 2.
+ * @return true if the format is supported.
+ */
+bool FormatConverter::begin(uint16_t bits, uint16_t inChannels, uint16_t outChannels) {
+    if ((bits != 8 && bits != 16 && bits != 24 && bits != 32) ||
+        inChannels < 1 || inChannels > 2 || outChannels < 1 || outChannels > 2) {
+        Serial.println("Unsupported PCM sample format.");
+        return false;
+    }
+    m_bits = bits;
+    m_inChannels = inChannels;
+    m_outChannels = outChannels;
+    m_kernel = kKernels[bits / 8 - 1][inChannels - 1][outChannels - 1];
+    return true;
+}
+
+/**
+ * @brief Returns true if the input is already 16-bit with the output channel count.
+ *
+ * Callers skip `convert()` in that case and keep their zero-copy path.
+ */
+bool FormatConverter::isPassthrough() {
+    return m_bits == 16 && m_inChannels == m_outChannels;
+}
+
+/**
+ * @brief Returns the number of bytes per input frame.
+ */
+size_t FormatConverter::inputFrameBytes() {
+    return (size_t)(m_bits / 8) * m_inChannels;
+}
+
+/**
+ * @brief Returns the number of channels per output frame.
+ */
+uint16_t FormatConverter::outputChannels() {
+    return m_outChannels;
+}
+
+/**
+ * @brief Converts a block of frames with the kernel selected by `begin()`.
+ *
+ * @param in `frames * inputFrameBytes()` bytes of input, no alignment required.
+ * @param out Destination for `frames * outputChannels()` samples; must not overlap `in`.
+ * @param frames Number of frames.
+ */
+void FormatConverter::convert(const uint8_t* in, int16_t* out, size_t frames) {
+    m_kernel(in, out, frames);
+}
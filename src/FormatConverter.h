@@ -0,0 +1,46 @@
+#ifndef FORMAT_CONVERTER_H
+#define FORMAT_CONVERTER_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * @file FormatConverter.h
+ * @brief Block conversion of PCM sample formats and channel layouts to 16-bit output.
+ *
+ * The output engine plays 16-bit interleaved stereo, while files come as 8-bit unsigned,
+ * 16/24/32-bit signed PCM, in mono or stereo. The `FormatConverter` turns blocks of any of these
+ * into 16-bit samples with the requested channel count: mono is duplicated to both channels,
+ * stereo is downmixed to mono as `(L + R) / 2`, and wider samples keep their top 16 bits.
+ *
+ * `begin()` selects one kernel from the format, once per file. Every kernel is a template
+ * instance for one sample width and channel mapping, so each is a plain loop over the frames
+ * with no per-sample branches.
+ *
+ * ## Example:
+ * ```cpp
+ * FormatConverter format;
+ * format.begin(header.bits_per_samp, header.num_chans, AUDIO_OUTPUT_CHANNELS);
+ * format.convert(raw, samples, frames); // frames * outputChannels() samples written
+ * ```
+ */
+
+class FormatConverter {
+public:
+    typedef void (*Kernel)(const uint8_t* in, int16_t* out, size_t frames);
+
+    FormatConverter();
+    bool begin(uint16_t bits, uint16_t inChannels, uint16_t outChannels); // Select the kernel, false if unsupported
+    bool isPassthrough();               // 16-bit input with the output channel count, no conversion needed
+    size_t inputFrameBytes();           // Bytes per input frame
+    uint16_t outputChannels();          // Channels per output frame
+    void convert(const uint8_t* in, int16_t* out, size_t frames); // Convert a block of frames
+
+private:
+    Kernel m_kernel;                    // Selected by begin()
+    uint16_t m_bits;                    // Input bits per sample
+    uint16_t m_inChannels;              // Input channels, 1 or 2
+    uint16_t m_outChannels;             // Output channels, 1 or 2
+};
+
+#endif // FORMAT_CONVERTER_H
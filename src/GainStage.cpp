@@ -0,0 +1,153 @@
+#include "GainStage.h"
+#include <esp_timer.h>
+
+/**
+ * @brief Constructor, the stage starts at unity gain (bypassed).
+ */
+GainStage::GainStage()
+    : m_target(GAIN_UNITY), m_current(GAIN_UNITY), m_rampFrom(GAIN_UNITY), m_rampTo(GAIN_UNITY),
+      m_rampStep(0), m_stepLeft(0), m_rampSteps(GAIN_RAMP_STEPS), m_stepSamples(GAIN_STEP_SAMPLES) {}
+
+/**
+ * @brief Constructor for a stage with its own ramp length, starting at unity gain.
+ *
+ * @param rampSteps Steps of a ramp, at least 1.
+ * @param stepSamples Samples per step, rounded down to an even count of at least 2.
+ */
+GainStage::GainStage(uint32_t rampSteps, size_t stepSamples)
+    : m_target(GAIN_UNITY), m_current(GAIN_UNITY), m_rampFrom(GAIN_UNITY), m_rampTo(GAIN_UNITY),
+      m_rampStep(0), m_stepLeft(0), m_rampSteps(rampSteps > 0 ? rampSteps : 1),
+      m_stepSamples(stepSamples >= 2 ? stepSamples & ~(size_t)1 : 2) {}
+
+/**
+ * @brief Sets the gain to ramp towards.
+ *
+ * Safe to call from any task; the ramp starts at the next step boundary of the stream.
+ *
+ * @param gain Q15 gain, clamped to 0..GAIN_UNITY.
+ */
+void GainStage::setTarget(int32_t gain) {
+    m_target = constrain(gain, 0, GAIN_UNITY);
+}
+
+/**
+ * @brief Returns the gain the stage is ramping towards.
+ */
+int32_t GainStage::getTarget() {
+    return m_target;
+}
+
+/**
+ * @brief Sets the gain at once, dropping any ramp in progress.
+ *
+ * Only for the task that calls `process()`, when nothing is being heard (the output is about
+ * to stop, say), so the jump cannot click.
+ */
+void GainStage::jumpTo(int32_t gain) {
+    gain = constrain(gain, 0, GAIN_UNITY);
+    m_target = gain;
+    m_current = gain;
+    m_rampFrom = gain;
+    m_rampTo = gain;
+    m_rampStep = 0;
+    m_stepLeft = 0;
+}
+
+/**
+ * @brief Returns true once the gain has reached the target, i.e. no ramp is in progress.
+ */
+bool GainStage::isSettled() {
+    return m_current == m_target;
+}
+
+/**
+ * @brief Maps a 0..100 % volume to a Q15 gain.
+ *
+ * The gain follows the square of the volume, which is closer to perceived loudness than a
+ * linear map: 50 % is about -12 dB, 10 % about -40 dB.
+ */
+int32_t GainStage::volumeToGain(uint8_t percent) {
+    if (percent > 100) percent = 100;
+    return (int32_t)((uint32_t)percent * percent * GAIN_UNITY / 10000);
+}
+
+/**
+ * @brief Applies the gain to a block in place, advancing any ramp in progress.
+ *
+ * @param samples Interleaved 16-bit samples.
+ * @param count Number of samples. Keep it even for stereo so both channels of a frame
+ *              always get the same gain.
+ */
+void GainStage::process(int16_t* samples, size_t count) {
+    while (count > 0) {
+        if (m_stepLeft == 0) {
+            int32_t target = m_target;
+            if (target != m_rampTo) {
+                m_rampFrom = m_current; // Retarget from wherever the last ramp got to
+                m_rampTo = target;
+                m_rampStep = 0;
+            }
+            if (m_current == m_rampTo) {
+                if (m_current < GAIN_UNITY) {
+                    scale(samples, count, (int16_t)m_current);
+                }
+                return; // Steady gain for the rest of the block
+            }
+            m_rampStep++;
+            m_current = m_rampFrom + (m_rampTo - m_rampFrom) * (int32_t)m_rampStep / (int32_t)m_rampSteps;
+            m_stepLeft = m_stepSamples;
+        }
+
+        size_t n = count < m_stepLeft ? count : m_stepLeft;
+        if (m_current < GAIN_UNITY) {
+            scale(samples, n, (int16_t)m_current);
+        }
+        samples += n;
+        count -= n;
+        m_stepLeft -= n;
+    }
+}
+
+/**
+ * @brief Scales a block in place: `x = (x * gain) >> 15` with saturation.
+ *
+ * The shift truncates towards minus infinity; the gain never exceeds 32767 inside the stage,
+ * so the saturation only matters for gains outside its range.
+ */
+void GainStage::scale(int16_t* samples, size_t count, int16_t gain) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t v = ((int32_t)samples[i] * gain) >> 15;
+        samples[i] = (int16_t)(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+    }
+}
+
+/**
+ * @brief Prints the throughput of the kernel.
+ *
+ * Runs on the calling core with a 2 KB block of noise. Takes a few milliseconds.
+ */
+void GainStage::benchmark() {
+    const size_t samples = 1024;
+    const int rounds = 64;
+    int16_t* block = new int16_t[samples];
+    if (!block) {
+        return;
+    }
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < samples; i++) {
+        seed = seed * 1664525UL + 1013904223UL;
+        block[i] = (int16_t)(seed >> 16);
+    }
+
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) {
+        scale(block, samples, 32767); // Keeps the level, so every round scales noise
+    }
+    int64_t totalUs = esp_timer_get_time() - start;
+    delete[] block;
+
+    const uint64_t total = (uint64_t)samples * rounds * 1000000ULL;
+    Serial.print("GainStage: ");
+    Serial.print((uint32_t)(total / (totalUs > 0 ? totalUs : 1)));
+    Serial.println(" samples/s per core");
+}
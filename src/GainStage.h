@@ -0,0 +1,57 @@
+#ifndef GAIN_STAGE_H
+#define GAIN_STAGE_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * @file GainStage.h
+ * @brief Q15 fixed-point volume stage applied in place to the playback blocks.
+ *
+ * The `GainStage` scales 16-bit samples by a Q15 gain: `out = (in * gain) >> 15`. The gain is
+ * at most 32767 below unity, so the product always fits 16 bits; unity (`GAIN_UNITY`) skips
+ * the block entirely. The kernel saturates anyway, which keeps it safe if the range is ever
+ * widened. `benchmark()` prints its throughput (`pio test -e esp32-s3-dsp-test` on the board).
+ *
+ * A new target is never applied in one step. The stage ramps from the current gain to the
+ * target over `GAIN_RAMP_STEPS` steps of `GAIN_STEP_SAMPLES` samples each, with the gain
+ * constant within a step, so volume changes do not click. The step position follows the
+ * sample stream, not the block boundaries, so the result does not depend on how the stream
+ * is split into blocks. The ramp length can be set per stage: the output engine runs a second,
+ * shorter stage to fade in and out on pause, resume and stop.
+ *
+ * ## Example:
+ * ```cpp
+ * GainStage gain;
+ * gain.setTarget(GainStage::volumeToGain(60));
+ * gain.process(samples, count); // Called by the I2S writer task on every block
+ * ```
+ */
+
+#define GAIN_UNITY 32768                                     ///< Q15 unity gain, the stage is bypassed at this value
+
+class GainStage {
+public:
+    GainStage();
+    GainStage(uint32_t rampSteps, size_t stepSamples); // Stage with its own ramp length
+    void setTarget(int32_t gain);       // Ramp towards a Q15 gain (0..GAIN_UNITY)
+    int32_t getTarget();                // Gain the stage is ramping towards
+    void jumpTo(int32_t gain);          // Set the gain at once, no ramp (processing task only)
+    bool isSettled();                   // The ramp has reached the target
+    void process(int16_t* samples, size_t count); // Apply the gain in place
+    static int32_t volumeToGain(uint8_t percent); // Perceptual 0..100 % volume to a Q15 gain
+    static void scale(int16_t* samples, size_t count, int16_t gain); // Q15 kernel with saturation
+    static void benchmark();            // Print the kernel's samples/s per core
+
+private:
+    volatile int32_t m_target;          // Written by setTarget(), read by the processing task
+    int32_t m_current;                  // Gain of the current step
+    int32_t m_rampFrom;                 // Gain when the current ramp started
+    int32_t m_rampTo;                   // Target of the current ramp
+    uint32_t m_rampStep;                // Steps of the current ramp done
+    size_t m_stepLeft;                  // Samples left at m_current before the next ramp step
+    uint32_t m_rampSteps;               // Steps of a ramp
+    size_t m_stepSamples;               // Samples per ramp step, even
+};
+
+#endif // GAIN_STAGE_H
@@ -3,90 +3,594 @@
 /**
  * @brief Constructs the I2SManager with the specified pin configuration and sample rate.
  * 
- * Initializes the I2S configuration with parameters suitable for 16-bit stereo audio.
- * It also installs the I2S driver and sets the provided pins for the I2S communication.
+ * Prepares the I2S configuration with parameters suitable for 16-bit stereo audio.
+ * The driver itself is installed by `begin()`, once, and stays installed until `end()`.
  * 
  * @param pins Configuration structure defining the GPIO pins for I2S signals.
  * @param sample_rate The sample rate for audio data, typically 44100Hz or 48000Hz for audio playback.
  */
-I2SManager::I2SManager(i2s_pin_config_t pins, int sample_rate) {
+I2SManager::I2SManager(i2s_pin_config_t pins, int sample_rate)
+    : pins(pins), playing(false), installed(false), xWriterTask(NULL), flushRequested(false),
+      haltRequested(false), waitingFirstSample(false), trackStartUs(0), firstSampleLatencyUs(0), lastGapFrames(0),
+      effectStartLatencyUs(0), underrunFrames(0), starvedSinceUs(0),
+      fade(AUDIO_FADE_STEPS, I2S_FADE_STEP_SAMPLES), gainedAhead(0) {
+    trackGainHead = 0;
+    trackGainTail = 0;
+    memset(&i2s_config, 0, sizeof(i2s_config));
+    i2s_config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX);
     i2s_config.sample_rate = sample_rate;
     i2s_config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
     i2s_config.channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT;
     i2s_config.communication_format = I2S_COMM_FORMAT_I2S;
-    i2s_config.dma_buf_count = 8;
-    i2s_config.dma_buf_len = 1024;
-
-    i2s_set_pin(I2S_NUM_0, &pins);
-    i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL);
+    i2s_config.intr_alloc_flags = ESP_INTR_FLAG_LEVEL1;
+    i2s_config.dma_buf_count = I2S_DMA_BUF_COUNT;
+    i2s_config.dma_buf_len = I2S_DMA_BUF_LEN;
+    i2s_config.tx_desc_auto_clear = true; // Output silence instead of stale samples on underrun
+}
 
-    playing = false;
+/**
+ * @brief Destroys the I2SManager, stopping the writer task and uninstalling the driver.
+ */
+I2SManager::~I2SManager() {
+    end();
 }
 
 /**
  * @brief Begins I2S audio streaming.
  * 
- * Starts the I2S driver, allowing audio samples to be written to the I2S peripheral.
+ * Installs the I2S driver and allocates its DMA descriptors on the first call, then starts
+ * the driver and the writer task. Later calls only restart the driver.
  * Sets the `playing` flag to true, indicating that I2S streaming is active.
  */
 void I2SManager::begin() {
+    if (!installed) {
+        if (i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL) != ESP_OK) {
+            Serial.println("I2SManager: Failed to install I2S driver.");
+            return;
+        }
+        i2s_set_pin(I2S_NUM_0, &pins);
+        i2s_zero_dma_buffer(I2S_NUM_0);
+        installed = true;
+    }
+
+    if (!xWriterTask) {
+        xTaskCreate(writerTask, "I2SWriterTask", I2S_WRITER_STACK_SIZE, this, AUDIO_WRITER_TASK_PRIORITY, &xWriterTask);
+    }
+
+    fade.setTarget(GAIN_UNITY);
     i2s_start(I2S_NUM_0);
     playing = true;
 }
 
 /**
- * @brief Writes a single audio sample to the I2S peripheral.
+ * @brief Stops the writer task and uninstalls the I2S driver, releasing its DMA buffers.
+ */
+void I2SManager::end() {
+    if (xWriterTask) {
+        vTaskDelete(xWriterTask);
+        xWriterTask = NULL;
+    }
+    if (installed) {
+        i2s_stop(I2S_NUM_0);
+        i2s_driver_uninstall(I2S_NUM_0);
+        installed = false;
+    }
+    playing = false;
+}
+
+/**
+ * @brief Retunes the I2S clock to a new sample rate.
  * 
- * Sends the provided 16-bit sample to the I2S hardware, blocking until the sample is 
- * written to the I2S buffer. Only writes if `playing` is true.
+ * Only the clock is reprogrammed; the driver stays installed and the DMA descriptors keep
+ * their allocation because the frame format does not change. Nothing is done if the rate
+ * is already current.
+ * 
+ * @param sample_rate The new sample rate in Hz.
+ * @return true if the engine now runs at `sample_rate`.
+ */
+bool I2SManager::setSampleRate(int sample_rate) {
+    if (sample_rate <= 0) {
+        return false;
+    }
+    if ((uint32_t)sample_rate == i2s_config.sample_rate) {
+        return true;
+    }
+    if (installed && i2s_set_clk(I2S_NUM_0, sample_rate, i2s_config.bits_per_sample, I2S_CHANNEL_STEREO) != ESP_OK) {
+        Serial.println("I2SManager: Failed to retune I2S clock.");
+        return false;
+    }
+    i2s_config.sample_rate = sample_rate;
+
+    if (!playing && installed) {
+        i2s_stop(I2S_NUM_0); // i2s_set_clk restarts the driver, keep it stopped while paused
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the current output sample rate.
+ */
+int I2SManager::getSampleRate() {
+    return i2s_config.sample_rate;
+}
+
+/**
+ * @brief Queues a single audio sample for the I2S peripheral.
+ * 
+ * The sample is placed in the playback ring and written out by the writer task.
+ * Only one task may produce samples at a time.
  * 
  * @param sample The 16-bit signed integer sample to send to the I2S peripheral.
  */
 void I2SManager::writeSample(int16_t sample) {
-    if (playing) {
-        size_t bytes_written;
-        i2s_write(I2S_NUM_0, &sample, sizeof(sample), &bytes_written, portMAX_DELAY);
+    writeBlock(&sample, 1);
+}
+
+/**
+ * @brief Queues a block of interleaved 16-bit samples for the I2S peripheral.
+ * 
+ * Copies as much of the block as currently fits into the playback ring. Producers that
+ * can fill the ring in place should use `ring()` instead to avoid the copy.
+ * 
+ * @param samples Pointer to the interleaved sample data.
+ * @param count Number of samples to queue.
+ * @return The number of samples accepted by the ring.
+ */
+size_t I2SManager::writeBlock(const int16_t* samples, size_t count) {
+    return playbackRing.write(samples, count);
+}
+
+/**
+ * @brief Returns the playback ring drained by the writer task.
+ */
+I2SManager::PlaybackRing& I2SManager::ring() {
+    return playbackRing;
+}
+
+/**
+ * @brief Drops every queued sample and clears the DMA buffers.
+ * 
+ * The producer must be stopped before calling this. The ring is emptied by the writer task
+ * itself, as its only consumer; this call waits until that has happened.
+ */
+void I2SManager::flush() {
+    if (!xWriterTask) {
+        playbackRing.reset();
+        return;
+    }
+
+    flushRequested = true;
+    TickType_t start = xTaskGetTickCount();
+    while (flushRequested && (xTaskGetTickCount() - start) < pdMS_TO_TICKS(AUDIO_TASK_POLL_MS * 10)) {
+        vTaskDelay(1);
+    }
+}
+
+/**
+ * @brief Starts timing a new track.
+ * 
+ * The writer task records the elapsed time once the first sample queued after this call
+ * has been handed to DMA. Call it just before the producer starts filling the ring.
+ */
+void I2SManager::markTrackStart() {
+    trackStartUs = micros();
+    waitingFirstSample = true;
+}
+
+/**
+ * @brief Returns the time to first sample of the last track, in microseconds.
+ * 
+ * The value covers the time from `markTrackStart()` until the first sample was copied into
+ * the DMA buffers. Add `I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN` frames for the time until it
+ * is heard.
+ */
+uint32_t I2SManager::getFirstSampleLatencyUs() {
+    return firstSampleLatencyUs;
+}
+
+/**
+ * @brief Returns the time to first sample of the last sound effect or prompt, in microseconds.
+ *
+ * Measured like `getFirstSampleLatencyUs()`, from `AudioMixer::play()` until the block holding
+ * its first sample was copied into the DMA buffers. While a track plays the effect waits for
+ * the next block; on an idle engine only the wake-up and one mix are paid.
+ */
+uint32_t I2SManager::getEffectStartLatencyUs() {
+    return effectStartLatencyUs;
+}
+
+/**
+ * @brief Records the start latency of the effects first mixed into the block just written.
+ */
+void I2SManager::noteEffectStart() {
+    uint32_t startedUs = effects.takeStartedUs();
+    if (startedUs != 0) {
+        effectStartLatencyUs = micros() - startedUs;
+        if (DEBUGMODE) {
+            Serial.print("I2SManager: Effect time to first sample ");
+            Serial.print(effectStartLatencyUs);
+            Serial.println(" us");
+        }
+    }
+}
+
+/**
+ * @brief Returns the number of silent frames heard before the last track started.
+ *
+ * For a track spliced behind the previous one this is the inter-segment gap; 0 means the
+ * splice was sample accurate. Silence still covered by queued DMA buffers is not counted.
+ */
+uint32_t I2SManager::getLastGapFrames() {
+    return lastGapFrames;
+}
+
+/**
+ * @brief Returns the number of silent frames heard because the ring ran dry while playing.
+ */
+uint32_t I2SManager::getUnderrunFrames() {
+    return underrunFrames;
+}
+
+/**
+ * @brief Sets the output volume.
+ *
+ * The writer task ramps to the new gain over `GAIN_RAMP_STEPS * GAIN_STEP_SAMPLES` samples.
+ * 100 % plays samples unchanged.
+ *
+ * @param percent Volume from 0 to 100 %, mapped to a Q15 gain by `GainStage::volumeToGain()`.
+ */
+void I2SManager::setVolume(uint8_t percent) {
+    gain.setTarget(GainStage::volumeToGain(percent));
+}
+
+/**
+ * @brief Sets the loudness normalization gain of the samples queued from now on.
+ *
+ * Called by the producer before it queues the first sample of a track (`WAVFileReader` does
+ * so in `startPlayback()` with the gain of its loudness sidecar). The writer task ramps to
+ * the gain when that sample comes up, so the track still playing from the ring keeps its own
+ * gain. Only the narration is normalized; effects and prompts are not.
+ *
+ * @param gain Q15 gain, at most GAIN_UNITY.
+ */
+void I2SManager::setTrackGain(int32_t gain) {
+    if (gain > GAIN_UNITY) gain = GAIN_UNITY;
+    if (gain < 0) gain = 0;
+    uint32_t head = trackGainHead;
+    if (head - trackGainTail >= AUDIO_TRACK_GAIN_SLOTS) {
+        head--; // Full with tracks shorter than the ring: the newest entry is replaced
+    }
+    TrackGain& slot = trackGains[head % AUDIO_TRACK_GAIN_SLOTS];
+    slot.gain = gain;
+    slot.at = playbackRing.writePosition();
+    std::atomic_thread_fence(std::memory_order_release); // The slot before the head that publishes it
+    trackGainHead = head + 1;
+}
+
+/**
+ * @brief Starts the track gains that are due and ends the block at the next one.
+ *
+ * Called by the writer task before it scales the samples of the ring from `gainedAhead` on.
+ *
+ * @param count Samples of the block, more than `gainedAhead`.
+ * @return The samples of the block up to the next track's first sample, if it lies inside.
+ */
+size_t I2SManager::applyTrackGains(size_t count) {
+    const size_t start = playbackRing.readPosition() + gainedAhead;
+    while (trackGainTail != trackGainHead) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const TrackGain& next = trackGains[trackGainTail % AUDIO_TRACK_GAIN_SLOTS];
+        size_t ahead = next.at - start; // Positions wrap, compare by difference
+        if (ahead == 0 || ahead > AUDIO_RING_SAMPLES) {
+            normalize.setTarget(next.gain); // Reached, or flushed before it was reached
+            trackGainTail = trackGainTail + 1;
+            continue;
+        }
+        if (gainedAhead + ahead < count) {
+            count = gainedAhead + ahead; // Scale this track up to its last sample only
+        }
+        break;
     }
+    return count;
+}
+
+/**
+ * @brief Returns the sound effect mixer run by the writer task.
+ */
+AudioMixer& I2SManager::mixer() {
+    return effects;
+}
+
+/**
+ * @brief Returns the compressor and limiter applied to the mix.
+ *
+ * The writer task owns its audio state; other tasks should only call `configure()` and the
+ * getters.
+ */
+Compressor& I2SManager::compressor() {
+    return dynamics;
+}
+
+/**
+ * @brief Converts the current starvation period into audible silent frames.
+ *
+ * The DMA buffers still hold up to `I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN` frames of audio
+ * when the ring runs dry, so only starvation beyond that is heard.
+ *
+ * @param now Current time from micros().
+ */
+uint32_t I2SManager::starvationFrames(uint32_t now) {
+    int32_t elapsedUs = (int32_t)(now - starvedSinceUs);
+    if (elapsedUs <= 0) {
+        return 0; // starvedSinceUs is micros() | 1, up to 1 us ahead
+    }
+    uint64_t frames = (uint64_t)elapsedUs * i2s_config.sample_rate / 1000000ULL;
+    const uint32_t queuedFrames = I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN;
+    return frames > queuedFrames ? (uint32_t)(frames - queuedFrames) : 0;
+}
+
+/**
+ * @brief Writer task implementation.
+ * 
+ * Runs for the lifetime of the engine. While playing, it takes up to one block of samples
+ * from the playback ring, normalizes it, mixes the sound effects over it, compresses the mix,
+ * applies the volume and writes it to the driver in place. With no samples queued but effects playing, it
+ * writes the effects alone. On underrun the driver outputs silence (`tx_desc_auto_clear`), so
+ * the task simply waits for the producer and accounts for the silence once samples arrive
+ * again. Only when the ring has stayed dry for longer than the DMA buffers last does it write
+ * out the compressor's delayed tail: a shorter dry spell is not heard, and draining there
+ * would refill the look-ahead with silence.
+ * 
+ * @param parameter A pointer to the I2SManager instance.
+ */
+void I2SManager::writerTask(void* parameter) {
+    I2SManager* output = static_cast<I2SManager*>(parameter);
+    const size_t blockSamples = AUDIO_BLOCK_SIZE / sizeof(int16_t);
+    const size_t fadeSamples = AUDIO_FADE_STEPS * I2S_FADE_STEP_SAMPLES; // Samples of a whole fade
+
+    while (true) {
+        if (output->flushRequested) {
+            size_t count = output->playbackRing.readAvailable();
+            while (count > 0) {
+                size_t span = count;
+                output->playbackRing.peek(span);
+                output->playbackRing.consume(span);
+                count -= span;
+            }
+            output->gainedAhead = 0;
+            output->dynamics.reset();
+            i2s_zero_dma_buffer(I2S_NUM_0);
+            output->flushRequested = false;
+            continue;
+        }
+
+        if (!output->playing) {
+            output->starvedSinceUs = 0; // Silence while stopped is not an underrun
+            output->effects.service(); // Let stopAll() return while no block is mixed
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_TASK_POLL_MS)); // Paused or stopped, resume() wakes it
+            continue;
+        }
+
+        // While fading out, write no more than the fade so little audio is dropped after it
+        const size_t wanted = output->haltRequested && fadeSamples > 0 && fadeSamples < blockSamples ? fadeSamples : blockSamples;
+        size_t count = wanted;
+        int16_t* span = output->playbackRing.peek(count);
+        if (count == 0 && output->effects.isActive()) {
+            // No track queued: play the effects over silence
+            size_t rendered = wanted;
+            int16_t* block = output->effects.render(rendered);
+            output->dynamics.process(block, rendered);
+            output->gain.process(block, rendered);
+            output->fade.process(block, rendered);
+            if (output->writeToDriver(block, rendered * sizeof(int16_t)) > 0) { // A pause drops the rest of this block
+                output->noteEffectStart();
+            }
+            output->starvedSinceUs = 0; // Not silent
+            output->haltIfFaded();
+            continue;
+        }
+        if (count == 0) {
+            if (output->haltRequested) {
+                output->fade.jumpTo(0); // Nothing left to fade out
+                output->dynamics.reset(); // Its tail would be faded out too
+                output->halt();
+                continue;
+            }
+            if (output->starvedSinceUs == 0) {
+                output->starvedSinceUs = micros() | 1; // Never store 0, it means "not starved"
+            }
+            if (output->dynamics.holdsAudio() && output->starvationFrames(micros()) > 0) {
+                // Dry for longer than the DMA buffers last: the stream has ended, play out
+                // the tail held back by the compressor's look-ahead
+                size_t drained = 0;
+                int16_t* block = output->dynamics.drain(drained);
+                output->gain.process(block, drained);
+                output->fade.process(block, drained);
+                output->writeToDriver(block, drained * sizeof(int16_t));
+                // The tail is not silence: count the gap from the end of the stream without it
+                output->starvedSinceUs += (uint32_t)((uint64_t)drained / AUDIO_OUTPUT_CHANNELS * 1000000ULL / output->i2s_config.sample_rate);
+                output->starvedSinceUs |= 1;
+                continue;
+            }
+            vTaskDelay(1); // Producer has not caught up yet
+            continue;
+        }
+
+        uint32_t gapFrames = 0;
+        if (output->starvedSinceUs != 0) {
+            gapFrames = output->starvationFrames(micros());
+            output->underrunFrames += gapFrames;
+            output->starvedSinceUs = 0;
+        }
+        if (output->waitingFirstSample) {
+            output->lastGapFrames = gapFrames;
+        }
+
+        if (count < output->gainedAhead) {
+            count = output->gainedAhead; // Never split a block that was already mixed and scaled
+        }
+
+        // Mix and scale in place; samples left over from a partial write were already done
+        if (count > output->gainedAhead) {
+            count = output->applyTrackGains(count);
+            output->normalize.process(span + output->gainedAhead, count - output->gainedAhead);
+            output->effects.mix(span + output->gainedAhead, count - output->gainedAhead);
+            output->dynamics.process(span + output->gainedAhead, count - output->gainedAhead);
+            output->gain.process(span + output->gainedAhead, count - output->gainedAhead);
+            output->fade.process(span + output->gainedAhead, count - output->gainedAhead);
+            output->gainedAhead = count;
+        }
+
+        size_t written = output->writeToDriver(span, count * sizeof(int16_t));
+        output->playbackRing.consume(written / sizeof(int16_t)); // Keep anything not written when paused mid-block
+        output->gainedAhead -= written / sizeof(int16_t);
+        if (written > 0) {
+            output->noteEffectStart();
+        }
+        output->haltIfFaded();
+
+        if (written > 0 && output->waitingFirstSample) {
+            output->firstSampleLatencyUs = micros() - output->trackStartUs;
+            output->waitingFirstSample = false;
+            if (DEBUGMODE) {
+                Serial.print("I2SManager: Time to first sample ");
+                Serial.print(output->firstSampleLatencyUs);
+                Serial.print(" us, gap ");
+                Serial.print(output->lastGapFrames);
+                Serial.println(" frames");
+            }
+        }
+    }
+}
+
+/**
+ * @brief Writes a block of interleaved 16-bit samples to the I2S driver.
+ * 
+ * Hands the whole block to the I2S driver in as few `i2s_write` calls as possible,
+ * blocking until every byte has been queued into the DMA buffers. Each call waits at
+ * most `AUDIO_TASK_POLL_MS`, so a pause or stop interrupts the block. Only writes if
+ * `playing` is true.
+ * 
+ * @param data Pointer to the interleaved sample data.
+ * @param bytes Number of bytes to write.
+ * @return The number of bytes actually queued to the I2S driver.
+ */
+size_t I2SManager::writeToDriver(const void* data, size_t bytes) {
+    size_t total = 0;
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+
+    while (playing && total < bytes) {
+        size_t bytes_written = 0;
+        if (i2s_write(I2S_NUM_0, src + total, bytes - total, &bytes_written, pdMS_TO_TICKS(AUDIO_TASK_POLL_MS)) != ESP_OK) {
+            break; // Driver error, give up on this block
+        }
+        total += bytes_written;
+    }
+    return total;
 }
 
 /**
  * @brief Pauses the I2S audio stream.
  * 
- * Stops the I2S driver, effectively pausing audio output. Sets `playing` to false to
- * indicate that I2S streaming is inactive.
+ * Fades the output out and stops the I2S driver on silence (see `fadeOutAndHalt()`). Sets
+ * `playing` to false to indicate that I2S streaming is inactive. Queued samples stay in the
+ * ring, less the `AUDIO_FADE_MS` played during the fade.
  */
 void I2SManager::pause() {
-    if (playing) {
-        i2s_stop(I2S_NUM_0);
-        playing = false;
-    }
+    fadeOutAndHalt();
 }
 
 /**
  * @brief Resumes the I2S audio stream.
  * 
  * Restarts the I2S driver if it was previously paused, setting the `playing` flag to true.
+ * The DMA buffers were zeroed when the output stopped, and the writer task fades the first
+ * samples in over `AUDIO_FADE_MS`.
  */
 void I2SManager::resume() {
-    if (!playing) {
+    if (!playing && installed) {
+        fade.setTarget(GAIN_UNITY);
         i2s_start(I2S_NUM_0);
         playing = true;
+        if (xWriterTask) {
+            xTaskNotifyGive(xWriterTask); // Skip the rest of the idle poll
+        }
     }
 }
 
 /**
  * @brief Stops the I2S audio stream.
  * 
- * Completely halts the I2S driver and sets `playing` to false. Should be used when
- * terminating audio output.
+ * Fades the output out, halts the I2S driver on silence and sets `playing` to false. The
+ * driver stays installed and its DMA descriptors stay allocated; use `end()` to release them.
  */
 void I2SManager::stop() {
-    if (playing) {
-        i2s_stop(I2S_NUM_0);
+    fadeOutAndHalt();
+}
+
+/**
+ * @brief Fades the output out and stops the driver once silence is playing.
+ *
+ * The writer task applies the fade to the next blocks it writes, then queues silence until
+ * the faded tail has left the DMA buffers, stops the driver and zeroes its buffers. This
+ * returns once that is done, after at most `AUDIO_FADE_MS` plus the DMA depth (about 60 ms).
+ * If the writer task does not answer in time the driver is stopped as it is.
+ */
+void I2SManager::fadeOutAndHalt() {
+    if (!playing) {
+        return;
+    }
+    if (!xWriterTask) {
         playing = false;
+        i2s_stop(I2S_NUM_0);
+        i2s_zero_dma_buffer(I2S_NUM_0);
+        return;
+    }
+
+    fade.setTarget(0);
+    haltRequested = true;
+    TickType_t start = xTaskGetTickCount();
+    while (haltRequested && (xTaskGetTickCount() - start) < pdMS_TO_TICKS(AUDIO_TASK_POLL_MS * 10)) {
+        vTaskDelay(1);
+    }
+    if (haltRequested) {
+        playing = false; // Writer task stuck in the driver, stop without the fade
+        i2s_stop(I2S_NUM_0);
+        i2s_zero_dma_buffer(I2S_NUM_0);
+        haltRequested = false;
     }
 }
 
+/**
+ * @brief Halts the output if a fade-out was requested and has reached silence.
+ *
+ * Called by the writer task after each block, so the fade-out costs no work beyond the
+ * ramped gain pass on the blocks that are written anyway.
+ */
+void I2SManager::haltIfFaded() {
+    if (haltRequested && fade.getTarget() == 0 && fade.isSettled()) {
+        halt();
+    }
+}
+
+/**
+ * @brief Queues silence behind the faded tail, then stops the driver and zeroes its buffers.
+ *
+ * `i2s_write()` returns once the data is in the DMA buffers, not once it is heard, so
+ * `I2S_DMA_BUF_COUNT` buffers of silence are queued first: when the last one is accepted,
+ * everything written before it has been played.
+ */
+void I2SManager::halt() {
+    static const int16_t silence[I2S_DMA_BUF_LEN * AUDIO_OUTPUT_CHANNELS] = { 0 };
+    for (int i = 0; i < I2S_DMA_BUF_COUNT; i++) {
+        writeToDriver(silence, sizeof(silence));
+    }
+    playing = false;
+    i2s_stop(I2S_NUM_0);
+    i2s_zero_dma_buffer(I2S_NUM_0); // Nothing stale is replayed on resume
+    haltRequested = false;
+}
+
 /**
  * @brief Checks if the I2S stream is currently active.
  * 
@@ -5,10 +5,34 @@
  * @file I2SManager.h
  * @brief Provides an interface to control I2S audio playback on the ESP32.
  * 
- * The I2SManager class facilitates initializing and managing I2S audio communication
- * on the ESP32, including playback control (play, pause, resume, stop) and handling
- * audio samples for real-time audio output. This class is designed for applications 
- * requiring stereo audio output with a configurable sample rate.
+ * The I2SManager class is the long-lived audio output engine of the toy. It installs the
+ * I2S driver once, keeps its DMA descriptors allocated for the lifetime of the object and
+ * runs a writer task that drains a lock-free playback ring into the driver. Producers (such
+ * as `WAVFileReader`) only ever write samples into `ring()`; switching tracks never
+ * reinstalls the driver, and a change of sample rate only retunes the I2S clock in place.
+ * 
+ * The engine also measures, for each track, the time from `markTrackStart()` to the moment
+ * the first sample of that track has been queued to DMA, and the number of silent frames
+ * heard between the previous track and this one (zero for a gapless splice), and the same
+ * time to first sample for each sound effect or prompt started on the mixer. `resume()` wakes
+ * the writer task at once, so a sound started while the engine is idle reaches DMA within the
+ * time it takes to mix one block.
+ * 
+ * The volume is applied by the writer task, on each block just before it goes to DMA, through
+ * a `GainStage` that ramps every change so it does not click. The narration read from the ring
+ * first goes through its own `GainStage` for loudness normalization: producers schedule a
+ * track's gain with `setTrackGain()` before queuing its first sample, and the writer task
+ * switches to it when that sample comes up. Before the volume, the `mixer()` layers
+ * preloaded sound effects over the block (or over silence when no track is queued), and the
+ * `compressor()` evens out the level of the mix and limits its peaks. The compressor delays the
+ * output by its look-ahead; the delayed tail is played out once the ring has been dry for
+ * longer than the DMA buffers last, and dropped by `flush()`.
+ *
+ * Pause and stop never cut the output mid-waveform. They ask the writer task to fade out over
+ * `AUDIO_FADE_MS`, as one more ramped `GainStage` pass on the blocks it already writes, then to
+ * queue silence until the faded tail has left the DMA buffers. Only then is the driver stopped
+ * and its buffers zeroed, so `resume()` starts from silence and fades back in; nothing stale
+ * is replayed.
  * 
  * Usage Example:
  * @code
@@ -22,7 +46,10 @@
  * 
  * I2SManager i2sManager(pins, sampleRate);
  * i2sManager.begin();
- * i2sManager.writeSample(sample);
+ * i2sManager.setSampleRate(22050);
+ * i2sManager.setVolume(60);
+ * i2sManager.markTrackStart();
+ * i2sManager.writeBlock(samples, sampleCount);
  * i2sManager.pause();
  * i2sManager.resume();
  * i2sManager.stop();
@@ -31,20 +58,78 @@
 #include <Arduino.h>
 #include <driver/i2s.h>
 #include "OtaManager.h"
+#include "AudioRingBuffer.h"
+#include "GainStage.h"
+#include "AudioMixer.h"
+#include "Compressor.h"
+
+#define I2S_FADE_STEP_SAMPLES (((uint32_t)AUDIO_OUTPUT_RATE * AUDIO_FADE_MS / 1000 * AUDIO_OUTPUT_CHANNELS / AUDIO_FADE_STEPS) & ~1UL) ///< Samples per fade step, even
 
 class I2SManager {
 public:
+    typedef AudioRingBuffer<int16_t, AUDIO_RING_SAMPLES> PlaybackRing;
+
     I2SManager(i2s_pin_config_t pins, int sample_rate);
-    void begin();
-    void writeSample(int16_t sample);
+    ~I2SManager();
+    void begin();                       // Install the driver once and start the writer task
+    void end();                         // Stop the writer task and uninstall the driver
+    bool setSampleRate(int sample_rate);// Retune the I2S clock in place
+    int getSampleRate();                // Current output sample rate
+    void writeSample(int16_t sample);   // Queue a single sample (producer side)
+    size_t writeBlock(const int16_t* samples, size_t count); // Queue a block of samples (producer side)
+    PlaybackRing& ring();               // Playback ring for zero-copy producers
+    void flush();                       // Drop queued samples and clear the DMA buffers
+    void markTrackStart();              // Start timing the first sample of a new track
+    uint32_t getFirstSampleLatencyUs(); // Time to first sample of the last track
+    uint32_t getLastGapFrames();        // Silent frames heard before the last track started
+    uint32_t getEffectStartLatencyUs(); // Time from mixer().play() to DMA of the last started effect
+    uint32_t getUnderrunFrames();       // Silent frames heard because of underruns since begin()
+    void setVolume(uint8_t percent);    // Output volume 0..100 %, ramped by the writer task
+    void setTrackGain(int32_t gain);    // Q15 normalization of the samples queued from now on (producer side)
+    AudioMixer& mixer();                // Sound effect voices mixed over the playback ring
+    Compressor& compressor();           // Dynamics of the mix, configure() may be called from any task
     void pause();
     void resume();
     void stop();
     bool isPlaying();
 
 private:
+    static void writerTask(void* parameter);                 // FreeRTOS task draining the ring to I2S
+    size_t writeToDriver(const void* data, size_t bytes);    // Blocking write into the DMA buffers
+    void fadeOutAndHalt();                                   // Fade out, then stop the driver on silence
+    void haltIfFaded();                                      // Writer task: halt once a requested fade-out is done
+    void halt();                                             // Writer task: drain the DMA buffers with silence and stop
+    size_t applyTrackGains(size_t count);                    // Writer task: start due track gains, end the block at the next one
+    struct TrackGain {
+        int32_t gain;                                        // Q15 normalization gain
+        size_t at;                                           // Ring write position of the track's first sample
+    };
+    TrackGain trackGains[AUDIO_TRACK_GAIN_SLOTS];            // Track gains not reached by the writer task yet
+    volatile uint32_t trackGainHead;                         // Next slot setTrackGain() fills
+    volatile uint32_t trackGainTail;                         // Next slot the writer task applies
+    i2s_pin_config_t pins;                                   // Pin configuration for I2S output
     i2s_config_t i2s_config;
-    bool playing;
+    volatile bool playing;
+    bool installed;                                          // Driver installed and DMA allocated
+    TaskHandle_t xWriterTask;                                // Task handle for the writer task
+    volatile bool flushRequested;                            // Set by flush(), cleared by the writer task
+    volatile bool haltRequested;                             // Set by pause() and stop(), cleared by the writer task
+    volatile bool waitingFirstSample;                        // A track started and has not reached DMA yet
+    uint32_t trackStartUs;                                   // micros() at markTrackStart()
+    volatile uint32_t firstSampleLatencyUs;                  // Measured time to first sample
+    volatile uint32_t lastGapFrames;                         // Silent frames before the last track
+    volatile uint32_t effectStartLatencyUs;                  // Measured time to first sample of an effect
+    void noteEffectStart();                                  // Time the effects started in the block just written
+    volatile uint32_t underrunFrames;                        // Silent frames caused by underruns
+    uint32_t starvedSinceUs;                                 // micros() when the ring ran dry, 0 if not starved
+    uint32_t starvationFrames(uint32_t now);                 // Audible silent frames of the current starvation
+    PlaybackRing playbackRing;                               // Samples waiting for the writer task
+    AudioMixer effects;                                      // Sound effects, mixed by the writer task
+    Compressor dynamics;                                     // Compressor and limiter, applied by the writer task
+    GainStage normalize;                                     // Track loudness normalization, applied by the writer task
+    GainStage gain;                                          // Volume, applied by the writer task
+    GainStage fade;                                          // Pause, resume and stop fades, applied by the writer task
+    size_t gainedAhead;                                      // Samples at the front of the ring already mixed and scaled
 };
 
 #endif // I2SMANAGER_H
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "ImaAdpcmDecoder.h"
+
+// Quantizer step sizes, indexed by the step index (0..88)
+static const int16_t kStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+// Step index adjustment, indexed by the 4-bit code
+static const int8_t kIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/**
+ * @brief Constructor, the decoder must be configured with `begin()` before use.
+ */
+ImaAdpcmDecoder::ImaAdpcmDecoder() : m_channels(0), m_blockAlign(0) {}
+
+/**
+ * @brief Configures the decoder for a file's block layout.
+ *
+ * @param channels Number of channels (1 or 2).
+ * @param blockAlign Bytes per block from the fmt chunk, headers included.
+ * @return true if the layout is supported.
+ */
+bool ImaAdpcmDecoder::begin(uint16_t channels, uint16_t blockAlign) {
+    if ((channels != 1 && channels != 2) || blockAlign <= 4 * channels || (blockAlign % (4 * channels)) != 0) {
+        Serial.println("Unsupported IMA-ADPCM block layout.");
+        return false;
+    }
+    m_channels = channels;
+    m_blockAlign = blockAlign;
+    return true;
+}
+
+/**
+ * @brief Returns the number of frames decoded from one full block.
+ */
+size_t ImaAdpcmDecoder::framesPerBlock() {
+    return framesPerBlock(m_channels, m_blockAlign);
+}
+
+/**
+ * @brief Returns the number of frames in a block: the header sample plus two per code byte.
+ */
+size_t ImaAdpcmDecoder::framesPerBlock(uint16_t channels, uint16_t blockAlign) {
+    if (channels == 0 || blockAlign <= 4 * channels) {
+        return 0;
+    }
+    return 1 + (size_t)(blockAlign - 4 * channels) * 2 / channels;
+}
+
+/**
+ * @brief Decodes a single 4-bit code and updates the channel state.
+ *
+ * Bits 0..2 scale the step by 1/4, 1/2 and 1, bit 3 is the sign. The terms are selected
+ * with masks, so the only data-dependent work is the two clamps, which compile to
+ * min/max instructions.
+ */
+inline int16_t ImaAdpcmDecoder::decodeCode(uint8_t code, int32_t& predictor, int32_t& index) {
+    int32_t step = kStepTable[index];
+    int32_t diff = (step >> 3)
+                 + (step & -(int32_t)((code >> 2) & 1))
+                 + ((step >> 1) & -(int32_t)((code >> 1) & 1))
+                 + ((step >> 2) & -(int32_t)(code & 1));
+    int32_t sign = -(int32_t)((code >> 3) & 1); // 0 or -1
+    predictor += (diff ^ sign) - sign;          // Add or subtract diff
+    predictor = predictor > 32767 ? 32767 : (predictor < -32768 ? -32768 : predictor);
+
+    index += kIndexTable[code];
+    index = index > 88 ? 88 : (index < 0 ? 0 : index);
+    return (int16_t)predictor;
+}
+
+/**
+ * @brief Decodes one block into interleaved 16-bit samples.
+ *
+ * A short final block (the data chunk need not be a multiple of `blockAlign`) decodes
+ * to fewer frames.
+ *
+ * @param block Block bytes as stored in the data chunk.
+ * @param size Number of valid bytes, at most `blockAlign`.
+ * @param out Destination for `framesPerBlock() * channels` interleaved samples.
+ * @return The number of frames written to `out`; 0 if the block is too short or corrupt.
+ */
+size_t ImaAdpcmDecoder::decodeBlock(const uint8_t* block, size_t size, int16_t* out) {
+    const size_t channels = m_channels;
+    const size_t headerBytes = 4 * channels;
+    if (size > m_blockAlign) size = m_blockAlign;
+    if (channels == 0 || size < headerBytes) {
+        return 0;
+    }
+
+    // Whole 4-byte groups per channel, a partial trailing group is ignored
+    const size_t groups = (size - headerBytes) / headerBytes;
+
+    for (size_t c = 0; c < channels; c++) {
+        const uint8_t* header = block + 4 * c;
+        int32_t predictor = (int16_t)(header[0] | (header[1] << 8));
+        int32_t index = header[2];
+        if (index > 88) {
+            return 0; // Corrupt block
+        }
+        out[c] = (int16_t)predictor; // The header holds the first sample
+
+        const uint8_t* codes = block + headerBytes + 4 * c;
+        int16_t* dst = out + channels + c;
+        for (size_t g = 0; g < groups; g++) {
+            for (size_t b = 0; b < 4; b++) {
+                uint8_t byte = codes[b];
+                dst[0] = decodeCode(byte & 0x0F, predictor, index); // Low nibble first
+                dst[channels] = decodeCode(byte >> 4, predictor, index);
+                dst += 2 * channels;
+            }
+            codes += headerBytes; // Skip the other channel's group
+        }
+    }
+    return 1 + groups * 8;
+}
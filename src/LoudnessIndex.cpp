@@ -0,0 +1,120 @@
+#include "LoudnessIndex.h"
+#include "GainStage.h"
+#include <math.h>
+
+/**
+ * @brief Constructor, the record is empty until `load()` or `save()`.
+ */
+LoudnessIndex::LoudnessIndex() : m_valid(false) {
+    memset(&m_record, 0, sizeof(m_record));
+}
+
+/**
+ * @brief Returns the sum of the 32-bit words of a record before its checksum.
+ */
+uint32_t LoudnessIndex::checksum(const Record& record) {
+    const uint32_t* words = (const uint32_t*)&record;
+    uint32_t sum = 0x5A5A5A5A;
+    for (size_t i = 0; i < offsetof(Record, checksum) / sizeof(uint32_t); i++) {
+        sum = (sum << 1 | sum >> 31) + words[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief Reads the sidecar of an audio file.
+ *
+ * @param indexPath Path of the sidecar.
+ * @param audio The open audio file, checked against the size and time it was measured at.
+ * @return true if the sidecar exists, is well formed and matches the audio file.
+ */
+bool LoudnessIndex::load(const char* indexPath, File& audio) {
+    m_valid = false;
+    if (!SD.exists(indexPath)) {
+        return false;
+    }
+    File file = SD.open(indexPath);
+    if (!file) {
+        return false;
+    }
+    bool ok = file.read((uint8_t*)&m_record, sizeof(m_record)) == sizeof(m_record);
+    file.close();
+
+    m_valid = ok && m_record.magic == LOUDNESS_INDEX_MAGIC && m_record.version == LOUDNESS_INDEX_VERSION &&
+              m_record.checksum == checksum(m_record) &&
+              m_record.fileSize == (uint32_t)audio.size() && m_record.lastWrite == (uint32_t)audio.getLastWrite();
+    return m_valid;
+}
+
+/**
+ * @brief Writes the sidecar of a measured audio file.
+ *
+ * @param indexPath Path of the sidecar.
+ * @param audio The measured audio file; its size and time are recorded.
+ * @param integrated Integrated loudness, centi-LUFS or LOUDNESS_SILENT.
+ * @param peak Sample peak.
+ * @return true if the sidecar was written.
+ */
+bool LoudnessIndex::save(const char* indexPath, File& audio, int16_t integrated, int16_t peak) {
+    memset(&m_record, 0, sizeof(m_record));
+    m_record.magic = LOUDNESS_INDEX_MAGIC;
+    m_record.version = LOUDNESS_INDEX_VERSION;
+    m_record.integrated = integrated;
+    m_record.fileSize = (uint32_t)audio.size();
+    m_record.lastWrite = (uint32_t)audio.getLastWrite();
+    m_record.peak = peak;
+    m_record.checksum = checksum(m_record);
+    m_valid = true;
+
+    File file = SD.open(indexPath, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    bool ok = file.write((const uint8_t*)&m_record, sizeof(m_record)) == sizeof(m_record);
+    file.close();
+    if (!ok) {
+        SD.remove(indexPath); // Never leave a truncated record behind
+    }
+    return ok;
+}
+
+/**
+ * @brief Returns true once a record was loaded or saved.
+ */
+bool LoudnessIndex::isValid() {
+    return m_valid;
+}
+
+/**
+ * @brief Returns the integrated loudness, in centi-LUFS, or LOUDNESS_SILENT.
+ */
+int16_t LoudnessIndex::integrated() {
+    return m_valid ? m_record.integrated : LOUDNESS_SILENT;
+}
+
+/**
+ * @brief Returns the sample peak, 0..32767, or 0 without a record.
+ */
+int16_t LoudnessIndex::peak() {
+    return m_valid ? m_record.peak : 0;
+}
+
+/**
+ * @brief Returns the Q15 gain that brings the file to `LOUDNESS_TARGET_LUFS`.
+ *
+ * Files quieter than the target, silent files and files without a record play at unity;
+ * the cut is at most `LOUDNESS_MAX_CUT_DB`.
+ */
+int32_t LoudnessIndex::gain() {
+    if (!m_valid || m_record.integrated == LOUDNESS_SILENT) {
+        return GAIN_UNITY;
+    }
+    int32_t cutCentiDb = m_record.integrated - LOUDNESS_TARGET_LUFS * 100;
+    if (cutCentiDb <= 0) {
+        return GAIN_UNITY;
+    }
+    if (cutCentiDb > LOUDNESS_MAX_CUT_DB * 100) {
+        cutCentiDb = LOUDNESS_MAX_CUT_DB * 100;
+    }
+    return (int32_t)(GAIN_UNITY * powf(10.0f, -cutCentiDb / 2000.0f));
+}
@@ -0,0 +1,61 @@
+#ifndef LOUDNESS_INDEX_H
+#define LOUDNESS_INDEX_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include "Config.h"
+#include "LoudnessMeter.h"
+
+/**
+ * @file LoudnessIndex.h
+ * @brief Loudness and peak of an audio file, cached in a sidecar file next to it.
+ *
+ * The `LoudnessScanner` measures every audio file on the SD card in idle time and stores the
+ * result as `<audio path>LOUDNESS_EXTENSION`, a 24-byte record with the size and modification
+ * time of the file it was measured on. When a segment is opened, `WAVFileReader` loads the
+ * record and turns it into the normalization gain of the track with `gain()`: playing a file
+ * costs one small read, never a scan of its samples.
+ *
+ * The gain brings every file down to `LOUDNESS_TARGET_LUFS`. It never boosts: the gain stages
+ * of the engine are Q15 and stop at unity, and a quiet recording would only gain noise.
+ *
+ * ## Example:
+ * ```cpp
+ * LoudnessIndex loudness;
+ * if (loudness.load(indexPath, file)) {
+ *     i2sManager.setTrackGain(loudness.gain());
+ * }
+ * ```
+ */
+
+#define LOUDNESS_INDEX_MAGIC 0x58444E4C                      ///< "LNDX"
+#define LOUDNESS_INDEX_VERSION 1                             ///< Bumped whenever the sidecar layout or the measurement changes
+
+class LoudnessIndex {
+public:
+    LoudnessIndex();
+    bool load(const char* indexPath, File& audio); // Read the sidecar, false if missing or stale
+    bool save(const char* indexPath, File& audio, int16_t integrated, int16_t peak); // Write the sidecar for a measured file
+    bool isValid();                     // Loaded or saved
+    int16_t integrated();               // Integrated loudness, centi-LUFS or LOUDNESS_SILENT
+    int16_t peak();                     // Sample peak, 0..32767
+    int32_t gain();                     // Q15 normalization gain, GAIN_UNITY if unknown
+
+private:
+    struct Record {
+        uint32_t magic;                 // LOUDNESS_INDEX_MAGIC
+        uint16_t version;               // LOUDNESS_INDEX_VERSION
+        int16_t integrated;             // Integrated loudness, centi-LUFS
+        uint32_t fileSize;              // Size of the audio file when measured
+        uint32_t lastWrite;             // Modification time of the audio file when measured
+        int16_t peak;                   // Sample peak
+        uint16_t reserved;              // Zero
+        uint32_t checksum;              // Sum of the words above, catches torn writes
+    };
+
+    static uint32_t checksum(const Record& record); // Checksum of every field before it
+    Record m_record;                    // Record as stored in the sidecar
+    bool m_valid;                       // Loaded or saved
+};
+
+#endif // LOUDNESS_INDEX_H
@@ -0,0 +1,153 @@
+#include "LoudnessMeter.h"
+#include <math.h>
+
+/**
+ * @brief Constructor, computes the K-weighting filters for AUDIO_OUTPUT_RATE.
+ *
+ * The constants are those of BS.1770 at 48 kHz, turned back into analog prototypes so the
+ * filters can be rebuilt by the bilinear transform at any rate.
+ */
+LoudnessMeter::LoudnessMeter() : m_subBlockFrames(AUDIO_OUTPUT_RATE / 10) {
+    const double pi = 3.14159265358979323846;
+
+    // Stage 1: high shelf, +4 dB above ~1.7 kHz (head effect)
+    double k = tan(pi * 1681.974450955533 / AUDIO_OUTPUT_RATE);
+    double q = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m_b[0][0] = (float)((vh + vb * k / q + k * k) / a0);
+    m_b[0][1] = (float)(2.0 * (k * k - vh) / a0);
+    m_b[0][2] = (float)((vh - vb * k / q + k * k) / a0);
+    m_a[0][0] = (float)(2.0 * (k * k - 1.0) / a0);
+    m_a[0][1] = (float)((1.0 - k / q + k * k) / a0);
+
+    // Stage 2: RLB high-pass at ~38 Hz
+    k = tan(pi * 38.13547087602444 / AUDIO_OUTPUT_RATE);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    m_b[1][0] = 1.0f;
+    m_b[1][1] = -2.0f;
+    m_b[1][2] = 1.0f;
+    m_a[1][0] = (float)(2.0 * (k * k - 1.0) / a0);
+    m_a[1][1] = (float)((1.0 - k / q + k * k) / a0);
+
+    reset();
+}
+
+/**
+ * @brief Starts a new measurement.
+ */
+void LoudnessMeter::reset() {
+    memset(&m_state, 0, sizeof(m_state));
+}
+
+/**
+ * @brief Measures a block of interleaved frames.
+ *
+ * @param samples Interleaved AUDIO_OUTPUT_CHANNELS samples at AUDIO_OUTPUT_RATE.
+ * @param frames Number of frames; blocks may have any length.
+ */
+void LoudnessMeter::process(const int16_t* samples, size_t frames) {
+    for (size_t f = 0; f < frames; f++) {
+        for (int c = 0; c < AUDIO_OUTPUT_CHANNELS; c++) {
+            int32_t raw = samples[f * AUDIO_OUTPUT_CHANNELS + c];
+            int32_t magnitude = raw < 0 ? -raw : raw;
+            if (magnitude > m_state.peak) {
+                m_state.peak = magnitude;
+            }
+
+            // Two transposed direct form II biquads
+            float* z = m_state.filter[c];
+            float x = raw * (1.0f / 32768.0f);
+            float y = m_b[0][0] * x + z[0];
+            z[0] = m_b[0][1] * x - m_a[0][0] * y + z[1];
+            z[1] = m_b[0][2] * x - m_a[0][1] * y;
+            x = y;
+            y = x + z[2]; // m_b[1] is 1, -2, 1
+            z[2] = -2.0f * x - m_a[1][0] * y + z[3];
+            z[3] = x - m_a[1][1] * y;
+            m_state.sum += y * y;
+        }
+        if (++m_state.frames == m_subBlockFrames) {
+            completeSubBlock();
+        }
+    }
+}
+
+/**
+ * @brief Closes a 100 ms sub-block. From the fourth one on, each also closes a 400 ms gating
+ * block, which is counted in the histogram if it is above the absolute gate.
+ */
+void LoudnessMeter::completeSubBlock() {
+    float meanSquare = m_state.sum / m_subBlockFrames; // Channel weights are 1 for left and right
+    if (m_state.subBlockCount >= 3) {
+        float block = (m_state.subBlocks[0] + m_state.subBlocks[1] + m_state.subBlocks[2] + meanSquare) * 0.25f;
+        if (block > 0.0f) {
+            float loudness = -0.691f + 10.0f * log10f(block);
+            if (loudness >= LOUDNESS_FLOOR_LUFS) {
+                int bin = (int)((loudness - LOUDNESS_FLOOR_LUFS) * 10.0f + 0.5f);
+                m_state.histogram[bin < LOUDNESS_BINS ? bin : LOUDNESS_BINS - 1]++;
+            }
+        }
+    }
+    m_state.subBlocks[0] = m_state.subBlocks[1];
+    m_state.subBlocks[1] = m_state.subBlocks[2];
+    m_state.subBlocks[2] = meanSquare;
+    m_state.subBlockCount++;
+    m_state.sum = 0.0f;
+    m_state.frames = 0;
+}
+
+/**
+ * @brief Returns the integrated loudness of everything measured since `reset()`.
+ *
+ * The mean energy of the blocks above the absolute gate sets the relative gate, 10 LU below
+ * it; the mean energy of the blocks above both gates is the integrated loudness. Blocks are
+ * taken at the centre of their 0.1 LU bin.
+ *
+ * @return Loudness in centi-LUFS (-1800 for -18 LUFS), or LOUDNESS_SILENT when the file is
+ *         shorter than 400 ms or entirely below -70 LUFS.
+ */
+int16_t LoudnessMeter::integrated() {
+    double energy = 0.0;
+    uint32_t blocks = 0;
+    for (int i = 0; i < LOUDNESS_BINS; i++) {
+        if (m_state.histogram[i]) {
+            energy += m_state.histogram[i] * pow(10.0, (LOUDNESS_FLOOR_LUFS + i * 0.1 + 0.691) / 10.0);
+            blocks += m_state.histogram[i];
+        }
+    }
+    if (blocks == 0) {
+        return LOUDNESS_SILENT;
+    }
+
+    double gate = -0.691 + 10.0 * log10(energy / blocks) - 10.0;
+    int first = (int)ceil((gate - LOUDNESS_FLOOR_LUFS) * 10.0);
+    energy = 0.0;
+    blocks = 0;
+    for (int i = first > 0 ? first : 0; i < LOUDNESS_BINS; i++) {
+        if (m_state.histogram[i]) {
+            energy += m_state.histogram[i] * pow(10.0, (LOUDNESS_FLOOR_LUFS + i * 0.1 + 0.691) / 10.0);
+            blocks += m_state.histogram[i];
+        }
+    }
+    if (blocks == 0) {
+        return LOUDNESS_SILENT;
+    }
+    return (int16_t)lround(100.0 * (-0.691 + 10.0 * log10(energy / blocks)));
+}
+
+/**
+ * @brief Returns the highest absolute sample measured, 0..32767.
+ */
+int16_t LoudnessMeter::peak() {
+    return (int16_t)(m_state.peak > 32767 ? 32767 : m_state.peak);
+}
+
+/**
+ * @brief Returns the whole state of the measurement, to save it or to restore a saved one.
+ */
+LoudnessMeter::State& LoudnessMeter::state() {
+    return m_state;
+}
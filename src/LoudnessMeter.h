@@ -0,0 +1,60 @@
+#ifndef LOUDNESS_METER_H
+#define LOUDNESS_METER_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * @file LoudnessMeter.h
+ * @brief Integrated loudness (ITU-R BS.1770, LUFS) and sample peak of a stream of blocks.
+ *
+ * The samples are K-weighted (a high shelf and a high-pass biquad per channel), their mean
+ * square is taken over 100 ms sub-blocks, and every 400 ms gating block (75 % overlap) is
+ * counted in a histogram of 0.1 LU bins above the -70 LUFS absolute gate. `integrated()`
+ * applies the -10 LU relative gate to the histogram, so the meter needs a fixed 3 KB whatever
+ * the length of the file.
+ *
+ * The meter is only run by the background `LoudnessScanner`, never on the playback path, so
+ * it uses the FPU. Its whole state is the plain `State` struct, which the scanner saves to
+ * resume an analysis after a reboot.
+ *
+ * ## Example:
+ * ```cpp
+ * LoudnessMeter meter;
+ * meter.process(samples, frames);    // Interleaved stereo at AUDIO_OUTPUT_RATE, any block size
+ * int16_t lufs = meter.integrated(); // Centi-LUFS, LOUDNESS_SILENT if nothing passed the gate
+ * ```
+ */
+
+#define LOUDNESS_FLOOR_LUFS -70                              ///< Absolute gate of BS.1770
+#define LOUDNESS_BINS 750                                    ///< Histogram bins of 0.1 LU, from -70 to +5 LUFS
+#define LOUDNESS_SILENT -32768                               ///< Integrated loudness of a file with no block above the gate
+
+class LoudnessMeter {
+public:
+    struct State {
+        float filter[AUDIO_OUTPUT_CHANNELS][4]; // Delay elements of the two K-weighting biquads
+        float subBlocks[3];             // Mean square of the last three complete sub-blocks
+        float sum;                      // Sum of squares of the sub-block in progress
+        uint32_t frames;                // Frames in the sub-block in progress
+        uint32_t subBlockCount;         // Complete sub-blocks
+        int32_t peak;                   // Highest absolute sample
+        uint32_t histogram[LOUDNESS_BINS]; // Gating blocks per 0.1 LU above LOUDNESS_FLOOR_LUFS
+    };
+
+    LoudnessMeter();
+    void reset();                       // Start a new measurement
+    void process(const int16_t* samples, size_t frames); // Measure interleaved frames at AUDIO_OUTPUT_RATE
+    int16_t integrated();               // Gated loudness in centi-LUFS, or LOUDNESS_SILENT
+    int16_t peak();                     // Sample peak
+    State& state();                     // Whole state, to save and restore a measurement
+
+private:
+    void completeSubBlock();            // Close a 100 ms sub-block and count the gating block it ends
+    float m_b[2][3];                    // Feed-forward coefficients of the shelf and high-pass
+    float m_a[2][2];                    // Feedback coefficients (a1, a2) of the shelf and high-pass
+    uint32_t m_subBlockFrames;          // Frames per 100 ms
+    State m_state;                      // Measurement so far
+};
+
+#endif // LOUDNESS_METER_H
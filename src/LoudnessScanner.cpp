@@ -0,0 +1,385 @@
+#include "LoudnessScanner.h"
+#include <esp_timer.h>
+
+/**
+ * @brief Constructor, nothing runs until `begin()`.
+ *
+ * @param output Engine whose activity pauses the job; its ring is never touched.
+ */
+LoudnessScanner::LoudnessScanner(I2SManager* output)
+    : m_output(output), m_ring(nullptr), m_meter(nullptr), m_job(nullptr), m_checked(0), m_task(NULL),
+      m_running(false), m_held(false) {
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/**
+ * @brief Destructor, stops the task and frees the buffers.
+ */
+LoudnessScanner::~LoudnessScanner() {
+    end();
+    delete m_ring;
+    delete m_meter;
+    delete m_job;
+}
+
+/**
+ * @brief Allocates the decode ring and the meter and starts the scanner task.
+ *
+ * @return false if the buffers could not be allocated.
+ */
+bool LoudnessScanner::begin() {
+    if (m_task) {
+        return true;
+    }
+    if (!m_ring) m_ring = new I2SManager::PlaybackRing();
+    if (!m_meter) m_meter = new LoudnessMeter();
+    if (!m_job) m_job = new Job();
+    if (!m_ring || !m_meter || !m_job || !m_output) {
+        Serial.println("LoudnessScanner: Not enough memory, loudness is not measured.");
+        return false;
+    }
+    memset(m_job, 0, sizeof(Job));
+    m_running = true;
+    if (xTaskCreate(scanTask, "LoudnessTask", LOUDNESS_STACK_SIZE, this, LOUDNESS_TASK_PRIORITY, &m_task) != pdPASS) {
+        m_running = false;
+        m_task = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Stops the scanner task. A measurement in progress is saved to the job file first.
+ */
+void LoudnessScanner::end() {
+    if (!m_task) {
+        return;
+    }
+    m_running = false;
+    xTaskNotifyGive(m_task);
+    TickType_t start = xTaskGetTickCount();
+    while (m_task && (xTaskGetTickCount() - start) < pdMS_TO_TICKS(LOUDNESS_IDLE_POLL_MS * 4)) {
+        vTaskDelay(1); // Let the current decode step and checkpoint finish
+    }
+}
+
+/**
+ * @brief Keeps the scanner off the SD card while set, even when the output is idle.
+ *
+ * Set while recording, so the capture writer has the card to itself. A measurement in
+ * progress steps aside within one decode step.
+ */
+void LoudnessScanner::hold(bool held) {
+    m_held = held;
+    if (!held && m_task) {
+        xTaskNotifyGive(m_task);
+    }
+}
+
+/**
+ * @brief Starts a new pass as soon as the card is idle, to measure a file just written.
+ */
+void LoudnessScanner::rescan() {
+    if (m_task) {
+        xTaskNotifyGive(m_task);
+    }
+}
+
+/**
+ * @brief Returns the counters of the job.
+ */
+LoudnessScanner::Stats LoudnessScanner::getStats() {
+    Stats stats = m_stats;
+    stats.filesPerSecondX100 = stats.busyMs ? (uint32_t)((uint64_t)stats.filesAnalyzed * 100000ULL / stats.busyMs) : 0;
+    return stats;
+}
+
+/**
+ * @brief Returns true while the output is stopped or paused and the scanner is not held.
+ */
+bool LoudnessScanner::isIdle() {
+    return !m_held && !m_output->isPlaying();
+}
+
+/**
+ * @brief Waits for idle time.
+ *
+ * @return true once idle, false if the scanner is ending.
+ */
+bool LoudnessScanner::waitIdle() {
+    while (m_running && !isIdle()) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOUDNESS_IDLE_POLL_MS));
+    }
+    return m_running;
+}
+
+/**
+ * @brief Scanner task implementation.
+ *
+ * Finishes the file the job file names, if any, then walks the card, then sleeps until the
+ * next pass. Whenever idle time ends, the pass waits for the next idle time and carries on
+ * with the same file.
+ *
+ * @param parameter A pointer to the LoudnessScanner instance.
+ */
+void LoudnessScanner::scanTask(void* parameter) {
+    LoudnessScanner* scanner = static_cast<LoudnessScanner*>(parameter);
+    scanner->loadJob();
+
+    while (scanner->m_running) {
+        if (!scanner->waitIdle()) {
+            break;
+        }
+        if (scanner->m_job->magic == LOUDNESS_JOB_MAGIC && !scanner->measure(String(scanner->m_job->path))) {
+            continue; // Interrupted again, the job file holds the new position
+        }
+
+        scanner->m_checked = 0;
+        uint32_t analyzed = scanner->m_stats.filesAnalyzed;
+        if (!scanner->scanDirectory(LOUDNESS_SCAN_ROOT, 0)) {
+            continue; // Ending
+        }
+        scanner->m_stats.filesChecked = scanner->m_checked;
+        scanner->m_stats.passes++;
+        if (DEBUGMODE && scanner->m_stats.filesAnalyzed != analyzed) {
+            Stats stats = scanner->getStats();
+            Serial.printf("LoudnessScanner: %u audio files, %u measured this pass, %u.%02u files/s, %u s of audio in %u ms\n",
+                          stats.filesChecked, stats.filesAnalyzed - analyzed, stats.filesPerSecondX100 / 100,
+                          stats.filesPerSecondX100 % 100, stats.audioSeconds, stats.busyMs);
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOUDNESS_RESCAN_MS)); // rescan() cuts it short
+    }
+
+    scanner->m_task = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Measures every audio file below a directory that has no up-to-date sidecar.
+ *
+ * @param path Directory to walk.
+ * @param depth Levels below LOUDNESS_SCAN_ROOT.
+ * @return false if the scanner is ending, true once the directory is done.
+ */
+bool LoudnessScanner::scanDirectory(const String& path, int depth) {
+    File dir = SD.open(path);
+    if (!dir || !dir.isDirectory()) {
+        return true;
+    }
+
+    File entry = dir.openNextFile();
+    while (entry) {
+        if (!waitIdle()) {
+            return false;
+        }
+        String child = entry.path();
+        if (entry.isDirectory()) {
+            entry.close();
+            if (depth < LOUDNESS_SCAN_DEPTH && !scanDirectory(child, depth + 1)) {
+                return false;
+            }
+        } else if (isAudioFile(child)) {
+            m_checked++;
+            LoudnessIndex loudness;
+            bool current = loudness.load((child + LOUDNESS_EXTENSION).c_str(), entry);
+            entry.close();
+            while (!current && !measure(child)) {
+                if (!waitIdle()) {
+                    return false;
+                }
+            }
+        } else {
+            entry.close();
+        }
+        entry = dir.openNextFile();
+    }
+    return m_running;
+}
+
+/**
+ * @brief Measures one file and writes its sidecar.
+ *
+ * Resumes from the job file when it names this file at the same size and time. Steps aside,
+ * after saving the job file, as soon as idle time ends; every `LOUDNESS_CHECKPOINT_MS` of
+ * audio it saves the job file too. A file that cannot be decoded gets a silent record, so it
+ * plays at unity and is not tried again.
+ *
+ * @return true when the file is done, false if interrupted.
+ */
+bool LoudnessScanner::measure(const String& path) {
+    const int64_t startUs = esp_timer_get_time();
+    File audio = SD.open(path);
+    if (!audio) {
+        if (m_job->magic == LOUDNESS_JOB_MAGIC) {
+            m_job->magic = 0;
+            SD.remove(LOUDNESS_JOB_PATH); // The file was deleted
+        }
+        return true;
+    }
+
+    const String indexPath = path + LOUDNESS_EXTENSION;
+    LoudnessIndex loudness;
+    WAVFileReader* reader = new WAVFileReader(path.c_str(), m_output);
+    if (!reader || !reader->open()) {
+        delete reader;
+        if (DEBUGMODE) {
+            Serial.printf("LoudnessScanner: %s cannot be decoded, played without normalization.\n", path.c_str());
+        }
+        loudness.save(indexPath.c_str(), audio, LOUDNESS_SILENT, 0);
+        m_job->magic = 0;
+        SD.remove(LOUDNESS_JOB_PATH);
+        return true;
+    }
+
+    uint32_t framesDone = 0;
+    uint32_t skipFrames = 0;
+    m_meter->reset();
+    if (m_job->magic == LOUDNESS_JOB_MAGIC && path == m_job->path &&
+        m_job->fileSize == (uint32_t)audio.size() && m_job->lastWrite == (uint32_t)audio.getLastWrite() &&
+        reader->seekMs(m_job->positionMs)) {
+        m_meter->state() = m_job->meter;
+        framesDone = m_job->framesDone;
+        skipFrames = m_job->skipFrames;
+    }
+
+    const uint32_t checkpointFrames = (uint32_t)((uint64_t)AUDIO_OUTPUT_RATE * LOUDNESS_CHECKPOINT_MS / 1000);
+    uint32_t lastCheckpoint = framesDone;
+    bool more = true;
+    bool interrupted = false;
+    for (uint32_t step = 1; more; step++) {
+        if (!m_running || !isIdle()) {
+            interrupted = true;
+            break;
+        }
+        m_ring->reset(); // Private ring, drained after every step
+        more = reader->decodeStep(*m_ring);
+
+        size_t available = m_ring->readAvailable();
+        while (available > 0) {
+            size_t span = available;
+            const int16_t* samples = m_ring->peek(span);
+            uint32_t frames = span / AUDIO_OUTPUT_CHANNELS;
+            uint32_t drop = skipFrames < frames ? skipFrames : frames; // Measured before the reboot
+            skipFrames -= drop;
+            m_meter->process(samples + drop * AUDIO_OUTPUT_CHANNELS, frames - drop);
+            framesDone += frames - drop;
+            m_ring->consume(span);
+            available -= span;
+        }
+
+        if (framesDone - lastCheckpoint >= checkpointFrames) {
+            saveJob(path.c_str(), audio, framesDone);
+            lastCheckpoint = framesDone;
+        }
+        if ((step & 7) == 0) {
+            vTaskDelay(1); // Let the idle task run, this is idle-time work
+        }
+    }
+    delete reader;
+
+    if (interrupted) {
+        if (framesDone > 0) {
+            saveJob(path.c_str(), audio, framesDone);
+        }
+        m_stats.busyMs += (uint32_t)((esp_timer_get_time() - startUs) / 1000);
+        return false;
+    }
+
+    int16_t integrated = m_meter->integrated();
+    loudness.save(indexPath.c_str(), audio, integrated, m_meter->peak());
+    m_job->magic = 0;
+    SD.remove(LOUDNESS_JOB_PATH);
+
+    m_stats.filesAnalyzed++;
+    m_stats.audioSeconds += (framesDone + AUDIO_OUTPUT_RATE / 2) / AUDIO_OUTPUT_RATE;
+    m_stats.busyMs += (uint32_t)((esp_timer_get_time() - startUs) / 1000);
+    if (DEBUGMODE) {
+        if (integrated == LOUDNESS_SILENT) {
+            Serial.printf("LoudnessScanner: %s is silent\n", path.c_str());
+        } else {
+            Serial.printf("LoudnessScanner: %s %.1f LUFS, peak %d\n", path.c_str(), integrated / 100.0f, m_meter->peak());
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Saves the position and meter state of the file being measured.
+ *
+ * The position is stored in milliseconds, for `WAVFileReader::seekMs()`, plus the frames
+ * already measured past it.
+ */
+bool LoudnessScanner::saveJob(const char* path, File& audio, uint32_t framesDone) {
+    memset(m_job, 0, sizeof(Job));
+    m_job->magic = LOUDNESS_JOB_MAGIC;
+    m_job->version = LOUDNESS_JOB_VERSION;
+    strncpy(m_job->path, path, PLAYBACK_PATH_MAX - 1);
+    m_job->fileSize = (uint32_t)audio.size();
+    m_job->lastWrite = (uint32_t)audio.getLastWrite();
+    m_job->positionMs = (uint32_t)((uint64_t)framesDone * 1000 / AUDIO_OUTPUT_RATE);
+    m_job->skipFrames = framesDone - (uint32_t)((uint64_t)m_job->positionMs * AUDIO_OUTPUT_RATE / 1000);
+    m_job->framesDone = framesDone;
+    m_job->meter = m_meter->state();
+    m_job->checksum = jobChecksum(*m_job);
+
+    File file = SD.open(LOUDNESS_JOB_PATH, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    bool ok = file.write((const uint8_t*)m_job, sizeof(Job)) == sizeof(Job);
+    file.close();
+    if (!ok) {
+        SD.remove(LOUDNESS_JOB_PATH); // A torn job would resume with a wrong meter state
+    }
+    return ok;
+}
+
+/**
+ * @brief Reads the job file left by an interrupted measurement.
+ *
+ * @return true if it is complete and intact; m_job is cleared otherwise.
+ */
+bool LoudnessScanner::loadJob() {
+    memset(m_job, 0, sizeof(Job));
+    if (!SD.exists(LOUDNESS_JOB_PATH)) {
+        return false;
+    }
+    File file = SD.open(LOUDNESS_JOB_PATH);
+    if (!file) {
+        return false;
+    }
+    bool ok = file.read((uint8_t*)m_job, sizeof(Job)) == sizeof(Job);
+    file.close();
+    if (!ok || m_job->magic != LOUDNESS_JOB_MAGIC || m_job->version != LOUDNESS_JOB_VERSION ||
+        m_job->path[PLAYBACK_PATH_MAX - 1] != '\0' || m_job->checksum != jobChecksum(*m_job)) {
+        memset(m_job, 0, sizeof(Job));
+        SD.remove(LOUDNESS_JOB_PATH);
+        return false;
+    }
+    if (DEBUGMODE) {
+        Serial.printf("LoudnessScanner: Resuming %s at %u ms\n", m_job->path, m_job->positionMs);
+    }
+    return true;
+}
+
+/**
+ * @brief Returns the FNV-1a hash of the bytes of a job before its checksum.
+ */
+uint32_t LoudnessScanner::jobChecksum(const Job& job) {
+    const uint8_t* bytes = (const uint8_t*)&job;
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < offsetof(Job, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Returns true for the files the reader plays: `.wav` (EXTENSION) and `.mp3`.
+ */
+bool LoudnessScanner::isAudioFile(const String& path) {
+    String lower = path;
+    lower.toLowerCase();
+    return lower.endsWith(EXTENSION) || lower.endsWith(".mp3");
+}
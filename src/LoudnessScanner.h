@@ -0,0 +1,101 @@
+#ifndef LOUDNESS_SCANNER_H
+#define LOUDNESS_SCANNER_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "Config.h"
+#include "I2SManager.h"
+#include "WAVFileReader.h"
+#include "LoudnessMeter.h"
+#include "LoudnessIndex.h"
+
+/**
+ * @file LoudnessScanner.h
+ * @brief Background job measuring the loudness of every audio file on the SD card.
+ *
+ * A task at `LOUDNESS_TASK_PRIORITY` walks `LOUDNESS_SCAN_ROOT` (down to `LOUDNESS_SCAN_DEPTH`
+ * levels) for `.wav` and `.mp3` files without an up-to-date `LoudnessIndex` sidecar, decodes
+ * each through a `WAVFileReader` exactly as it would be played, measures it with a
+ * `LoudnessMeter` and writes the sidecar. Playback then reads the result instead of scanning.
+ *
+ * The job only runs in idle time: it steps aside, one decode step at most, as soon as the
+ * output engine plays or `hold()` is set (while recording), and waits for the engine to stop.
+ * Every `LOUDNESS_CHECKPOINT_MS` of audio, and whenever it steps aside, it saves its position
+ * and the meter state to `LOUDNESS_JOB_PATH`; after a reboot it picks the interrupted file up
+ * from there before walking the card again. Files already measured only cost the check of
+ * their sidecar, so each pass resumes where the last one left off. A new pass runs every
+ * `LOUDNESS_RESCAN_MS`, or at once after `rescan()`.
+ *
+ * `getStats()` reports the files measured and the rate of the job in files per second of
+ * busy time (printed after each pass in `DEBUGMODE`).
+ *
+ * ## Example:
+ * ```cpp
+ * LoudnessScanner scanner(&i2sManager);
+ * scanner.begin();
+ * scanner.hold(true);  // Recording: keep the SD card for the writer
+ * scanner.hold(false);
+ * scanner.rescan();    // A new file was written
+ * ```
+ */
+
+#define LOUDNESS_JOB_MAGIC 0x424F4A4C                        ///< "LJOB"
+#define LOUDNESS_JOB_VERSION 1                               ///< Bumped whenever the job layout or LoudnessMeter::State changes
+
+class LoudnessScanner {
+public:
+    struct Stats {
+        uint32_t filesChecked;          // Audio files found by the last complete pass
+        uint32_t filesAnalyzed;         // Files measured since begin()
+        uint32_t audioSeconds;          // Audio measured since begin()
+        uint32_t busyMs;                // Time spent measuring since begin()
+        uint32_t filesPerSecondX100;    // filesAnalyzed per second of busy time, times 100
+        uint32_t passes;                // Complete passes over the card
+    };
+
+    LoudnessScanner(I2SManager* output);
+    ~LoudnessScanner();
+    bool begin();                       // Allocate the buffers and start the scanner task
+    void end();                         // Stop the task, progress is kept in the job file
+    void hold(bool held);               // Keep the scanner off the SD card even while the output is idle
+    void rescan();                      // Walk the card again as soon as it is idle
+    Stats getStats();                   // Files measured and rate
+
+private:
+    struct Job {
+        uint32_t magic;                 // LOUDNESS_JOB_MAGIC
+        uint16_t version;               // LOUDNESS_JOB_VERSION
+        uint16_t reserved;              // Zero
+        char path[PLAYBACK_PATH_MAX];   // File being measured
+        uint32_t fileSize;              // Its size when the measurement started
+        uint32_t lastWrite;             // Its modification time when the measurement started
+        uint32_t positionMs;            // Position to seek to when resuming
+        uint32_t skipFrames;            // Output frames past positionMs already measured
+        uint32_t framesDone;            // Output frames measured
+        LoudnessMeter::State meter;     // Meter state at framesDone
+        uint32_t checksum;              // FNV-1a of the fields above
+    };
+
+    static void scanTask(void* parameter); // FreeRTOS task running the passes
+    bool scanDirectory(const String& path, int depth); // Measure the files below path, false when ending
+    bool measure(const String& path);   // Measure a file until done or idle time ends, true when done
+    bool waitIdle();                    // Block until idle time, false when ending
+    bool isIdle();                      // Output stopped and not held
+    bool saveJob(const char* path, File& audio, uint32_t framesDone); // Checkpoint the measurement
+    bool loadJob();                     // Read the job file into m_job, false if missing or corrupt
+    static uint32_t jobChecksum(const Job& job); // Checksum of every field before it
+    static bool isAudioFile(const String& path); // .wav or .mp3, case insensitive
+    I2SManager* m_output;               // Engine whose activity pauses the job
+    I2SManager::PlaybackRing* m_ring;   // Private ring the files are decoded into
+    LoudnessMeter* m_meter;             // Measurement of the current file
+    Job* m_job;                         // Job file contents
+    uint32_t m_checked;                 // Audio files found by the pass in progress
+    Stats m_stats;                      // Counters
+    TaskHandle_t m_task;                // Task handle of the scanner task
+    volatile bool m_running;            // Cleared to stop the scanner task
+    volatile bool m_held;               // Set by hold()
+};
+
+#endif // LOUDNESS_SCANNER_H
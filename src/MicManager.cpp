@@ -7,7 +7,11 @@
  * 
  * @param configManager Pointer to the ConfigManager instance, which handles configuration data.
  */
-MicManager::MicManager(){}
+MicManager::MicManager()
+    : adcChannel(-1), gainLevel(MIC_GAIN_DEFAULT_LEVEL), capturing(false), xCaptureTask(NULL), frameCallback(nullptr),
+      callbackContext(nullptr), lastFrameUs(0), frameJitterSumUs(0), preTrigger(0), trimming(false) {
+    memset(&stats, 0, sizeof(stats));
+}
 
 /**
  * @brief Initializes the microphone system.
@@ -24,17 +28,18 @@ void MicManager::begin() {
     }
     // Configure the pins for microphone input and control
    // pinMode(MIC_OUT_PIN, INPUT);         // Microphone output pin as input
-    pinMode(MIC_GAIN_PIN, OUTPUT);       // Gain control pin as output
-    pinMode(MIC_AR_PIN, OUTPUT);         // Auto-gain control pin as output
 
     analogReadResolution(MIC_RESOLUTION);// Set analog pin resolution
 
-    // Set initial states from configuration
-    digitalWrite(MIC_GAIN_PIN, LOW);  // Initialize gain control state
-    digitalWrite(MIC_AR_PIN, LOW);  // Initialize auto-gain control state
+    // Continuous mode can only sample ADC1 channels
+    int8_t channel = digitalPinToAnalogChannel(MIC_OUT_PIN);
+    adcChannel = (channel >= 0 && channel < SOC_ADC_MAX_CHANNEL_NUM) ? channel : -1;
+    if (DEBUGMODE && adcChannel < 0) {
+        Serial.println("MicManager: MIC_OUT_PIN has no ADC1 channel, capture will poll analogRead.");
+    }
 
-    // Initialize the microphone with default gain settings
-    setGain(1); // Default gain
+    // Initialize the microphone with default gain settings (gain and attack/release pins)
+    setGain(MIC_GAIN_DEFAULT_LEVEL);
 
     if (DEBUGMODE) {
         Serial.println("MicManager: Microphone initialized successfully.");
@@ -42,27 +47,60 @@ void MicManager::begin() {
 }
 
 /**
- * @brief Sets the microphone gain.
+ * @brief Sets the hardware gain level of the microphone amplifier.
  * 
- * This method adjusts the microphone gain by controlling the gain pin. It constrains the gain value to 
- * a predefined range (0 to 5, adjust as needed) and sets the gain pin accordingly. 
- * Debug information is printed if `DEBUGMODE` is enabled.
+ * The gain and attack/release pins of the amplifier are three-state: tied high, tied low or
+ * left open. Each level drives both pins:
+ * - level 0, 40 dB: gain pin high, attack/release 1:500 (low), so the amplifier recovers
+ *   quickly after a shout;
+ * - level 1, 50 dB: gain pin low, attack/release 1:2000 (high);
+ * - level 2, 60 dB: gain pin open, attack/release 1:4000 (open), so the amplifier's own AGC
+ *   does not pump the noise up between the words of a quiet child.
+ * The recording AGC (`AutoGain`) switches levels while recording; outside recordings the
+ * level stays where it was left. Debug information is printed if `DEBUGMODE` is enabled.
  * 
- * @param gain The desired gain value for the microphone (typically constrained to a certain range).
+ * @param gain Hardware level, 0 to `MIC_GAIN_LEVELS` - 1 (`MIC_GAIN_STEP_DB` apart).
  */
 void MicManager::setGain(int gain) {
-    // Constrain the gain value within the allowed range
-    int gainValue = constrain(gain, 0, 5); // Adjust the range as necessary for the hardware
+    static const PinState gainPin[MIC_GAIN_LEVELS] = { PIN_HIGH, PIN_LOW, PIN_OPEN };
+    static const PinState attackReleasePin[MIC_GAIN_LEVELS] = { PIN_LOW, PIN_HIGH, PIN_OPEN };
+    static_assert(MIC_GAIN_LEVELS == 3, "The three-state gain pin selects three levels");
 
-    // Set the gain control pin based on the constrained value
-    digitalWrite(MIC_GAIN_PIN, gainValue); // Adjust this to fit the hardware control mechanism
+    // Constrain the gain value within the allowed range
+    int gainValue = constrain(gain, 0, MIC_GAIN_LEVELS - 1);
+    driveThreeState(MIC_GAIN_PIN, gainPin[gainValue]);
+    driveThreeState(MIC_AR_PIN, attackReleasePin[gainValue]);
+    gainLevel = (uint8_t)gainValue;
 
     if (DEBUGMODE) {
         Serial.print("MicManager: Gain set to ");
-        Serial.println(gainValue);
+        Serial.print(MIC_GAIN_MIN_DB + gainValue * MIC_GAIN_STEP_DB);
+        Serial.println(" dB");
     }
 }
 
+/**
+ * @brief Returns the hardware gain level last set by `setGain()`.
+ */
+int MicManager::getGain() {
+    return gainLevel;
+}
+
+/**
+ * @brief Ties a control pin high or low, or leaves it open (input, no pull).
+ * 
+ * The level is written before the pin turns into an output, so it never glitches through
+ * the other state.
+ */
+void MicManager::driveThreeState(uint8_t pin, PinState state) {
+    if (state == PIN_OPEN) {
+        pinMode(pin, INPUT);
+        return;
+    }
+    digitalWrite(pin, state == PIN_HIGH ? HIGH : LOW);
+    pinMode(pin, OUTPUT);
+}
+
 /**
  * @brief Reads the microphone output value.
  * 
@@ -76,4 +114,328 @@ int MicManager::readOutput() {
     // Map the 10-bit ADC value (0-1024) to a signed 16-bit range (-1000 to 1000)
     int16_t convertedValue =  map(micValue, MIC_RESOLUTION_MIN, MIC_RESOLUTION_MAX, WAV_RESOLUTION_MIN, WAV_RESOLUTION_MAX); 
     return convertedValue; // Return the converted value
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Starts continuous capture of the microphone.
+ * 
+ * Frames of `MIC_FRAME_SAMPLES` samples are delivered from the capture task. With a callback,
+ * the callback receives each frame and must return quickly; without one, frames are queued to
+ * `captureRing()` and samples that do not fit are counted as dropped.
+ * 
+ * @param sample_rate Capture rate in Hz.
+ * @param callback Optional frame consumer, called from the capture task.
+ * @param context Passed back to the callback.
+ * @return true if capture started; false if it is already running or the ADC failed to start.
+ */
+bool MicManager::startCapture(uint32_t sample_rate, FrameCallback callback, void* context) {
+    if (capturing || xCaptureTask) {
+        return false; // One capture at a time
+    }
+
+    frameCallback = callback;
+    callbackContext = context;
+    ring.reset();
+    dcBlocker.reset();
+    preTrigger.store(0);
+    trimming.store(false);
+    memset(&stats, 0, sizeof(stats));
+    stats.sampleRate = sample_rate;
+    stats.dma = adcChannel >= 0 && !MIC_CAPTURE_POLLING;
+    lastFrameUs = 0;
+    frameJitterSumUs = 0;
+
+    if (stats.dma) {
+        adc_digi_init_config_t init_config = {};
+        init_config.max_store_buf_size = MIC_DMA_POOL_SIZE;
+        init_config.conv_num_each_intr = MIC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES;
+        init_config.adc1_chan_mask = 1UL << adcChannel;
+
+        adc_digi_pattern_config_t pattern = {};
+        pattern.atten = MIC_ADC_ATTEN;
+        pattern.channel = adcChannel;
+        pattern.unit = 0; // ADC1
+        pattern.bit_width = MIC_ADC_BITS;
+
+        adc_digi_configuration_t dig_config = {};
+        dig_config.conv_limit_en = false;
+        dig_config.conv_limit_num = 250;
+        dig_config.pattern_num = 1;
+        dig_config.adc_pattern = &pattern;
+        dig_config.sample_freq_hz = sample_rate;
+        dig_config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+        dig_config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+
+        if (adc_digi_initialize(&init_config) != ESP_OK ||
+            adc_digi_controller_configure(&dig_config) != ESP_OK ||
+            adc_digi_start() != ESP_OK) {
+            Serial.println("MicManager: Failed to start continuous ADC.");
+            adc_digi_deinitialize();
+            return false;
+        }
+    }
+
+    capturing = true;
+    if (xTaskCreate(captureTask, "CaptureTask", MIC_CAPTURE_STACK_SIZE, this, MIC_CAPTURE_TASK_PRIORITY, &xCaptureTask) != pdPASS) {
+        Serial.println("MicManager: Failed to create capture task.");
+        capturing = false;
+        xCaptureTask = NULL;
+        if (stats.dma) {
+            adc_digi_stop();
+            adc_digi_deinitialize();
+        }
+        return false;
+    }
+
+    if (DEBUGMODE) {
+        Serial.print("MicManager: Capture started at ");
+        Serial.print(sample_rate);
+        Serial.println(stats.dma ? " Hz (ADC DMA)" : " Hz (polling)");
+    }
+    return true;
+}
+
+/**
+ * @brief Stops capture, waits for the capture task to exit and releases the ADC.
+ * 
+ * Frames already queued to `captureRing()` stay there for the consumer.
+ */
+void MicManager::stopCapture() {
+    if (!xCaptureTask) {
+        return;
+    }
+    capturing = false;
+    while (xCaptureTask) {
+        vTaskDelay(1); // The task finishes its current frame and exits
+    }
+    if (stats.dma) {
+        adc_digi_stop();
+        adc_digi_deinitialize();
+    }
+    preTrigger.store(0);
+    trimming.store(false);
+
+    if (DEBUGMODE) {
+        Serial.print("MicManager: Capture stopped, frames ");
+        Serial.print(stats.frames);
+        Serial.print(", dropped ");
+        Serial.print(stats.droppedSamples);
+        Serial.print(", sample jitter ");
+        Serial.print(stats.maxSampleJitterUs);
+        Serial.print(" us, frame jitter max/mean ");
+        Serial.print(stats.maxFrameJitterUs);
+        Serial.print("/");
+        Serial.print(stats.meanFrameJitterUs);
+        Serial.print(" us, CPU ");
+        Serial.print(stats.cpuLoadPercent);
+        Serial.println(" %");
+    }
+}
+
+/**
+ * @brief Returns true while the capture task is running.
+ */
+bool MicManager::isCapturing() {
+    return capturing;
+}
+
+/**
+ * @brief Returns the ring frames are queued to when capture runs without a callback.
+ * 
+ * The capture task is the only producer; the caller must be the only consumer.
+ */
+MicManager::CaptureRing& MicManager::captureRing() {
+    return ring;
+}
+
+/**
+ * @brief Keeps only the newest samples in the capture ring, or hands the ring to a consumer.
+ * 
+ * With `samples` > 0 the capture task becomes the consumer of `captureRing()`: before each
+ * frame it drops the oldest samples so that at most `samples` stay queued. This keeps the
+ * moments before a recording in RAM without any other task running. With 0 it stops doing so
+ * and returns once the capture task has let go of the ring (at most one frame), so the caller
+ * can consume from then on, starting with the samples kept.
+ * 
+ * Only for capture without a callback. `startCapture()` and `stopCapture()` clear it.
+ * 
+ * @param samples Samples to keep, at most `RECORD_RING_SAMPLES` - `MIC_FRAME_SAMPLES`; 0 to
+ *                hand the ring over.
+ */
+void MicManager::setPreTrigger(size_t samples) {
+    if (samples > RECORD_RING_SAMPLES - MIC_FRAME_SAMPLES) {
+        samples = RECORD_RING_SAMPLES - MIC_FRAME_SAMPLES; // Room for the next frame
+    }
+    if (samples > 0) {
+        trimming.store(true);
+        preTrigger.store(samples, std::memory_order_release);
+        return;
+    }
+    preTrigger.store(0, std::memory_order_release);
+    while (trimming.load(std::memory_order_acquire) && xCaptureTask) {
+        vTaskDelay(1); // The capture task lets go at its next frame
+    }
+    stats.preTriggerSamples = 0;
+}
+
+/**
+ * @brief Returns the jitter and CPU load figures of the current or last capture.
+ */
+MicManager::CaptureStats MicManager::getCaptureStats() {
+    return stats;
+}
+
+/**
+ * @brief Capture task implementation.
+ * 
+ * Runs the DMA or the polling frame loop until `stopCapture()` is called.
+ * 
+ * @param parameter A pointer to the MicManager instance.
+ */
+void MicManager::captureTask(void* parameter) {
+    MicManager* mic = static_cast<MicManager*>(parameter);
+    if (mic->stats.dma) {
+        mic->captureDma();
+    } else {
+        mic->capturePolling();
+    }
+    mic->xCaptureTask = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Frame loop fed by the ADC DMA driver.
+ * 
+ * The task blocks in `adc_digi_read_bytes` until a frame worth of conversions is ready, so it
+ * only uses the CPU to unpack results. Sample timing comes from the ADC clock and has no
+ * software jitter; the driver reports an overflow when the task falls behind.
+ */
+void MicManager::captureDma() {
+    uint8_t raw[MIC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES];
+    int16_t frame[MIC_FRAME_SAMPLES];
+    size_t filled = 0;
+    const uint32_t fullScale = 1UL << MIC_ADC_BITS;
+    uint32_t startUs = micros();
+    uint64_t busyUs = 0;
+
+    while (capturing) {
+        uint32_t length = 0;
+        esp_err_t err = adc_digi_read_bytes(raw, sizeof(raw), &length, AUDIO_TASK_POLL_MS);
+        uint32_t wakeUs = micros();
+        if (err == ESP_ERR_INVALID_STATE) {
+            stats.droppedSamples += MIC_DMA_POOL_SIZE / SOC_ADC_DIGI_RESULT_BYTES; // Driver pool overflowed, estimate the loss
+        } else if (err != ESP_OK) {
+            continue; // Timeout, re-check the capture state
+        }
+
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t* result = reinterpret_cast<const adc_digi_output_data_t*>(&raw[i]);
+            if (result->type2.channel != (uint32_t)adcChannel) {
+                continue; // Not our channel
+            }
+            frame[filled++] = toSample(result->type2.data, fullScale);
+            if (filled == MIC_FRAME_SAMPLES) {
+                dcBlocker.process(frame, filled);
+                deliverFrame(frame, filled);
+                filled = 0;
+            }
+        }
+
+        uint32_t now = micros();
+        busyUs += now - wakeUs;
+        stats.cpuLoadPercent = (uint8_t)(busyUs * 100 / (now - startUs + 1));
+    }
+}
+
+/**
+ * @brief Frame loop fed by timed `analogRead` calls.
+ * 
+ * This is the previous recording loop moved onto the capture task: every sample is read on a
+ * `micros()` schedule and the task spins between samples, so it keeps its core busy. The
+ * lateness of each read is recorded as sample jitter.
+ */
+void MicManager::capturePolling() {
+    int16_t frame[MIC_FRAME_SAMPLES];
+    size_t filled = 0;
+    const uint32_t sampleInterval = 1000000UL / stats.sampleRate;
+    uint32_t startUs = micros();
+    uint32_t nextSampleTime = startUs;
+    uint64_t busyUs = 0;
+
+    while (capturing) {
+        uint32_t runUs = micros();
+        while ((int32_t)(micros() - nextSampleTime) < 0) {
+            // Spin until the sample is due
+        }
+        uint32_t late = micros() - nextSampleTime;
+        if (late > stats.maxSampleJitterUs) stats.maxSampleJitterUs = late;
+
+        frame[filled++] = toSample(analogRead(MIC_OUT_PIN), 1UL << MIC_RESOLUTION);
+        nextSampleTime += sampleInterval;
+
+        if (filled == MIC_FRAME_SAMPLES) {
+            dcBlocker.process(frame, filled);
+            deliverFrame(frame, filled);
+            filled = 0;
+            uint32_t now = micros();
+            busyUs += now - runUs;
+            stats.cpuLoadPercent = (uint8_t)(busyUs * 100 / (now - startUs + 1));
+            taskYIELD(); // Let tasks of the same priority run between frames
+        } else {
+            busyUs += micros() - runUs;
+        }
+    }
+}
+
+/**
+ * @brief Hands a complete frame to the callback or the capture ring and updates the jitter figures.
+ * 
+ * @param frame Frame samples.
+ * @param count Number of samples in the frame.
+ */
+void MicManager::deliverFrame(const int16_t* frame, size_t count) {
+    uint32_t now = micros();
+    if (lastFrameUs != 0) {
+        uint32_t period = (uint32_t)((uint64_t)count * 1000000UL / stats.sampleRate);
+        uint32_t interval = now - lastFrameUs;
+        uint32_t jitter = interval > period ? interval - period : period - interval;
+        if (jitter > stats.maxFrameJitterUs) stats.maxFrameJitterUs = jitter;
+        frameJitterSumUs += jitter;
+        stats.meanFrameJitterUs = (uint32_t)(frameJitterSumUs / stats.frames);
+    }
+    lastFrameUs = now;
+    stats.frames++;
+
+    if (frameCallback) {
+        frameCallback(frame, count, callbackContext);
+        return;
+    }
+    size_t keep = preTrigger.load(std::memory_order_acquire);
+    if (keep > 0) {
+        // Pre-trigger: this task is the consumer, drop the oldest to make room for the frame
+        size_t queued = ring.readAvailable();
+        size_t drop = queued + count > keep ? queued + count - keep : 0;
+        while (drop > 0) {
+            size_t span = drop;
+            ring.peek(span); // Also keeps the consumer's view of the ring current for the handover
+            if (span == 0) break;
+            ring.consume(span);
+            drop -= span;
+        }
+        stats.preTriggerSamples = ring.readAvailable() + count;
+    } else if (trimming.load(std::memory_order_relaxed)) {
+        trimming.store(false, std::memory_order_release); // Handed over, never touch the consumer side again
+    }
+    stats.droppedSamples += count - ring.write(frame, count);
+}
+
+/**
+ * @brief Scales a raw ADC reading to the WAV range, like `map()` in `readOutput()`.
+ * 
+ * @param raw Raw reading.
+ * @param fullScale Number of ADC codes (1 << resolution).
+ * @return The signed sample.
+ */
+int16_t MicManager::toSample(uint32_t raw, uint32_t fullScale) {
+    return (int16_t)(WAV_RESOLUTION_MIN + (int32_t)(raw * (uint32_t)(WAV_RESOLUTION_MAX - WAV_RESOLUTION_MIN) / fullScale));
+}
@@ -14,22 +14,92 @@
  * - I2SManager.h: Provides control over the I2S interface used to communicate with the microphone.
  * - Arduino.h: Required for general Arduino functions and types.
  * 
+ * ## Continuous Capture:
+ * `startCapture()` runs the ADC in continuous (DMA) mode, so samples are taken by the hardware
+ * at an exact rate instead of by a polling loop. A capture task collects the DMA results into
+ * frames of `MIC_FRAME_SAMPLES` signed 16-bit samples and delivers each frame either to a
+ * callback or, when no callback is given, to `captureRing()`. When the microphone pin has no
+ * ADC1 channel (continuous mode only supports ADC1), capture falls back to timed `analogRead`
+ * polling on the same task; `MIC_CAPTURE_POLLING` forces that loop on an ADC1 pin as well.
+ * `getCaptureStats()` reports sample and frame jitter and the CPU load of the capture task for
+ * both modes, so the two can be compared on the device. On this board the microphone is wired
+ * to GPIO38, which has no ADC1 channel, so capture polls until it moves to one of GPIO1-10.
+ * 
+ * ## Gain:
+ * The amplifier has `MIC_GAIN_LEVELS` hardware gains (40, 50 and 60 dB) chosen by a
+ * three-state gain pin, and an attack/release pin for its own limiter. `setGain()` drives
+ * both; the recording AGC (`AutoGain`) picks the level while recording.
+ * 
+ * ## Pre-trigger:
+ * `setPreTrigger()` keeps capture running between recordings with the capture task as the
+ * consumer of its own ring: it drops the oldest samples so the ring holds only the newest
+ * ones (`PRETRIGGER_MS` for the recordings). `setPreTrigger(0)` hands the consumer side back,
+ * with those samples still queued, so a recording writes them in place like any other frame.
+ * 
+ * Every frame goes through a fixed-point `DcBlocker` before it is delivered, so recordings
+ * do not carry the bias offset of the microphone (first-order high-pass, about 10 Hz at
+ * 8 kHz).
+ * 
  * @note Set up an I2SManager instance before using MicManager for audio data to ensure proper 
  * I2S initialization and audio handling.
  */
 #include "I2SManager.h"
 #include"Arduino.h"
+#include <driver/adc.h>
+#include "AudioRingBuffer.h"
+#include "DcBlocker.h"
+#include <atomic>
 
 class MicManager {
 public:
     MicManager();// Constructor, accepting a ConfigManager object for managing configuration
     void begin();// Initialize the microphone
-    void setGain(int gain);// Set the microphone gain
+    void setGain(int gain);// Set the hardware gain level (0 to MIC_GAIN_LEVELS - 1)
+    int getGain();// Hardware gain level last set
     int readOutput();// Read the microphone output value
+
+    typedef AudioRingBuffer<int16_t, RECORD_RING_SAMPLES> CaptureRing;
+    typedef void (*FrameCallback)(const int16_t* frame, size_t count, void* context);
+
+    struct CaptureStats {
+        bool dma;                   // true for continuous ADC DMA, false for analogRead polling
+        uint32_t sampleRate;        // Capture rate in Hz
+        uint32_t frames;            // Frames delivered since startCapture()
+        uint32_t droppedSamples;    // Samples lost to a full ring or a driver overflow
+        uint32_t maxSampleJitterUs; // Worst lateness of a sample against its schedule (0 for DMA)
+        uint32_t maxFrameJitterUs;  // Worst deviation of a frame interval from the frame period
+        uint32_t meanFrameJitterUs; // Mean deviation of a frame interval from the frame period
+        uint8_t cpuLoadPercent;     // Share of wall time the capture task spent running
+        uint32_t preTriggerSamples; // Samples queued ahead of a recording while pre-triggering, else 0
+    };
+
+    bool startCapture(uint32_t sample_rate, FrameCallback callback = nullptr, void* context = nullptr); // Start frame capture
+    void stopCapture();                 // Stop capture and release the ADC
+    bool isCapturing();                 // Capture task running
+    CaptureRing& captureRing();         // Frames captured without a callback
+    void setPreTrigger(size_t samples); // Keep only the newest samples in the ring, 0 to hand it to a consumer
+    CaptureStats getCaptureStats();     // Jitter and CPU load of the current or last capture
 private:
- float alpha = 0.98;                  // Filter coefficient for the high-pass filter
-    float lastMicValue = 0.0;            // Previous microphone value for high-pass filter
-    float filteredMicValue = 0.0;        // High-pass filtered microphone value
+    enum PinState : uint8_t { PIN_LOW, PIN_HIGH, PIN_OPEN }; // Three-state amplifier control pin
+    static void driveThreeState(uint8_t pin, PinState state); // Tie a control pin or leave it open
+    static void captureTask(void* parameter);            // FreeRTOS task collecting frames
+    void captureDma();                                   // Frame loop fed by the ADC DMA driver
+    void capturePolling();                               // Frame loop fed by timed analogRead
+    void deliverFrame(const int16_t* frame, size_t count); // Hand a frame to the callback or ring
+    static int16_t toSample(uint32_t raw, uint32_t fullScale); // Scale a raw reading to the WAV range
+    int8_t adcChannel;                   // ADC1 channel of MIC_OUT_PIN, -1 without continuous mode
+    uint8_t gainLevel;                   // Hardware gain level set by setGain()
+    volatile bool capturing;             // Cleared by stopCapture()
+    TaskHandle_t xCaptureTask;           // Task handle for the capture task
+    FrameCallback frameCallback;         // Frame consumer, nullptr to use the capture ring
+    void* callbackContext;               // Passed back to frameCallback
+    CaptureStats stats;                  // Updated by the capture task
+    uint32_t lastFrameUs;                // micros() of the previous frame delivery
+    uint64_t frameJitterSumUs;           // Sum of frame interval deviations
+    CaptureRing ring;                    // Frames waiting for a consumer
+    DcBlocker dcBlocker;                 // Removes the bias offset from each captured frame
+    std::atomic<size_t> preTrigger;      // Samples the capture task keeps in the ring, 0 when a consumer has it
+    std::atomic<bool> trimming;          // The capture task may still consume from the ring
 
 };
 
@@ -0,0 +1,198 @@
+#include "Mp3Decoder.h"
+#include <esp_timer.h>
+
+/**
+ * @brief Constructor, the decoder must be allocated with `begin()` before use.
+ */
+Mp3Decoder::Mp3Decoder()
+    : m_decoder(nullptr), m_input(nullptr), m_readPos(0), m_bytesLeft(0),
+      m_totalDecodeUs(0), m_totalAudioUs(0) {
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/**
+ * @brief Destructor, frees the decoder state.
+ */
+Mp3Decoder::~Mp3Decoder() {
+    end();
+}
+
+/**
+ * @brief Allocates the Helix decoder and the input buffer.
+ *
+ * @return true if both were allocated.
+ */
+bool Mp3Decoder::begin() {
+    if (!m_decoder) {
+        m_decoder = MP3InitDecoder();
+    }
+    if (!m_input) {
+        m_input = new uint8_t[MP3_INPUT_BUFFER_SIZE];
+    }
+    if (!m_decoder || !m_input) {
+        Serial.println("Failed to allocate MP3 decoder.");
+        end();
+        return false;
+    }
+    m_readPos = 0;
+    m_bytesLeft = 0;
+    return true;
+}
+
+/**
+ * @brief Frees the decoder state and the input buffer.
+ */
+void Mp3Decoder::end() {
+    if (m_decoder) {
+        MP3FreeDecoder(m_decoder);
+        m_decoder = nullptr;
+    }
+    delete[] m_input;
+    m_input = nullptr;
+    m_readPos = 0;
+    m_bytesLeft = 0;
+}
+
+/**
+ * @brief Drops the buffered input and the bit reservoir, for a rewind.
+ *
+ * Helix has no reset call, so the decoder state is reallocated.
+ */
+void Mp3Decoder::reset() {
+    if (m_decoder) {
+        MP3FreeDecoder(m_decoder);
+        m_decoder = MP3InitDecoder();
+    }
+    m_readPos = 0;
+    m_bytesLeft = 0;
+}
+
+/**
+ * @brief Returns the free space at the end of the input buffer.
+ *
+ * Undecoded bytes are moved to the front first, so the space is as large as possible.
+ *
+ * @param count Out: number of bytes that may be written.
+ * @return Pointer to the first free byte.
+ */
+uint8_t* Mp3Decoder::inputSpace(size_t& count) {
+    if (m_readPos > 0) {
+        memmove(m_input, m_input + m_readPos, m_bytesLeft);
+        m_readPos = 0;
+    }
+    count = MP3_INPUT_BUFFER_SIZE - m_bytesLeft;
+    return m_input + m_bytesLeft;
+}
+
+/**
+ * @brief Publishes bytes written into the space returned by `inputSpace()`.
+ */
+void Mp3Decoder::inputCommit(size_t count) {
+    m_bytesLeft += count;
+}
+
+/**
+ * @brief Returns the number of input bytes not decoded yet.
+ */
+size_t Mp3Decoder::bufferedBytes() {
+    return m_bytesLeft;
+}
+
+/**
+ * @brief Finds the next frame and parses its header without decoding it.
+ *
+ * Bytes before the frame are dropped.
+ *
+ * @param sampleRate Out: sample rate of the stream.
+ * @param channels Out: number of channels.
+ * @return true if a valid frame header was found in the buffered input.
+ */
+bool Mp3Decoder::probe(int& sampleRate, int& channels) {
+    while (m_bytesLeft > 4) {
+        int offset = MP3FindSyncWord(m_input + m_readPos, m_bytesLeft);
+        if (offset < 0) {
+            return false;
+        }
+        m_readPos += offset;
+        m_bytesLeft -= offset;
+
+        MP3FrameInfo info;
+        if (MP3GetNextFrameInfo(m_decoder, &info, m_input + m_readPos) == ERR_MP3_NONE) {
+            sampleRate = info.samprate;
+            channels = info.nChans;
+            return true;
+        }
+        m_readPos++; // False sync, keep searching
+        m_bytesLeft--;
+    }
+    return false;
+}
+
+/**
+ * @brief Decodes the next frame from the buffered input.
+ *
+ * @param out Destination for up to `maxFrameSamples()` interleaved samples.
+ * @return The number of samples written (> 0); 0 if the next frame is not complete
+ *         yet and more input is needed; a negative value if a frame produced no
+ *         output (bit reservoir warm-up or a corrupt frame, which is skipped).
+ */
+int Mp3Decoder::decodeFrame(int16_t* out) {
+    int offset = MP3FindSyncWord(m_input + m_readPos, m_bytesLeft);
+    if (offset < 0) {
+        // No sync in the buffer: keep the last byte, it may start a split sync word
+        m_readPos += m_bytesLeft > 0 ? m_bytesLeft - 1 : 0;
+        m_bytesLeft = m_bytesLeft > 0 ? 1 : 0;
+        return 0;
+    }
+    m_readPos += offset;
+    m_bytesLeft -= offset;
+
+    unsigned char* ptr = m_input + m_readPos;
+    int left = (int)m_bytesLeft;
+    int64_t startUs = esp_timer_get_time();
+    int err = MP3Decode(m_decoder, &ptr, &left, out, 0);
+    uint32_t decodeUs = (uint32_t)(esp_timer_get_time() - startUs);
+
+    if (err == ERR_MP3_INDATA_UNDERFLOW) {
+        return 0; // Frame not complete, leave it in the buffer
+    }
+    if (err == ERR_MP3_MAINDATA_UNDERFLOW) {
+        m_readPos = ptr - m_input; // Frame consumed into the bit reservoir
+        m_bytesLeft = left;
+        return -1;
+    }
+    if (err != ERR_MP3_NONE) {
+        m_readPos++; // Corrupt frame, resync on the next byte
+        m_bytesLeft--;
+        return -1;
+    }
+    m_readPos = ptr - m_input;
+    m_bytesLeft = left;
+
+    MP3FrameInfo info;
+    MP3GetLastFrameInfo(m_decoder, &info);
+    if (info.samprate > 0 && info.nChans > 0) {
+        m_totalAudioUs += (uint64_t)(info.outputSamps / info.nChans) * 1000000ULL / info.samprate;
+    }
+    m_totalDecodeUs += decodeUs;
+    m_stats.frames++;
+    m_stats.lastFrameUs = decodeUs;
+    if (decodeUs > m_stats.maxFrameUs) m_stats.maxFrameUs = decodeUs;
+    m_stats.meanFrameUs = (uint32_t)(m_totalDecodeUs / m_stats.frames);
+    m_stats.loadPercent = m_totalAudioUs ? (uint8_t)(m_totalDecodeUs * 100 / m_totalAudioUs) : 0;
+    return info.outputSamps;
+}
+
+/**
+ * @brief Returns the number of interleaved samples one frame may produce.
+ */
+size_t Mp3Decoder::maxFrameSamples() {
+    return MAX_NCHAN * MAX_NGRAN * MAX_NSAMP;
+}
+
+/**
+ * @brief Returns the decode time per frame of the stream so far.
+ */
+Mp3Decoder::Stats Mp3Decoder::getStats() {
+    return m_stats;
+}
@@ -0,0 +1,67 @@
+#ifndef MP3_DECODER_H
+#define MP3_DECODER_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "libhelix-mp3/mp3dec.h"
+
+/**
+ * @file Mp3Decoder.h
+ * @brief Frame-by-frame streaming MP3 decoder built on the fixed-point Helix decoder.
+ *
+ * The `Mp3Decoder` class keeps a small input buffer that the caller refills from the SD card
+ * through `inputSpace()`/`inputCommit()`, and decodes one MPEG audio frame per
+ * `decodeFrame()` call into interleaved 16-bit samples. The working set is bounded by the Helix
+ * state, the `MP3_INPUT_BUFFER_SIZE` input buffer and one output frame, whatever the length of
+ * the file; nothing is buffered beyond the next frame.
+ *
+ * Every decoded frame is timed, and `getStats()` reports the decode time per frame against the
+ * audio duration of the frame, i.e. the share of one core the decoder needs for real time.
+ *
+ * ## Example:
+ * ```cpp
+ * Mp3Decoder mp3;
+ * mp3.begin();
+ * size_t space;
+ * uint8_t* dst = mp3.inputSpace(space);
+ * mp3.inputCommit(file.read(dst, space));
+ * int samples = mp3.decodeFrame(pcm); // > 0 samples, 0 needs more input, < 0 frame skipped
+ * ```
+ */
+
+#define WAVE_FORMAT_MPEGLAYER3 0x0055                        ///< Format tag reported for MP3 streams
+
+class Mp3Decoder {
+public:
+    struct Stats {
+        uint32_t frames;                // Frames decoded
+        uint32_t lastFrameUs;           // Decode time of the last frame
+        uint32_t maxFrameUs;            // Worst decode time of a frame
+        uint32_t meanFrameUs;           // Mean decode time of a frame
+        uint8_t loadPercent;            // Decode time as a share of the decoded audio duration
+    };
+
+    Mp3Decoder();
+    ~Mp3Decoder();
+    bool begin();                       // Allocate the decoder and the input buffer
+    void end();                         // Free everything
+    void reset();                       // Drop buffered input and decoder history (rewind)
+    uint8_t* inputSpace(size_t& count); // Free space at the end of the input buffer
+    void inputCommit(size_t count);     // Publish bytes written into inputSpace()
+    size_t bufferedBytes();             // Input bytes not decoded yet
+    bool probe(int& sampleRate, int& channels); // Parse the next frame header without decoding
+    int decodeFrame(int16_t* out);      // Decode one frame, see the file comment for the result
+    static size_t maxFrameSamples();    // Interleaved samples one frame may produce
+    Stats getStats();                   // Decode time per frame
+
+private:
+    HMP3Decoder m_decoder;              // Helix decoder state
+    uint8_t* m_input;                   // Undecoded input
+    size_t m_readPos;                   // First undecoded byte in m_input
+    size_t m_bytesLeft;                 // Undecoded bytes from m_readPos
+    Stats m_stats;                      // Decode timing
+    uint64_t m_totalDecodeUs;           // Sum of frame decode times
+    uint64_t m_totalAudioUs;            // Sum of decoded frame durations
+};
+
+#endif // MP3_DECODER_H
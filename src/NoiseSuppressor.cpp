@@ -0,0 +1,294 @@
+#include "NoiseSuppressor.h"
+#include <esp_timer.h>
+#include <math.h>
+
+/**
+ * @brief Constructor, computes the window, twiddle factors and bit-reversal order.
+ */
+NoiseSuppressor::NoiseSuppressor() {
+    static_assert((NOISE_FFT_SIZE & (NOISE_FFT_SIZE - 1)) == 0, "NOISE_FFT_SIZE must be a power of two");
+    const float pi = 3.14159265358979f;
+    for (size_t n = 0; n < NOISE_FFT_SIZE; n++) {
+        m_window[n] = sinf(pi * n / NOISE_FFT_SIZE); // Squared, a periodic Hann: halves overlapping by 50 % sum to 1
+    }
+    for (size_t k = 0; k < NOISE_FFT_SIZE / 2; k++) {
+        m_cos[k] = cosf(2.0f * pi * k / NOISE_FFT_SIZE);
+        m_sin[k] = -sinf(2.0f * pi * k / NOISE_FFT_SIZE);
+    }
+    size_t bits = 0;
+    while ((1u << bits) < NOISE_FFT_SIZE) {
+        bits++;
+    }
+    for (size_t i = 0; i < NOISE_FFT_SIZE; i++) {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        m_bitrev[i] = (uint16_t)reversed;
+    }
+
+    m_oversubtract = powf(10.0f, NOISE_OVERSUBTRACT_DB / 10.0f);
+    m_floor = powf(10.0f, NOISE_FLOOR_DB / 10.0f);
+    m_update = powf(10.0f, NOISE_UPDATE_DB / 10.0f);
+    reset(SAMPLE_RATE);
+}
+
+/**
+ * @brief Starts a new stream: drops the delayed samples and forgets the noise profile.
+ *
+ * @param sampleRate Rate of the stream, sets the number of frames the profile is learnt from
+ *                   and the time budget of a frame.
+ */
+void NoiseSuppressor::reset(uint32_t sampleRate) {
+    memset(m_noise, 0, sizeof(m_noise));
+    memset(m_input, 0, sizeof(m_input));
+    memset(m_overlap, 0, sizeof(m_overlap));
+    memset(m_output, 0, sizeof(m_output));
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_pos = 0;
+    m_totalUs = 0;
+    m_learnFrames = (uint32_t)((uint64_t)NOISE_LEARN_MS * sampleRate / 1000 / NOISE_HOP_SAMPLES);
+    if (m_learnFrames == 0) {
+        m_learnFrames = 1;
+    }
+    m_stats.budgetUs = (uint32_t)((uint64_t)NOISE_HOP_SAMPLES * 10000ULL * NOISE_CPU_BUDGET_PERCENT / sampleRate);
+}
+
+/**
+ * @brief Suppresses the noise of a block in place.
+ *
+ * Each sample is swapped for the output sample `latency()` positions earlier; a frame is
+ * processed every `NOISE_HOP_SAMPLES` samples, so blocks may have any length.
+ *
+ * @param samples Mono 16-bit samples.
+ * @param count Number of samples.
+ */
+void NoiseSuppressor::process(int16_t* samples, size_t count) {
+    while (count > 0) {
+        size_t span = NOISE_HOP_SAMPLES - m_pos;
+        if (span > count) {
+            span = count;
+        }
+        float* in = m_input + NOISE_HOP_SAMPLES + m_pos;
+        for (size_t i = 0; i < span; i++) {
+            in[i] = samples[i];
+        }
+        memcpy(samples, m_output + m_pos, span * sizeof(int16_t));
+        samples += span;
+        count -= span;
+        m_pos += span;
+        if (m_pos == NOISE_HOP_SAMPLES) {
+            processFrame();
+            m_pos = 0;
+        }
+    }
+}
+
+/**
+ * @brief Pushes the delayed tail out with silence, at the end of a stream.
+ *
+ * @param count Out: the number of samples returned, `latency()`.
+ * @return The last samples of the stream, valid until the next call.
+ */
+int16_t* NoiseSuppressor::drain(size_t& count) {
+    count = latency();
+    memset(m_tail, 0, sizeof(m_tail));
+    process(m_tail, count);
+    return m_tail;
+}
+
+/**
+ * @brief Returns the delay added to the stream, in samples (32 ms at 8 kHz).
+ */
+size_t NoiseSuppressor::latency() {
+    return NOISE_FFT_SIZE;
+}
+
+/**
+ * @brief Returns true during the first `NOISE_LEARN_MS` of a stream.
+ */
+bool NoiseSuppressor::isLearning() {
+    return m_stats.frames < m_learnFrames;
+}
+
+/**
+ * @brief Returns the frame count and timing since `reset()`.
+ */
+NoiseSuppressor::Stats NoiseSuppressor::getStats() {
+    return m_stats;
+}
+
+/**
+ * @brief Processes the frame made of the previous and the current hop.
+ *
+ * The first `NOISE_LEARN_MS` of frames are averaged into the noise profile; afterwards only
+ * frames within `NOISE_UPDATE_DB` of it refine it, by 1/2^`NOISE_TRACK_SHIFT` per frame. The
+ * profile is applied as it stands, also while it is being learnt.
+ */
+void NoiseSuppressor::processFrame() {
+    int64_t start = esp_timer_get_time();
+
+    for (size_t n = 0; n < NOISE_FFT_SIZE; n++) {
+        m_re[n] = m_input[n] * m_window[n];
+        m_im[n] = 0.0f;
+    }
+    memcpy(m_input, m_input + NOISE_HOP_SAMPLES, NOISE_HOP_SAMPLES * sizeof(float));
+    transform(m_re, m_im);
+
+    float framePower = 0.0f;
+    float noisePower = 0.0f;
+    for (size_t k = 0; k < NOISE_BINS; k++) {
+        m_power[k] = m_re[k] * m_re[k] + m_im[k] * m_im[k];
+        framePower += m_power[k];
+        noisePower += m_noise[k];
+    }
+    if (m_stats.frames < m_learnFrames) {
+        float share = 1.0f / (m_stats.frames + 1); // Running mean
+        for (size_t k = 0; k < NOISE_BINS; k++) {
+            m_noise[k] += (m_power[k] - m_noise[k]) * share;
+        }
+    } else if (framePower <= noisePower * m_update) {
+        const float share = 1.0f / (1 << NOISE_TRACK_SHIFT);
+        for (size_t k = 0; k < NOISE_BINS; k++) {
+            m_noise[k] += (m_power[k] - m_noise[k]) * share;
+        }
+    }
+
+    for (size_t k = 0; k < NOISE_BINS; k++) {
+        float gain = m_power[k] > 0.0f ? 1.0f - m_oversubtract * m_noise[k] / m_power[k] : 0.0f;
+        gain = sqrtf(gain > m_floor ? gain : m_floor);
+        m_re[k] *= gain;
+        m_im[k] *= gain;
+        if (k > 0 && k < NOISE_FFT_SIZE / 2) {
+            m_re[NOISE_FFT_SIZE - k] *= gain; // Mirror bin, keeps the frame real
+            m_im[NOISE_FFT_SIZE - k] *= gain;
+        }
+    }
+
+    transform(m_im, m_re); // Inverse: the real part lands in m_re, times NOISE_FFT_SIZE
+    const float scale = 1.0f / NOISE_FFT_SIZE;
+    for (size_t n = 0; n < NOISE_HOP_SAMPLES; n++) {
+        float v = m_overlap[n] + m_re[n] * m_window[n] * scale;
+        int32_t sample = (int32_t)lrintf(v);
+        m_output[n] = (int16_t)(sample > 32767 ? 32767 : (sample < -32768 ? -32768 : sample));
+        m_overlap[n] = m_re[n + NOISE_HOP_SAMPLES] * m_window[n + NOISE_HOP_SAMPLES] * scale;
+    }
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    m_stats.frames++;
+    m_totalUs += us;
+    m_stats.meanUs = (uint32_t)(m_totalUs / m_stats.frames);
+    if (us > m_stats.maxUs) {
+        m_stats.maxUs = us;
+    }
+}
+
+/**
+ * @brief In-place iterative radix-2 FFT over `NOISE_FFT_SIZE` points.
+ *
+ * Called with the real and imaginary parts swapped it computes the inverse transform, times
+ * `NOISE_FFT_SIZE`.
+ */
+void NoiseSuppressor::transform(float* re, float* im) {
+    for (size_t i = 0; i < NOISE_FFT_SIZE; i++) {
+        size_t j = m_bitrev[i];
+        if (j > i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (size_t half = 1, stride = NOISE_FFT_SIZE / 2; half < NOISE_FFT_SIZE; half <<= 1, stride >>= 1) {
+        for (size_t group = 0; group < NOISE_FFT_SIZE; group += half << 1) {
+            for (size_t k = 0; k < half; k++) {
+                float wr = m_cos[k * stride];
+                float wi = m_sin[k * stride];
+                size_t a = group + k;
+                size_t b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Prints the SNR gained on a synthetic recording and the cost of a frame.
+ *
+ * Runs on the calling core with a private instance at `SAMPLE_RATE`: 500 ms of white noise,
+ * then a 440 Hz tone over the same noise for 1.5 s, fed in capture frames. The tone level is
+ * fitted over the last second before and after suppression, and everything else counts as
+ * noise. The cost is reported per frame against `NOISE_CPU_BUDGET_PERCENT` of its hop.
+ */
+void NoiseSuppressor::benchmark() {
+    NoiseSuppressor* stage = new NoiseSuppressor();
+    int16_t* frame = new int16_t[MIC_FRAME_SAMPLES];
+    if (!stage || !frame) {
+        delete stage;
+        delete[] frame;
+        return;
+    }
+
+    const uint32_t rate = SAMPLE_RATE;
+    const size_t total = rate * 2;
+    const size_t measureFrom = total - rate; // Last second, the tone starts at rate / 2
+    const float w = 2.0f * 3.14159265f * 440.0f / rate;
+    uint32_t seed = 12345;
+    // Sums over the measured span for the input (0) and the output (1): sample squared, sin and cos projections
+    double energy[2] = { 0.0, 0.0 }, sinSum[2] = { 0.0, 0.0 }, cosSum[2] = { 0.0, 0.0 };
+    double quietIn = 0.0, quietOut = 0.0; // Noise only, after learning
+
+    for (size_t done = 0; done < total; done += MIC_FRAME_SAMPLES) {
+        int16_t input[MIC_FRAME_SAMPLES];
+        for (size_t i = 0; i < MIC_FRAME_SAMPLES; i++) {
+            size_t n = done + i;
+            seed = seed * 1664525UL + 1013904223UL;
+            float v = (int16_t)(seed >> 16) * (1500.0f / 32768.0f);
+            if (n >= rate / 2) {
+                v += 3000.0f * sinf(w * n);
+            }
+            input[i] = (int16_t)v;
+            frame[i] = input[i];
+        }
+        stage->process(frame, MIC_FRAME_SAMPLES);
+
+        for (size_t i = 0; i < MIC_FRAME_SAMPLES; i++) {
+            size_t n = done + i; // Input sample n; output sample n is input n - latency()
+            if (n >= measureFrom) {
+                double s = sin(w * n), c = cos(w * n);
+                energy[0] += (double)input[i] * input[i];
+                sinSum[0] += input[i] * s;
+                cosSum[0] += input[i] * c;
+                energy[1] += (double)frame[i] * frame[i];
+                sinSum[1] += frame[i] * s;
+                cosSum[1] += frame[i] * c;
+            }
+            if (n >= rate * 2 / 5 && n < rate / 2) { // 400..500 ms in, before the tone reaches either side
+                quietIn += (double)input[i] * input[i];
+                quietOut += (double)frame[i] * frame[i];
+            }
+        }
+    }
+
+    float snr[2];
+    float toneDb[2];
+    for (int side = 0; side < 2; side++) {
+        double tone = 2.0 * (sinSum[side] * sinSum[side] + cosSum[side] * cosSum[side]) / (total - measureFrom); // Fitted tone energy
+        double noise = energy[side] - tone;
+        snr[side] = (float)(10.0 * log10(tone / (noise > 1.0 ? noise : 1.0)));
+        toneDb[side] = (float)(10.0 * log10(tone > 1.0 ? tone : 1.0));
+    }
+    float quietDb = (float)(10.0 * log10((quietOut > 1.0 ? quietOut : 1.0) / (quietIn > 1.0 ? quietIn : 1.0)));
+    Stats stats = stage->getStats();
+
+    delete stage;
+    delete[] frame;
+
+    Serial.printf("NoiseSuppressor: SNR %.1f -> %.1f dB, tone %+.1f dB, noise alone %+.1f dB, "
+                  "%u us per %u-sample frame (worst %u, budget %u us, %s)\n",
+                  snr[0], snr[1], toneDb[1] - toneDb[0], quietDb, stats.meanUs, (unsigned)NOISE_FFT_SIZE,
+                  stats.maxUs, stats.budgetUs, stats.maxUs <= stats.budgetUs ? "met" : "EXCEEDED");
+}
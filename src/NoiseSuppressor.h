@@ -0,0 +1,87 @@
+#ifndef NOISE_SUPPRESSOR_H
+#define NOISE_SUPPRESSOR_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * @file NoiseSuppressor.h
+ * @brief Streaming spectral-subtraction noise suppressor for the microphone recordings.
+ *
+ * The analog microphone on `MIC_OUT_PIN` adds a steady hiss to every recording. This stage
+ * removes it block by block as the recording writer task drains the capture ring.
+ *
+ * The stream is cut into frames of `NOISE_FFT_SIZE` samples overlapping by half. Each frame is
+ * windowed, transformed, and every frequency bin is scaled by a gain computed from its power
+ * and the noise profile: `1 - NOISE_OVERSUBTRACT_DB * noise / power` (power domain), never
+ * below `NOISE_FLOOR_DB`. The frame is transformed back, windowed again and overlap-added. The
+ * square-root Hann window is used on both sides, so with nothing to subtract the output is the
+ * input, delayed by `latency()` samples.
+ *
+ * The noise profile is the mean power spectrum of the first `NOISE_LEARN_MS` of the recording,
+ * the moment between the button press and the first word. Later frames whose power stays
+ * within `NOISE_UPDATE_DB` of the profile keep refining it, so it follows a slowly changing
+ * background but not speech.
+ *
+ * The window, the twiddle factors and the bit-reversal order are computed once by the
+ * constructor; a frame costs two radix-2 transforms and one square root per bin. Each frame
+ * is timed and `getStats()` reports the mean and worst time against the
+ * `NOISE_CPU_BUDGET_PERCENT` budget of the frame hop. `benchmark()` runs a synthetic tone in
+ * noise through a private instance and prints the SNR gained and the cost.
+ *
+ * ## Example:
+ * ```cpp
+ * NoiseSuppressor suppressor;
+ * suppressor.reset(SAMPLE_RATE);          // New recording, learn a new profile
+ * suppressor.process(samples, count);     // Any block length, in place
+ * size_t tailCount;
+ * int16_t* tail = suppressor.drain(tailCount); // Last latency() samples at the end
+ * ```
+ */
+
+#define NOISE_HOP_SAMPLES (NOISE_FFT_SIZE / 2)               ///< New samples per frame (50 % overlap)
+#define NOISE_BINS (NOISE_FFT_SIZE / 2 + 1)                  ///< Frequency bins of a real frame, DC to Nyquist
+
+class NoiseSuppressor {
+public:
+    struct Stats {
+        uint32_t frames;                // Frames processed since reset()
+        uint32_t meanUs;                // Mean processing time of a frame
+        uint32_t maxUs;                 // Worst processing time of a frame
+        uint32_t budgetUs;              // NOISE_CPU_BUDGET_PERCENT of the frame hop
+    };
+
+    NoiseSuppressor();
+    void reset(uint32_t sampleRate);    // Start a new stream and learn a new noise profile
+    void process(int16_t* samples, size_t count); // Suppress noise in place (delayed by latency())
+    int16_t* drain(size_t& count);      // Push the delayed tail out with silence, returns it
+    size_t latency();                   // Delay added to the stream, in samples
+    bool isLearning();                  // The noise profile is still being learnt
+    Stats getStats();                   // Frame timing against the budget
+    static void benchmark();            // Print the SNR gain on a synthetic signal and the cost
+
+private:
+    void processFrame();                // Suppress the frame in m_input and refill m_output
+    void transform(float* re, float* im); // In-place radix-2 FFT, swap re and im for the inverse
+    float m_window[NOISE_FFT_SIZE];     // Square-root Hann analysis and synthesis window
+    float m_cos[NOISE_FFT_SIZE / 2];    // Twiddle factors, real part
+    float m_sin[NOISE_FFT_SIZE / 2];    // Twiddle factors, imaginary part
+    uint16_t m_bitrev[NOISE_FFT_SIZE];  // Bit-reversed index of each sample
+    float m_re[NOISE_FFT_SIZE];         // Transform buffer, real part
+    float m_im[NOISE_FFT_SIZE];         // Transform buffer, imaginary part
+    float m_power[NOISE_BINS];          // Power of each bin of the current frame
+    float m_noise[NOISE_BINS];          // Noise profile, power per bin
+    float m_input[NOISE_FFT_SIZE];      // Previous hop, then the hop being filled
+    float m_overlap[NOISE_HOP_SAMPLES]; // Second half of the previous synthesized frame
+    int16_t m_output[NOISE_HOP_SAMPLES]; // Finished samples handed out during the next hop
+    int16_t m_tail[NOISE_FFT_SIZE];     // Output of drain()
+    size_t m_pos;                       // Samples of the current hop taken in
+    uint32_t m_learnFrames;             // Frames the profile is learnt from
+    float m_oversubtract;               // NOISE_OVERSUBTRACT_DB as a power ratio
+    float m_floor;                      // NOISE_FLOOR_DB as a power ratio
+    float m_update;                     // NOISE_UPDATE_DB as a power ratio
+    Stats m_stats;                      // Frame timing
+    uint64_t m_totalUs;                 // Sum of the frame times
+};
+
+#endif // NOISE_SUPPRESSOR_H
@@ -0,0 +1,363 @@
+#include "PrefetchCache.h"
+#include <esp_timer.h>
+
+/**
+ * @brief Constructor, the cache does nothing until `begin()` has allocated its pool.
+ */
+PrefetchCache::PrefetchCache()
+    : m_pool(nullptr), m_blocks(nullptr), m_blockCount(0), m_useCounter(0), m_attachCounter(0),
+      m_totalFillUs(0), m_lock(NULL), m_fillTask(NULL), m_running(false), m_fillRunning(false) {
+    for (size_t s = 0; s < PREFETCH_STREAMS; s++) {
+        m_streams[s].active = false;
+        m_streams[s].busy = false;
+    }
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/**
+ * @brief Destructor, stops the fill task and frees the pool.
+ *
+ * Waits for the fill task to exit however long its current block read takes, as it
+ * reads into the pool and holds the lock around it.
+ */
+PrefetchCache::~PrefetchCache() {
+    if (m_fillRunning) {
+        xTaskNotifyGive(m_fillTask); // While it cannot exit yet, so the handle is valid
+        m_running = false;
+    }
+    while (m_fillRunning) {
+        vTaskDelay(1); // Let the current block read finish, the task sleeps AUDIO_TASK_POLL_MS at most
+    }
+    for (int s = 0; s < PREFETCH_STREAMS; s++) {
+        detach(s);
+    }
+    if (m_lock) vSemaphoreDelete(m_lock);
+    delete[] m_blocks;
+    heap_caps_free(m_pool);
+}
+
+/**
+ * @brief Allocates the block pool in PSRAM and starts the fill task.
+ *
+ * @return false if there is no PSRAM (or not enough), the cache then stays disabled.
+ */
+bool PrefetchCache::begin() {
+    if (m_pool) {
+        return true;
+    }
+    m_pool = (uint8_t*)heap_caps_malloc(PREFETCH_CACHE_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!m_pool) {
+        Serial.println("PrefetchCache: no PSRAM, reading audio from SD only.");
+        return false;
+    }
+    m_blockCount = PREFETCH_CACHE_BYTES / PREFETCH_BLOCK_BYTES;
+    m_blocks = new Block[m_blockCount];
+    for (size_t b = 0; b < m_blockCount; b++) {
+        m_blocks[b].state = BLOCK_FREE;
+        m_blocks[b].lastUsed = 0;
+    }
+    m_lock = xSemaphoreCreateMutex();
+    m_running = true;
+    m_fillRunning = true; // Before the task can run, it clears the flag as it exits
+    if (xTaskCreate(fillTask, "PrefetchTask", PREFETCH_STACK_SIZE, this, PREFETCH_TASK_PRIORITY, &m_fillTask) != pdPASS) {
+        m_fillRunning = false;
+        m_fillTask = NULL;
+    }
+    if (DEBUGMODE) {
+        Serial.printf("PrefetchCache: %u blocks of %u bytes in PSRAM\n", (unsigned)m_blockCount, (unsigned)PREFETCH_BLOCK_BYTES);
+    }
+    return true;
+}
+
+/**
+ * @brief Starts reading ahead in a file.
+ *
+ * @param path Path of the file on the SD card; the fill task opens its own handle.
+ * @param start First byte to read ahead from, usually the start of the audio data.
+ * @param end End of the bytes to read ahead.
+ * @param bytesPerSecond File bytes played per second, sizes the read-ahead window.
+ * @return The stream number for `read()`, or -1 if the cache is disabled or full.
+ */
+int PrefetchCache::attach(const char* path, uint32_t start, uint32_t end, uint32_t bytesPerSecond) {
+    if (!m_pool || !path) {
+        return -1;
+    }
+    File file = SD.open(path);
+    if (!file) {
+        return -1;
+    }
+    uint32_t size = (uint32_t)file.size();
+    uint32_t key = fileKey(path, size, (uint32_t)file.getLastWrite());
+
+    xSemaphoreTake(m_lock, portMAX_DELAY);
+    int stream = -1;
+    for (int s = 0; s < PREFETCH_STREAMS; s++) {
+        if (!m_streams[s].active && !m_streams[s].busy) {
+            stream = s;
+            break;
+        }
+    }
+    if (stream >= 0) {
+        Stream& slot = m_streams[stream];
+        slot.file = file;
+        slot.key = key;
+        slot.end = end < size ? end : size;
+        slot.aheadBytes = (uint32_t)((uint64_t)bytesPerSecond * PREFETCH_AHEAD_MS / 1000);
+        slot.playHead = start;
+        slot.attachOrder = ++m_attachCounter;
+        slot.active = true;
+    }
+    xSemaphoreGive(m_lock);
+
+    if (stream < 0) {
+        file.close();
+        return -1;
+    }
+    xTaskNotifyGive(m_fillTask);
+    return stream;
+}
+
+/**
+ * @brief Stops reading ahead in a file.
+ *
+ * Waits for a block read in progress on it; its cached blocks become evictable.
+ */
+void PrefetchCache::detach(int stream) {
+    if (!m_pool || stream < 0 || stream >= PREFETCH_STREAMS) {
+        return;
+    }
+    xSemaphoreTake(m_lock, portMAX_DELAY);
+    bool wasActive = m_streams[stream].active;
+    m_streams[stream].active = false;
+    xSemaphoreGive(m_lock);
+    if (!wasActive) {
+        return;
+    }
+
+    while (m_streams[stream].busy) {
+        vTaskDelay(1); // The fill task is reading this file
+    }
+    m_streams[stream].file.close();
+}
+
+/**
+ * @brief Copies cached bytes of a file and moves its play head.
+ *
+ * Copies from `offset` as long as the blocks are cached; the caller reads the
+ * remaining bytes from the SD card. The read-ahead window then starts at the end
+ * of this read.
+ *
+ * @param stream Stream number from `attach()`.
+ * @param offset File offset of the first byte.
+ * @param buffer Destination.
+ * @param size Bytes wanted.
+ * @return Bytes copied, from 0 (miss) to `size` (hit).
+ */
+size_t PrefetchCache::read(int stream, uint32_t offset, uint8_t* buffer, size_t size) {
+    if (!m_pool || stream < 0 || stream >= PREFETCH_STREAMS) {
+        return 0;
+    }
+
+    xSemaphoreTake(m_lock, portMAX_DELAY);
+    Stream& slot = m_streams[stream];
+    size_t copied = 0;
+    if (slot.active) {
+        while (copied < size) {
+            uint32_t position = offset + copied;
+            int b = findBlock(slot.key, position / PREFETCH_BLOCK_BYTES);
+            if (b < 0 || m_blocks[b].state != BLOCK_READY) {
+                break;
+            }
+            Block& block = m_blocks[b];
+            uint32_t within = position % PREFETCH_BLOCK_BYTES;
+            if (within >= block.length) {
+                break; // Past the cached end of the file
+            }
+            size_t n = block.length - within;
+            if (n > size - copied) n = size - copied;
+            memcpy(buffer + copied, m_pool + (size_t)b * PREFETCH_BLOCK_BYTES + within, n);
+            copied += n;
+            block.lastUsed = ++m_useCounter;
+        }
+        slot.playHead = offset + size;
+        if (copied == size) {
+            m_stats.hits++;
+        } else {
+            m_stats.misses++;
+        }
+    }
+    xSemaphoreGive(m_lock);
+
+    xTaskNotifyGive(m_fillTask); // The window has moved
+    return copied;
+}
+
+/**
+ * @brief Returns the hit, miss and fill counters.
+ */
+PrefetchCache::Stats PrefetchCache::getStats() {
+    Stats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (!m_pool) {
+        return stats;
+    }
+    xSemaphoreTake(m_lock, portMAX_DELAY);
+    stats = m_stats;
+    for (size_t b = 0; b < m_blockCount; b++) {
+        if (m_blocks[b].state == BLOCK_READY) {
+            stats.cachedBlocks++;
+        }
+    }
+    xSemaphoreGive(m_lock);
+    return stats;
+}
+
+/**
+ * @brief Fill task.
+ *
+ * Runs for the lifetime of the cache at `PREFETCH_TASK_PRIORITY`. Whenever a stream is
+ * attached or read it reads blocks until every window is full, then sleeps until the
+ * next read or at most `AUDIO_TASK_POLL_MS`.
+ *
+ * @param parameter A pointer to the PrefetchCache instance.
+ */
+void PrefetchCache::fillTask(void* parameter) {
+    PrefetchCache* cache = static_cast<PrefetchCache*>(parameter);
+    while (cache->m_running) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_TASK_POLL_MS));
+        while (cache->m_running && cache->fillOne()) {
+        }
+    }
+    cache->m_fillTask = NULL;
+    cache->m_fillRunning = false; // Last access to the cache, which may be freed from here on
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Reads the most urgent missing block.
+ *
+ * The stream attached first (the segment playing) is served first. The block is read
+ * into a free block or into the least recently used one outside every window, with
+ * the lock released during the SD read.
+ *
+ * @return false if every window is full, no block can be evicted or the read failed.
+ */
+bool PrefetchCache::fillOne() {
+    xSemaphoreTake(m_lock, portMAX_DELAY);
+
+    // Most urgent stream with a missing block in its window
+    int stream = -1;
+    uint32_t index = 0;
+    uint32_t bestOrder = UINT32_MAX;
+    for (int s = 0; s < PREFETCH_STREAMS; s++) {
+        Stream& slot = m_streams[s];
+        if (!slot.active || slot.attachOrder >= bestOrder || slot.playHead >= slot.end) {
+            continue;
+        }
+        uint32_t windowEnd = slot.end - slot.playHead < slot.aheadBytes ? slot.end : slot.playHead + slot.aheadBytes;
+        for (uint32_t i = slot.playHead / PREFETCH_BLOCK_BYTES; i <= (windowEnd - 1) / PREFETCH_BLOCK_BYTES; i++) {
+            if (findBlock(slot.key, i) < 0) {
+                stream = s;
+                index = i;
+                bestOrder = slot.attachOrder;
+                break;
+            }
+        }
+    }
+
+    // Free block, else the least recently used one nobody is about to play
+    int victim = -1;
+    if (stream >= 0) {
+        for (size_t b = 0; b < m_blockCount; b++) {
+            Block& block = m_blocks[b];
+            if (block.state == BLOCK_FREE) {
+                victim = (int)b;
+                break;
+            }
+            if (block.state == BLOCK_READY && !inWindow(block) &&
+                (victim < 0 || block.lastUsed < m_blocks[victim].lastUsed)) {
+                victim = (int)b;
+            }
+        }
+    }
+    if (victim < 0) {
+        xSemaphoreGive(m_lock);
+        return false;
+    }
+
+    Stream& slot = m_streams[stream];
+    Block& block = m_blocks[victim];
+    block.key = slot.key;
+    block.index = index;
+    block.length = 0;
+    block.state = BLOCK_FILLING;
+    slot.busy = true;
+    uint32_t offset = index * PREFETCH_BLOCK_BYTES;
+    uint32_t length = slot.end - offset < PREFETCH_BLOCK_BYTES ? slot.end - offset : PREFETCH_BLOCK_BYTES;
+    xSemaphoreGive(m_lock);
+
+    // The reader keeps playing from the ring and the cache while the card is slow
+    int64_t startUs = esp_timer_get_time();
+    size_t got = slot.file.seek(offset) ? slot.file.read(m_pool + (size_t)victim * PREFETCH_BLOCK_BYTES, length) : 0;
+    uint32_t fillUs = (uint32_t)(esp_timer_get_time() - startUs);
+
+    xSemaphoreTake(m_lock, portMAX_DELAY);
+    block.length = got;
+    block.state = got > 0 ? BLOCK_READY : BLOCK_FREE;
+    block.lastUsed = ++m_useCounter;
+    slot.busy = false;
+    if (got > 0) {
+        m_stats.fills++;
+        m_totalFillUs += fillUs;
+        m_stats.meanFillUs = (uint32_t)(m_totalFillUs / m_stats.fills);
+        if (fillUs > m_stats.maxFillUs) m_stats.maxFillUs = fillUs;
+    }
+    xSemaphoreGive(m_lock);
+    return got > 0;
+}
+
+/**
+ * @brief Returns true if a block lies in the read-ahead window of an attached file. Caller holds the lock.
+ */
+bool PrefetchCache::inWindow(const Block& block) {
+    for (int s = 0; s < PREFETCH_STREAMS; s++) {
+        const Stream& slot = m_streams[s];
+        if (!slot.active || slot.key != block.key) {
+            continue;
+        }
+        uint32_t first = slot.playHead / PREFETCH_BLOCK_BYTES;
+        uint32_t last = (slot.playHead + slot.aheadBytes) / PREFETCH_BLOCK_BYTES;
+        if (block.index >= first && block.index <= last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Finds the block holding (or being filled with) a block of a file. Caller holds the lock.
+ *
+ * @return The block number, or -1 if that part of the file is not cached.
+ */
+int PrefetchCache::findBlock(uint32_t key, uint32_t index) {
+    for (size_t b = 0; b < m_blockCount; b++) {
+        const Block& block = m_blocks[b];
+        if (block.state != BLOCK_FREE && block.key == key && block.index == index) {
+            return (int)b;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Identifies a file by its path, size and modification time, so an unchanged file
+ * replayed later hits.
+ */
+uint32_t PrefetchCache::fileKey(const char* path, uint32_t size, uint32_t lastWrite) {
+    uint32_t hash = 2166136261UL;
+    while (*path) {
+        hash ^= (uint8_t)*path++;
+        hash *= 16777619UL;
+    }
+    return hash ^ (size * 2654435761UL) ^ (lastWrite * 40503UL);
+}
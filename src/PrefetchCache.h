@@ -0,0 +1,102 @@
+#ifndef PREFETCH_CACHE_H
+#define PREFETCH_CACHE_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_heap_caps.h>
+#include "Config.h"
+
+/**
+ * @file PrefetchCache.h
+ * @brief PSRAM read-ahead cache for the audio files being played.
+ *
+ * The playback ring only holds a couple of hundred milliseconds of audio, so an SD card
+ * stall longer than that is heard as a dropout. This cache keeps the next
+ * `PREFETCH_AHEAD_MS` of every attached file in PSRAM, in blocks of `PREFETCH_BLOCK_BYTES`
+ * from a pool of `PREFETCH_CACHE_BYTES`.
+ *
+ * A fill task at `PREFETCH_TASK_PRIORITY`, below every playback task, reads the missing
+ * blocks ahead of each stream's play head through its own file handle, the current segment
+ * first, then the segments opened ahead of time. `read()` copies what is cached and reports a
+ * miss for the rest, which the reader then reads from the SD card itself, so the cache can
+ * only make playback faster. Blocks inside a read-ahead window are never evicted; the others
+ * (already played, or of closed files) are recycled least recently used first. Blocks are
+ * keyed by path, size and modification time, so replaying an unchanged file that is still
+ * cached costs no SD reads, while a rewritten file (a new response) never hits stale data.
+ *
+ * `getStats()` reports the hits, misses and fill latency.
+ *
+ * ## Example:
+ * ```cpp
+ * PrefetchCache cache;
+ * cache.begin();                                  // Fails without PSRAM
+ * int stream = cache.attach(path, start, end, byteRate);
+ * size_t length = cache.read(stream, offset, buffer, size); // Then read the rest from SD
+ * cache.detach(stream);
+ * ```
+ */
+
+class PrefetchCache {
+public:
+    struct Stats {
+        uint32_t hits;                  // Reads served entirely from PSRAM
+        uint32_t misses;                // Reads that needed the SD card for some bytes
+        uint32_t fills;                 // Blocks read ahead
+        uint32_t meanFillUs;            // Mean SD read time of a block
+        uint32_t maxFillUs;             // Longest SD read time of a block
+        uint32_t cachedBlocks;          // Blocks holding data
+    };
+
+    PrefetchCache();
+    ~PrefetchCache();
+    bool begin();                       // Allocate the PSRAM pool and start the fill task
+    int attach(const char* path, uint32_t start, uint32_t end, uint32_t bytesPerSecond); // Start reading ahead in a file
+    void detach(int stream);            // Stop reading ahead, the cached blocks stay until evicted
+    size_t read(int stream, uint32_t offset, uint8_t* buffer, size_t size); // Copy cached bytes, returns the length copied
+    Stats getStats();                   // Hit, miss and fill counters
+
+private:
+    enum BlockState : uint8_t { BLOCK_FREE, BLOCK_FILLING, BLOCK_READY };
+
+    struct Block {
+        uint32_t key;                   // File key of the data
+        uint32_t index;                 // Block number in the file
+        uint32_t length;                // Valid bytes, short for the last block of a file
+        uint32_t lastUsed;              // Use counter value of the last fill or hit, for LRU
+        BlockState state;               // Free, being read or holding data
+    };
+
+    struct Stream {
+        bool active;                    // Attached
+        volatile bool busy;             // The fill task is reading this file
+        File file;                      // Handle of the fill task
+        uint32_t key;                   // Hash of the path, size and modification time
+        uint32_t end;                   // End of the range to read ahead
+        uint32_t aheadBytes;            // Size of the read-ahead window
+        volatile uint32_t playHead;     // Offset the reader has reached
+        uint32_t attachOrder;           // Lower is more urgent (the current segment)
+    };
+
+    static void fillTask(void* parameter); // FreeRTOS task reading blocks ahead
+    bool fillOne();                     // Read one missing block, false when every window is full
+    bool inWindow(const Block& block);  // Block is ahead of a play head, not evictable
+    int findBlock(uint32_t key, uint32_t index); // Block holding or being filled with this data, or -1
+    static uint32_t fileKey(const char* path, uint32_t size, uint32_t lastWrite); // FNV-1a of the path, mixed with size and time
+    uint8_t* m_pool;                    // PREFETCH_CACHE_BYTES of PSRAM
+    Block* m_blocks;                    // One entry per block of the pool
+    size_t m_blockCount;                // Blocks in the pool
+    Stream m_streams[PREFETCH_STREAMS]; // Attached files
+    uint32_t m_useCounter;              // Bumped on every block access
+    uint32_t m_attachCounter;           // Bumped on every attach
+    Stats m_stats;                      // Counters, except cachedBlocks
+    uint64_t m_totalFillUs;             // Sum of the fill times, for the mean
+    SemaphoreHandle_t m_lock;           // Guards the blocks, the streams and the counters
+    TaskHandle_t m_fillTask;            // Task handle of the fill task
+    volatile bool m_running;            // Cleared to stop the fill task
+    volatile bool m_fillRunning;        // Fill task created and not yet exited
+};
+
+#endif // PREFETCH_CACHE_H
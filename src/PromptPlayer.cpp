@@ -0,0 +1,210 @@
+#include "PromptPlayer.h"
+
+/**
+ * @brief Constructor, nothing is mapped until `begin()`.
+ *
+ * @param output Engine whose mixer plays the prompts.
+ */
+PromptPlayer::PromptPlayer(I2SManager* output)
+    : m_output(output), m_base(nullptr), m_mapHandle(0), m_header(nullptr), m_entries(nullptr),
+      m_idsMatch(false) {}
+
+/**
+ * @brief Destructor, stops the prompts and unmaps the bank.
+ */
+PromptPlayer::~PromptPlayer() {
+    end();
+}
+
+/**
+ * @brief Maps the prompt partition and checks the bank it holds.
+ *
+ * Only the bytes of the bank are mapped, not the whole partition. A partition that was never
+ * flashed (erased to 0xFF) or holds a bank of another layout is left unmapped.
+ *
+ * @return true if the bank is mapped and valid, even if it holds no prompt.
+ */
+bool PromptPlayer::begin() {
+    if (m_base) {
+        return true;
+    }
+    const esp_partition_t* partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+        (esp_partition_subtype_t)PROMPT_PARTITION_SUBTYPE, PROMPT_PARTITION_LABEL);
+    if (!partition) {
+        if (DEBUGMODE) {
+            Serial.println("PromptPlayer: No prompt partition in the partition table.");
+        }
+        return false;
+    }
+
+    BankHeader header;
+    if (esp_partition_read(partition, 0, &header, sizeof(header)) != ESP_OK ||
+        header.magic != PROMPT_BANK_MAGIC || header.version != PROMPT_BANK_VERSION ||
+        header.size < sizeof(header) || header.size > partition->size) {
+        if (DEBUGMODE) {
+            Serial.println("PromptPlayer: The prompt partition holds no bank, run the uploadprompts target.");
+        }
+        return false;
+    }
+
+    const void* mapped = nullptr;
+    if (esp_partition_mmap(partition, 0, header.size, SPI_FLASH_MMAP_DATA, &mapped, &m_mapHandle) != ESP_OK) {
+        Serial.println("PromptPlayer: Failed to map the prompt partition.");
+        return false;
+    }
+    m_base = (const uint8_t*)mapped;
+    if (!checkBank(header.size)) {
+        Serial.println("PromptPlayer: The prompt bank is corrupt.");
+        end();
+        return false;
+    }
+
+    m_idsMatch = m_header->indexHash == PROMPT_BANK_HASH;
+    if (DEBUGMODE) {
+        Serial.printf("PromptPlayer: %u prompt(s) mapped, %u bytes\n", (unsigned)m_header->count, (unsigned)m_header->size);
+        if (!m_idsMatch) {
+            Serial.println("PromptPlayer: The flashed bank was packed for another build, prompts play by name only.");
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Stops the prompts and unmaps the bank.
+ *
+ * Every mixer voice is stopped, as the engine cannot tell a prompt from an effect and a
+ * voice must never read an unmapped prompt.
+ */
+void PromptPlayer::end() {
+    if (!m_base) {
+        return;
+    }
+    if (m_output) {
+        m_output->mixer().stopAll();
+    }
+    spi_flash_munmap(m_mapHandle);
+    m_base = nullptr;
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_idsMatch = false;
+}
+
+/**
+ * @brief Checks the mapped index: the sample format must be one the mixer plays, every prompt
+ * must lie inside the bank and the names must hash to the header's index hash.
+ */
+bool PromptPlayer::checkBank(uint32_t size) {
+    const BankHeader* header = (const BankHeader*)m_base;
+    const BankEntry* entries = (const BankEntry*)(m_base + sizeof(BankHeader));
+    if (sizeof(BankHeader) + (uint32_t)header->count * sizeof(BankEntry) > size ||
+        (header->channels != 1 && header->channels != AUDIO_OUTPUT_CHANNELS) ||
+        header->rateShift > MIXER_MAX_RATE_SHIFT) {
+        return false;
+    }
+
+    uint32_t hash = 2166136261UL;
+    for (uint16_t i = 0; i < header->count; i++) {
+        const BankEntry& entry = entries[i];
+        if (entry.name[PROMPT_NAME_MAX - 1] != '\0' || (entry.offset & 3) != 0 ||
+            entry.offset > size || entry.samples > (size - entry.offset) / sizeof(int16_t) ||
+            entry.samples % header->channels != 0) {
+            return false;
+        }
+        for (size_t c = 0; c < PROMPT_NAME_MAX; c++) {
+            hash ^= (uint8_t)entry.name[c];
+            hash *= 16777619UL;
+        }
+    }
+    if (hash != header->indexHash) {
+        return false;
+    }
+    m_header = header;
+    m_entries = entries;
+    return true;
+}
+
+/**
+ * @brief Returns true once the bank is mapped.
+ */
+bool PromptPlayer::isReady() {
+    return m_base != nullptr;
+}
+
+/**
+ * @brief Returns the number of prompts in the bank, 0 when it is not mapped.
+ */
+uint16_t PromptPlayer::count() {
+    return m_header ? m_header->count : 0;
+}
+
+/**
+ * @brief Finds a prompt by the name of the file it was packed from, without extension.
+ *
+ * Meant for prompts chosen at run time (from the web UI, say); firmware code should use the
+ * `Prompt::` ids, which cost no lookup.
+ *
+ * @return The id of the prompt, or -1 if there is none by that name.
+ */
+int PromptPlayer::find(const char* name) {
+    if (!name) {
+        return -1;
+    }
+    for (int i = 0; i < count(); i++) {
+        if (strncmp(m_entries[i].name, name, PROMPT_NAME_MAX) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Gets the samples of a prompt, pointing into the mapped flash.
+ *
+ * The sound stays valid until `end()`.
+ */
+bool PromptPlayer::getSound(int id, AudioMixer::Sound& sound) {
+    if (id < 0 || id >= count()) {
+        return false;
+    }
+    sound.samples = (const int16_t*)(m_base + m_entries[id].offset);
+    sound.count = m_entries[id].samples;
+    sound.mono = m_header->channels == 1;
+    sound.rateShift = m_header->rateShift;
+    return true;
+}
+
+/**
+ * @brief Starts a prompt on a free mixer voice, over whatever is playing.
+ *
+ * The engine must be running (or be resumed right after) for the prompt to be heard. Ids are
+ * refused when the flashed bank was packed for another build, as they may name another
+ * prompt; play by name then.
+ *
+ * @param id Prompt id, from `PromptIndex.h`.
+ * @param volume Volume of the prompt, 0..100 %.
+ * @return The mixer voice, or -1 if the prompt does not exist or every voice is busy.
+ */
+int PromptPlayer::play(int id, int volume) {
+    if (!m_idsMatch) {
+        return -1;
+    }
+    return startVoice(id, volume);
+}
+
+/**
+ * @brief Starts a prompt by name, see `find()`. Works whatever build the bank was packed for.
+ */
+int PromptPlayer::play(const char* name, int volume) {
+    return startVoice(find(name), volume);
+}
+
+/**
+ * @brief Hands the mapped samples of a prompt to a mixer voice.
+ */
+int PromptPlayer::startVoice(int id, int volume) {
+    AudioMixer::Sound sound;
+    if (!m_output || !getSound(id, sound)) {
+        return -1;
+    }
+    return m_output->mixer().play(sound, GainStage::volumeToGain(constrain(volume, 0, 100)));
+}
@@ -0,0 +1,86 @@
+#ifndef PROMPT_PLAYER_H
+#define PROMPT_PLAYER_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include "Config.h"
+#include "I2SManager.h"
+#include "PromptIndex.h"
+
+/**
+ * @file PromptPlayer.h
+ * @brief Plays short UI prompts (boot chime, "battery low", "recording started") from flash.
+ *
+ * The prompts are packed at build time by `scripts/pack_prompts.py` from the WAV files in
+ * `prompts/` (PCM or IMA-ADPCM) into the `PROMPT_PARTITION_LABEL` partition, already converted
+ * to 16-bit mono at `AUDIO_OUTPUT_RATE >> PROMPT_RATE_SHIFT`: a quarter of the flash of the
+ * output format, so the 1 MB partition holds about 23 s of prompts. The same script writes
+ * `include/PromptIndex.h`, one `constexpr` id per prompt in bank order, so a prompt is
+ * played by a compile-time constant and never looked up by name at run time.
+ *
+ * `begin()` maps the bank into the address space with `esp_partition_mmap()`. A prompt is
+ * then handed to the engine's mixer as a sound pointing straight into the mapping: no SD card,
+ * no FAT lookup, no copy and no decoding. The mixer plays each stored sample on both channels
+ * and interpolates the frames in between as it mixes (see `AudioMixer`). Its time to first sample, from `play()` to DMA, is
+ * measured by the engine (`I2SManager::getEffectStartLatencyUs()`).
+ *
+ * Bank layout, little endian: a `BankHeader`, then `count` `BankEntry` records, then the
+ * samples of each prompt, 4-byte aligned. The header carries the hash of the index it was
+ * packed with; if it differs from `PROMPT_BANK_HASH` the flashed bank does not match this
+ * firmware and prompts can only be played by name.
+ *
+ * ## Example:
+ * ```cpp
+ * PromptPlayer prompts(&i2sManager);
+ * prompts.begin();
+ * prompts.play(Prompt::BOOT_CHIME, 80);
+ * prompts.play("battery_low");
+ * ```
+ */
+
+#define PROMPT_BANK_MAGIC 0x544D5250                         ///< "PRMT"
+#define PROMPT_BANK_VERSION 2                                ///< Bumped whenever the bank layout changes
+
+class PromptPlayer {
+public:
+    PromptPlayer(I2SManager* output);
+    ~PromptPlayer();
+    bool begin();                       // Map the prompt partition and check the bank
+    void end();                         // Stop the prompts and unmap the partition
+    bool isReady();                     // Bank mapped and valid
+    uint16_t count();                   // Prompts in the bank
+    int find(const char* name);         // Id of a prompt by name, or -1
+    bool getSound(int id, AudioMixer::Sound& sound); // Samples of a prompt, in mapped flash
+    int play(int id, int volume = 100); // Start a prompt on a mixer voice, returns the voice or -1
+    int play(const char* name, int volume = 100); // Start a prompt by name
+
+private:
+    struct BankHeader {
+        uint32_t magic;                 // PROMPT_BANK_MAGIC
+        uint16_t version;               // PROMPT_BANK_VERSION
+        uint16_t count;                 // Entries following the header
+        uint32_t indexHash;             // FNV-1a of the names in bank order, PROMPT_BANK_HASH of the matching firmware
+        uint32_t size;                  // Bytes of the whole bank
+        uint8_t channels;               // Samples per frame of every prompt, 1 or 2
+        uint8_t rateShift;              // Prompts are stored at AUDIO_OUTPUT_RATE >> rateShift
+        uint16_t reserved;              // Zero
+    };
+
+    struct BankEntry {
+        char name[PROMPT_NAME_MAX];     // File name without extension, zero terminated
+        uint32_t offset;                // Bank offset of the samples, 4-byte aligned
+        uint32_t samples;               // Samples, BankHeader::channels per frame
+    };
+
+    bool checkBank(uint32_t size);      // Validate the mapped header and entries
+    int startVoice(int id, int volume); // Hand a prompt to a mixer voice
+    I2SManager* m_output;               // Engine whose mixer plays the prompts
+    const uint8_t* m_base;              // Mapped bank, nullptr when not mapped
+    spi_flash_mmap_handle_t m_mapHandle; // Handle of the mapping
+    const BankHeader* m_header;         // Header at m_base
+    const BankEntry* m_entries;         // Index following the header
+    bool m_idsMatch;                    // The bank was packed with this firmware's PromptIndex.h
+};
+
+#endif // PROMPT_PLAYER_H
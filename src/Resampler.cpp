@@ -0,0 +1,211 @@
+#include "Resampler.h"
+
+// Kaiser-windowed sinc, cutoff 0.45 of the input rate, beta 7, in Q14.
+// Row p holds the taps for a position p / RESAMPLER_PHASES of a sample past the window centre;
+// every row sums to 16384 (unity gain). Q14 keeps the 32-tap sum of full-scale products within
+// an int32 accumulator. Generated offline.
+static const int16_t kResamplerTable[(RESAMPLER_PHASES + 1) * RESAMPLER_TAPS] = {
+    -6, 14, -23, 30, -26, 0, 59, -162, 315, -516, 755, -1010, 1254, -1457, 1591, 14746,
+    1591, -1457, 1254, -1010, 755, -516, 315, -162, 59, 0, -26, 30, -23, 14, -6, 2,
+    -6, 13, -21, 26, -18, -11, 74, -179, 330, -523, 744, -966, 1154, -1253, 1117, 14727,
+    2084, -1657, 1347, -1046, 759, -504, 296, -143, 43, 11, -33, 34, -25, 15, -7, 2,
+    -6, 13, -19, 21, -11, -22, 88, -194, 343, -527, 728, -916, 1047, -1045, 663, 14669,
+    2593, -1850, 1431, -1075, 758, -488, 275, -123, 27, 23, -40, 38, -27, 15, -7, 2,
+    -6, 12, -17, 17, -4, -32, 101, -207, 352, -525, 706, -860, 935, -837, 230, 14573,
+    3117, -2036, 1506, -1096, 751, -468, 252, -101, 10, 35, -47, 41, -29, 16, -7, 2,
+    -5, 11, -15, 13, 3, -42, 112, -219, 359, -520, 679, -798, 818, -629, -179, 14440,
+    3654, -2212, 1571, -1109, 738, -444, 225, -78, -8, 47, -54, 45, -30, 16, -7, 2,
+    -5, 10, -13, 9, 10, -51, 123, -228, 362, -511, 648, -731, 698, -423, -564, 14267,
+    4202, -2377, 1626, -1113, 719, -416, 197, -54, -26, 58, -61, 48, -31, 16, -7, 2,
+    -5, 9, -10, 4, 16, -60, 132, -236, 363, -498, 612, -660, 576, -220, -925, 14061,
+    4758, -2529, 1668, -1109, 693, -383, 166, -29, -44, 70, -67, 51, -32, 17, -7, 2,
+    -4, 8, -8, 0, 22, -68, 141, -241, 361, -482, 572, -586, 452, -22, -1258, 13815,
+    5320, -2666, 1699, -1095, 661, -347, 133, -3, -62, 81, -73, 54, -33, 17, -6, 2,
+    -4, 6, -6, -3, 28, -75, 147, -245, 356, -462, 528, -508, 327, 171, -1565, 13539,
+    5887, -2787, 1717, -1073, 624, -308, 99, 24, -80, 92, -79, 56, -33, 16, -6, 1,
+    -3, 5, -4, -7, 33, -81, 153, -246, 349, -438, 481, -428, 203, 355, -1845, 13229,
+    6455, -2891, 1722, -1041, 580, -265, 63, 50, -98, 102, -84, 58, -34, 16, -6, 1,
+    -3, 4, -1, -11, 38, -87, 157, -246, 338, -412, 432, -347, 81, 532, -2096, 12888,
+    7022, -2976, 1713, -1001, 531, -219, 25, 78, -116, 112, -89, 59, -34, 16, -5, 1,
+    -3, 3, 1, -14, 43, -91, 160, -243, 326, -383, 380, -264, -40, 699, -2319, 12512,
+    7586, -3040, 1690, -951, 477, -171, -13, 105, -133, 122, -93, 60, -33, 15, -5, 1,
+    -2, 2, 3, -17, 47, -95, 162, -239, 311, -352, 326, -182, -157, 856, -2514, 12112,
+    8144, -3082, 1653, -893, 418, -120, -52, 131, -149, 130, -96, 61, -33, 14, -4, 1,
+    -2, 1, 5, -20, 50, -98, 162, -233, 294, -319, 270, -99, -270, 1001, -2680, 11688,
+    8693, -3101, 1601, -826, 354, -67, -91, 158, -164, 138, -99, 61, -32, 13, -4, 0,
+    -1, 0, 6, -23, 53, -100, 161, -225, 275, -283, 214, -18, -379, 1134, -2818, 11239,
+    9233, -3097, 1536, -751, 286, -12, -131, 183, -179, 144, -101, 60, -31, 12, -3, 0,
+    -1, -1, 8, -25, 56, -102, 158, -215, 254, -247, 157, 62, -482, 1255, -2928, 10764,
+    9759, -3067, 1456, -668, 215, 43, -170, 208, -192, 150, -102, 59, -29, 11, -2, 0,
+    -1, -2, 10, -27, 58, -102, 155, -205, 232, -209, 100, 140, -578, 1362, -3011, 10271,
+    10269, -3011, 1362, -578, 140, 100, -209, 232, -205, 155, -102, 58, -27, 10, -2, -1,
+    0, -2, 11, -29, 59, -102, 150, -192, 208, -170, 43, 215, -668, 1456, -3067, 9759,
+    10764, -2928, 1255, -482, 62, 157, -247, 254, -215, 158, -102, 56, -25, 8, -1, -1,
+    0, -3, 12, -31, 60, -101, 144, -179, 183, -131, -12, 286, -751, 1536, -3097, 9233,
+    11239, -2818, 1134, -379, -18, 214, -283, 275, -225, 161, -100, 53, -23, 6, 0, -1,
+    0, -4, 13, -32, 61, -99, 138, -164, 158, -91, -67, 354, -826, 1601, -3101, 8693,
+    11688, -2680, 1001, -270, -99, 270, -319, 294, -233, 162, -98, 50, -20, 5, 1, -2,
+    1, -4, 14, -33, 61, -96, 130, -149, 131, -52, -120, 418, -893, 1653, -3082, 8144,
+    12112, -2514, 856, -157, -182, 326, -352, 311, -239, 162, -95, 47, -17, 3, 2, -2,
+    1, -5, 15, -33, 60, -93, 122, -133, 105, -13, -171, 477, -951, 1690, -3040, 7586,
+    12512, -2319, 699, -40, -264, 380, -383, 326, -243, 160, -91, 43, -14, 1, 3, -3,
+    1, -5, 16, -34, 59, -89, 112, -116, 78, 25, -219, 531, -1001, 1713, -2976, 7022,
+    12888, -2096, 532, 81, -347, 432, -412, 338, -246, 157, -87, 38, -11, -1, 4, -3,
+    1, -6, 16, -34, 58, -84, 102, -98, 50, 63, -265, 580, -1041, 1722, -2891, 6455,
+    13229, -1845, 355, 203, -428, 481, -438, 349, -246, 153, -81, 33, -7, -4, 5, -3,
+    1, -6, 16, -33, 56, -79, 92, -80, 24, 99, -308, 624, -1073, 1717, -2787, 5887,
+    13539, -1565, 171, 327, -508, 528, -462, 356, -245, 147, -75, 28, -3, -6, 6, -4,
+    2, -6, 17, -33, 54, -73, 81, -62, -3, 133, -347, 661, -1095, 1699, -2666, 5320,
+    13815, -1258, -22, 452, -586, 572, -482, 361, -241, 141, -68, 22, 0, -8, 8, -4,
+    2, -7, 17, -32, 51, -67, 70, -44, -29, 166, -383, 693, -1109, 1668, -2529, 4758,
+    14061, -925, -220, 576, -660, 612, -498, 363, -236, 132, -60, 16, 4, -10, 9, -5,
+    2, -7, 16, -31, 48, -61, 58, -26, -54, 197, -416, 719, -1113, 1626, -2377, 4202,
+    14267, -564, -423, 698, -731, 648, -511, 362, -228, 123, -51, 10, 9, -13, 10, -5,
+    2, -7, 16, -30, 45, -54, 47, -8, -78, 225, -444, 738, -1109, 1571, -2212, 3654,
+    14440, -179, -629, 818, -798, 679, -520, 359, -219, 112, -42, 3, 13, -15, 11, -5,
+    2, -7, 16, -29, 41, -47, 35, 10, -101, 252, -468, 751, -1096, 1506, -2036, 3117,
+    14573, 230, -837, 935, -860, 706, -525, 352, -207, 101, -32, -4, 17, -17, 12, -6,
+    2, -7, 15, -27, 38, -40, 23, 27, -123, 275, -488, 758, -1075, 1431, -1850, 2593,
+    14669, 663, -1045, 1047, -916, 728, -527, 343, -194, 88, -22, -11, 21, -19, 13, -6,
+    2, -7, 15, -25, 34, -33, 11, 43, -143, 296, -504, 759, -1046, 1347, -1657, 2084,
+    14727, 1117, -1253, 1154, -966, 744, -523, 330, -179, 74, -11, -18, 26, -21, 13, -6,
+    2, -6, 14, -23, 30, -26, 0, 59, -162, 315, -516, 755, -1010, 1254, -1457, 1591,
+    14746, 1591, -1457, 1254, -1010, 755, -516, 315, -162, 59, 0, -26, 30, -23, 14, -6
+};
+
+/**
+ * @brief Constructor, the resampler passes samples through until `begin()` succeeds.
+ */
+Resampler::Resampler()
+    : m_active(false), m_inputRate(0), m_outputRate(0), m_channels(1), m_phaseNum(0),
+      m_phaseScale(0), m_start(0), m_count(0) {}
+
+/**
+ * @brief Configures the conversion.
+ *
+ * Only upsampling (and 1:1) is supported: the filter cutoff follows the input rate.
+ *
+ * @param inputRate Rate of the source in Hz.
+ * @param outputRate Rate of the output in Hz.
+ * @param channels Number of interleaved channels (1 or 2).
+ * @return true if the resampler converts; false if the rates are equal or the
+ *         conversion is not supported, in which case the caller must pass the
+ *         samples through.
+ */
+bool Resampler::begin(uint32_t inputRate, uint32_t outputRate, uint16_t channels) {
+    m_active = inputRate > 0 && inputRate < outputRate && (channels == 1 || channels == 2);
+    m_inputRate = inputRate;
+    m_outputRate = outputRate;
+    m_channels = channels;
+    m_phaseScale = m_active ? ((uint64_t)RESAMPLER_PHASES << 32) / outputRate : 0;
+    reset();
+    return m_active;
+}
+
+/**
+ * @brief Clears the filter history so the next block starts a new stream.
+ */
+void Resampler::reset() {
+    // Prime with silence so the first output sample lines up with the first input sample
+    m_count = RESAMPLER_TAPS / 2 - 1;
+    memset(m_buffer, 0, m_count * m_channels * sizeof(int16_t));
+    m_start = 0;
+    m_phaseNum = 0;
+}
+
+/**
+ * @brief Returns true if samples are converted, false if they must be passed through.
+ */
+bool Resampler::isActive() {
+    return m_active;
+}
+
+/**
+ * @brief Returns an upper bound of the output frames produced for an input block.
+ */
+size_t Resampler::outputFramesFor(size_t inputFrames) {
+    if (!m_active) {
+        return inputFrames;
+    }
+    return (size_t)(((uint64_t)inputFrames * m_outputRate + m_inputRate - 1) / m_inputRate) + 1;
+}
+
+/**
+ * @brief Converts a block of interleaved frames.
+ *
+ * Stops when either the input is used up or the output is full; the caller
+ * passes the rest of the input again in the next call.
+ *
+ * @param in Input frames.
+ * @param inFrames Number of input frames.
+ * @param consumed Out: number of input frames taken into the filter history.
+ * @param out Destination for output frames.
+ * @param outFrames Capacity of `out` in frames.
+ * @return The number of output frames written.
+ */
+size_t Resampler::process(const int16_t* in, size_t inFrames, size_t& consumed, int16_t* out, size_t outFrames) {
+    const size_t ch = m_channels;
+    const size_t capacity = RESAMPLER_BUFFER_FRAMES + RESAMPLER_TAPS;
+    size_t produced = 0;
+    consumed = 0;
+
+    while (produced < outFrames) {
+        if (m_start + RESAMPLER_TAPS > m_count) {
+            if (consumed == inFrames) {
+                break; // Need more input
+            }
+            // Move the history to the front and append input
+            if (m_start > 0) {
+                memmove(m_buffer, m_buffer + m_start * ch, (m_count - m_start) * ch * sizeof(int16_t));
+                m_count -= m_start;
+                m_start = 0;
+            }
+            size_t take = capacity - m_count;
+            if (take > inFrames - consumed) take = inFrames - consumed;
+            memcpy(m_buffer + m_count * ch, in + consumed * ch, take * ch * sizeof(int16_t));
+            m_count += take;
+            consumed += take;
+            continue;
+        }
+
+        filterFrame(out + produced * ch);
+        produced++;
+
+        // Advance by inputRate / outputRate input samples, exactly
+        m_phaseNum += m_inputRate;
+        while (m_phaseNum >= m_outputRate) {
+            m_phaseNum -= m_outputRate;
+            m_start++;
+        }
+    }
+    return produced;
+}
+
+/**
+ * @brief Computes one output frame at the current position.
+ *
+ * The filter is evaluated with the two phases around the fractional position and
+ * the results are interpolated, which is the same as interpolating the taps.
+ */
+void Resampler::filterFrame(int16_t* out) {
+    const size_t ch = m_channels;
+    uint32_t position = (uint32_t)(((uint64_t)m_phaseNum * m_phaseScale) >> 16); // Phase in Q16
+    uint32_t phase = position >> 16;
+    int32_t frac = (int32_t)((position & 0xFFFF) >> 1); // Q15
+    const int16_t* h0 = kResamplerTable + phase * RESAMPLER_TAPS;
+    const int16_t* h1 = h0 + RESAMPLER_TAPS;
+
+    for (size_t c = 0; c < ch; c++) {
+        const int16_t* x = m_buffer + m_start * ch + c;
+        int32_t acc0 = 0;
+        int32_t acc1 = 0;
+        for (size_t k = 0; k < RESAMPLER_TAPS; k++) {
+            int32_t sample = x[k * ch];
+            acc0 += sample * h0[k];
+            acc1 += sample * h1[k];
+        }
+        int64_t acc = (int64_t)acc0 + ((((int64_t)acc1 - acc0) * frac) >> 15);
+        int32_t y = (int32_t)((acc + (1 << 13)) >> 14);
+        out[c] = (int16_t)(y > 32767 ? 32767 : (y < -32768 ? -32768 : y));
+    }
+}
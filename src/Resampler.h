@@ -0,0 +1,59 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * @file Resampler.h
+ * @brief Streaming fixed-point polyphase sample-rate converter.
+ *
+ * The `Resampler` converts 16-bit interleaved audio (mono or stereo) from the rate of a file
+ * (8 kHz recordings, 11.025/16/22.05 kHz stories, TTS output) up to the single output rate of
+ * the I2S engine, so the engine never has to retune its clock between tracks.
+ *
+ * The interpolation filter is a 32-tap Kaiser-windowed sinc (cutoff 0.45 of the input rate,
+ * beta 7) stored as `RESAMPLER_PHASES + 1` precomputed Q14 phases. The read position advances by
+ * the exact ratio `inputRate / outputRate` with an integer remainder, so there is no drift over
+ * long files; the fractional position selects two neighbouring phases and the two filter
+ * outputs are linearly interpolated.
+ *
+ * Input is processed in blocks: `process()` consumes as many input frames and produces as many
+ * output frames as fit, and keeps the filter history between calls.
+ *
+ * ## Example:
+ * ```cpp
+ * Resampler resampler;
+ * resampler.begin(16000, AUDIO_OUTPUT_RATE, 1);
+ * size_t used;
+ * size_t made = resampler.process(in, inFrames, used, out, outFrames);
+ * ```
+ */
+
+#define RESAMPLER_TAPS 32                                    ///< Filter taps per phase
+#define RESAMPLER_PHASES 32                                  ///< Filter phases per input sample
+#define RESAMPLER_BUFFER_FRAMES 256                          ///< Input frames buffered per channel beyond the filter history
+
+class Resampler {
+public:
+    Resampler();
+    bool begin(uint32_t inputRate, uint32_t outputRate, uint16_t channels); // Configure, false if it must be bypassed
+    void reset();                       // Clear the filter history (rewind)
+    bool isActive();                    // Converting (false: pass samples through unchanged)
+    size_t outputFramesFor(size_t inputFrames); // Upper bound of output frames for an input block
+    size_t process(const int16_t* in, size_t inFrames, size_t& consumed, int16_t* out, size_t outFrames); // Convert a block
+
+private:
+    void filterFrame(int16_t* out);     // Compute one output frame at the current position
+    bool m_active;                      // Rates differ and are supported
+    uint32_t m_inputRate;               // Source rate in Hz
+    uint32_t m_outputRate;              // Output rate in Hz
+    uint16_t m_channels;                // 1 or 2
+    uint32_t m_phaseNum;                // Fractional position, in 1/outputRate input samples
+    uint64_t m_phaseScale;              // Converts m_phaseNum to a Q32 phase position
+    size_t m_start;                     // First frame of the filter window in m_buffer
+    size_t m_count;                     // Frames held in m_buffer
+    int16_t m_buffer[(RESAMPLER_BUFFER_FRAMES + RESAMPLER_TAPS) * 2]; // Interleaved input history
+};
+
+#endif // RESAMPLER_H
@@ -0,0 +1,258 @@
+#include "RiffParser.h"
+#include <esp_timer.h>
+#include "ImaAdpcmDecoder.h"
+
+RiffParser::CacheEntry RiffParser::s_cache[RIFF_CACHE_SLOTS];
+uint32_t RiffParser::s_useCounter = 0;
+portMUX_TYPE RiffParser::s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Gets the header of a WAV file, from the cache or by walking its chunks.
+ *
+ * A cached header is used only if the file still has the size and modification time it
+ * was parsed with; anything rewritten in place (a new recording, a new response) is
+ * walked again.
+ *
+ * @param file The open file; positioned anywhere afterwards.
+ * @param path Path the file was opened with, the cache key.
+ * @param info Out: the parsed header.
+ * @return true if the file is a valid WAV file.
+ */
+bool RiffParser::open(File& file, const char* path, WavInfo& info) {
+    const uint32_t hash = hashPath(path);
+    const uint32_t fileSize = (uint32_t)file.size();
+    const uint32_t lastWrite = (uint32_t)file.getLastWrite();
+
+    bool hit = false;
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < RIFF_CACHE_SLOTS; i++) {
+        CacheEntry& entry = s_cache[i];
+        if (entry.pathHash == hash && entry.fileSize == fileSize && entry.lastWrite == lastWrite) {
+            entry.lastUsed = ++s_useCounter;
+            info = entry.info;
+            hit = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (hit) {
+        return true;
+    }
+
+    if (!parse(file, info)) {
+        return false;
+    }
+
+    // Replace the stale entry of this file, or else the least recently used one
+    portENTER_CRITICAL(&s_lock);
+    size_t slot = 0;
+    for (size_t i = 0; i < RIFF_CACHE_SLOTS; i++) {
+        if (s_cache[i].pathHash == hash) {
+            slot = i;
+            break;
+        }
+        if (s_cache[i].lastUsed < s_cache[slot].lastUsed) {
+            slot = i;
+        }
+    }
+    s_cache[slot].pathHash = hash;
+    s_cache[slot].fileSize = fileSize;
+    s_cache[slot].lastWrite = lastWrite;
+    s_cache[slot].lastUsed = ++s_useCounter;
+    s_cache[slot].info = info;
+    portEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+/**
+ * @brief Walks the RIFF chunks of a WAV file.
+ *
+ * Chunks are visited in file order with one 8-byte read each; only `fmt ` and `smpl` are
+ * read, every other chunk (`data` included) is seeked over. The walk ends at the end of the
+ * RIFF chunk, at the first chunk running past it, or after `RIFF_MAX_CHUNKS` chunks.
+ *
+ * @param file The open file; positioned anywhere afterwards.
+ * @param info Out: the parsed header.
+ * @return true if both a valid `fmt ` and a `data` chunk were found.
+ */
+bool RiffParser::parse(File& file, WavInfo& info) {
+    memset(&info, 0, sizeof(info));
+    const uint32_t fileSize = (uint32_t)file.size();
+
+    struct { char id[4]; uint32_t size; char wave[4]; } riff;
+    if (!file.seek(0) || file.read((uint8_t*)&riff, sizeof(riff)) != sizeof(riff) ||
+        memcmp(riff.id, "RIFF", 4) != 0 || memcmp(riff.wave, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    // A RIFF size of 0 or past the end is left by a recording that was never finalized
+    bool unfinished = riff.size < 4 || riff.size > fileSize - 8;
+    uint32_t end = unfinished ? fileSize : riff.size + 8;
+
+    bool fmtFound = false;
+    bool dataFound = false;
+    uint32_t pos = sizeof(riff);
+    for (int chunks = 0; chunks < RIFF_MAX_CHUNKS && end - pos >= 8; chunks++) {
+        struct { char id[4]; uint32_t size; } chunk;
+        if (!file.seek(pos) || file.read((uint8_t*)&chunk, sizeof(chunk)) != sizeof(chunk)) {
+            break;
+        }
+        const uint32_t body = pos + sizeof(chunk);
+        const uint32_t left = end - body;
+
+        if (memcmp(chunk.id, "data", 4) == 0) {
+            if (dataFound) {
+                return false; // Only one data chunk allowed
+            }
+            dataFound = true;
+            info.dataOffset = body;
+            info.dataSize = chunk.size;
+            if (chunk.size > left || (chunk.size == 0 && unfinished)) {
+                info.dataSize = left; // Truncated, or the size was never patched
+                break;
+            }
+        } else if (chunk.size > left) {
+            break; // Chunk runs past the end, nothing after it can be trusted
+        } else if (memcmp(chunk.id, "fmt ", 4) == 0) {
+            if (fmtFound || !parseFmt(file, chunk.size, info)) {
+                return false;
+            }
+            fmtFound = true;
+        } else if (memcmp(chunk.id, "smpl", 4) == 0) {
+            parseSmpl(file, chunk.size, info);
+        }
+
+        uint32_t next = body + chunk.size + (chunk.size & 1); // Chunks are padded to an even size
+        if (next < body || next > end) {
+            break;
+        }
+        pos = next;
+    }
+
+    if (!fmtFound || !dataFound) {
+        return false;
+    }
+    if (info.hasLoop) {
+        uint32_t frames = info.formatTag == WAVE_FORMAT_PCM ? info.dataSize / info.blockAlign : UINT32_MAX;
+        if (info.loopStart > info.loopEnd || info.loopEnd >= frames) {
+            info.hasLoop = false; // Loop outside the audio
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Reads the fixed part of a `fmt ` chunk and checks its fields.
+ *
+ * Format-specific checks (PCM frame size, ADPCM block size) are left to the decode stage.
+ */
+bool RiffParser::parseFmt(File& file, uint32_t size, WavInfo& info) {
+    struct {
+        uint16_t formatTag;
+        uint16_t channels;
+        uint32_t sampleRate;
+        uint32_t byteRate;
+        uint16_t blockAlign;
+        uint16_t bitsPerSample;
+    } fmt;
+    if (size < sizeof(fmt) || file.read((uint8_t*)&fmt, sizeof(fmt)) != sizeof(fmt)) {
+        return false;
+    }
+    if (fmt.channels == 0 || fmt.sampleRate == 0 || fmt.sampleRate > 384000 || fmt.blockAlign == 0) {
+        return false;
+    }
+    info.formatTag = fmt.formatTag;
+    info.channels = fmt.channels;
+    info.sampleRate = fmt.sampleRate;
+    info.byteRate = fmt.byteRate;
+    info.blockAlign = fmt.blockAlign;
+    info.bitsPerSample = fmt.bitsPerSample;
+    return true;
+}
+
+/**
+ * @brief Reads the first loop of a `smpl` chunk, if it has one.
+ *
+ * A malformed chunk is ignored; it never prevents the file from playing.
+ */
+void RiffParser::parseSmpl(File& file, uint32_t size, WavInfo& info) {
+    uint32_t header[9]; // Manufacturer ... sampler data, then the loop count at [7]
+    uint32_t loop[6];   // Cue point id, type, start, end, fraction, play count
+    if (size < sizeof(header) + sizeof(loop) ||
+        file.read((uint8_t*)header, sizeof(header)) != sizeof(header) || header[7] == 0 ||
+        file.read((uint8_t*)loop, sizeof(loop)) != sizeof(loop)) {
+        return;
+    }
+    info.hasLoop = true;
+    info.loopStart = loop[2];
+    info.loopEnd = loop[3];
+}
+
+/**
+ * @brief Drops the cached header of a file, for callers that rewrite it without
+ * changing its size or time stamp.
+ */
+void RiffParser::invalidate(const char* path) {
+    const uint32_t hash = hashPath(path);
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < RIFF_CACHE_SLOTS; i++) {
+        if (s_cache[i].pathHash == hash) {
+            s_cache[i].pathHash = 0;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+/**
+ * @brief 32-bit FNV-1a hash of a path. 0 marks a free cache slot, so it is never returned.
+ */
+uint32_t RiffParser::hashPath(const char* path) {
+    uint32_t hash = 2166136261UL;
+    while (path && *path) {
+        hash ^= (uint8_t)*path++;
+        hash *= 16777619UL;
+    }
+    return hash ? hash : 1;
+}
+
+/**
+ * @brief Prints how many times per second a file can be opened and parsed, with the
+ * chunk walk and with the cache.
+ *
+ * Both figures include opening the file on the SD card. Call it from a debug hook with
+ * a story segment; it takes a few hundred milliseconds.
+ */
+void RiffParser::benchmark(const char* path) {
+    const int rounds = 32;
+    WavInfo info;
+    int64_t walkUs = 0;
+    int64_t cachedUs = 0;
+    bool ok = true;
+
+    for (int r = 0; r < rounds && ok; r++) {
+        int64_t start = esp_timer_get_time();
+        File file = SD.open(path);
+        ok = file && parse(file, info);
+        file.close();
+        walkUs += esp_timer_get_time() - start;
+    }
+    invalidate(path);
+    File first = SD.open(path);
+    ok = first && open(first, path, info); // Fill the cache entry
+    first.close();
+    for (int r = 0; r < rounds && ok; r++) {
+        int64_t start = esp_timer_get_time();
+        File file = SD.open(path);
+        ok = file && open(file, path, info);
+        file.close();
+        cachedUs += esp_timer_get_time() - start;
+    }
+    if (!ok) {
+        Serial.println("RiffParser: benchmark file is not a valid WAV file.");
+        return;
+    }
+
+    Serial.printf("RiffParser: %u opens/s with the chunk walk, %u opens/s cached\n",
+                  (unsigned)(rounds * 1000000LL / (walkUs > 0 ? walkUs : 1)),
+                  (unsigned)(rounds * 1000000LL / (cachedUs > 0 ? cachedUs : 1)));
+}
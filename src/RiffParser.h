@@ -0,0 +1,72 @@
+#ifndef RIFF_PARSER_H
+#define RIFF_PARSER_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include <freertos/FreeRTOS.h>
+#include "Config.h"
+
+/**
+ * @file RiffParser.h
+ * @brief RIFF/WAVE chunk walker with a small in-RAM cache of the parsed headers.
+ *
+ * `parse()` walks the chunks of a WAV file and collects the `fmt `, `data` and `smpl` chunks
+ * wherever they are, skipping `LIST`, `fact`, `cue ` or any other chunk in between. Every size
+ * is checked against the file: a chunk running past the end stops the walk, a truncated `data`
+ * chunk is clamped to the bytes actually present, and a recording whose header was never
+ * patched (RIFF and data sizes of 0) is played up to the end of the file. At most
+ * `RIFF_MAX_CHUNKS` chunks are visited, so a corrupt file costs a bounded number of reads.
+ *
+ * `open()` is what the reader calls: it first looks the file up in a cache of
+ * `RIFF_CACHE_SLOTS` entries, keyed by path, size and modification time, and only walks the
+ * chunks on a miss. Replaying a story segment or a prompt then costs no header reads at all.
+ * `benchmark()` prints the opens per second of both paths for a file.
+ *
+ * ## Example:
+ * ```cpp
+ * RiffParser::WavInfo info;
+ * if (RiffParser::open(file, "/Stories/Cendrillon/1.wav", info)) {
+ *     file.seek(info.dataOffset);
+ * }
+ * ```
+ */
+
+class RiffParser {
+public:
+    struct WavInfo {
+        uint16_t formatTag;             // fmt: WAVE_FORMAT_PCM, WAVE_FORMAT_IMA_ADPCM, ...
+        uint16_t channels;              // fmt: channels
+        uint32_t sampleRate;            // fmt: frames per second
+        uint32_t byteRate;              // fmt: average bytes per second
+        uint16_t blockAlign;            // fmt: bytes per frame (PCM) or per block (ADPCM)
+        uint16_t bitsPerSample;         // fmt: bits per sample
+        uint32_t dataOffset;            // File offset of the first audio byte
+        uint32_t dataSize;              // Bytes of audio data present in the file
+        bool hasLoop;                   // smpl: a loop is defined
+        uint32_t loopStart;             // smpl: first frame of the loop
+        uint32_t loopEnd;               // smpl: last frame of the loop, inclusive
+    };
+
+    static bool open(File& file, const char* path, WavInfo& info); // Cached header, walked on a miss
+    static bool parse(File& file, WavInfo& info);   // Walk the chunks of a file
+    static void invalidate(const char* path);       // Drop the cached header of a file
+    static void benchmark(const char* path);        // Print opens per second, walked and cached
+
+private:
+    struct CacheEntry {
+        uint32_t pathHash;              // FNV-1a hash of the path, 0 for a free slot
+        uint32_t fileSize;              // Size of the file when parsed
+        uint32_t lastWrite;             // Modification time of the file when parsed
+        uint32_t lastUsed;              // Use counter value of the last hit, for LRU replacement
+        WavInfo info;                   // Parsed header
+    };
+
+    static uint32_t hashPath(const char* path);     // FNV-1a, never 0
+    static bool parseFmt(File& file, uint32_t size, WavInfo& info);  // Read and check a fmt chunk
+    static void parseSmpl(File& file, uint32_t size, WavInfo& info); // Read the first loop of a smpl chunk
+    static CacheEntry s_cache[RIFF_CACHE_SLOTS];    // Parsed headers of recently opened files
+    static uint32_t s_useCounter;                   // Bumped on every cache access
+    static portMUX_TYPE s_lock;                     // Guards the cache, readers open from several tasks
+};
+
+#endif // RIFF_PARSER_H
@@ -0,0 +1,328 @@
+#include "SeekIndex.h"
+#include "Mp3Decoder.h"
+
+/**
+ * @brief Constructor, the index is empty until `load()` or `build()`.
+ */
+SeekIndex::SeekIndex() : m_points(nullptr), m_valid(false) {
+    clear();
+}
+
+/**
+ * @brief Destructor, frees the seek points.
+ */
+SeekIndex::~SeekIndex() {
+    delete[] m_points;
+}
+
+/**
+ * @brief Drops the index.
+ */
+void SeekIndex::clear() {
+    delete[] m_points;
+    m_points = nullptr;
+    memset(&m_header, 0, sizeof(m_header));
+    memset(&m_layout, 0, sizeof(m_layout));
+    m_valid = false;
+}
+
+/**
+ * @brief Reads the sidecar of an audio file.
+ *
+ * @param indexPath Path of the sidecar.
+ * @param audio The open audio file, checked against the size and time the index was built for.
+ * @return true if the sidecar exists, is well formed and matches the audio file.
+ */
+bool SeekIndex::load(const char* indexPath, File& audio) {
+    clear();
+    if (!SD.exists(indexPath)) {
+        return false;
+    }
+    File file = SD.open(indexPath);
+    if (!file) {
+        return false;
+    }
+
+    bool ok = file.read((uint8_t*)&m_header, sizeof(m_header)) == sizeof(m_header) &&
+              m_header.magic == SEEK_INDEX_MAGIC && m_header.version == SEEK_INDEX_VERSION &&
+              m_header.fileSize == (uint32_t)audio.size() && m_header.lastWrite == (uint32_t)audio.getLastWrite() &&
+              m_header.framesPerBlock > 0;
+    if (ok && m_header.pointCount > 0) {
+        m_points = new uint32_t[m_header.pointCount];
+        size_t bytes = m_header.pointCount * sizeof(uint32_t);
+        ok = m_points && file.read((uint8_t*)m_points, bytes) == bytes;
+    }
+    file.close();
+    if (!ok) {
+        clear();
+        return false;
+    }
+
+    m_layout.formatTag = m_header.formatTag;
+    m_layout.channels = m_header.channels;
+    m_layout.sampleRate = m_header.sampleRate;
+    m_layout.dataOffset = m_header.dataOffset;
+    m_layout.dataSize = m_header.dataSize;
+    m_layout.blockAlign = m_header.blockAlign;
+    m_layout.framesPerBlock = m_header.framesPerBlock;
+    m_valid = true;
+    return true;
+}
+
+/**
+ * @brief Indexes an audio file.
+ *
+ * PCM and IMA-ADPCM blocks have a fixed size, so their index is computed from the
+ * layout alone. MP3 frames are walked once, reading only their headers.
+ *
+ * @param audio The open audio file; its position is changed.
+ * @param layout Format and data chunk of the file, as parsed by the reader.
+ * @return true if the file could be indexed.
+ */
+bool SeekIndex::build(File& audio, const Layout& layout) {
+    clear();
+    m_layout = layout;
+    m_header.magic = SEEK_INDEX_MAGIC;
+    m_header.version = SEEK_INDEX_VERSION;
+    m_header.fileSize = (uint32_t)audio.size();
+    m_header.lastWrite = (uint32_t)audio.getLastWrite();
+
+    if (layout.formatTag == WAVE_FORMAT_MPEGLAYER3) {
+        if (!buildMp3(audio)) {
+            clear();
+            return false;
+        }
+    } else {
+        if (layout.blockAlign == 0 || layout.framesPerBlock == 0) {
+            clear();
+            return false;
+        }
+        uint32_t blocks = layout.dataSize / layout.blockAlign;
+        uint32_t tail = layout.dataSize % layout.blockAlign; // A short last ADPCM block still decodes
+        m_header.totalFrames = blocks * layout.framesPerBlock;
+        if (tail > 0 && layout.framesPerBlock > 1) {
+            uint32_t tailFrames = 1 + (tail > 4u * layout.channels ? (tail - 4u * layout.channels) / (4u * layout.channels) * 8 : 0);
+            m_header.totalFrames += tailFrames < layout.framesPerBlock ? tailFrames : layout.framesPerBlock;
+        }
+    }
+
+    m_header.formatTag = m_layout.formatTag;
+    m_header.channels = m_layout.channels;
+    m_header.sampleRate = m_layout.sampleRate;
+    m_header.dataOffset = m_layout.dataOffset;
+    m_header.dataSize = m_layout.dataSize;
+    m_header.blockAlign = m_layout.blockAlign;
+    m_header.framesPerBlock = m_layout.framesPerBlock;
+    m_valid = true;
+    return true;
+}
+
+/**
+ * @brief Walks the MPEG frame headers and records a seek point every `SEEK_MP3_POINT_FRAMES` frames.
+ *
+ * Only the 4 header bytes of each frame are looked at, from `AUDIO_BLOCK_SIZE` reads. The
+ * walk ends at the first byte that is not a valid Layer III header (such as an ID3v1 tag).
+ */
+bool SeekIndex::buildMp3(File& audio) {
+    uint8_t* block = new uint8_t[AUDIO_BLOCK_SIZE];
+    size_t capacity = 64;
+    m_points = new uint32_t[capacity];
+    if (!block || !m_points) {
+        delete[] block;
+        return false;
+    }
+
+    uint32_t pos = 0;          // Offset of the current frame in the data
+    uint32_t blockStart = 0;   // Data offset of block[0]
+    size_t blockLength = 0;    // Valid bytes in block
+    uint32_t frames = 0;       // MPEG frames walked
+    uint32_t samplesPerFrame = 0;
+
+    while (pos + 4 <= m_layout.dataSize) {
+        if (pos < blockStart || pos + 4 > blockStart + blockLength) {
+            uint32_t length = m_layout.dataSize - pos;
+            audio.seek(m_layout.dataOffset + pos);
+            blockLength = audio.read(block, length < AUDIO_BLOCK_SIZE ? length : AUDIO_BLOCK_SIZE);
+            blockStart = pos;
+            if (blockLength < 4) {
+                break;
+            }
+        }
+
+        uint32_t frameBytes = 0;
+        uint32_t frameSamples = 0;
+        if (!parseMp3Header(block + (pos - blockStart), frameBytes, frameSamples)) {
+            break; // End of the frames
+        }
+        if (samplesPerFrame == 0) {
+            samplesPerFrame = frameSamples;
+        }
+
+        if (frames % SEEK_MP3_POINT_FRAMES == 0) {
+            size_t point = frames / SEEK_MP3_POINT_FRAMES;
+            if (point == capacity) {
+                uint32_t* grown = new uint32_t[capacity * 2];
+                if (!grown) {
+                    break; // Index what fits
+                }
+                memcpy(grown, m_points, capacity * sizeof(uint32_t));
+                delete[] m_points;
+                m_points = grown;
+                capacity *= 2;
+            }
+            m_points[point] = pos;
+            m_header.pointCount = point + 1;
+        }
+        frames++;
+        pos += frameBytes;
+        if ((frames & 63) == 0) {
+            esp_task_wdt_reset(); // Long responses take a while to walk
+        }
+    }
+    delete[] block;
+
+    if (frames == 0) {
+        return false;
+    }
+    m_layout.framesPerBlock = samplesPerFrame;
+    m_header.totalFrames = frames * samplesPerFrame;
+    return true;
+}
+
+/**
+ * @brief Parses an MPEG-1/2/2.5 Layer III frame header.
+ *
+ * @param h The 4 header bytes.
+ * @param length Out: frame size in bytes, padding included.
+ * @param frames Out: audio frames (samples per channel) the MPEG frame decodes to.
+ * @return false if the bytes are not a supported frame header (free format included).
+ */
+bool SeekIndex::parseMp3Header(const uint8_t* h, uint32_t& length, uint32_t& frames) {
+    static const uint16_t kBitrateV1[15] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+    static const uint16_t kBitrateV2[15] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+    static const uint32_t kRates[3] = { 44100, 48000, 32000 };
+
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    uint8_t version = (h[1] >> 3) & 3;      // 0: MPEG-2.5, 1: reserved, 2: MPEG-2, 3: MPEG-1
+    uint8_t layer = (h[1] >> 1) & 3;        // 1: Layer III
+    uint8_t bitrateIndex = h[2] >> 4;
+    uint8_t rateIndex = (h[2] >> 2) & 3;
+    uint8_t padding = (h[2] >> 1) & 1;
+    if (version == 1 || layer != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3) {
+        return false;
+    }
+
+    uint32_t rate = kRates[rateIndex] >> (version == 3 ? 0 : (version == 2 ? 1 : 2));
+    if (version == 3) {
+        frames = 1152;
+        length = 144000UL * kBitrateV1[bitrateIndex] / rate + padding;
+    } else {
+        frames = 576;
+        length = 72000UL * kBitrateV2[bitrateIndex] / rate + padding;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the index to its sidecar file, replacing any previous one.
+ */
+bool SeekIndex::save(const char* indexPath) {
+    if (!m_valid) {
+        return false;
+    }
+    File file = SD.open(indexPath, FILE_WRITE);
+    if (!file) {
+        return false;
+    }
+    size_t bytes = m_header.pointCount * sizeof(uint32_t);
+    bool ok = file.write((const uint8_t*)&m_header, sizeof(m_header)) == sizeof(m_header) &&
+              (bytes == 0 || file.write((const uint8_t*)m_points, bytes) == bytes);
+    file.close();
+    if (!ok) {
+        SD.remove(indexPath); // Never leave a truncated index behind
+    }
+    return ok;
+}
+
+/**
+ * @brief Returns true once the index has been loaded or built.
+ */
+bool SeekIndex::isValid() {
+    return m_valid;
+}
+
+/**
+ * @brief Returns the layout of the indexed file.
+ */
+const SeekIndex::Layout& SeekIndex::layout() {
+    return m_layout;
+}
+
+/**
+ * @brief Returns the number of frames in the file.
+ */
+uint32_t SeekIndex::totalFrames() {
+    return m_header.totalFrames;
+}
+
+/**
+ * @brief Finds where to start decoding to reach a frame.
+ *
+ * @param frame Target frame, clamped to the end of the file.
+ * @param byteOffset Out: offset from the start of the audio data of the block to read first.
+ * @param startFrame Out: first frame that block decodes to; the frames from there up to
+ *                   `frame` must be decoded and dropped.
+ */
+void SeekIndex::locate(uint32_t frame, uint32_t& byteOffset, uint32_t& startFrame) {
+    byteOffset = 0;
+    startFrame = 0;
+    if (!m_valid) {
+        return;
+    }
+    if (frame > m_header.totalFrames) {
+        frame = m_header.totalFrames;
+    }
+
+    const uint32_t framesPerBlock = m_layout.framesPerBlock;
+    uint32_t block = frame / framesPerBlock;
+    if (m_layout.formatTag != WAVE_FORMAT_MPEGLAYER3) {
+        byteOffset = block * m_layout.blockAlign;
+        startFrame = block * framesPerBlock;
+        return;
+    }
+
+    // Start a few MPEG frames early so the bit reservoir is refilled by the target frame
+    block = block > SEEK_MP3_PREROLL_FRAMES ? block - SEEK_MP3_PREROLL_FRAMES : 0;
+    uint32_t point = block / SEEK_MP3_POINT_FRAMES;
+    if (point >= m_header.pointCount) {
+        point = m_header.pointCount - 1;
+    }
+    byteOffset = m_points[point];
+    startFrame = point * SEEK_MP3_POINT_FRAMES * framesPerBlock;
+}
+
+/**
+ * @brief Returns how much of a read to take so that it ends on a sector boundary of the file.
+ *
+ * Reads longer than a sector are trimmed to end on an `AUDIO_SECTOR_SIZE` boundary, so every
+ * later read is sector aligned, then rounded down to whole blocks. When the data does not start
+ * on a block boundary of the sector grid (a 16-bit stereo `data` chunk at an offset of 2 mod 4
+ * is valid), the read ends a few bytes before the sector instead of in the middle of a frame.
+ *
+ * @param fileOffset File offset the read starts at.
+ * @param bytes Bytes wanted, a whole number of blocks.
+ * @param blockAlign Bytes per block (a PCM frame).
+ * @return Bytes to read, a whole number of blocks.
+ */
+size_t SeekIndex::sectorRead(uint32_t fileOffset, size_t bytes, uint16_t blockAlign) {
+    if (bytes <= AUDIO_SECTOR_SIZE) {
+        return bytes;
+    }
+    bytes -= (fileOffset + bytes) % AUDIO_SECTOR_SIZE;
+    if (blockAlign > 1) {
+        bytes -= bytes % blockAlign;
+    }
+    return bytes;
+}
@@ -0,0 +1,91 @@
+#ifndef SEEK_INDEX_H
+#define SEEK_INDEX_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include "Config.h"
+
+/**
+ * @file SeekIndex.h
+ * @brief Compact per-file seek index, cached in a sidecar file next to the audio file.
+ *
+ * The index maps a frame number to the file offset of the codec block holding it, so
+ * `WAVFileReader::seekMs()` costs one seek plus one aligned read, whatever the position:
+ *
+ * - PCM: every frame is its own block, the offset is `frame * blockAlign`.
+ * - IMA-ADPCM: blocks are `blockAlign` bytes of `framesPerBlock` frames each, so the block map
+ *   is implicit; the frames before the target within its block are decoded and dropped.
+ * - MP3: frames vary in size (VBR, padding), so the index holds a table of seek points, the
+ *   offset of every `SEEK_MP3_POINT_FRAMES`th MPEG frame, found once by walking the frame
+ *   headers. Decoding restarts a couple of frames ahead of the target to refill the bit
+ *   reservoir.
+ *
+ * The index is stored as `<audio path>SEEK_INDEX_EXTENSION`: a 44-byte header followed by the
+ * MP3 seek points. It records the size and modification time of the audio file and is rebuilt
+ * when either changes (the TTS response, for one, is rewritten for every answer).
+ *
+ * ## Example:
+ * ```cpp
+ * SeekIndex index;
+ * if (!index.load(indexPath, file)) {
+ *     index.build(file, layout);
+ *     index.save(indexPath);
+ * }
+ * uint32_t offset, start;
+ * index.locate(frame, offset, start);
+ * ```
+ */
+
+#define SEEK_INDEX_MAGIC 0x58444953                          ///< "SIDX"
+#define SEEK_INDEX_VERSION 1                                 ///< Bumped whenever the sidecar layout changes
+
+class SeekIndex {
+public:
+    struct Layout {
+        uint16_t formatTag;             // WAVE_FORMAT_PCM, WAVE_FORMAT_IMA_ADPCM or WAVE_FORMAT_MPEGLAYER3
+        uint16_t channels;              // Channels in the file
+        uint32_t sampleRate;            // Frames per second
+        uint32_t dataOffset;            // File offset of the first audio byte
+        uint32_t dataSize;              // Bytes of audio data
+        uint16_t blockAlign;            // Bytes per codec block (PCM frame, ADPCM block), 0 for MP3
+        uint32_t framesPerBlock;        // Frames per codec block, found by build() for MP3
+    };
+
+    SeekIndex();
+    ~SeekIndex();
+    bool load(const char* indexPath, File& audio); // Read the sidecar, false if missing or stale
+    bool build(File& audio, const Layout& layout);  // Index the audio file (walks the frames of an MP3)
+    bool save(const char* indexPath);   // Write the sidecar
+    bool isValid();                     // Loaded or built
+    const Layout& layout();             // Layout of the indexed file
+    uint32_t totalFrames();             // Frames in the file
+    void locate(uint32_t frame, uint32_t& byteOffset, uint32_t& startFrame); // Block to start decoding at for a frame
+    static size_t sectorRead(uint32_t fileOffset, size_t bytes, uint16_t blockAlign); // Read length ending on a sector, in whole blocks
+
+private:
+    struct Header {
+        uint32_t magic;                 // SEEK_INDEX_MAGIC
+        uint16_t version;               // SEEK_INDEX_VERSION
+        uint16_t formatTag;             // Layout::formatTag
+        uint32_t fileSize;              // Size of the audio file when indexed
+        uint32_t lastWrite;             // Modification time of the audio file when indexed
+        uint32_t dataOffset;            // Layout::dataOffset
+        uint32_t dataSize;              // Layout::dataSize
+        uint32_t sampleRate;            // Layout::sampleRate
+        uint16_t channels;              // Layout::channels
+        uint16_t blockAlign;            // Layout::blockAlign
+        uint32_t framesPerBlock;        // Layout::framesPerBlock
+        uint32_t totalFrames;           // Frames in the file
+        uint32_t pointCount;            // MP3 seek points following the header
+    };
+
+    bool buildMp3(File& audio);         // Walk the MPEG frame headers and record the seek points
+    static bool parseMp3Header(const uint8_t* h, uint32_t& length, uint32_t& frames); // One Layer III frame header
+    void clear();                       // Drop the index
+    Header m_header;                    // Index header, as stored in the sidecar
+    Layout m_layout;                    // Same fields, as used by the reader
+    uint32_t* m_points;                 // Data offset of every SEEK_MP3_POINT_FRAMES-th MP3 frame
+    bool m_valid;                       // Loaded or built
+};
+
+#endif // SEEK_INDEX_H
@@ -6,14 +6,43 @@ SpeakerManager::SpeakerManager(
         WAVFileWriter* wavfileWriter,
         MicManager* micManager,
         i2s_pin_config_t* i2sPins,
-        I2SManager* i2SManager)
-    : currentVolume(0), 
+        I2SManager* i2SManager,
+        ConfigManager* configManager)
+    : currentVolume(100), 
+      configManager(configManager),
       i2SManager(i2SManager), 
       wavfileReader(wavfileReader), 
+      nextReader(nullptr),
+      prefetch(nullptr),
+      loudness(nullptr),
+      playQueue(NULL),
+      playbackMutex(NULL),
+      xSequencerTask(NULL),
+      effectCount(0),
+      prompts(nullptr),
       wavfileWriter(wavfileWriter),  
       isPaused(false),
       i2sPins(i2sPins),
-      micManager(micManager){}
+      micManager(micManager),
+      recording(false),
+      xRecordWriterTask(NULL),
+      denoiser(nullptr),
+      noiseReduction(true),
+      voice(nullptr),
+      voiceDetection(true),
+      recordHold(nullptr),
+      holdCapacity(0),
+      holdStart(0),
+      holdCount(0),
+      prerollSamples(0),
+      tailSamples(0),
+      speechHeard(false),
+      silenceStop(false),
+      leadDropped(0),
+      agc(nullptr),
+      autoGain(true),
+      armed(false),
+      armedSampleRate(SAMPLE_RATE){}
 
 /**
  * @brief Initializes the I2S amplifier and configures I2S pins.
@@ -37,152 +66,1051 @@ void SpeakerManager::begin() {
     i2sPins ->ws_io_num = I2S_SD_MODE_PIN,
     i2sPins ->data_out_num = I2S_DIN_PIN,
     i2sPins ->data_in_num = I2S_PIN_NO_CHANGE;
+
+    // Create the long-lived output engine; the driver is installed once here
+    if (!i2SManager) {
+        i2SManager = new I2SManager(*i2sPins, I2S_DEFAULT_SAMPLE_RATE);
+    }
+    i2SManager->begin();
+    i2SManager->setVolume(currentVolume);
+    if (configManager) {
+        Compressor::Settings settings = {
+            configManager->GetInt(COMP_THRESHOLD_KEY, COMP_DEFAULT_THRESHOLD_DB),
+            configManager->GetInt(COMP_ATTACK_KEY, COMP_DEFAULT_ATTACK_MS),
+            configManager->GetInt(COMP_RELEASE_KEY, COMP_DEFAULT_RELEASE_MS)
+        };
+        i2SManager->compressor().configure(settings);
+    }
+
+    // Map the prompt bank; UI prompts then play without the SD card
+    if (!prompts) {
+        prompts = new PromptPlayer(i2SManager);
+        prompts->begin();
+    }
+
+    // Read segments ahead into PSRAM when the board has some
+    if (!prefetch) {
+        prefetch = new PrefetchCache();
+        if (!prefetch->begin()) {
+            delete prefetch;
+            prefetch = nullptr;
+        }
+    }
+
+    // Measure the loudness of the files on the card in idle time, for normalization
+    if (!loudness) {
+        loudness = new LoudnessScanner(i2SManager);
+        if (!loudness->begin()) {
+            delete loudness;
+            loudness = nullptr;
+        }
+    }
+
+    // Create the playback queue and the sequencer that chains its segments
+    if (!playQueue) {
+        playQueue = xQueueCreate(PLAYBACK_QUEUE_LENGTH, sizeof(PlaybackItem));
+    }
+    if (!playbackMutex) {
+        playbackMutex = xSemaphoreCreateMutex();
+    }
+    if (!xSequencerTask) {
+        xTaskCreate(sequencerTask, "SequencerTask", SEQUENCER_STACK_SIZE, this, SEQUENCER_TASK_PRIORITY, &xSequencerTask);
+    }
     
     if (DEBUGMODE) {
         Serial.println("SpeakerManager: I2S amplifier initialized successfully.");
     }
 }
 
-// Starts playback with the given WAV file.
-void SpeakerManager::startPlayback(const char* file_name) {
+// Starts playback with the given WAV file at startMs, replacing anything playing or queued.
+void SpeakerManager::startPlayback(const char* file_name, uint32_t startMs) {
     esp_task_wdt_reset(); // Reset watchdog timer
     stopPlayback(); // Clean up previous resources
+    isPaused = false; // A new track always starts playing
 
-    // Initialize WAV file reader
-    wavfileReader = new WAVFileReader(file_name, *i2sPins);
-
-    // Open the new WAV file
-    if (wavfileReader && wavfileReader->open()) { // Open the specified WAV file
-        wavfileReader->startPlayback(); // Start playback in the background
-    } else {
-        Serial.println("Failed to open WAV file for playback.");
-        delete wavfileReader; // Clean up if failed to open
-        wavfileReader = nullptr; // Avoid dangling pointer
+    // The sequencer opens the file and starts it on the shared output engine
+    if (!enqueue(file_name, startMs)) {
+        Serial.println("Failed to queue WAV file for playback.");
     }
 }
 
-// Stops playback and cleans up resources.
+// Stops playback, drops the queue and cleans up resources. The output engine stays installed.
 void SpeakerManager::stopPlayback() {
-    if (wavfileReader) {
-        wavfileReader->stopPlayback(); // Stop the WAV file playback
-        delete wavfileReader; // Delete the WAV file reader to free memory
-        wavfileReader = nullptr; // Avoid dangling pointer
+    clearQueue(); // Nothing queued may start after a stop
+    if (playbackMutex) xSemaphoreTake(playbackMutex, portMAX_DELAY);
+    releaseReaders();
+    if (i2SManager) {
+        i2SManager->stop(); // Halt output, DMA descriptors stay allocated
+        i2SManager->flush(); // Drop queued samples of the stopped track
+        if (i2SManager->mixer().isActive()) {
+            i2SManager->resume(); // Sound effects play on after the track
+        }
     }
+    if (playbackMutex) xSemaphoreGive(playbackMutex);
 }
 
 // Pauses the current playback.
 void SpeakerManager::pausePlayback() {
+    if (playbackMutex) xSemaphoreTake(playbackMutex, portMAX_DELAY);
     if (wavfileReader) {
         wavfileReader->pausePlayback(); // Implement pause in WAVFileReader
     }
+    if (i2SManager) {
+        i2SManager->pause(); // Queued samples stay in the playback ring
+    }
+    isPaused = true;
+    if (playbackMutex) xSemaphoreGive(playbackMutex);
 }
 
 // Resumes the paused playback.
 void SpeakerManager::resumePlayback() {
+    if (playbackMutex) xSemaphoreTake(playbackMutex, portMAX_DELAY);
     if (wavfileReader) {
         wavfileReader->resumePlayback(); // Implement resume in WAVFileReader
     }
+    if (i2SManager) {
+        i2SManager->resume();
+    }
+    isPaused = false;
+    if (playbackMutex) xSemaphoreGive(playbackMutex);
+}
+
+/**
+ * @brief Returns the position being heard in the current segment.
+ *
+ * The position of the reader, less the samples still waiting in the playback ring. Pass
+ * it to `startPlayback()` or `enqueue()` later to resume the segment where it was left.
+ *
+ * @return The position in milliseconds, 0 when nothing plays.
+ */
+uint32_t SpeakerManager::positionMs() {
+    if (!i2SManager) {
+        return 0;
+    }
+    if (playbackMutex) xSemaphoreTake(playbackMutex, portMAX_DELAY);
+    uint32_t position = wavfileReader ? wavfileReader->positionMs() : 0;
+    if (playbackMutex) xSemaphoreGive(playbackMutex);
+
+    uint32_t rate = i2SManager->getSampleRate();
+    uint32_t queuedMs = rate > 0
+        ? (uint32_t)((uint64_t)i2SManager->ring().readAvailable() / AUDIO_OUTPUT_CHANNELS * 1000 / rate) : 0;
+    return position > queuedMs ? position - queuedMs : 0;
+}
+
+/**
+ * @brief Jumps to a position in the current segment.
+ *
+ * The samples already queued are dropped and the reader restarts at the new position,
+ * paused if playback is paused. The rest of the queue is kept.
+ *
+ * @param ms Position from the start of the segment, clamped to its end.
+ * @return false if nothing is playing or the segment cannot be seeked.
+ */
+bool SpeakerManager::seekMs(uint32_t ms) {
+    if (playbackMutex) xSemaphoreTake(playbackMutex, portMAX_DELAY);
+    bool ok = false;
+    if (wavfileReader && i2SManager) {
+        wavfileReader->stopPlayback();
+        i2SManager->stop(); // Halt output, DMA descriptors stay allocated
+        i2SManager->flush(); // The reader is stopped, so the ring has no producer
+        ok = wavfileReader->seekMs(ms);
+        i2SManager->markTrackStart();
+        if (!isPaused) {
+            i2SManager->resume();
+        }
+        wavfileReader->startPlayback(); // From the start if the seek failed
+        if (isPaused) {
+            wavfileReader->pausePlayback();
+        }
+    }
+    if (playbackMutex) xSemaphoreGive(playbackMutex);
+    return ok;
+}
+
+/**
+ * @brief Appends a segment to the playback queue.
+ *
+ * The segment starts as soon as everything queued before it has been read. If nothing is
+ * playing it starts right away.
+ *
+ * @param file_name Path of the WAV file on the SD card.
+ * @param startMs Position to start the segment at, 0 for its beginning.
+ * @return true if the segment was queued; false if the queue is full or the path is too long.
+ */
+bool SpeakerManager::enqueue(const char* file_name, uint32_t startMs) {
+    PlaybackItem item;
+    if (!playQueue || !file_name || strlen(file_name) >= sizeof(item.path)) {
+        return false;
+    }
+    strncpy(item.path, file_name, sizeof(item.path));
+    item.startMs = startMs;
+
+    if (xQueueSend(playQueue, &item, 0) != pdTRUE) {
+        if (DEBUGMODE) Serial.println("SpeakerManager: Playback queue full.");
+        return false;
+    }
+    if (xSequencerTask) xTaskNotifyGive(xSequencerTask); // Start it without waiting for the next poll
+    return true;
+}
+
+/**
+ * @brief Stops the current segment and continues with the next queued one.
+ *
+ * The skipped segment fades out; its samples still in the playback ring are dropped.
+ */
+void SpeakerManager::skip() {
+    if (playbackMutex) xSemaphoreTake(playbackMutex, portMAX_DELAY);
+    if (wavfileReader) {
+        wavfileReader->stopPlayback();
+        delete wavfileReader;
+        wavfileReader = nullptr;
+        i2SManager->stop(); // Fade the skipped segment out instead of cutting it
+        i2SManager->flush(); // The reader is stopped, so the ring has no producer
+        if (!isPaused) {
+            i2SManager->resume(); // The next segment and any effects fade in
+        }
+    }
+    if (playbackMutex) xSemaphoreGive(playbackMutex);
+    if (xSequencerTask) xTaskNotifyGive(xSequencerTask);
+}
+
+/**
+ * @brief Drops every queued segment that has not started yet, including the one
+ * already opened ahead of time. The current segment keeps playing.
+ */
+void SpeakerManager::clearQueue() {
+    if (playQueue) {
+        xQueueReset(playQueue);
+    }
+    if (playbackMutex) xSemaphoreTake(playbackMutex, portMAX_DELAY);
+    if (nextReader) {
+        delete nextReader;
+        nextReader = nullptr;
+    }
+    if (playbackMutex) xSemaphoreGive(playbackMutex);
+}
+
+/**
+ * @brief Returns the number of segments waiting to start.
+ */
+size_t SpeakerManager::queueLength() {
+    size_t waiting = playQueue ? uxQueueMessagesWaiting(playQueue) : 0;
+    return waiting + (nextReader ? 1 : 0);
+}
+
+/**
+ * @brief Stops and deletes the current and the prepared reader. Caller holds the mutex.
+ */
+void SpeakerManager::releaseReaders() {
+    if (wavfileReader) {
+        wavfileReader->stopPlayback(); // Stop the WAV file playback
+        delete wavfileReader; // Delete the WAV file reader to free memory
+        wavfileReader = nullptr; // Avoid dangling pointer
+    }
+    if (nextReader) {
+        delete nextReader;
+        nextReader = nullptr;
+    }
+}
+
+/**
+ * @brief Playback sequencer task.
+ *
+ * Runs for the lifetime of the SpeakerManager and calls `sequencerStep()` whenever a
+ * segment is queued or skipped, and at least every `AUDIO_TASK_POLL_MS`. The playback
+ * ring holds far more than one poll period of audio, so segments are always spliced
+ * before the ring runs dry.
+ *
+ * @param parameter A pointer to the SpeakerManager instance.
+ */
+void SpeakerManager::sequencerTask(void* parameter) {
+    SpeakerManager* speaker = static_cast<SpeakerManager*>(parameter);
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_TASK_POLL_MS));
+        xSemaphoreTake(speaker->playbackMutex, portMAX_DELAY);
+        speaker->sequencerStep();
+        xSemaphoreGive(speaker->playbackMutex);
+    }
+}
+
+/**
+ * @brief Prepares the next segment and splices it behind the current one.
+ *
+ * While segment N plays, segment N+1 is opened and its header parsed. As soon as the
+ * reader of segment N has queued its last sample, it is released and the reader of
+ * segment N+1 starts filling the same playback ring right behind it. The writer task
+ * never sees a boundary, so the splice is sample accurate with no silence in between.
+ * Segments below `AUDIO_OUTPUT_RATE` are resampled by their reader, so they all share
+ * the output rate. Only a segment above it waits for the ring to drain and retunes the
+ * clock first.
+ */
+void SpeakerManager::sequencerStep() {
+    // Open the next segment ahead of time
+    if (!nextReader) {
+        PlaybackItem item;
+        if (xQueueReceive(playQueue, &item, 0) == pdTRUE) {
+            nextReader = new WAVFileReader(item.path, i2SManager, prefetch);
+            if (!nextReader->open()) {
+                Serial.println("Failed to open WAV file for playback.");
+                delete nextReader; // Clean up if failed to open
+                nextReader = nullptr; // Avoid dangling pointer
+                xTaskNotifyGive(xSequencerTask); // Try the following segment right away
+                return;
+            }
+            if (item.startMs > 0 && !nextReader->seekMs(item.startMs)) {
+                Serial.println("Failed to seek, playing from the start.");
+            }
+        }
+    }
+
+    bool currentDone = !wavfileReader || wavfileReader->getPlaybackState() == WAVFileReader::STOPPED;
+    if (!currentDone) {
+        return; // Segment N is still reading
+    }
+
+    if (!nextReader) {
+        // Queue finished: release the last reader once its samples have played
+        if (wavfileReader && i2SManager->ring().readAvailable() == 0) {
+            delete wavfileReader;
+            wavfileReader = nullptr;
+        }
+        return;
+    }
+
+    bool sameRate = nextReader->getOutputRate() == i2SManager->getSampleRate();
+    if (!sameRate && wavfileReader && i2SManager->ring().readAvailable() > 0) {
+        return; // Let the old rate drain before retuning
+    }
+
+    if (wavfileReader) {
+        wavfileReader->stopPlayback(); // Reader task has already exited, this only waits for it
+        delete wavfileReader;
+    }
+    wavfileReader = nextReader;
+    nextReader = nullptr;
+
+    if (!sameRate) {
+        i2SManager->setSampleRate(wavfileReader->getOutputRate()); // Retune the clock in place
+    }
+    i2SManager->markTrackStart(); // Measure time to first sample and gap for this segment
+    if (!isPaused) {
+        i2SManager->resume(); // Restart output if a previous stop halted it
+    }
+    wavfileReader->startPlayback(); // Splice right behind the previous segment
+    if (isPaused) {
+        wavfileReader->pausePlayback();
+    }
+}
+
+/**
+ * @brief Returns the counters of the PSRAM read-ahead cache, all zero without PSRAM.
+ */
+PrefetchCache::Stats SpeakerManager::getPrefetchStats() {
+    if (!prefetch) {
+        PrefetchCache::Stats none;
+        memset(&none, 0, sizeof(none));
+        return none;
+    }
+    return prefetch->getStats();
+}
+
+/**
+ * @brief Returns the progress of the background loudness measurement.
+ *
+ * @return The files measured and the rate of the job, all zero if it is not running.
+ */
+LoudnessScanner::Stats SpeakerManager::getLoudnessStats() {
+    if (!loudness) {
+        LoudnessScanner::Stats none;
+        memset(&none, 0, sizeof(none));
+        return none;
+    }
+    return loudness->getStats();
+}
+
+/**
+ * @brief Decodes a short sound effect into RAM.
+ *
+ * The file is decoded, converted to 16-bit stereo and resampled to `AUDIO_OUTPUT_RATE`
+ * once, into PSRAM when there is some, so playing it later costs no SD access. Any
+ * format the playback path accepts can be loaded, up to `MIXER_EFFECT_MAX_SAMPLES`.
+ *
+ * @param file_name Path of the effect on the SD card.
+ * @return The effect id for `playEffect()`, or -1 on failure.
+ */
+int SpeakerManager::loadEffect(const char* file_name) {
+    if (!i2SManager || effectCount >= MIXER_EFFECT_SLOTS) {
+        Serial.println("No free sound effect slot.");
+        return -1;
+    }
+
+    WAVFileReader* reader = new WAVFileReader(file_name, i2SManager);
+    if (!reader->open() || reader->getOutputRate() != AUDIO_OUTPUT_RATE) {
+        Serial.println("Failed to open sound effect.");
+        delete reader;
+        return -1;
+    }
+
+    uint32_t caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    int16_t* samples = (int16_t*)heap_caps_malloc(MIXER_EFFECT_MAX_SAMPLES * sizeof(int16_t), caps);
+    if (!samples) {
+        caps = MALLOC_CAP_8BIT; // No PSRAM, try internal RAM
+        samples = (int16_t*)heap_caps_malloc(MIXER_EFFECT_MAX_SAMPLES * sizeof(int16_t), caps);
+    }
+    if (!samples) {
+        Serial.println("Failed to allocate sound effect.");
+        delete reader;
+        return -1;
+    }
+    size_t count = reader->decodeAll(samples, MIXER_EFFECT_MAX_SAMPLES);
+    delete reader;
+    if (count == 0) {
+        heap_caps_free(samples);
+        return -1;
+    }
+
+    // Give back what the effect does not use
+    int16_t* fitted = (int16_t*)heap_caps_realloc(samples, count * sizeof(int16_t), caps);
+    if (fitted) {
+        samples = fitted;
+    }
+    effects[effectCount].samples = samples;
+    effects[effectCount].count = count;
+    effects[effectCount].mono = false;      // Decoded to the output format
+    effects[effectCount].rateShift = 0;
+
+    if (DEBUGMODE) {
+        Serial.print("SpeakerManager: Loaded sound effect ");
+        Serial.print(file_name);
+        Serial.print(", ");
+        Serial.print((uint32_t)(count / AUDIO_OUTPUT_CHANNELS * 1000ULL / AUDIO_OUTPUT_RATE));
+        Serial.println(" ms");
+    }
+    return effectCount++;
+}
+
+/**
+ * @brief Plays a loaded sound effect over whatever is playing.
+ *
+ * The narration is ducked while the effect plays. Effects also play when no track
+ * does, but not while playback is paused.
+ *
+ * @param effect Id returned by `loadEffect()`.
+ * @param volume Volume of the effect, 0-100, on top of the output volume.
+ * @return true if a voice was free to play it.
+ */
+bool SpeakerManager::playEffect(int effect, int volume) {
+    if (!i2SManager || effect < 0 || effect >= effectCount) {
+        return false;
+    }
+    int voice = i2SManager->mixer().play(effects[effect], GainStage::volumeToGain(constrain(volume, 0, 100)));
+    if (voice < 0) {
+        if (DEBUGMODE) {
+            Serial.println("SpeakerManager: Every effect voice is busy.");
+        }
+        return false;
+    }
+    if (!isPaused) {
+        i2SManager->resume(); // Output is stopped when no track has played yet
+    }
+    return true;
+}
+
+/**
+ * @brief Plays a prompt from the flash bank over the narration, like an effect.
+ *
+ * The samples are read straight from the mapped partition, so this works before the SD
+ * card is mounted and costs no file lookup.
+ *
+ * @param prompt Id from `PromptIndex.h` (`Prompt::BOOT_CHIME`, ...).
+ * @param volume Volume of the prompt, 0..100 %.
+ * @return true if the prompt was started.
+ */
+bool SpeakerManager::playPrompt(int prompt, int volume) {
+    return prompts && startedPrompt(prompts->play(prompt, volume));
+}
+
+/**
+ * @brief Plays a prompt from the flash bank by the name of its source file, without extension.
+ */
+bool SpeakerManager::playPrompt(const char *name, int volume) {
+    return prompts && startedPrompt(prompts->play(name, volume));
+}
+
+/**
+ * @brief Starts the output for a prompt that got a voice, unless playback is paused.
+ */
+bool SpeakerManager::startedPrompt(int voice) {
+    if (voice < 0) {
+        if (DEBUGMODE) {
+            Serial.println("SpeakerManager: Prompt not in the bank, or every voice is busy.");
+        }
+        return false;
+    }
+    if (!isPaused) {
+        i2SManager->resume(); // Wakes the writer task at once
+    }
+    return true;
+}
+
+/**
+ * @brief Silences every playing sound effect. The narration is not affected.
+ */
+void SpeakerManager::stopEffects() {
+    if (i2SManager) {
+        i2SManager->mixer().stopAll();
+    }
 }
 
-// Sets the volume level for the I2S amplifier.
+/**
+ * @brief Stops the sound effects and frees their memory. Their ids become invalid.
+ */
+void SpeakerManager::unloadEffects() {
+    stopEffects();
+    for (int i = 0; i < effectCount; i++) {
+        heap_caps_free((void*)effects[i].samples); // Allocated by loadEffect()
+        effects[i].samples = nullptr;
+        effects[i].count = 0;
+    }
+    effectCount = 0;
+}
+
+// Sets the playback volume; the output engine ramps to it so the change does not click.
 void SpeakerManager::setVolume(int volume) {
     currentVolume = constrain(volume, 0, 100); // Ensure volume is within range (0-100)
-    // Code to set volume in the I2S amplifier would go here
+    if (i2SManager) {
+        i2SManager->setVolume(currentVolume);
+    }
 
     if (DEBUGMODE) {
         Serial.print("SpeakerManager: Volume set to ");
         Serial.println(currentVolume);
     }
 }
+
+/**
+ * @brief Tunes the compressor and limiter of the output and saves the settings.
+ *
+ * The new settings apply within a sub-block of `COMP_SUBBLOCK_FRAMES`, without a click, and
+ * are loaded again by `begin()` after a restart when a `ConfigManager` was given.
+ *
+ * @param thresholdDb Level compression starts at, COMP_THRESHOLD_MIN_DB..0 dBFS.
+ * @param attackMs Time constant of gain reduction, 0 for instant.
+ * @param releaseMs Time constant of gain recovery.
+ */
+void SpeakerManager::setDynamics(int thresholdDb, int attackMs, int releaseMs) {
+    Compressor::Settings settings = { thresholdDb, attackMs, releaseMs };
+    if (i2SManager) {
+        i2SManager->compressor().configure(settings);
+        settings = i2SManager->compressor().getSettings(); // Save the clamped values
+    }
+    if (configManager) {
+        configManager->PutInt(COMP_THRESHOLD_KEY, settings.thresholdDb);
+        configManager->PutInt(COMP_ATTACK_KEY, settings.attackMs);
+        configManager->PutInt(COMP_RELEASE_KEY, settings.releaseMs);
+    }
+
+    if (DEBUGMODE) {
+        Serial.printf("SpeakerManager: Compressor threshold %d dBFS, attack %d ms, release %d ms\n",
+                      settings.thresholdDb, settings.attackMs, settings.releaseMs);
+    }
+}
 /**
- * @brief Starts recording to a WAV file.
+ * @brief Starts streaming a recording to a WAV file.
  *
- * @param file_name The name of the WAV file to record to. The file will 
- *                  be created if it does not exist, and must be in a valid 
- *                  format to ensure proper recording.
+ * @param file_name The name of the WAV file to record to, without extension. The file 
+ *                  is created in `Folder`.
+ * @param sample_rate Capture rate in Hz.
+ * @param Folder Folder of the recording on the SD card.
+ * @return true if the recording started.
  *
- * This method stops any ongoing playback before initializing the WAV file writer.
- * It should be called to initiate audio recording to a specified WAV file.
+ * This method stops any ongoing playback, starts the microphone capture and a
+ * background writer task that appends every captured block to the SD card. Memory
+ * use is the capture ring only, whatever the length of the recording.
  */
-void SpeakerManager::startRecording() {
+bool SpeakerManager::startRecording(const char *file_name, int sample_rate, String Folder) {
+    if (recording || xRecordWriterTask) {
+        return false; // One recording at a time
+    }
+
     // Clean up previous resources
     if (DEBUGMODE)Serial.println("SpeakerManager: Stop Playback.");
     stopPlayback(); // Ensure playback is stopped before recording
+    if (loudness) loudness->hold(true); // The capture writer gets the SD card to itself
+
+    // The suppressor is kept between recordings, it learns a new noise profile each time
+    if (noiseReduction) {
+        if (!denoiser) denoiser = new NoiseSuppressor();
+        denoiser->reset(sample_rate);
+    } else if (denoiser) {
+        delete denoiser;
+        denoiser = nullptr;
+    }
+
+    // Trim the silence around the speech; the hold takes the longest pause kept in the file
+    speechHeard = false;
+    silenceStop = false;
+    holdStart = 0;
+    holdCount = 0;
+    if (voiceDetection) {
+        holdCapacity = (size_t)VAD_STOP_MS * sample_rate / 1000;
+        recordHold = (int16_t*)heap_caps_malloc(holdCapacity * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+        if (!recordHold) recordHold = (int16_t*)malloc(holdCapacity * sizeof(int16_t));
+        if (recordHold) {
+            if (!voice) voice = new VoiceDetector();
+            voice->reset(sample_rate);
+            prerollSamples = (size_t)VAD_PREROLL_MS * sample_rate / 1000;
+            tailSamples = (size_t)VAD_TAIL_MS * sample_rate / 1000;
+        } else if (DEBUGMODE) {
+            Serial.println("SpeakerManager: No memory to trim silence, recording everything.");
+        }
+    }
+
+    // The AGC is kept between recordings, it starts from the gain the last one ended at
+    leadDropped = 0;
+    if (autoGain) {
+        if (!agc) agc = new AutoGain();
+        agc->reset(sample_rate);
+        micManager->setGain(agc->getLevel());
+    } else if (agc) {
+        delete agc;
+        agc = nullptr;
+    }
+
+    // A pre-trigger capture at this rate is taken over with the audio it holds, else restarted
+    bool preTriggered = armed && armedSampleRate == sample_rate && micManager->isCapturing();
+    if (armed && !preTriggered) {
+        micManager->stopCapture();
+    }
+
+    // No duration limit, the file grows until stopRecording()
+    wavfileWriter = new WAVFileWriter(file_name, CHANNEL, sample_rate, 0, Folder);
+
+    if (preTriggered) {
+        micManager->setPreTrigger(0); // The writer task is the consumer of the ring from here on
+        if (DEBUGMODE) {
+            MicManager::CaptureStats stats = micManager->getCaptureStats();
+            Serial.printf("SpeakerManager: Recording starts %u ms early, capture CPU %u %% while armed\n",
+                          (unsigned)(micManager->captureRing().readAvailable() * 1000 / sample_rate), stats.cpuLoadPercent);
+        }
+    } else if (!micManager->startCapture(sample_rate)) {
+        Serial.println("Failed to start microphone capture.");
+        delete wavfileWriter; // Closes the empty file
+        wavfileWriter = nullptr;
+        free(recordHold);
+        recordHold = nullptr;
+        if (loudness) loudness->hold(false);
+        return false;
+    }
+
+    recording = true;
+    xTaskCreate(recordWriterTask, "RecordWriterTask", RECORD_WRITER_STACK_SIZE, this, RECORD_WRITER_TASK_PRIORITY, &xRecordWriterTask);
+
+    if (DEBUGMODE) {
+        Serial.println("SpeakerManager: Recording started.");
+    }
+    return true;
 }
 
 /**
  * @brief Stops recording and cleans up resources.
  *
- * This method closes the WAV file writer and frees up memory. It should 
- * be called when recording is no longer needed to prevent resource leaks.
+ * Capture stops after the current frame, the writer task appends what is left in
+ * the ring, patches the WAV header with the final sizes and closes the file. This
+ * completes within one block of the call.
  */
 void SpeakerManager::stopRecording() {
+    if (recording) {
+        micManager->stopCapture(); // No more samples after this
+        recording = false;
+        if (xRecordWriterTask) xTaskNotifyGive(xRecordWriterTask);
+        while (xRecordWriterTask) {
+            vTaskDelay(1); // Wait for the writer task to finalize the file
+        }
+    }
+
     if (wavfileWriter) {
-        wavfileWriter->close(); // Ensure writing is stopped
-        delete wavfileWriter;
+        delete wavfileWriter; // Already closed by the writer task
         wavfileWriter = nullptr;
-        
+    }
+    if (loudness) {
+        loudness->hold(false);
+        loudness->rescan(); // Measure the new recording in the next idle time
+    }
+    if (armed && !micManager->isCapturing()) {
+        startPreTrigger(); // Back to listening for the next recording
+    }
+    if (DEBUGMODE && denoiser) {
+        NoiseSuppressor::Stats stats = denoiser->getStats();
+        Serial.printf("SpeakerManager: Noise suppressor %u frames, %u us mean, %u us worst (budget %u us)\n",
+                      stats.frames, stats.meanUs, stats.maxUs, stats.budgetUs);
+    }
+    if (recordHold) {
+        if (DEBUGMODE) {
+            VoiceDetector::Stats stats = voice->getStats();
+            Serial.printf("SpeakerManager: Speech in %u of %u frames, %u onsets%s\n", stats.speechFrames, stats.frames,
+                          stats.onsets, silenceStop ? ", stopped on silence" : "");
+        }
+        free(recordHold);
+        recordHold = nullptr;
+    }
+    if (DEBUGMODE && agc) {
+        AutoGain::Stats stats = agc->getStats();
+        Serial.printf("SpeakerManager: AGC %u switches, %u steps, %u of %u frames clipped, ends at %d dB %+d dB\n",
+                      stats.switches, stats.steps, stats.clippedFrames, stats.frames,
+                      MIC_GAIN_MIN_DB + agc->getLevel() * MIC_GAIN_STEP_DB, agc->getDigitalDb());
+    }
+}
+
+/**
+ * @brief Turns silence trimming and the stop on silence on or off, from the next recording on.
+ *
+ * @param enabled true to keep only the speech of a recording (the default).
+ */
+void SpeakerManager::setVoiceDetection(bool enabled) {
+    voiceDetection = enabled;
+}
+
+/**
+ * @brief Turns the microphone AGC on or off, from the next recording on.
+ *
+ * Without it the microphone stays at the gain level it was left at.
+ *
+ * @param enabled true to level the recordings (the default).
+ */
+void SpeakerManager::setAutoGain(bool enabled) {
+    autoGain = enabled;
+}
+
+/**
+ * @brief Arms the pre-trigger: the microphone keeps capturing between recordings.
+ *
+ * The capture task keeps the last `PRETRIGGER_MS` in the capture ring and drops the rest, with
+ * no other task running. A recording started at the same rate takes the ring over in place,
+ * so the file starts `PRETRIGGER_MS` before `startRecording()` and includes the first
+ * syllable; the silence trimming still drops it when nobody spoke. Capture resumes after each
+ * recording until `disarmRecording()`.
+ *
+ * The cost while armed is the capture ring (`RECORD_RING_SAMPLES` samples, in internal RAM
+ * whether armed or not), the capture task and the DMA pool, and the CPU load of the capture
+ * task (`MicManager::getCaptureStats()`, printed when a recording starts and on disarm in
+ * `DEBUGMODE`). Arming needs DMA capture: polling would keep a core busy.
+ *
+ * The ring must hold `PRETRIGGER_MS` at `sample_rate` plus 4096 samples of headroom for the
+ * writer task to catch up; higher rates are refused (8 kHz fits the default ring, 16 kHz
+ * does not).
+ *
+ * @param sample_rate Rate of the recordings to come.
+ * @return true if armed; false if the rate does not fit the ring or capture failed.
+ */
+bool SpeakerManager::armRecording(int sample_rate) {
+    static_assert((uint64_t)PRETRIGGER_MS * SAMPLE_RATE / 1000 + 4096 <= RECORD_RING_SAMPLES,
+                  "RECORD_RING_SAMPLES must hold PRETRIGGER_MS and 4096 samples of headroom");
+    if (sample_rate <= 0 || (uint64_t)PRETRIGGER_MS * sample_rate / 1000 + 4096 > RECORD_RING_SAMPLES) {
+        if (DEBUGMODE) {
+            Serial.printf("SpeakerManager: %d Hz needs more than RECORD_RING_SAMPLES for the pre-trigger, not armed.\n", sample_rate);
+        }
+        return false; // The ring would fill before the writer task starts draining it
+    }
+    if (armed && armedSampleRate == sample_rate) {
+        return true;
+    }
+    disarmRecording();
+    armed = true;
+    armedSampleRate = sample_rate;
+    if (recording) {
+        return true; // Starts when the recording stops
+    }
+    if (!startPreTrigger()) {
+        armed = false;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Stops the pre-trigger capture; recordings start when they are called again.
+ */
+void SpeakerManager::disarmRecording() {
+    if (!armed) {
+        return;
+    }
+    armed = false;
+    if (recording) {
+        return; // The recording owns the capture, it is not restarted afterwards
+    }
+    MicManager::CaptureStats stats = micManager->getCaptureStats();
+    micManager->stopCapture();
     if (DEBUGMODE) {
-        Serial.println("SpeakerManager: Recording stopped.");
-    };
+        Serial.printf("SpeakerManager: Pre-trigger disarmed, capture CPU %u %%, %u samples held, %u bytes of ring\n",
+                      stats.cpuLoadPercent, stats.preTriggerSamples, (unsigned)(RECORD_RING_SAMPLES * sizeof(int16_t)));
     }
 }
 
 /**
- * @brief Periodically reads audio data and writes to the WAV file.
+ * @brief Returns true while the pre-trigger is armed.
+ */
+bool SpeakerManager::isArmed() {
+    return armed;
+}
+
+/**
+ * @brief Starts the capture that keeps the last `PRETRIGGER_MS` for the next recording.
  *
- * This method captures audio data from the microphone and writes the
- * data to the currently active WAV file. It should be called regularly
- * to ensure continuous recording.
+ * @return true if the capture runs; false if it failed or could only poll.
+ */
+bool SpeakerManager::startPreTrigger() {
+    if (!micManager->startCapture(armedSampleRate)) {
+        return false;
+    }
+    if (!micManager->getCaptureStats().dma) {
+        micManager->stopCapture();
+        if (DEBUGMODE) Serial.println("SpeakerManager: Pre-trigger needs DMA capture, not armed.");
+        return false;
+    }
+    micManager->setPreTrigger((size_t)PRETRIGGER_MS * armedSampleRate / 1000);
+    if (DEBUGMODE) {
+        Serial.printf("SpeakerManager: Pre-trigger armed, %u ms kept in a %u-byte ring\n",
+                      PRETRIGGER_MS, (unsigned)(RECORD_RING_SAMPLES * sizeof(int16_t)));
+    }
+    return true;
+}
+
+/**
+ * @brief Returns true once nobody has spoken for `VAD_STOP_MS` after the speech of a recording.
  *
- * The method reads the output from the microphone manager and converts 
- * the data into a format suitable for writing to the WAV file.
+ * Nothing more is written to the file after that; call `stopRecording()` to finalize it.
+ * `recordAudio()` does so on its own.
  */
-void SpeakerManager::recordAudio(const int duration_seconds, const char *file_name, const int sample_rate,String Folder) {
-    // Calculate total samples to record based on the recording length and sample rate
-    const int buffer_size = sample_rate * (duration_seconds / 1000); 
-    buffer = new short int[buffer_size]; // Allocate buffer for audio samples
-    int sampleIndex = 0; // To track the number of samples recorded
+bool SpeakerManager::silenceDetected() {
+    return silenceStop;
+}
+
+/**
+ * @brief Turns the recording noise suppressor on or off, from the next recording on.
+ *
+ * @param enabled true to suppress the microphone noise (the default).
+ */
+void SpeakerManager::setNoiseReduction(bool enabled) {
+    noiseReduction = enabled;
+}
+
+/**
+ * @brief Returns true while a recording is in progress.
+ */
+bool SpeakerManager::isRecording() {
+    return recording;
+}
+
+/**
+ * @brief Recording writer task.
+ *
+ * Wakes every `AUDIO_TASK_POLL_MS`, or when notified by `stopRecording()`, and appends
+ * every complete block in the capture ring to the WAV file. Once the recording stops
+ * it writes the remainder and closes the file, which patches the header.
+ *
+ * @param parameter A pointer to the SpeakerManager instance.
+ */
+void SpeakerManager::recordWriterTask(void* parameter) {
+    SpeakerManager* speaker = static_cast<SpeakerManager*>(parameter);
+    const size_t blockSamples = AUDIO_BLOCK_SIZE / sizeof(int16_t);
 
-    // Create the WAV file writer before starting the recording
-    wavfileWriter = new WAVFileWriter(file_name, CHANNEL, sample_rate, duration_seconds / 1000,Folder);
+    while (speaker->recording) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(AUDIO_TASK_POLL_MS));
+        speaker->drainRecordRing(blockSamples);
+    }
+
+    // Capture has stopped: write what is left and finalize the header
+    speaker->drainRecordRing(1);
+    if (speaker->denoiser) {
+        size_t tailCount;
+        int16_t* tail = speaker->denoiser->drain(tailCount); // Samples still in the suppressor
+        speaker->levelSamples(tail, tailCount, 0);
+        speaker->recordSamples(tail, tailCount);
+    }
+    if (speaker->recordHold && speaker->speechHeard) {
+        speaker->writeHeld(speaker->holdCount < speaker->tailSamples ? speaker->holdCount : speaker->tailSamples);
+    }
+    if (speaker->agc) {
+        // Gain steps in file positions, for speech recognition
+        speaker->wavfileWriter->setComment(speaker->agc->describe(speaker->leadDropped,
+                                                                  (uint32_t)speaker->wavfileWriter->getFramesWritten()));
+    }
+    speaker->wavfileWriter->close();
 
+    speaker->xRecordWriterTask = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Records audio from the microphone for a given time and saves it as a WAV file.
+ *
+ * Samples are streamed to the SD card while recording; this loop only watches the
+ * duration, the stop button and the end of speech (`silenceDetected()`). When the stop
+ * button is pressed the file is finalized before waiting for the button to be released.
+ *
+ * @param duration_seconds Recording length in milliseconds.
+ */
+void SpeakerManager::recordAudio(const int duration_seconds, const char *file_name, const int sample_rate,String Folder) {
     esp_task_wdt_reset();
-    unsigned long startTime = micros(); // Use micros for higher precision
-    unsigned long sampleInterval = 1000000 / sample_rate; // Calculate interval in microseconds
-    unsigned long nextSampleTime = startTime; // Initialize next sample time
+    if (!startRecording(file_name, sample_rate, Folder)) {
+        return;
+    }
+    unsigned long startTime = millis();
+    bool stopPressed = false;
 
     // Record audio for the specified duration
-    while (micros() - startTime < (duration_seconds * 1000)) {
+    while (millis() - startTime < (unsigned long)duration_seconds) {
         esp_task_wdt_reset();
 
-        // Check if it's time to read the next sample
-        if (micros() >= nextSampleTime) {
-            // Read microphone output values
-            if (sampleIndex < buffer_size) { // Ensure we don't exceed the buffer size
-                buffer[sampleIndex] = micManager->readOutput(); // Read sample from the microphone
-                sampleIndex++; // Move to the next sample index
-            }
-            // Update the time for the next sample
-            nextSampleTime += sampleInterval; 
-        };
+        if (silenceDetected()) {
+            break; // The child has stopped speaking
+        }
+
         // Check if the stop button is pressed
         if (!digitalRead(BUTTON_02_PIN)) {
             delay(50); // Adjusted debounce delay for better responsiveness
             Serial.println("Stop button pressed");
-            // Wait until button is released
-            while (!digitalRead(BUTTON_02_PIN)) {
-                delay(10); // Small delay to prevent rapid looping
-            }
+            stopPressed = true;
             break; // Exit the recording loop if button is pressed
         }
+
+        vTaskDelay(pdMS_TO_TICKS(AUDIO_TASK_POLL_MS)); // The capture and writer tasks keep running meanwhile
     };
 
+    stopRecording(); // Finalize the file right away
 
-    // Write the recorded samples to the WAV file
-    for(int i = 0; i< buffer_size; i++) wavfileWriter->writeFrame (buffer[i],buffer[i]); // Use a single function to write all frames
-    
-    wavfileWriter->close(); // Close the WAV file
-    delete[] buffer; // Free the allocated buffer
+    // Wait until button is released
+    while (stopPressed && !digitalRead(BUTTON_02_PIN)) {
+        delay(10); // Small delay to prevent rapid looping
+    }
     esp_task_wdt_reset();
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Writes buffered samples from the microphone capture ring to the WAV file writer.
+ *
+ * Samples are consumed in place from contiguous ring spans, so nothing is copied
+ * between the capture task and the writer. The noise suppressor and the AGC, when
+ * enabled, also work on the span in place before it is written.
+ *
+ * @param minSamples Minimum number of buffered samples before anything is written.
+ */
+void SpeakerManager::drainRecordRing(size_t minSamples) {
+    MicManager::CaptureRing& recordRing = micManager->captureRing();
+    while (recordRing.readAvailable() >= minSamples) {
+        size_t count = recordRing.capacity();
+        int16_t* span = recordRing.peek(count);
+        if (count == 0) {
+            break;
+        }
+        if (denoiser) {
+            denoiser->process(span, count); // In place, the span is ours until consumed
+        }
+        // A gain switch shows after the samples still in the ring, the suppressor and a DMA frame
+        size_t delay = recordRing.readAvailable() - count + MIC_FRAME_SAMPLES + (denoiser ? denoiser->latency() : 0);
+        levelSamples(span, count, delay);
+        recordSamples(span, count);
+        recordRing.consume(count);
+    }
+}
+
+/**
+ * @brief Runs captured samples through the AGC and switches the microphone gain when it asks.
+ *
+ * @param samples Mono samples, scaled in place.
+ * @param count Number of samples.
+ * @param delay Samples between the end of the block and the first one captured after a switch.
+ */
+void SpeakerManager::levelSamples(int16_t* samples, size_t count, size_t delay) {
+    if (!agc) {
+        return;
+    }
+    bool speech = recordHold ? voice->isSpeech() : true; // Without the detector, the AGC gate alone
+    if (agc->process(samples, count, speech, delay)) {
+        micManager->setGain(agc->getLevel());
+    }
+}
+
+/**
+ * @brief Writes captured samples to the WAV file, holding back silence.
+ *
+ * Without trimming every sample is written. With it, samples go through the voice detector:
+ * before the first speech only the last `VAD_PREROLL_MS` are held (the pre-roll that covers
+ * the onset of the first word); during speech and its hangover samples are written, after
+ * the held ones; after speech they are held, and written as a pause if speech resumes. Once
+ * the hold is full, `VAD_STOP_MS` of silence, the recording is over and nothing more is
+ * written; the writer task keeps the first `VAD_TAIL_MS` of the hold when it closes the file.
+ *
+ * @param samples Mono samples.
+ * @param count Number of samples.
+ */
+void SpeakerManager::recordSamples(const int16_t* samples, size_t count) {
+    if (!recordHold) {
+        wavfileWriter->writeFrames(samples, samples, count); // Mono capture, duplicated in stereo files
+        return;
+    }
+    while (count > 0 && !silenceStop) {
+        size_t n = voice->process(samples, count);
+        if (voice->isSpeech()) {
+            if (holdCount > 0) {
+                writeHeld(holdCount); // Pre-roll, or the pause since the last word
+            }
+            speechHeard = true;
+            wavfileWriter->writeFrames(samples, samples, n);
+        } else {
+            holdSamples(samples, n);
+            if (speechHeard && holdCount == holdCapacity) {
+                silenceStop = true;
+                if (DEBUGMODE) Serial.println("SpeakerManager: Speech ended, recording can stop.");
+            }
+        }
+        samples += n;
+        count -= n;
+    }
+}
+
+/**
+ * @brief Appends samples to the held silence.
+ *
+ * Before the first speech the hold keeps only the newest `VAD_PREROLL_MS`; after it, samples
+ * beyond its capacity are dropped, since the recording stops there anyway.
+ */
+void SpeakerManager::holdSamples(const int16_t* samples, size_t count) {
+    size_t limit = speechHeard ? holdCapacity : prerollSamples;
+    if (count > limit) {
+        if (!speechHeard) leadDropped += count - limit;
+        samples += count - limit; // Only the newest fit
+        count = limit;
+    }
+    if (holdCount + count > limit) {
+        if (speechHeard) {
+            count = limit - holdCount;
+        } else {
+            size_t drop = holdCount + count - limit; // Slide the pre-roll window
+            holdStart = (holdStart + drop) % holdCapacity;
+            holdCount -= drop;
+            leadDropped += drop;
+        }
+    }
+    size_t end = (holdStart + holdCount) % holdCapacity;
+    size_t first = count < holdCapacity - end ? count : holdCapacity - end;
+    memcpy(recordHold + end, samples, first * sizeof(int16_t));
+    memcpy(recordHold, samples + first, (count - first) * sizeof(int16_t));
+    holdCount += count;
+}
+
+/**
+ * @brief Writes the oldest held samples to the WAV file and empties the hold.
+ *
+ * @param count Number of held samples to write, the rest is dropped.
+ */
+void SpeakerManager::writeHeld(size_t count) {
+    size_t first = count < holdCapacity - holdStart ? count : holdCapacity - holdStart;
+    wavfileWriter->writeFrames(recordHold + holdStart, recordHold + holdStart, first);
+    if (count > first) {
+        wavfileWriter->writeFrames(recordHold, recordHold, count - first);
+    }
+    holdStart = 0;
+    holdCount = 0;
+}
@@ -9,6 +9,15 @@
 #include "WAVFileReader.h"
 #include "WAVFileWriter.h"
 #include "MicManager.h"
+#include "PromptPlayer.h"
+#include "ConfigManager.h"
+#include "LoudnessScanner.h"
+#include "NoiseSuppressor.h"
+#include "VoiceDetector.h"
+#include "AutoGain.h"
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_heap_caps.h>
 
 /**
  * @class SpeakerManager
@@ -21,18 +30,52 @@
  * features in your ESP32 applications.
  *
  * Key functionalities include:
- * - Audio Playback: Start, stop, pause, and resume playback of WAV audio files.
+ * - Audio Playback: Start, stop, pause, and resume playback of WAV audio files through one
+ *   long-lived `I2SManager` output engine that is installed once in `begin()`.
+ * - Playback Queue: Enqueue the segments of a story; a sequencer task opens segment N+1 while
+ *   segment N plays and starts it the moment N has queued its last sample, so segments are
+ *   spliced back to back in the playback ring with no silence in between.
+ * - Resume: Segments can start at any position, and `positionMs()`/`seekMs()` report and move
+ *   the position being heard, so a story can be resumed where it was left.
+ * - Read-Ahead: Segments are read several seconds ahead into a PSRAM `PrefetchCache`, so SD
+ *   card stalls do not reach the playback ring.
  * - Volume Control: Set and manage playback volume levels.
- * - Audio Recording: Record audio from a microphone and save it in WAV format.
- * - Noise Reduction: Implement basic noise reduction algorithms on recorded audio samples.
+ * - Loudness Normalization: A background `LoudnessScanner` measures every file on the card in
+ *   idle time; each segment is then brought to `LOUDNESS_TARGET_LUFS` from its sidecar, with no
+ *   analysis when it plays.
+ * - Dynamics: A look-ahead compressor and limiter evens out stories, responses and recordings
+ *   and keeps peaks below what the speaker handles; its settings are saved in the configuration.
+ * - Sound Effects: Preload short effects into RAM and layer them over the narration; the
+ *   narration is ducked while they play.
+ * - Audio Recording: Record audio from a microphone and stream it to a WAV file. A background
+ *   writer task appends captured blocks to the SD card while recording, so memory use does not
+ *   grow with the recording length, and the header is patched when the recording stops.
+ * - Silence Trimming: A `VoiceDetector` on the writer task drops the silence before the first
+ *   word and after the last one, and ends `recordAudio()` once nobody has spoken for
+ *   `VAD_STOP_MS`.
+ * - Noise Reduction: The writer task runs each captured block through a `NoiseSuppressor`,
+ *   which learns the microphone hiss from the first `NOISE_LEARN_MS` of the recording and
+ *   subtracts it spectrally, in place in the capture ring.
+ * - Automatic Gain: An `AutoGain` on the writer task switches the hardware gain of the
+ *   microphone and fills the steps between levels digitally, so quiet and loud children are
+ *   recorded at the same level. Its steps are logged in the comment of the WAV file.
+ * - Pre-trigger: `armRecording()` keeps the microphone capturing between recordings, with the
+ *   last `PRETRIGGER_MS` in the capture ring. A recording takes the ring over in place, so the
+ *   file starts before the call and includes the first syllable.
  *
  * ## Example Usage:
  *
  * ```cpp
- * SpeakerManager speakerManager(&wavReader, &wavWriter, &micManager, &i2sPins, &i2sManager);
+ * SpeakerManager speakerManager(&wavReader, &wavWriter, &micManager, &i2sPins, &i2sManager, &configManager);
  * speakerManager.begin();
  * speakerManager.startPlayback("audio.wav");
- * speakerManager.startRecording();
+ * speakerManager.enqueue("/Stories/Cendrillon/2.wav");
+ * uint32_t resumeAt = speakerManager.positionMs(); // Later: startPlayback(path, resumeAt)
+ * int chime = speakerManager.loadEffect("/Sounds/chime.wav");
+ * speakerManager.playEffect(chime, 80);
+ * speakerManager.setDynamics(-12, 2, 150); // Threshold dBFS, attack and release ms
+ * speakerManager.startRecording("Recording1", 16000, "/WebRecording");
+ * speakerManager.stopRecording();
  * ```
  *
  * ## Dependencies:
@@ -53,33 +96,110 @@ public:
         WAVFileWriter* wavfileWriter,
         MicManager* micManager,
         i2s_pin_config_t* i2sPins,
-        I2SManager* i2SManager);
+        I2SManager* i2SManager,
+        ConfigManager* configManager = nullptr);
     
     // Initialize the Speaker Manager
     void begin();
 
     // Playback control
-    void startPlayback(const char *file_name);
+    void startPlayback(const char *file_name, uint32_t startMs = 0);
     void stopPlayback();
     void pausePlayback();
     void resumePlayback();
     void setVolume(int volume);
+    void setDynamics(int thresholdDb, int attackMs, int releaseMs); // Tune and save the output compressor
+    bool seekMs(uint32_t ms);             // Jump within the current segment
+    uint32_t positionMs();                // Position being heard in the current segment
+
+    // Playback queue
+    bool enqueue(const char *file_name, uint32_t startMs = 0); // Append a segment to the playback queue
+    void skip();                          // Stop the current segment and continue with the next one
+    void clearQueue();                    // Drop every segment that has not started yet
+    size_t queueLength();                 // Number of segments waiting to start
+
+    // Sound effects
+    int loadEffect(const char *file_name);  // Decode a short effect into RAM, returns its id or -1
+    bool playEffect(int effect, int volume = 100); // Layer a loaded effect over the narration
+    void stopEffects();                   // Silence every playing effect
+    void unloadEffects();                 // Stop the effects and free their memory
+
+    // Flash prompts
+    bool playPrompt(int prompt, int volume = 100); // Layer a prompt from the flash bank, by Prompt:: id
+    bool playPrompt(const char *name, int volume = 100); // Layer a prompt from the flash bank, by name
+
+    // Read-ahead
+    PrefetchCache::Stats getPrefetchStats(); // Hits, misses and fill latency of the PSRAM cache
+
+    // Loudness normalization
+    LoudnessScanner::Stats getLoudnessStats(); // Files measured by the background job and its rate
 
     // Recording control
-    void startRecording();
-    void stopRecording();
+    bool startRecording(const char *file_name, int sample_rate, String Folder); // Start streaming a recording to SD
+    void stopRecording();               // Stop capture, flush the ring and finalize the WAV file
+    bool isRecording();                 // Recording in progress
+    void setNoiseReduction(bool enabled); // Run the noise suppressor on the next recordings
+    void setVoiceDetection(bool enabled); // Trim silence and stop on silence in the next recordings
+    void setAutoGain(bool enabled);     // Run the microphone AGC in the next recordings
+    bool armRecording(int sample_rate = SAMPLE_RATE); // Keep the last PRETRIGGER_MS captured for the next recordings
+    void disarmRecording();             // Stop the pre-trigger capture
+    bool isArmed();                     // Pre-trigger armed
+    bool silenceDetected();             // No speech for VAD_STOP_MS after speech, time to stop
     void recordAudio(const int duration_seconds, const char *file_name, const int sample_rate, String Folder);
 
 private:
+    struct PlaybackItem {
+        char path[PLAYBACK_PATH_MAX];   // Path of the segment
+        uint32_t startMs;               // Position to start at
+    };
+
     int currentVolume;                  // Current volume level
-    I2SManager* i2SManager;             // Pointer to I2S output object
+    ConfigManager* configManager;       // Persists the compressor settings, or nullptr
+    I2SManager* i2SManager;             // Long-lived I2S output engine shared by every track
     WAVFileReader* wavfileReader;       // Pointer to WAV file reader object
+    WAVFileReader* nextReader;          // Next segment, opened while the current one plays
+    PrefetchCache* prefetch;            // PSRAM read-ahead shared by the segments, nullptr without PSRAM
+    LoudnessScanner* loudness;          // Measures the files on the card in idle time, or nullptr
+    QueueHandle_t playQueue;            // Segments waiting to start, as PlaybackItem
+    SemaphoreHandle_t playbackMutex;    // Guards the reader pointers against the sequencer task
+    TaskHandle_t xSequencerTask;        // Task handle for the playback sequencer
+    static void sequencerTask(void* parameter); // FreeRTOS task chaining queued segments
+    void sequencerStep();               // Prepare and splice queued segments
+    void releaseReaders();              // Stop and delete the current and next readers
+    AudioMixer::Sound effects[MIXER_EFFECT_SLOTS]; // Preloaded sound effects
+    int effectCount;                    // Effects loaded in `effects`
+    PromptPlayer* prompts;              // Prompt bank mapped from flash
+    bool startedPrompt(int voice);      // Resume the output for a prompt voice
     WAVFileWriter* wavfileWriter;       // Pointer to WAV file writer object
     bool isPaused;                      // Playback pause state
     i2s_pin_config_t* i2sPins;          // I2S pin configuration structure
     MicManager* micManager;             // Pointer to the MicManager for audio input
-    short int* buffer;                  // Buffer for audio samples
-    short int applyNoiseReduction(short int sample, short int* noiseBuffer, int noiseSize); // Noise reduction function
+    void drainRecordRing(size_t minSamples); // Write captured samples to the WAV file writer
+    void levelSamples(int16_t* samples, size_t count, size_t delay); // Run the AGC and switch the microphone gain
+    volatile bool recording;            // Cleared by stopRecording() once capture has stopped
+    TaskHandle_t xRecordWriterTask;     // Task handle for the recording writer task
+    static void recordWriterTask(void* parameter); // FreeRTOS task appending captured blocks to SD
+    NoiseSuppressor* denoiser;          // Noise suppressor of the recording in progress, or nullptr
+    bool noiseReduction;                // Set by setNoiseReduction()
+    VoiceDetector* voice;               // Voice detector, kept between recordings, or nullptr
+    bool voiceDetection;                // Set by setVoiceDetection()
+    int16_t* recordHold;                // Silence held back until speech resumes, nullptr when not trimming
+    size_t holdCapacity;                // Samples recordHold can take, VAD_STOP_MS worth
+    size_t holdStart;                   // Oldest held sample
+    size_t holdCount;                   // Samples held
+    size_t prerollSamples;              // VAD_PREROLL_MS worth of samples
+    size_t tailSamples;                 // VAD_TAIL_MS worth of samples
+    bool speechHeard;                   // Speech has started in this recording
+    volatile bool silenceStop;          // Set by the writer task after VAD_STOP_MS of silence
+    uint32_t leadDropped;               // Samples dropped before the first speech, not in the file
+    AutoGain* agc;                      // Microphone AGC, kept between recordings, or nullptr
+    bool autoGain;                      // Set by setAutoGain()
+    bool armed;                         // Set by armRecording(), cleared by disarmRecording()
+    int armedSampleRate;                // Rate of the pre-trigger capture
+    bool startPreTrigger();             // Start capture keeping the last PRETRIGGER_MS in the ring
+    void recordSamples(const int16_t* samples, size_t count); // Write or hold captured samples by voice activity
+    void holdSamples(const int16_t* samples, size_t count); // Add samples to the held silence
+    void writeHeld(size_t count);       // Write the oldest held samples and empty the hold
 };
 
 #endif // SPEAKER_MANAGER_H
@@ -0,0 +1,266 @@
+#include "VoiceDetector.h"
+#include <esp_timer.h>
+#include <math.h>
+
+/**
+ * @brief Constructor, converts the thresholds of Config.h and starts at `SAMPLE_RATE`.
+ */
+VoiceDetector::VoiceDetector() {
+    m_energyRatio = (uint32_t)(256.0f * powf(10.0f, VAD_ENERGY_DB / 10.0f));
+    m_strongRatio = (uint32_t)(256.0f * powf(10.0f, VAD_STRONG_DB / 10.0f));
+    reset(SAMPLE_RATE);
+}
+
+/**
+ * @brief Starts a new stream: silence, no noise floor yet.
+ *
+ * @param sampleRate Rate of the stream, sets the frame length and the zero-crossing limit.
+ */
+void VoiceDetector::reset(uint32_t sampleRate) {
+    m_frameSamples = sampleRate * VAD_FRAME_MS / 1000;
+    if (m_frameSamples == 0) {
+        m_frameSamples = 1;
+    }
+    m_zcrMax = (uint32_t)((uint64_t)VAD_ZCR_MAX_HZ * 2 * m_frameSamples / sampleRate); // Two crossings per period
+    m_hangoverFrames = VAD_HANGOVER_MS / VAD_FRAME_MS;
+    m_fill = 0;
+    m_energy = 0;
+    m_crossings = 0;
+    m_negative = false;
+    m_floor = 0;
+    m_floorSet = false;
+    m_run = 0;
+    m_hangLeft = 0;
+    m_speech = false;
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+/**
+ * @brief Analyses samples up to the end of the current frame.
+ *
+ * @param samples Mono 16-bit samples.
+ * @param count Number of samples available.
+ * @return The number of samples taken, at most what completes the frame. `isSpeech()` is
+ *         updated when the frame completes.
+ */
+size_t VoiceDetector::process(const int16_t* samples, size_t count) {
+    size_t n = m_frameSamples - m_fill;
+    if (n > count) {
+        n = count;
+    }
+    uint64_t energy = 0;
+    uint32_t crossings = 0;
+    bool negative = m_negative;
+    for (size_t i = 0; i < n; i++) {
+        int32_t x = samples[i];
+        energy += (uint32_t)(x * x);
+        bool sign = x < 0;
+        crossings += sign != negative;
+        negative = sign;
+    }
+    m_energy += energy;
+    m_crossings += crossings;
+    m_negative = negative;
+    m_fill += n;
+    if (m_fill == m_frameSamples) {
+        completeFrame();
+    }
+    return n;
+}
+
+/**
+ * @brief Classifies the completed frame, then updates the speech state and the noise floor.
+ */
+void VoiceDetector::completeFrame() {
+    uint64_t meanSquare = (m_energy << 8) / m_frameSamples; // Q8
+    if (!m_floorSet) {
+        m_floor = meanSquare;
+        m_floorSet = true;
+    }
+    uint64_t floor = m_floor > 256 ? m_floor : 256; // Never below one LSB of noise
+    bool strong = meanSquare * 256 > floor * m_strongRatio;
+    bool loud = meanSquare * 256 > floor * m_energyRatio;
+    bool voiced = strong || (loud && m_crossings <= m_zcrMax);
+
+    if (voiced) {
+        m_run++;
+        if (m_speech || m_run >= VAD_ONSET_FRAMES) {
+            if (!m_speech) {
+                m_stats.onsets++;
+            }
+            m_speech = true;
+            m_hangLeft = m_hangoverFrames;
+        }
+        m_floor += (meanSquare - m_floor) >> (VAD_FLOOR_SHIFT + 5); // Creeps towards a lasting background
+    } else {
+        m_run = 0;
+        if (m_speech) {
+            if (m_hangLeft > 0) {
+                m_hangLeft--;
+            } else {
+                m_speech = false;
+            }
+        }
+        if (meanSquare < m_floor) {
+            m_floor -= (m_floor - meanSquare) >> 2;
+        } else if (meanSquare < floor * 2) {
+            m_floor += (meanSquare - m_floor) >> VAD_FLOOR_SHIFT; // Only frames within 3 dB, not the rise of a word
+        }
+    }
+
+    m_stats.frames++;
+    if (m_speech) {
+        m_stats.speechFrames++;
+    }
+    m_energy = 0;
+    m_crossings = 0;
+    m_fill = 0;
+}
+
+/**
+ * @brief Returns the decision of the last complete frame, true during speech and its hangover.
+ */
+bool VoiceDetector::isSpeech() {
+    return m_speech;
+}
+
+/**
+ * @brief Returns the number of samples per frame, `VAD_FRAME_MS` at the rate of the stream.
+ */
+size_t VoiceDetector::frameSamples() {
+    return m_frameSamples;
+}
+
+/**
+ * @brief Returns the frame counts since `reset()`.
+ */
+VoiceDetector::Stats VoiceDetector::getStats() {
+    return m_stats;
+}
+
+/**
+ * @brief Prints the accuracy on a labelled synthetic recording and the cost of a frame.
+ *
+ * The recording at `SAMPLE_RATE` is white background noise with voiced syllables (a 180 Hz
+ * harmonic series under a raised-sine envelope) 25 dB and 12 dB above it and a fricative
+ * (high-passed noise). A frame is scored against its label extended by `VAD_HANGOVER_MS`
+ * after each speech segment, which is the designed behaviour; the first `VAD_ONSET_FRAMES`
+ * of each segment are not scored (the recording keeps a pre-roll for them).
+ */
+void VoiceDetector::benchmark() {
+    struct Segment {
+        uint16_t ms;                    // Length
+        uint8_t kind;                   // 0 silence, 1 voiced, 2 quiet voiced, 3 fricative
+    };
+    const Segment script[] = {
+        { 500, 0 }, { 400, 1 }, { 500, 0 }, { 150, 3 }, { 300, 1 }, { 800, 0 },
+        { 250, 1 }, { 120, 0 }, { 250, 1 }, { 900, 0 }, { 400, 2 }, { 700, 0 }, { 200, 3 }, { 600, 0 },
+    };
+    const uint32_t rate = SAMPLE_RATE;
+    VoiceDetector* vad = new VoiceDetector();
+    int16_t* frame = new int16_t[MIC_FRAME_SAMPLES];
+    if (!vad || !frame) {
+        delete vad;
+        delete[] frame;
+        return;
+    }
+
+    const float pi = 3.14159265f;
+    const size_t frameSamples = vad->frameSamples();
+    const size_t hangover = (size_t)VAD_HANGOVER_MS * rate / 1000;
+    uint32_t seed = 12345;
+    int32_t previousNoise = 0;
+    uint32_t scored = 0, correct = 0, missed = 0, falseAlarms = 0;
+    int64_t busyUs = 0;
+    size_t speechStart = 0;                             // Sample the current speech segment started at
+    size_t speechEnd = 0;                               // Sample after the last speech segment ended
+    bool inSpeech = false;
+    size_t position = 0;
+    size_t segmentLeft = 0;
+    size_t segmentLength = 0;
+    size_t index = 0;
+    uint8_t kind = 0;
+
+    while (index < sizeof(script) / sizeof(script[0]) || segmentLeft > 0) {
+        // Synthesize one capture frame, segment by segment
+        for (size_t i = 0; i < MIC_FRAME_SAMPLES; i++) {
+            if (segmentLeft == 0) {
+                if (index == sizeof(script) / sizeof(script[0])) {
+                    frame[i] = 0; // Past the end of the script
+                    if (inSpeech) speechEnd = position + i;
+                    inSpeech = false;
+                    continue;
+                }
+                kind = script[index].kind;
+                segmentLength = segmentLeft = (size_t)script[index].ms * rate / 1000;
+                index++;
+            }
+            size_t t = segmentLength - segmentLeft--;
+            seed = seed * 1664525UL + 1013904223UL;
+            int32_t noise = (int16_t)(seed >> 16) / 300; // Background, about -50 dBFS
+            float v = (float)noise;
+            if (kind == 1 || kind == 2) {
+                float envelope = sinf(pi * t / segmentLength);
+                float amplitude = (kind == 1 ? 1800.0f : 400.0f) * envelope;
+                for (int h = 1; h <= 5; h++) {
+                    v += amplitude / h * sinf(2.0f * pi * 180.0f * h * (position + i) / rate);
+                }
+            } else if (kind == 3) {
+                seed = seed * 1664525UL + 1013904223UL;
+                int32_t hiss = (int16_t)(seed >> 16) / 16;
+                v += (float)(hiss - previousNoise); // First difference: high-passed noise
+                previousNoise = hiss;
+            }
+            frame[i] = (int16_t)v;
+
+            // Label of this sample, for scoring at frame ends
+            bool speech = kind != 0;
+            if (speech && !inSpeech) speechStart = position + i;
+            if (!speech && inSpeech) speechEnd = position + i;
+            inSpeech = speech;
+        }
+
+        // Detect, scoring the decision at the end of every analysis frame
+        size_t done = 0;
+        while (done < MIC_FRAME_SAMPLES) {
+            int64_t start = esp_timer_get_time();
+            size_t taken = vad->process(frame + done, MIC_FRAME_SAMPLES - done);
+            busyUs += esp_timer_get_time() - start;
+            done += taken;
+            size_t sample = position + done;
+            if (sample % frameSamples != 0) {
+                continue; // Frame not complete yet
+            }
+            bool truth = inSpeech || (speechEnd > 0 && sample <= speechEnd + hangover);
+            bool onset = inSpeech && sample < speechStart + (VAD_ONSET_FRAMES + 1) * frameSamples;
+            if (onset) {
+                continue;
+            }
+            scored++;
+            if (vad->isSpeech() == truth) {
+                correct++;
+            } else if (truth) {
+                missed++;
+            } else {
+                falseAlarms++;
+            }
+        }
+        position += MIC_FRAME_SAMPLES;
+    }
+
+    uint32_t utterances = 0; // Speech after silence longer than the hangover
+    for (size_t i = 0; i < sizeof(script) / sizeof(script[0]); i++) {
+        if (script[i].kind != 0 && (i == 0 || (script[i - 1].kind == 0 && script[i - 1].ms > VAD_HANGOVER_MS))) {
+            utterances++;
+        }
+    }
+    Stats stats = vad->getStats();
+    delete vad;
+    delete[] frame;
+
+    uint32_t nsPerFrame = (uint32_t)(busyUs * 1000 / (stats.frames > 0 ? stats.frames : 1));
+    Serial.printf("VoiceDetector: %u/%u frames right (%u.%u%%), %u missed, %u false, %u onsets (%u spoken), "
+                  "%u ns per %u-sample frame\n",
+                  correct, scored, correct * 1000 / (scored ? scored : 1) / 10, correct * 1000 / (scored ? scored : 1) % 10,
+                  missed, falseAlarms, stats.onsets, utterances, nsPerFrame, (unsigned)frameSamples);
+}
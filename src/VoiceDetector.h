@@ -0,0 +1,82 @@
+#ifndef VOICE_DETECTOR_H
+#define VOICE_DETECTOR_H
+
+#include <Arduino.h>
+#include "Config.h"
+
+/**
+ * @file VoiceDetector.h
+ * @brief Streaming voice activity detector for the microphone recordings.
+ *
+ * Recordings run until the button is pressed or `RECORDING_LENGTH` is reached, so most of a
+ * file used to be silence. The recording writer task feeds every captured sample through a
+ * `VoiceDetector` and uses its decision to drop the silence before the first word and after
+ * the last one, and to end the recording once the child has stopped speaking.
+ *
+ * The stream is cut into frames of `VAD_FRAME_MS`. For each frame the detector sums the
+ * squared samples and counts the zero crossings, then compares them with the noise floor:
+ * - a frame `VAD_STRONG_DB` above the floor is speech;
+ * - a frame `VAD_ENERGY_DB` above the floor is speech if its zero-crossing rate stays below
+ *   `VAD_ZCR_MAX_HZ`, which tells voiced sounds from hiss and clicks;
+ * - speech starts after `VAD_ONSET_FRAMES` such frames in a row, and ends `VAD_HANGOVER_MS`
+ *   after the last one, so word endings and short pauses are kept.
+ *
+ * The noise floor starts at the first frame and follows the frames that are not speech:
+ * quickly down, and up by 2^-`VAD_FLOOR_SHIFT` from frames within 3 dB of it, so the slow
+ * rise of a word is not mistaken for background. During speech it only creeps up, so a
+ * lasting change of background is learnt in a few seconds. Everything is integer math: one multiply
+ * and add per sample and a few compares per frame.
+ *
+ * `benchmark()` runs a labelled synthetic recording (background noise, voiced syllables at two
+ * levels, a fricative) through a private instance and prints the frame accuracy, the misses
+ * and false alarms, and the cost per frame.
+ *
+ * ## Example:
+ * ```cpp
+ * VoiceDetector vad;
+ * vad.reset(SAMPLE_RATE);
+ * while (count > 0) {
+ *     size_t taken = vad.process(samples, count); // Up to the end of the current frame
+ *     route(samples, taken, vad.isSpeech());
+ *     samples += taken;
+ *     count -= taken;
+ * }
+ * ```
+ */
+
+class VoiceDetector {
+public:
+    struct Stats {
+        uint32_t frames;                // Frames analysed since reset()
+        uint32_t speechFrames;          // Frames that were speech (hangover included)
+        uint32_t onsets;                // Times speech started
+    };
+
+    VoiceDetector();
+    void reset(uint32_t sampleRate);    // Start a new stream, the next frame seeds the noise floor
+    size_t process(const int16_t* samples, size_t count); // Analyse up to the end of the frame, returns samples taken
+    bool isSpeech();                    // Decision of the last complete frame, hangover included
+    size_t frameSamples();              // Samples per frame at the current rate
+    Stats getStats();                   // Frame counts
+    static void benchmark();            // Print the accuracy on a labelled signal and the cost
+
+private:
+    void completeFrame();               // Classify the frame and update the state
+    size_t m_frameSamples;              // Samples per frame
+    size_t m_fill;                      // Samples of the current frame so far
+    uint64_t m_energy;                  // Sum of squares of the current frame
+    uint32_t m_crossings;               // Zero crossings in the current frame
+    bool m_negative;                    // Sign of the previous sample
+    uint64_t m_floor;                   // Noise floor, mean square Q8
+    bool m_floorSet;                    // The first frame has seeded the floor
+    uint32_t m_zcrMax;                  // VAD_ZCR_MAX_HZ as crossings per frame
+    uint32_t m_energyRatio;             // VAD_ENERGY_DB as a Q8 power ratio
+    uint32_t m_strongRatio;             // VAD_STRONG_DB as a Q8 power ratio
+    uint32_t m_hangoverFrames;          // VAD_HANGOVER_MS in frames
+    uint32_t m_run;                     // Consecutive speech frames
+    uint32_t m_hangLeft;                // Frames left before speech ends
+    bool m_speech;                      // Current decision
+    Stats m_stats;                      // Counters
+};
+
+#endif // VOICE_DETECTOR_H
@@ -1,14 +1,21 @@
 #include "WAVFileReader.h"
 #include "Config.h"
+#include <esp_timer.h>
 
 /**
  * @brief Constructor to initialize the WAV file reader.
  * 
  * @param file_name The name of the WAV file to be read.
- * @param i2sPins The pin configuration for I2S output.
+ * @param i2sOutput The shared I2S output engine the samples are queued to.
+ * @param prefetch The shared read-ahead cache, or nullptr to read from the SD card only.
  */
-WAVFileReader::WAVFileReader(const char* file_name, i2s_pin_config_t i2sPins) 
-    : m_i2sPins(i2sPins), m_currentPos(0), m_playbackState(STOPPED), xPlaybackTask(NULL) {
+WAVFileReader::WAVFileReader(const char* file_name, I2SManager* i2sOutput, PrefetchCache* prefetch) 
+    : m_dataSize(0), m_currentPos(0), m_dataOffset(sizeof(wav_header_)), m_codec(CODEC_PCM),
+      m_codecInput(nullptr), m_codecOutput(nullptr), m_convertOutput(nullptr), m_carry(0),
+      m_path(file_name), m_indexPath(String(file_name) + SEEK_INDEX_EXTENSION), m_framePos(0), m_skipFrames(0),
+      m_trackGain(GAIN_UNITY), m_i2sOutput(i2sOutput), m_prefetch(prefetch), m_prefetchStream(-1), xReaderTask(NULL),
+      m_readerRunning(false), m_playbackState(STOPPED), xSemaphore(NULL) {
+    memset(&m_info, 0, sizeof(m_info));
 
     // Attempt to open the WAV file
     m_file = SD.open(file_name);
@@ -29,15 +36,25 @@ WAVFileReader::WAVFileReader(const char* file_name, i2s_pin_config_t i2sPins)
  */
 WAVFileReader::~WAVFileReader() {
     stopPlayback(); // Ensure playback is stopped before cleanup
+    if (m_prefetch) {
+        m_prefetch->detach(m_prefetchStream); // Its cached blocks stay for a replay
+    }
     if (m_file) {
         m_file.close(); // Close the WAV file if it is open
     }
-    delete m_i2sOutput; // Clean up I2SOutput if allocated
+    if (xSemaphore) vSemaphoreDelete(xSemaphore);
+    delete[] m_codecInput;
+    delete[] m_codecOutput;
+    delete[] m_convertOutput;
 }
 
 /**
  * @brief Open the WAV file and read the header.
  * 
+ * Selects the decode stage from the format tag: linear PCM is played as is (or
+ * converted from 8/24/32 bits) and IMA-ADPCM is decoded block by block. MP3 streams, which have no RIFF header,
+ * are recognised by their first bytes and decoded frame by frame.
+ * 
  * @return true if the WAV file was opened successfully; false otherwise.
  */
 bool WAVFileReader::open() {
@@ -46,8 +63,20 @@ bool WAVFileReader::open() {
         return false; // Ensure the file is open before reading
     }
 
-    // Read the WAV header
-    if (m_file.read((uint8_t*)&m_header, sizeof(m_header)) != sizeof(m_header)) {
+    if (!m_i2sOutput) {
+        Serial.println("No I2S output to play to.");
+        return false; // The output engine is owned by SpeakerManager
+    }
+
+    loadTrackGain(); // Measured in idle time by the LoudnessScanner, nothing is scanned here
+
+    // MP3 responses carry their format in the frame headers
+    if (isMp3Stream()) {
+        return openMp3() && attachPrefetch();
+    }
+
+    // Read the WAV header and find the audio data
+    if (!readHeader()) {
         Serial.println("Failed to read WAV header.");
         return false; // Ensure the header is read successfully
     }
@@ -55,83 +84,592 @@ bool WAVFileReader::open() {
     m_dataSize = m_header.dlength; // Set data size from header
     m_currentPos = 0; // Reset current position
 
-    // Initialize I2SOutput with the sample rate
-    m_i2sOutput = new I2SManager(m_i2sPins, m_header.srate);
-    if (!m_i2sOutput) {
-        Serial.println("Failed to initialize I2S output.");
-        return false; // Ensure I2SOutput is initialized successfully
+    // Select the decode stage
+    switch ((uint16_t)m_header.format_tag) {
+        case WAVE_FORMAT_PCM:
+        case 0xFFFE: // WAVE_FORMAT_EXTENSIBLE, treated as PCM
+            m_codec = CODEC_PCM;
+            if (m_header.num_chans <= 0 ||
+                m_header.bytes_per_samp != m_header.num_chans * (m_header.bits_per_samp / 8)) {
+                Serial.println("Inconsistent PCM block alignment.");
+                return false;
+            }
+            break;
+        case WAVE_FORMAT_IMA_ADPCM:
+            m_codec = CODEC_IMA_ADPCM;
+            if (!m_adpcm.begin(m_header.num_chans, m_header.bytes_per_samp)) {
+                return false; // bytes_per_samp holds the block size for ADPCM
+            }
+            delete[] m_codecInput;
+            delete[] m_codecOutput;
+            m_codecInput = new uint8_t[m_header.bytes_per_samp];
+            m_codecOutput = new int16_t[m_adpcm.framesPerBlock() * m_header.num_chans];
+            break;
+        default:
+            Serial.print("Unsupported WAV format tag ");
+            Serial.println(m_header.format_tag);
+            return false;
+    }
+
+    return setupOutput() && attachPrefetch(); // Return true if successful
+}
+
+/**
+ * @brief Start reading the audio data ahead into the prefetch cache, if there is one.
+ * 
+ * The window is sized from the byte rate of the file; MP3 streams assume
+ * `PREFETCH_MP3_BYTE_RATE`. Playback works the same without the cache.
+ * 
+ * @return Always true, so it can end `open()`.
+ */
+bool WAVFileReader::attachPrefetch() {
+    if (m_prefetch && m_prefetchStream < 0) {
+        uint32_t byteRate = m_codec == CODEC_MP3 ? PREFETCH_MP3_BYTE_RATE : (uint32_t)m_header.bytes_per_sec;
+        m_prefetchStream = m_prefetch->attach(m_path.c_str(), m_dataOffset, m_dataOffset + m_dataSize, byteRate);
     }
-    m_i2sOutput->begin(); // Start I2S output
+    return true;
+}
 
-    return true; // Return true if successful
+/**
+ * @brief Check whether the file starts like an MP3 stream (ID3v2 tag or frame sync).
+ */
+bool WAVFileReader::isMp3Stream() {
+    uint8_t magic[3] = {0, 0, 0};
+    m_file.seek(0);
+    size_t length = m_file.read(magic, sizeof(magic));
+    m_file.seek(0);
+    if (length != sizeof(magic)) {
+        return false;
+    }
+    return memcmp(magic, "ID3", 3) == 0 || (magic[0] == 0xFF && (magic[1] & 0xE0) == 0xE0);
 }
 
 /**
- * @brief Playback task implementation.
+ * @brief Prepare an MP3 stream for playback.
+ * 
+ * Skips an ID3v2 tag, fills the decoder input and parses the first frame header
+ * to fill in the sample rate and channel count of `m_header`, so the rest of the
+ * playback path treats the stream like any other file.
  * 
- * This function runs as a FreeRTOS task and continuously reads samples 
- * from the WAV file and sends them to the I2S output while the playback 
- * state is PLAYING.
+ * @return true if a valid MP3 frame was found.
+ */
+bool WAVFileReader::openMp3() {
+    // Skip an ID3v2 tag: 10-byte header with a sync-safe size, optional 10-byte footer
+    uint8_t id3[10];
+    m_dataOffset = 0;
+    if (m_file.read(id3, sizeof(id3)) == sizeof(id3) && memcmp(id3, "ID3", 3) == 0) {
+        m_dataOffset = 10 + (((uint32_t)id3[6] & 0x7F) << 21 | ((uint32_t)id3[7] & 0x7F) << 14 |
+                             ((uint32_t)id3[8] & 0x7F) << 7 | ((uint32_t)id3[9] & 0x7F));
+        if (id3[5] & 0x10) {
+            m_dataOffset += 10;
+        }
+    }
+    m_file.seek(m_dataOffset);
+    m_dataSize = (int32_t)(m_file.size() - m_dataOffset);
+    m_currentPos = 0;
+
+    if (!m_mp3.begin()) {
+        return false;
+    }
+    refillMp3();
+
+    int sampleRate = 0;
+    int channels = 0;
+    if (!m_mp3.probe(sampleRate, channels)) {
+        Serial.println("No MP3 frame found.");
+        return false;
+    }
+
+    // Describe the decoded stream in the header
+    memset(&m_header, 0, sizeof(m_header));
+    m_header.format_tag = WAVE_FORMAT_MPEGLAYER3;
+    m_header.num_chans = channels;
+    m_header.srate = sampleRate;
+    m_header.bits_per_samp = 16;
+    m_header.bytes_per_samp = channels * sizeof(int16_t);
+    m_header.bytes_per_sec = sampleRate * m_header.bytes_per_samp;
+    m_header.dlength = m_dataSize;
+
+    m_codec = CODEC_MP3;
+    delete[] m_codecOutput;
+    m_codecOutput = new int16_t[Mp3Decoder::maxFrameSamples()];
+    return setupOutput();
+}
+
+/**
+ * @brief Get the header of the file from `RiffParser` and fill in `m_header`.
+ * 
+ * The chunks are walked on the first open of a file only; later opens of the same,
+ * unchanged file take the parsed header from the cache. On success the file is
+ * positioned on the first audio byte.
+ * 
+ * @return true if the file has valid `fmt ` and `data` chunks.
+ */
+bool WAVFileReader::readHeader() {
+    if (!RiffParser::open(m_file, m_path.c_str(), m_info)) {
+        return false;
+    }
+
+    memset(&m_header, 0, sizeof(m_header));
+    memcpy(m_header.riff, "RIFF", 4);
+    memcpy(m_header.wave, "WAVE", 4);
+    memcpy(m_header.fmt, "fmt ", 4);
+    memcpy(m_header.data, "data", 4);
+    m_header.flength = (int32_t)(m_file.size() - 8);
+    m_header.chunk_size = 16;
+    m_header.format_tag = (int16_t)m_info.formatTag;
+    m_header.num_chans = (int16_t)m_info.channels;
+    m_header.srate = (int32_t)m_info.sampleRate;
+    m_header.bytes_per_sec = (int32_t)m_info.byteRate;
+    m_header.bytes_per_samp = (int16_t)m_info.blockAlign;
+    m_header.bits_per_samp = (int16_t)m_info.bitsPerSample;
+    m_header.dlength = (int32_t)m_info.dataSize;
+    m_dataOffset = m_info.dataOffset;
+    return m_file.seek(m_dataOffset);
+}
+
+/**
+ * @brief Reader task implementation.
+ * 
+ * This function runs as a FreeRTOS task. Each step waits for enough free space in the
+ * output engine's playback ring, then fills it through the decode stage of the file
+ * (`fillPcm`, `fillAdpcm` or `fillMp3`) and, for files below `AUDIO_OUTPUT_RATE`, the
+ * resampler, for the engine's writer task. Once the end of the audio
+ * data is reached the state changes to STOPPED and the task exits; the samples already
+ * in the ring keep playing.
  * 
  * @param parameter A pointer to the WAVFileReader instance.
  */
-void WAVFileReader::playbackTask(void* parameter) {
+void WAVFileReader::readerTask(void* parameter) {
     WAVFileReader* reader = static_cast<WAVFileReader*>(parameter);
-    int16_t sample;
+    I2SManager::PlaybackRing& ring = reader->m_i2sOutput->ring();
+    const size_t needed = reader->ringSpaceNeeded();
+
+    while (reader->m_playbackState != STOPPED) {
+        if (reader->m_playbackState == PAUSED) {
+            xSemaphoreTake(reader->xSemaphore, pdMS_TO_TICKS(AUDIO_TASK_POLL_MS)); // Wait until resumed
+            continue;
+        }
+        if (ring.writeAvailable() < needed) {
+            vTaskDelay(1); // Wait for the writer task to free a whole block
+            continue;
+        }
+
+        if (!reader->fillStep(ring)) {
+            reader->m_playbackState = STOPPED; // End of data, every sample is in the ring
+            break;
+        }
+    }
+
+    if (DEBUGMODE && reader->m_codec == CODEC_MP3) {
+        Mp3Decoder::Stats stats = reader->getDecodeStats();
+        Serial.printf("MP3 decode: %u frames, mean %u us, max %u us per frame, %u%% of real time\n",
+                      stats.frames, stats.meanFrameUs, stats.maxFrameUs, stats.loadPercent);
+    }
+    if (DEBUGMODE && reader->m_prefetchStream >= 0) {
+        PrefetchCache::Stats stats = reader->m_prefetch->getStats();
+        Serial.printf("Prefetch: %u hits, %u misses, %u blocks read ahead, mean %u us, max %u us per block\n",
+                      stats.hits, stats.misses, stats.fills, stats.meanFillUs, stats.maxFillUs);
+    }
+
+    reader->xReaderTask = NULL;
+    reader->m_readerRunning = false; // Last access to the reader, which may be freed from here on
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Run the decode stage of the file once (`fillPcm`, `fillAdpcm` or `fillMp3`).
+ * 
+ * The ring must have `ringSpaceNeeded()` free samples.
+ * 
+ * @return false once the end of the data is reached.
+ */
+bool WAVFileReader::fillStep(I2SManager::PlaybackRing& ring) {
+    switch (m_codec) {
+        case CODEC_IMA_ADPCM: return fillAdpcm(ring);
+        case CODEC_MP3:       return fillMp3(ring);
+        default:              return fillPcm(ring);
+    }
+}
+
+/**
+ * @brief Free ring space, in samples, that one fill step may use after resampling.
+ */
+size_t WAVFileReader::ringSpaceNeeded() {
+    const size_t channels = m_format.outputChannels();
+    return m_resampler.outputFramesFor(blockSamples() / channels) * channels;
+}
+
+/**
+ * @brief Decoded samples, in the output format, that one fill step may produce before resampling.
+ */
+size_t WAVFileReader::blockSamples() {
+    const size_t channels = m_format.outputChannels();
+    if (m_codec == CODEC_IMA_ADPCM) {
+        return m_adpcm.framesPerBlock() * channels;
+    }
+    if (m_codec == CODEC_MP3) {
+        return Mp3Decoder::maxFrameSamples() / MAX_NCHAN * channels;
+    }
+    if (!m_format.isPassthrough()) {
+        return pcmFrames() * channels;
+    }
+    if (m_resampler.isActive()) {
+        return RESAMPLER_STAGE_SAMPLES - RESAMPLER_STAGE_SAMPLES % channels; // Staged, not read into the ring
+    }
+    return AUDIO_BLOCK_SIZE / sizeof(int16_t);
+}
+
+/**
+ * @brief Input frames that one step of `fillConvertedPcm()` reads.
+ * 
+ * At most one block of file data, and no more output than one playback block
+ * (or one resampler stage when resampling).
+ */
+size_t WAVFileReader::pcmFrames() {
+    size_t limit = m_resampler.isActive() ? RESAMPLER_STAGE_SAMPLES : AUDIO_BLOCK_SIZE / sizeof(int16_t);
+    size_t frames = AUDIO_BLOCK_SIZE / m_format.inputFrameBytes();
+    size_t outputFrames = limit / m_format.outputChannels();
+    return frames < outputFrames ? frames : outputFrames;
+}
+
+/**
+ * @brief Select the format conversion and the resampler for the output engine.
+ * 
+ * The decoded samples are converted to `AUDIO_OUTPUT_CHANNELS` 16-bit channels,
+ * then resampled to `AUDIO_OUTPUT_RATE` when the file is slower. Rates above the
+ * output rate are not resampled; the output engine is retuned for them instead.
+ * 
+ * @return false if the sample format is not supported.
+ */
+bool WAVFileReader::setupOutput() {
+    uint16_t bits = m_codec == CODEC_PCM ? m_header.bits_per_samp : 16; // Decoders output 16 bits
+    if (!m_format.begin(bits, m_header.num_chans, AUDIO_OUTPUT_CHANNELS)) {
+        return false;
+    }
+    if (m_resampler.begin(m_header.srate, AUDIO_OUTPUT_RATE, AUDIO_OUTPUT_CHANNELS) && DEBUGMODE) {
+        Serial.printf("Resampling %d Hz to %d Hz\n", (int)m_header.srate, AUDIO_OUTPUT_RATE);
+    }
+
+    delete[] m_convertOutput;
+    m_convertOutput = nullptr;
+    m_carry = 0;
+    if (!m_format.isPassthrough()) {
+        m_convertOutput = new int16_t[blockSamples()];
+        if (m_codec == CODEC_PCM) {
+            delete[] m_codecInput;
+            m_codecInput = new uint8_t[AUDIO_BLOCK_SIZE];
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Get space for decoded samples.
+ * 
+ * Without resampling this is the playback ring itself; otherwise it is the
+ * staging buffer, and `count` is clamped to its size.
+ * 
+ * @param ring The playback ring.
+ * @param count In: samples wanted. Out: samples available.
+ * @return Pointer to the first writable sample.
+ */
+int16_t* WAVFileReader::reserveOutput(I2SManager::PlaybackRing& ring, size_t& count) {
+    if (!m_resampler.isActive()) {
+        return ring.reserve(count);
+    }
+    size_t stage = RESAMPLER_STAGE_SAMPLES - RESAMPLER_STAGE_SAMPLES % m_format.outputChannels();
+    if (count > stage) count = stage;
+    return m_stage;
+}
+
+/**
+ * @brief Publish decoded samples written into the space from `reserveOutput()`.
+ */
+void WAVFileReader::commitOutput(I2SManager::PlaybackRing& ring, size_t count) {
+    if (!m_resampler.isActive()) {
+        ring.commit(count);
+        m_framePos += count / m_format.outputChannels();
+        return;
+    }
+    writeOutput(ring, m_stage, count);
+}
+
+/**
+ * @brief Queue decoded samples to the playback ring, resampling them if needed.
+ * 
+ * The resampler writes straight into contiguous ring spans. The caller has
+ * checked that the ring has room for the converted block.
+ */
+void WAVFileReader::writeOutput(I2SManager::PlaybackRing& ring, const int16_t* samples, size_t count) {
+    m_framePos += count / m_format.outputChannels();
+    if (!m_resampler.isActive()) {
+        ring.write(samples, count);
+        return;
+    }
+
+    const size_t channels = m_format.outputChannels();
+    size_t frames = count / channels;
+    while (true) {
+        size_t span = ring.capacity();
+        int16_t* dst = ring.reserve(span);
+        size_t used = 0;
+        size_t made = m_resampler.process(samples, frames, used, dst, span / channels);
+        ring.commit(made * channels);
+        samples += used * channels;
+        frames -= used;
+        if (made == 0 && used == 0) {
+            break; // Input used up and no complete output frame left
+        }
+    }
+}
+
+/**
+ * @brief Queue input frames to the playback ring through the format converter.
+ * 
+ * The frames are converted straight into the ring when the free span is
+ * contiguous, otherwise (or when resampling) through `m_convertOutput`.
+ */
+void WAVFileReader::convertOutput(I2SManager::PlaybackRing& ring, const uint8_t* in, size_t frames) {
+    size_t samples = frames * m_format.outputChannels();
+    size_t count = samples;
+    int16_t* span = reserveOutput(ring, count);
+    if (count == samples) {
+        m_format.convert(in, span, frames);
+        commitOutput(ring, samples);
+        return;
+    }
+    m_format.convert(in, m_convertOutput, frames);
+    writeOutput(ring, m_convertOutput, samples); // Span wraps around the end of the ring
+}
+
+/**
+ * @brief Queue frames decoded into `m_codecOutput`, dropping those before a seek target.
+ * 
+ * @param ring The playback ring.
+ * @param samples Decoded 16-bit frames with the file's channel count.
+ * @param frames Number of frames.
+ */
+void WAVFileReader::queueDecoded(I2SManager::PlaybackRing& ring, const int16_t* samples, size_t frames) {
+    size_t skip = frames < m_skipFrames ? frames : m_skipFrames;
+    m_skipFrames -= skip;
+    samples += skip * m_header.num_chans;
+    frames -= skip;
+    if (frames == 0) {
+        return;
+    }
+    if (m_format.isPassthrough()) {
+        writeOutput(ring, samples, frames * m_header.num_chans);
+    } else {
+        convertOutput(ring, (const uint8_t*)samples, frames); // Mono to stereo
+    }
+}
+
+/**
+ * @brief Read one block of PCM straight into the playback ring.
+ * 
+ * Reads are trimmed so that they end on a sector boundary, which keeps every
+ * read after the first one sector aligned. Files that are not 16-bit with the
+ * engine's channel count go through `fillConvertedPcm()`.
+ * 
+ * @return false once the end of the data is reached.
+ */
+bool WAVFileReader::fillPcm(I2SManager::PlaybackRing& ring) {
+    if (!m_format.isPassthrough()) {
+        return fillConvertedPcm(ring);
+    }
+
+    size_t count = blockSamples();
+    int16_t* span = reserveOutput(ring, count);
+
+    // End the read on a sector boundary unless the span is shorter than a sector, in whole
+    // frames: a stereo read ending mid-frame would swap the channels from there on
+    const size_t frameBytes = m_header.bytes_per_samp;
+    size_t bytes = SeekIndex::sectorRead(m_dataOffset + m_currentPos, count * sizeof(int16_t), frameBytes);
+
+    size_t length = readBlock((uint8_t*)span, bytes);
+    commitOutput(ring, (length - length % frameBytes) / sizeof(int16_t)); // A truncated last frame is dropped
+    return length > 0;
+}
+
+/**
+ * @brief Read one block of PCM in another format and convert it into the playback ring.
+ * 
+ * Reads end on a sector boundary like `fillPcm()`, so a frame (24-bit samples
+ * in particular) may be split between two reads; its first bytes are carried
+ * over to the front of the next read.
+ * 
+ * @return false once the end of the data is reached.
+ */
+bool WAVFileReader::fillConvertedPcm(I2SManager::PlaybackRing& ring) {
+    const size_t frameBytes = m_format.inputFrameBytes();
+    size_t bytes = pcmFrames() * frameBytes - m_carry;
+    size_t misalignment = (m_dataOffset + m_currentPos + bytes) % AUDIO_SECTOR_SIZE;
+    if (bytes > AUDIO_SECTOR_SIZE) {
+        bytes -= misalignment;
+    }
+
+    size_t length = readBlock(m_codecInput + m_carry, bytes);
+    size_t total = m_carry + length;
+    size_t frames = total / frameBytes;
+    convertOutput(ring, m_codecInput, frames);
+
+    m_carry = total - frames * frameBytes;
+    memmove(m_codecInput, m_codecInput + frames * frameBytes, m_carry);
+    return length > 0;
+}
+
+/**
+ * @brief Read one IMA-ADPCM block and decode it into the playback ring.
+ * 
+ * The block is decoded straight into the ring when the free span is contiguous,
+ * otherwise (or while dropping frames up to a seek target) through `m_codecOutput`.
+ * A corrupt block decodes to nothing and is skipped.
+ * 
+ * @return false once the end of the data is reached.
+ */
+bool WAVFileReader::fillAdpcm(I2SManager::PlaybackRing& ring) {
+    size_t length = readBlock(m_codecInput, m_header.bytes_per_samp);
+    if (length == 0) {
+        return false;
+    }
+
+    if (m_format.isPassthrough() && m_skipFrames == 0) {
+        size_t count = blockSamples();
+        int16_t* span = reserveOutput(ring, count);
+        if (count == blockSamples()) {
+            size_t samples = m_adpcm.decodeBlock(m_codecInput, length, span) * m_header.num_chans;
+            commitOutput(ring, samples);
+            return true;
+        }
+    }
 
+    // Span wraps around the end of the ring, mono to stereo, or frames to drop
+    queueDecoded(ring, m_codecOutput, m_adpcm.decodeBlock(m_codecInput, length, m_codecOutput));
+    return true;
+}
+
+/**
+ * @brief Decode one MP3 frame into the playback ring.
+ * 
+ * The decoder input is topped up from the SD card whenever it holds less than
+ * one maximum-size frame, so only the next frame is ever buffered. Frames that
+ * produce no output (bit reservoir warm-up, corrupt data) are skipped; after a
+ * seek they still count towards the frames to drop.
+ * 
+ * @return false once the end of the data is reached.
+ */
+bool WAVFileReader::fillMp3(I2SManager::PlaybackRing& ring) {
     while (true) {
-        switch (reader->m_playbackState) {
-            case PLAYING:
-                if (reader->readSample(sample)) {
-                    reader->m_i2sOutput->writeSample(sample);
-                } else {
-                    // End of data reached
-                    reader->stopPlayback(); // Stop playback if end is reached
-                    return; // Exit the loop
-                }
-                break;
+        if (m_mp3.bufferedBytes() < MAINBUF_SIZE && !isEnd()) {
+            refillMp3();
+        }
 
-            case PAUSED:
-                xSemaphoreTake(reader->xSemaphore, portMAX_DELAY); // Wait until resumed
-                break;
+        size_t count = Mp3Decoder::maxFrameSamples();
+        int16_t* span = m_format.isPassthrough() && m_skipFrames == 0 ? reserveOutput(ring, count) : nullptr;
+        bool direct = span && count == Mp3Decoder::maxFrameSamples();
+        int samples = m_mp3.decodeFrame(direct ? span : m_codecOutput);
 
-            case STOPPED:
-                vTaskDelete(NULL); // Exit task if stopped
-                return;
+        if (samples > 0) {
+            if (direct) {
+                commitOutput(ring, samples);
+            } else {
+                queueDecoded(ring, m_codecOutput, samples / m_header.num_chans); // Wrapped span, mono, or seeking
+            }
+            return true;
+        }
+        if (samples < 0 && m_skipFrames > 0) {
+            uint32_t frameFrames = m_seekIndex.layout().framesPerBlock; // Reservoir warm-up after a seek
+            m_skipFrames = m_skipFrames > frameFrames ? m_skipFrames - frameFrames : 0;
+        }
+        if (samples == 0 && refillMp3() == 0) {
+            return false; // Next frame incomplete and no more data
         }
-        vTaskDelay(1); // Yield to other tasks
+    }
+}
+
+/**
+ * @brief Append file data to the MP3 decoder input.
+ * 
+ * @return The number of bytes read.
+ */
+size_t WAVFileReader::refillMp3() {
+    size_t space = 0;
+    uint8_t* dst = m_mp3.inputSpace(space);
+    size_t length = readBlock(dst, space);
+    m_mp3.inputCommit(length);
+    return length;
+}
+
+/**
+ * @brief Wait until the reader task has observed the STOPPED state and exited.
+ *
+ * There is no timeout: the task may be inside an SD read that stalls for hundreds of
+ * milliseconds, and the file, the decoders and the buffers it uses must outlive it.
+ */
+void WAVFileReader::waitForTask() {
+    const TickType_t slow = pdMS_TO_TICKS(AUDIO_TASK_POLL_MS * 10);
+    TickType_t start = xTaskGetTickCount();
+    bool reported = false;
+
+    while (m_readerRunning) {
+        if (xSemaphore) xSemaphoreGive(xSemaphore); // Wake a paused reader task
+        if (!reported && (xTaskGetTickCount() - start) >= slow) {
+            reported = true;
+            if (DEBUGMODE) {
+                Serial.println("WAVFileReader: Reader task is still in a read, waiting for it to exit.");
+            }
+        }
+        vTaskDelay(1);
     }
 }
 
 /**
  * @brief Start playback of the WAV file.
  * 
- * This function creates a task to handle playback if it is currently stopped.
+ * This function creates the reader task if playback is currently stopped. The output
+ * engine must already run at this file's sample rate.
  */
 void WAVFileReader::startPlayback() {
-    if (m_playbackState == STOPPED) {
+    if (m_playbackState == STOPPED && m_i2sOutput) {
+        waitForTask(); // Make sure a previous run has fully ended
+        m_i2sOutput->setTrackGain(m_trackGain); // Applies from the first sample this run queues
         m_playbackState = PLAYING; // Change state to PLAYING
-        xTaskCreate(playbackTask, "PlaybackTask", READING_STACK_SIZE, this, 1, &xPlaybackTask);
+        uint32_t stackSize = m_codec == CODEC_MP3 ? MP3_READER_STACK_SIZE : READING_STACK_SIZE; // Helix needs a deeper stack
+        m_readerRunning = true; // Before the task can run, it clears the flag as it exits
+        if (xTaskCreate(readerTask, "ReaderTask", stackSize, this, AUDIO_READER_TASK_PRIORITY, &xReaderTask) != pdPASS) {
+            Serial.println("WAVFileReader: Failed to create the reader task.");
+            m_readerRunning = false;
+            xReaderTask = NULL;
+            m_playbackState = STOPPED;
+        }
     }
 }
 
 /**
  * @brief Stop playback of the WAV file.
  * 
- * This function stops the playback task and resets the current position.
+ * This function signals the reader task to exit, waits for it and rewinds the
+ * file to the start of the audio data. Samples already queued to the output engine
+ * are left to the caller, which may flush them.
  */
 void WAVFileReader::stopPlayback() {
     if (m_playbackState != STOPPED) {
         m_playbackState = STOPPED; // Set playback state to STOPPED
-        if (xPlaybackTask) {
-            vTaskDelete(xPlaybackTask); // Delete playback task
-            xPlaybackTask = NULL; // Reset task handle
-        }
-        if (m_i2sOutput) {
-            m_i2sOutput->stop(); // Stop the I2S output if initialized
+    }
+    waitForTask(); // Let the task finish its current block and exit
+
+    if (m_file && m_currentPos != 0) {
+        m_file.seek(m_dataOffset); // Rewind to the start of the audio data
+        if (m_codec == CODEC_MP3) {
+            m_mp3.reset(); // Drop buffered frames and the bit reservoir
         }
-        m_currentPos = 0; // Reset current position
+        m_resampler.reset();
+        m_carry = 0;
     }
+    m_currentPos = 0; // Reset current position
+    m_framePos = 0;
+    m_skipFrames = 0;
 }
 
 /**
@@ -165,18 +703,209 @@ void WAVFileReader::resumePlayback() {
  * @return true if a sample was read successfully; false if end of data is reached.
  */
 bool WAVFileReader::readSample(int16_t &sample) {
+    return readBlock((uint8_t*)&sample, sizeof(sample)) == sizeof(sample);
+}
+
+/**
+ * @brief Read a block of raw audio data from the WAV file.
+ * 
+ * The read is clamped to the remaining audio data so that trailing chunks
+ * are never played back as samples. The bytes the prefetch cache holds are
+ * copied from PSRAM; the rest is read from the SD card.
+ * 
+ * @param buffer Destination buffer.
+ * @param size Maximum number of bytes to read.
+ * @return The number of bytes read; 0 once the end of data is reached.
+ */
+size_t WAVFileReader::readBlock(uint8_t* buffer, size_t size) {
     if (m_currentPos >= m_dataSize) {
-        return false; // End of data
+        return 0; // End of data
     }
 
-    // Read a sample (2 bytes for 16-bit audio)
-    size_t bytesRead = m_file.read((uint8_t*)&sample, sizeof(sample));
-    if (bytesRead != sizeof(sample)) {
-        return false; // Return false if read fails
+    size_t remaining = (size_t)(m_dataSize - m_currentPos);
+    if (size > remaining) {
+        size = remaining;
+    }
+
+    size_t bytesRead = 0;
+    if (m_prefetchStream >= 0) {
+        bytesRead = m_prefetch->read(m_prefetchStream, m_dataOffset + m_currentPos, buffer, size);
+    }
+    if (bytesRead < size) {
+        uint32_t position = m_dataOffset + m_currentPos + bytesRead;
+        if (m_file.position() != position) {
+            m_file.seek(position); // Cached reads leave the SD handle behind
+        }
+        bytesRead += m_file.read(buffer + bytesRead, size - bytesRead);
+    }
+    m_currentPos += bytesRead; // Update current position
+    return bytesRead;
+}
+
+/**
+ * @brief Decode the whole file into a buffer, in the output format.
+ * 
+ * Used to preload short sound effects into RAM. The file runs through the same
+ * decode, format conversion and resampling stages as for playback, synchronously
+ * in the calling task, through a temporary ring. The reader must be open and not
+ * playing; it is rewound afterwards.
+ * 
+ * @param out Destination for 16-bit samples with `AUDIO_OUTPUT_CHANNELS` channels.
+ * @param maxSamples Capacity of `out`; a longer file is cut.
+ * @return The number of samples written.
+ */
+size_t WAVFileReader::decodeAll(int16_t* out, size_t maxSamples) {
+    if (m_playbackState != STOPPED) {
+        return 0;
+    }
+    I2SManager::PlaybackRing* ring = new I2SManager::PlaybackRing();
+    if (!ring) {
+        return 0;
+    }
+
+    size_t total = 0;
+    bool more = true;
+    while (more && total < maxSamples && ring->capacity() >= ringSpaceNeeded()) {
+        more = fillStep(*ring); // The ring is empty before each step
+        size_t available = ring->readAvailable();
+        while (available > 0) {
+            size_t span = available;
+            const int16_t* data = ring->peek(span);
+            size_t copy = span < maxSamples - total ? span : maxSamples - total;
+            memcpy(out + total, data, copy * sizeof(int16_t));
+            total += copy;
+            ring->consume(span);
+            available -= span;
+        }
+        esp_task_wdt_reset(); // Long effects take a while to decode
     }
 
-    m_currentPos += sizeof(sample); // Update current position
-    return true; // Return true if a sample was read
+    delete ring;
+    stopPlayback(); // Rewind
+    return total;
+}
+
+/**
+ * @brief Decode the next step of a stopped reader into a ring of the caller.
+ *
+ * For offline work on the decoded audio, such as the loudness analysis: the samples come out
+ * in the output format, 16-bit stereo at `AUDIO_OUTPUT_RATE`, as they would be played. The
+ * ring should be empty before each step. `seekMs()` may be used to start elsewhere.
+ *
+ * @param ring Ring to decode into; it is not the output engine's.
+ * @return false at the end of the data, or if the ring cannot hold a step.
+ */
+bool WAVFileReader::decodeStep(I2SManager::PlaybackRing& ring) {
+    if (!m_file || m_playbackState != STOPPED || ring.writeAvailable() < ringSpaceNeeded()) {
+        return false;
+    }
+    return fillStep(ring);
+}
+
+/**
+ * @brief Read the loudness sidecar of the file, if it was measured, into the track gain.
+ */
+void WAVFileReader::loadTrackGain() {
+    LoudnessIndex loudness;
+    m_trackGain = loudness.load((m_path + LOUDNESS_EXTENSION).c_str(), m_file) ? loudness.gain() : GAIN_UNITY;
+}
+
+/**
+ * @brief Get the Q15 normalization gain of the file, GAIN_UNITY when it was not measured.
+ */
+int32_t WAVFileReader::getTrackGain() {
+    return m_trackGain;
+}
+
+/**
+ * @brief Load the seek index of the file, or build it and cache it on the SD card.
+ * 
+ * A sidecar is only used if it was built for this exact file (size and modification
+ * time) and describes the same audio data as the header just parsed.
+ * 
+ * @return true if the index is ready.
+ */
+bool WAVFileReader::loadSeekIndex() {
+    SeekIndex::Layout layout;
+    layout.formatTag = (uint16_t)m_header.format_tag;
+    layout.channels = m_header.num_chans;
+    layout.sampleRate = m_header.srate;
+    layout.dataOffset = m_dataOffset;
+    layout.dataSize = m_dataSize;
+    layout.blockAlign = m_codec == CODEC_MP3 ? 0 : m_header.bytes_per_samp;
+    layout.framesPerBlock = m_codec == CODEC_IMA_ADPCM ? m_adpcm.framesPerBlock() : (m_codec == CODEC_PCM ? 1 : 0);
+
+    if (m_seekIndex.isValid() || m_seekIndex.load(m_indexPath.c_str(), m_file)) {
+        const SeekIndex::Layout& cached = m_seekIndex.layout();
+        if (cached.formatTag == layout.formatTag && cached.channels == layout.channels &&
+            cached.sampleRate == layout.sampleRate && cached.dataOffset == layout.dataOffset &&
+            cached.dataSize == layout.dataSize && cached.blockAlign == layout.blockAlign) {
+            return true;
+        }
+    }
+
+    int64_t startUs = esp_timer_get_time();
+    bool built = m_seekIndex.build(m_file, layout);
+    if (built && !m_seekIndex.save(m_indexPath.c_str())) {
+        Serial.println("Failed to save the seek index."); // Still usable for this reader
+    }
+    if (DEBUGMODE && built) {
+        Serial.printf("Seek index of %u frames built in %u ms\n", m_seekIndex.totalFrames(),
+                      (uint32_t)((esp_timer_get_time() - startUs) / 1000));
+    }
+    return built;
+}
+
+/**
+ * @brief Move a stopped reader to a position in the file.
+ * 
+ * The file is positioned on the codec block holding the target through the seek
+ * index; the frames of that block before the target are decoded and dropped when
+ * playback starts, so the first sample queued is the one at `ms`, to the frame.
+ * 
+ * @param ms Position from the start of the audio, clamped to its end.
+ * @return false if the reader is playing or the file could not be indexed.
+ */
+bool WAVFileReader::seekMs(uint32_t ms) {
+    if (!m_file || m_playbackState != STOPPED || m_header.srate <= 0) {
+        return false;
+    }
+    waitForTask();
+    if (!loadSeekIndex()) {
+        return false;
+    }
+
+    uint64_t target = (uint64_t)ms * (uint32_t)m_header.srate / 1000;
+    uint32_t frame = target < m_seekIndex.totalFrames() ? (uint32_t)target : m_seekIndex.totalFrames();
+    uint32_t offset = 0;
+    uint32_t startFrame = 0;
+    m_seekIndex.locate(frame, offset, startFrame);
+
+    m_file.seek(m_dataOffset + offset);
+    m_currentPos = offset;
+    if (m_codec == CODEC_MP3) {
+        m_mp3.reset(); // Drop buffered frames and the bit reservoir
+    }
+    m_resampler.reset();
+    m_carry = 0;
+    m_skipFrames = frame - startFrame;
+    m_framePos = frame;
+    return true;
+}
+
+/**
+ * @brief Get the position of the last frame queued to the output engine.
+ * 
+ * Samples still waiting in the playback ring are not accounted for; see
+ * `SpeakerManager::positionMs()` for the position being heard.
+ * 
+ * @return The position in milliseconds from the start of the audio.
+ */
+uint32_t WAVFileReader::positionMs() {
+    if (m_header.srate <= 0) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)m_framePos * 1000 / (uint32_t)m_header.srate); // Counted before resampling
 }
 
 /**
@@ -188,6 +917,57 @@ bool WAVFileReader::isEnd() {
     return (m_currentPos >= m_dataSize); // Check if current position exceeds data size
 }
 
+/**
+ * @brief Get the current playback state.
+ * 
+ * The state becomes STOPPED on its own once the reader task has queued the last
+ * sample to the output engine; the queued samples may still be playing.
+ * 
+ * @return The current playback state.
+ */
+WAVFileReader::PlaybackState WAVFileReader::getPlaybackState() {
+    return m_playbackState;
+}
+
+/**
+ * @brief Get the decode time per frame of an MP3 stream.
+ * 
+ * @return The decoder statistics; all zero for WAV files.
+ */
+Mp3Decoder::Stats WAVFileReader::getDecodeStats() {
+    if (m_codec == CODEC_MP3) {
+        return m_mp3.getStats();
+    }
+    Mp3Decoder::Stats none;
+    memset(&none, 0, sizeof(none));
+    return none;
+}
+
+/**
+ * @brief Get the rate of the samples this reader queues to the output engine.
+ * 
+ * @return `AUDIO_OUTPUT_RATE` when the file is resampled, the file's own rate otherwise.
+ */
+int WAVFileReader::getOutputRate() {
+    return m_resampler.isActive() ? AUDIO_OUTPUT_RATE : m_header.srate;
+}
+
+/**
+ * @brief Get the loop of the file's `smpl` chunk.
+ * 
+ * @param startFrame Out: first frame of the loop.
+ * @param endFrame Out: last frame of the loop, inclusive.
+ * @return false if the file defines no loop.
+ */
+bool WAVFileReader::getLoopPoints(uint32_t& startFrame, uint32_t& endFrame) {
+    if (!m_info.hasLoop) {
+        return false;
+    }
+    startFrame = m_info.loopStart;
+    endFrame = m_info.loopEnd;
+    return true;
+}
+
 /**
  * @brief Get the sample rate from the WAV header.
  * 
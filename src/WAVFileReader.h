@@ -5,7 +5,16 @@
 #include <SD.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include "Config.h"
 #include "I2SManager.h"  // Include the I2SOutput header
+#include "ImaAdpcmDecoder.h"
+#include "Mp3Decoder.h"
+#include "Resampler.h"
+#include "FormatConverter.h"
+#include "SeekIndex.h"
+#include "LoudnessIndex.h"
+#include "RiffParser.h"
+#include "PrefetchCache.h"
 
 /**
  * @file WAVFileReader.h
@@ -14,16 +23,51 @@
  * The `WAVFileReader` class provides functionality to read and play back WAV audio files from an SD card
  * using the ESP32 platform. It manages the WAV file format, including parsing the file header and 
  * streaming audio samples through I2S output. The class leverages FreeRTOS for handling playback in 
- * a separate task, allowing for efficient audio streaming without blocking the main program flow.
+ * separate tasks, allowing for efficient audio streaming without blocking the main program flow.
+ *
+ * Playback is a block pipeline: a reader task reads large, sector-aligned blocks from the SD card
+ * straight into the playback ring of the shared `I2SManager` output engine, whose writer task hands
+ * the already filled part of the ring to I2S in whole-block `i2s_write` calls. The ring is lock-free
+ * and both tasks work on it in place, so the SD read of block N+1 overlaps the DMA transfer of block N
+ * without copies or mutexes. The reader never installs or reconfigures the I2S driver itself.
+ *
+ * The decode stage is selected from the `format_tag` of the header. Linear PCM is read straight
+ * into the ring. IMA-ADPCM files are read one ADPCM block at a time and decoded by
+ * `ImaAdpcmDecoder` directly into the ring, which cuts the SD traffic of a story by four.
+ * MP3 files (the TTS responses) are recognised by their first bytes and decoded frame by frame
+ * by `Mp3Decoder`, with only the next frame buffered.
+ *
+ * Every file is played as 16-bit stereo. 8/24/32-bit PCM and mono files of any codec go
+ * through a `FormatConverter` kernel selected once from the header, which widens or narrows the
+ * samples and duplicates mono to both channels before the resampler.
+ *
+ * With a `PrefetchCache`, every read is served from PSRAM when the cache has read that part of
+ * the file ahead, and from the SD card otherwise, so SD stalls are absorbed by seconds of
+ * cached audio instead of the short playback ring.
+ *
+ * Files below `AUDIO_OUTPUT_RATE` (8 kHz recordings, 16/22.05 kHz stories, TTS output) are
+ * decoded into a small staging buffer and converted by the polyphase `Resampler` straight into
+ * the ring, so the output engine keeps one clock rate for every track.
+ *
+ * `seekMs()` moves a stopped reader to any position through a `SeekIndex` cached next to the
+ * file, and `positionMs()` reports the position of the samples queued so far, so a story can be
+ * resumed where it was left.
+ *
+ * `open()` also reads the `LoudnessIndex` sidecar written by the `LoudnessScanner`, and
+ * `startPlayback()` hands its normalization gain to the output engine at the ring position of
+ * the file's first sample, so each segment of a gapless queue gets its own level.
  *
  * ## Key Features:
  * - Reads WAV files and extracts audio data from the SD card.
- * - Provides playback control (play, pause, stop, resume).
+ * - Finds the `fmt `, `data` and `smpl` chunks anywhere in the file through `RiffParser`, which
+ *   checks every chunk size and caches the parsed header, so reopening a file reads no header.
+ * - Decodes 8/16/24/32-bit PCM, IMA-ADPCM (format tag 0x0011) and MP3, mono or stereo.
+ * - Provides playback control (play, pause, stop, resume) and sample-accurate seeking.
  * - Utilizes I2S for audio output to speakers or other audio devices.
  * - Supports checking the playback state and ensuring smooth audio handling.
  *
  * ## Usage:
- * 1. Instantiate the `WAVFileReader` with the desired file name and I2S pin configuration.
+ * 1. Instantiate the `WAVFileReader` with the desired file name and the shared `I2SManager`.
  * 2. Call the `open()` method to prepare the WAV file for playback.
  * 3. Use `startPlayback()`, `pausePlayback()`, and `stopPlayback()` to control audio playback.
  * 4. Monitor the playback state and check for end-of-file conditions using `isEnd()`.
@@ -35,7 +79,7 @@
  *
  * ## Example:
  * ```cpp
- * WAVFileReader wavReader("audio.wav", i2sPins);
+ * WAVFileReader wavReader("audio.wav", &i2sManager);
  * if (wavReader.open()) {
  *     wavReader.startPlayback();
  * }
@@ -63,7 +107,7 @@ class WAVFileReader {
 public:
     enum PlaybackState { STOPPED, PLAYING, PAUSED }; // Playback states
 
-    WAVFileReader(const char* file_name, i2s_pin_config_t i2sPins);
+    WAVFileReader(const char* file_name, I2SManager* i2sOutput, PrefetchCache* prefetch = nullptr);
     ~WAVFileReader();
     bool open();
     void startPlayback();  // Start playback
@@ -71,18 +115,72 @@ public:
     void pausePlayback();  // Pause playback
     void resumePlayback(); // Resume playback
     bool isEnd();          // Check if end of data is reached
+    PlaybackState getPlaybackState(); // Current playback state, STOPPED once every sample is queued
     int getSampleRate();   // Get the sample rate
+    int getOutputRate();   // Rate of the samples queued to the output engine
+    Mp3Decoder::Stats getDecodeStats(); // MP3 decode time per frame, zero for WAV files
     bool readSample(int16_t &sample); // Read a sample from the WAV file
+    size_t readBlock(uint8_t* buffer, size_t size); // Read a block of raw audio data from the WAV file
+    size_t decodeAll(int16_t* out, size_t maxSamples); // Decode the whole file into RAM in the output format
+    bool decodeStep(I2SManager::PlaybackRing& ring); // Decode the next step of a stopped reader into a private ring
+    int32_t getTrackGain();   // Q15 normalization gain from the loudness sidecar, GAIN_UNITY if none
+    bool seekMs(uint32_t ms); // Move a stopped reader to a position, in milliseconds
+    uint32_t positionMs();    // Position of the last sample queued, in milliseconds
+    bool getLoopPoints(uint32_t& startFrame, uint32_t& endFrame); // Loop of the smpl chunk, false if none
 
 private:
-    static void playbackTask(void* parameter); // FreeRTOS task for playback
+    enum Codec { CODEC_PCM, CODEC_IMA_ADPCM, CODEC_MP3 }; // Decode stage selected from the header
+
+    static void readerTask(void* parameter);   // FreeRTOS task filling the playback ring from the SD card
+    bool fillStep(I2SManager::PlaybackRing& ring);  // Run the decode stage of the file once, false at the end
+    size_t ringSpaceNeeded();   // Free ring space one fill step may use
+    bool fillPcm(I2SManager::PlaybackRing& ring);   // Read one block of PCM into the ring, false at the end
+    bool fillConvertedPcm(I2SManager::PlaybackRing& ring); // Read one block of PCM in another format, false at the end
+    bool fillAdpcm(I2SManager::PlaybackRing& ring); // Decode one ADPCM block into the ring, false at the end
+    bool fillMp3(I2SManager::PlaybackRing& ring);   // Decode one MP3 frame into the ring, false at the end
+    size_t refillMp3();         // Top up the MP3 decoder input from the file
+    bool isMp3Stream();         // File starts with an ID3 tag or an MPEG frame sync
+    bool setupOutput();         // Select the format conversion and the resampler for the output engine
+    size_t pcmFrames();         // Input frames one converted PCM step reads
+    void convertOutput(I2SManager::PlaybackRing& ring, const uint8_t* in, size_t frames); // Queue frames through the format converter
+    int16_t* reserveOutput(I2SManager::PlaybackRing& ring, size_t& count); // Space for decoded samples
+    void commitOutput(I2SManager::PlaybackRing& ring, size_t count);       // Queue reserved samples
+    void writeOutput(I2SManager::PlaybackRing& ring, const int16_t* samples, size_t count); // Queue samples from elsewhere
+    void queueDecoded(I2SManager::PlaybackRing& ring, const int16_t* samples, size_t frames); // Queue decoded frames after a seek skip
+    bool loadSeekIndex();       // Load the sidecar seek index, building it if missing or stale
+    void loadTrackGain();       // Read the loudness sidecar into m_trackGain
+    bool openMp3();             // Skip ID3 and read the stream format from the first frame
+    size_t blockSamples();      // Decoded samples one fill step may produce
+    bool readHeader();          // Parse (or look up) the RIFF header and fill m_header
+    bool attachPrefetch();      // Start reading the audio data ahead into m_prefetch
+    void waitForTask();         // Wait until the reader task has exited
     File m_file;                // File object for WAV file
     wav_header_ m_header;        // WAV file header
+    RiffParser::WavInfo m_info; // Parsed RIFF header, loop points included
     int32_t m_dataSize;        // Size of the audio data
     int32_t m_currentPos;      // Current position in the audio data
-    I2SManager* m_i2sOutput;    // Pointer to I2SOutput object
-    i2s_pin_config_t m_i2sPins; // Pin configuration for I2S output
-    TaskHandle_t xPlaybackTask; // Task handle for playback task
+    uint32_t m_dataOffset;     // File offset of the first audio byte
+    Codec m_codec;             // Decode stage for this file
+    ImaAdpcmDecoder m_adpcm;   // IMA-ADPCM block decoder
+    Mp3Decoder m_mp3;          // MP3 frame decoder, allocated for MP3 streams only
+    uint8_t* m_codecInput;     // One encoded or raw block, allocated for files that are decoded or converted
+    int16_t* m_codecOutput;    // One decoded block, used when the ring span wraps
+    FormatConverter m_format;  // Converts the file's samples to the engine's 16-bit stereo
+    int16_t* m_convertOutput;  // One converted step, used when it cannot go to the ring directly
+    size_t m_carry;            // Bytes of a partial PCM frame held at the front of m_codecInput
+    String m_path;             // Path of the file, key of the header cache
+    String m_indexPath;        // Path of the seek index sidecar
+    SeekIndex m_seekIndex;     // Block offsets for seekMs(), loaded on the first seek
+    uint32_t m_framePos;       // Position of the next frame to queue, in frames of the file
+    uint32_t m_skipFrames;     // Decoded frames still to drop to reach the seek target
+    int32_t m_trackGain;       // Normalization gain handed to the output engine at startPlayback()
+    Resampler m_resampler;     // Converts to AUDIO_OUTPUT_RATE, inactive at the output rate
+    int16_t m_stage[RESAMPLER_STAGE_SAMPLES]; // Decoded samples waiting for the resampler
+    I2SManager* m_i2sOutput;    // Shared output engine, owned by SpeakerManager
+    PrefetchCache* m_prefetch;  // Shared read-ahead cache, owned by SpeakerManager, or nullptr
+    int m_prefetchStream;       // Stream of this file in m_prefetch, -1 when not read ahead
+    TaskHandle_t xReaderTask;   // Task handle for reader task
+    volatile bool m_readerRunning; // Reader task created and not yet exited, its state must not be freed
     volatile PlaybackState m_playbackState; // Current playback state
     SemaphoreHandle_t xSemaphore; // Semaphore for synchronization
 };
@@ -1,6 +1,5 @@
 #include "WAVFileWriter.h"
 #include <string.h> // For memcpy
-#include "I2SManager.h"
 
 /**
  * @brief Constructs a WAVFileWriter object.
@@ -10,6 +9,7 @@
  * @param file_name The name of the file to write the WAV data to.
  * @param num_channels The number of audio channels (1 for mono, 2 for stereo).
  * @param sample_rate The sample rate in Hz (e.g., 44100 for CD quality).
+ * @param duration_seconds Maximum recording length in seconds, 0 for no limit.
  */
 WAVFileWriter::WAVFileWriter(const char *file_name, short num_channels, int sample_rate, int duration_seconds,String Folder) {
     // Construct the full file path
@@ -17,10 +17,14 @@ WAVFileWriter::WAVFileWriter(const char *file_name, short num_channels, int samp
     m_file = SD.open(fullPath.c_str(), FILE_WRITE); // Open the file for writing on the SD card
 
     // Calculate number of samples needed for the specified duration
-    m_totalSamples = sample_rate * duration_seconds; // Total samples for the duration
+    m_totalSamples = (uint64_t)sample_rate * duration_seconds; // Total samples for the duration
     m_channels = num_channels;
     m_sampleRate = sample_rate;
 
+    // The first block is shortened by the header so later blocks start on sector boundaries
+    m_bufferUsed = 0;
+    m_bufferLimit = sizeof(m_buffer) - sizeof(m_header);
+
     // Initialize the WAV header
     strncpy(m_header.riff, "RIFF", 4);
     strncpy(m_header.wave, "WAVE", 4);
@@ -35,8 +39,7 @@ WAVFileWriter::WAVFileWriter(const char *file_name, short num_channels, int samp
     m_header.bytes_per_sec = m_header.srate * m_header.bits_per_samp / 8 * m_header.num_chans;
     m_header.bytes_per_samp = m_header.bits_per_samp / 8 * m_header.num_chans;
 
-    m_header.dlength = m_totalSamples * m_channels * 2; // Data length for the total samples
-    m_header.flength = m_header.dlength + sizeof(m_header) - 8; // Total file length
+    updateHeaderLengths(m_totalSamples); // Data length for the total samples
 
     // Write the initial header (it will be updated later on close)
     m_file.write((uint8_t*)&m_header, sizeof(m_header));
@@ -58,45 +61,208 @@ WAVFileWriter::~WAVFileWriter() {
 /**
  * @brief Writes a single audio frame to the WAV file.
  * 
- * Writes the left and right audio samples of a frame to the file, updating the 
- * data byte count accordingly.
+ * The frame is appended to the block buffer, which is written to the card once full.
  *
  * @param left_sample Left channel sample (for mono, this will be the only sample).
  * @param right_sample Right channel sample (optional, for stereo).
  */
 void WAVFileWriter::writeFrame(int16_t left_sample, int16_t right_sample) {
     // Only write if we have not exceeded the total samples for the duration
-    if (m_samplesWritten < m_totalSamples) {
-        // Write left channel sample (always write, even in mono)
-        m_file.write((uint8_t*)&left_sample, sizeof(left_sample)); // Write left channel sample
+    if (writableFrames(1) == 0) {
+        return;
+    }
+
+    int16_t* out = (int16_t*)((uint8_t*)m_buffer + m_bufferUsed);
+    out[0] = left_sample; // Always write the left channel, even in mono
+    if (m_channels == 2) {
+        out[1] = right_sample; // Right channel only in stereo mode
+    }
+    m_bufferUsed += m_channels * sizeof(int16_t);
+    m_samplesWritten++;
+
+    if (m_bufferUsed >= m_bufferLimit) {
+        flushBuffer();
+    }
+}
+
+/**
+ * @brief Writes a block of interleaved audio frames to the WAV file.
+ * 
+ * Frames are copied into the block buffer. When the buffer is empty, whole blocks
+ * are written straight from `samples` without copying.
+ *
+ * @param samples Interleaved samples, `frame_count * num_channels` of them.
+ * @param frame_count Number of frames in the block.
+ * @return The number of frames accepted; fewer once the duration limit is reached.
+ */
+size_t WAVFileWriter::writeFrames(const int16_t* samples, size_t frame_count) {
+    frame_count = writableFrames(frame_count);
+    const size_t frameBytes = m_channels * sizeof(int16_t);
+    const uint8_t* src = (const uint8_t*)samples;
+    size_t bytes = frame_count * frameBytes;
 
-        // If in stereo mode, write the right channel sample
-        if (CHANNEL == 2) {
-            m_file.write((uint8_t*)&right_sample, sizeof(right_sample)); // Write right channel sample
+    while (bytes > 0) {
+        size_t space = m_bufferLimit - m_bufferUsed;
+        if (m_bufferUsed == 0 && bytes >= m_bufferLimit) {
+            // Whole blocks bypass the buffer and keep the sector alignment
+            size_t direct = m_bufferLimit == sizeof(m_buffer) ? bytes - bytes % sizeof(m_buffer) : m_bufferLimit;
+            m_file.write(src, direct);
+            m_bufferLimit = sizeof(m_buffer);
+            src += direct;
+            bytes -= direct;
+            continue;
         }
 
-        // Increment the number of samples written
-        m_samplesWritten++;
-    } else {
-        // If we have reached the maximum sample count, you may choose to handle it.
-        // For example, logging a message or resetting the written count can be done here.
+        size_t chunk = bytes < space ? bytes : space;
+        memcpy((uint8_t*)m_buffer + m_bufferUsed, src, chunk);
+        m_bufferUsed += chunk;
+        src += chunk;
+        bytes -= chunk;
+        if (m_bufferUsed >= m_bufferLimit) {
+            flushBuffer();
+        }
     }
 
-    // Reset watchdog timer to prevent task reset
-    esp_task_wdt_reset();
+    m_samplesWritten += frame_count;
+    return frame_count;
 }
 
+/**
+ * @brief Interleaves separate channel blocks into the WAV file.
+ * 
+ * Frames are interleaved straight into the block buffer in a tight loop. In mono
+ * only `left` is used.
+ *
+ * @param left Left channel samples.
+ * @param right Right channel samples, ignored in mono.
+ * @param frame_count Number of frames in each block.
+ * @return The number of frames accepted; fewer once the duration limit is reached.
+ */
+size_t WAVFileWriter::writeFrames(const int16_t* left, const int16_t* right, size_t frame_count) {
+    if (m_channels == 1) {
+        return writeFrames(left, frame_count);
+    }
+
+    frame_count = writableFrames(frame_count);
+    size_t done = 0;
+    while (done < frame_count) {
+        size_t space = (m_bufferLimit - m_bufferUsed) / (2 * sizeof(int16_t));
+        size_t chunk = frame_count - done < space ? frame_count - done : space;
+        int16_t* out = (int16_t*)((uint8_t*)m_buffer + m_bufferUsed);
+        for (size_t i = 0; i < chunk; i++) {
+            out[2 * i] = left[done + i];
+            out[2 * i + 1] = right[done + i];
+        }
+        m_bufferUsed += chunk * 2 * sizeof(int16_t);
+        done += chunk;
+        if (m_bufferUsed >= m_bufferLimit) {
+            flushBuffer();
+        }
+    }
+
+    m_samplesWritten += frame_count;
+    return frame_count;
+}
+
+/**
+ * @brief Returns the number of frames written so far.
+ */
+uint64_t WAVFileWriter::getFramesWritten() {
+    return m_samplesWritten;
+}
+
+/**
+ * @brief Sets the comment stored in the file when it is closed.
+ *
+ * @param text Comment text; an empty text writes no comment.
+ */
+void WAVFileWriter::setComment(const String& text) {
+    m_comment = text;
+}
+
+/**
+ * @brief Clamps a number of frames to what the duration limit still allows.
+ */
+size_t WAVFileWriter::writableFrames(size_t frame_count) {
+    if (m_totalSamples == 0) {
+        return frame_count; // No limit
+    }
+    uint64_t remaining = m_totalSamples > m_samplesWritten ? m_totalSamples - m_samplesWritten : 0;
+    return frame_count > remaining ? (size_t)remaining : frame_count;
+}
+
+/**
+ * @brief Writes the buffered bytes to the card and starts a new block.
+ */
+void WAVFileWriter::flushBuffer() {
+    if (m_bufferUsed > 0) {
+        m_file.write((const uint8_t*)m_buffer, m_bufferUsed);
+    }
+    m_bufferUsed = 0;
+    m_bufferLimit = sizeof(m_buffer); // Every block after the first is a whole block
+}
+
+/**
+ * @brief Fills the RIFF and data lengths of the header for a number of frames.
+ * 
+ * The 32-bit RIFF fields are saturated, so a recording past 4 GB keeps a valid
+ * (if truncated) header instead of a wrapped one.
+ */
+void WAVFileWriter::updateHeaderLengths(uint64_t frames) {
+    const uint64_t maxData = 0xFFFFFFFFULL - (sizeof(m_header) - 8);
+    uint64_t dataBytes = frames * m_channels * sizeof(int16_t);
+    if (dataBytes > maxData) {
+        dataBytes = maxData;
+    }
+    m_header.dlength = (int32_t)(uint32_t)dataBytes;
+    m_header.flength = (int32_t)(uint32_t)(dataBytes + sizeof(m_header) - 8);
+}
+
+/**
+ * @brief Appends the comment as a `LIST`/`INFO` chunk holding one `ICMT` sub-chunk.
+ *
+ * The text is stored with its terminating zero and padded to an even size, as RIFF requires.
+ *
+ * @return The bytes written, chunk header included; 0 without a comment.
+ */
+uint32_t WAVFileWriter::writeComment() {
+    if (m_comment.length() == 0) {
+        return 0;
+    }
+    uint32_t textSize = m_comment.length() + 1;     // With the terminating zero
+    uint32_t padded = (textSize + 1) & ~1UL;
+    uint32_t listSize = 4 + 8 + padded;             // "INFO" and the ICMT sub-chunk
+    uint8_t chunk[20];
+    memcpy(chunk, "LIST", 4);
+    memcpy(chunk + 4, &listSize, 4);
+    memcpy(chunk + 8, "INFOICMT", 8);
+    memcpy(chunk + 16, &textSize, 4);
+    m_file.write(chunk, sizeof(chunk));
+    m_file.write((const uint8_t*)m_comment.c_str(), textSize);
+    if (padded > textSize) {
+        m_file.write((uint8_t)0);
+    }
+    return 8 + listSize;
+}
 
 /**
  * @brief Closes the WAV file and updates the WAV header with correct sizes.
  * 
- * This method finalizes the WAV file by updating the header with the correct 
- * data size and closing the file.
+ * This method writes any buffered frames, finalizes the WAV file by updating
+ * the header with the correct data size and closes the file.
  */
 void WAVFileWriter::close() {
+    if (!m_file) {
+        return; // Already closed
+    }
+
+    flushBuffer(); // Write the last partial block
+    uint32_t commentBytes = writeComment(); // After the samples, so they stay block aligned
+
     // Update the WAV header length before closing
-    m_header.dlength = m_samplesWritten * m_channels * 2; // Update data length based on actual samples written
-    m_header.flength = m_header.dlength + sizeof(m_header) - 8; // Update total file length
+    updateHeaderLengths(m_samplesWritten); // Update data length based on actual samples written
+    uint32_t riffLength = (uint32_t)m_header.flength;
+    m_header.flength = (int32_t)(riffLength > 0xFFFFFFFFUL - commentBytes ? 0xFFFFFFFFUL : riffLength + commentBytes);
 
     // Write the updated header to the file
     m_file.seek(0); // Go back to the start of the file
@@ -106,4 +272,4 @@ void WAVFileWriter::close() {
         Serial.println("SpeakerManager: Recording stopped.");
     };
 
-}
+}
\ No newline at end of file
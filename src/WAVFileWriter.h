@@ -3,6 +3,7 @@
 
 #include <SD.h> // Include your SD library
 #include <Arduino.h>
+#include "Config.h"
 
 /**
  * @brief WAVFileWriter Class for creating and writing WAV audio files.
@@ -21,6 +22,13 @@
  *   sample rate, and duration, accommodating various audio recording needs.
  * - **Efficient File Handling**: Manages the opening and closing of files on the SD card efficiently, 
  *   ensuring that resources are properly released after use.
+ * - **Buffered Block Writes**: Frames are collected in an internal buffer of `AUDIO_BLOCK_SIZE`
+ *   bytes and written to the card in whole blocks. The first block is shortened by the header
+ *   size, so every later write starts on a sector boundary of the file. Whole blocks handed to
+ *   `writeFrames` are written straight from the caller's memory.
+ * - **Comment**: Text given to `setComment` is written as a `LIST`/`INFO` chunk (`ICMT`) after
+ *   the samples on close, where players and tools show it as the file's comment. Recordings
+ *   store the gain steps of the microphone AGC there.
  * 
  * ### Example Usage:
  * 
@@ -77,16 +85,37 @@ public:
     // Function to write a frame of audio samples
     void writeFrame(int16_t left_sample, int16_t right_sample);
 
+    // Function to write a block of interleaved frames
+    size_t writeFrames(const int16_t* samples, size_t frame_count);
+
+    // Function to interleave and write separate channel blocks (right is ignored in mono)
+    size_t writeFrames(const int16_t* left, const int16_t* right, size_t frame_count);
+
+    // Number of frames written so far
+    uint64_t getFramesWritten();
+
+    // Text stored in a LIST/INFO comment (ICMT) after the samples when the file is closed
+    void setComment(const String& text);
+
     // Function to close the WAV file
     void close();
 
 private:
     File m_file;                     // SD file object for writing
     wav_header m_header;             // WAV file header structure
-    int32_t m_totalSamples;           // Total samples for the audio duration
-    int16_t m_samplesWritten;         // Samples written so far
+    uint64_t m_totalSamples;          // Total frames for the audio duration, 0 for no limit
+    uint64_t m_samplesWritten;        // Frames written so far
     short m_channels;                 // Number of audio channels (1 for mono, 2 for stereo)
     int32_t m_sampleRate;             // Sampling rate (e.g., 44100 Hz)
+    uint32_t m_buffer[AUDIO_BLOCK_SIZE / sizeof(uint32_t)]; // Block buffer, word aligned for the SD driver
+    size_t m_bufferUsed;              // Bytes waiting in m_buffer
+    size_t m_bufferLimit;             // Bytes that end the current block on a sector boundary
+    String m_comment;                 // ICMT text written by close(), empty for none
+
+    size_t writableFrames(size_t frame_count); // Clamp a request to the duration limit
+    void flushBuffer();               // Write the buffered bytes to the card
+    void updateHeaderLengths(uint64_t frames); // Fill the RIFF and data lengths
+    uint32_t writeComment();          // Append the LIST/INFO chunk, returns its size
 
     // Additional private members can be declared here if necessary
 };
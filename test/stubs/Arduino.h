@@ -0,0 +1,157 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the Arduino core, for the `native` test environment only.
+ *
+ * Covers what the DSP, parsing and audio units use: fixed-width types, `constrain`, `String`,
+ * the time functions, a `Serial` that discards its output and the GPIO calls. Outputs keep
+ * the level written, inputs read HIGH (idle buttons are pulled up), and `analogRead()` returns
+ * what the source a test installs with `hostAnalogSource()` returns. Nothing here is built
+ * into the firmware.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline unsigned long micros() {
+    using namespace std::chrono;
+    return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline unsigned long millis() {
+    return micros() / 1000;
+}
+
+inline void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void* ps_malloc(size_t size) {
+    return malloc(size);
+}
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+struct HostPins {
+    std::mutex lock;
+    std::map<uint8_t, int> levels;  // Last level written to each pin
+};
+
+inline HostPins& hostPins() {
+    static HostPins pins;
+    return pins;
+}
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+    std::lock_guard<std::mutex> guard(hostPins().lock);
+    hostPins().levels[pin] = level;
+}
+inline int digitalRead(uint8_t pin) {
+    std::lock_guard<std::mutex> guard(hostPins().lock);
+    std::map<uint8_t, int>::const_iterator level = hostPins().levels.find(pin);
+    return level == hostPins().levels.end() ? HIGH : level->second;
+}
+
+/// Reading of an analog pin, installed by a test; analogRead() returns mid-scale without one
+typedef int (*HostAnalogSource)(uint8_t pin);
+
+inline std::atomic<HostAnalogSource>& hostAnalogSource() {
+    static std::atomic<HostAnalogSource> source(nullptr);
+    return source;
+}
+
+inline int analogRead(uint8_t pin) {
+    HostAnalogSource source = hostAnalogSource().load();
+    return source ? source(pin) : 512;
+}
+inline void analogReadResolution(uint8_t) {}
+
+inline void esp_sleep_enable_timer_wakeup(uint64_t) {}
+inline void esp_deep_sleep_start() { abort(); } // Never returns on the target either
+
+/// ADC channel of a pin as on the ESP32-S3: GPIO1-10 are ADC1, GPIO11-20 ADC2, the rest none
+inline int8_t digitalPinToAnalogChannel(uint8_t pin) {
+    return pin >= 1 && pin <= 20 ? (int8_t)(pin - 1) : -1;
+}
+
+class String {
+public:
+    String() {}
+    String(const char* text) { if (text) m_text = text; }
+    String(const std::string& text) : m_text(text) {}
+    explicit String(int value) : m_text(std::to_string(value)) {}
+    explicit String(unsigned int value) : m_text(std::to_string(value)) {}
+    explicit String(long value) : m_text(std::to_string(value)) {}
+    explicit String(unsigned long value) : m_text(std::to_string(value)) {}
+    const char* c_str() const { return m_text.c_str(); }
+    unsigned int length() const { return (unsigned int)m_text.size(); }
+    bool reserve(unsigned int size) { m_text.reserve(size); return true; }
+    String& operator+=(const String& other) { m_text += other.m_text; return *this; }
+    String& operator+=(const char* text) { m_text += text; return *this; }
+    String& operator+=(char c) { m_text += c; return *this; }
+    String operator+(const String& other) const { return String(m_text + other.m_text); }
+    bool operator==(const String& other) const { return m_text == other.m_text; }
+    bool operator!=(const String& other) const { return m_text != other.m_text; }
+    bool endsWith(const String& suffix) const {
+        return m_text.size() >= suffix.m_text.size() &&
+               m_text.compare(m_text.size() - suffix.m_text.size(), suffix.m_text.size(), suffix.m_text) == 0;
+    }
+    int indexOf(const char* text) const {
+        size_t at = m_text.find(text);
+        return at == std::string::npos ? -1 : (int)at;
+    }
+    char operator[](unsigned int i) const { return i < m_text.size() ? m_text[i] : 0; }
+    void toLowerCase() {
+        for (size_t i = 0; i < m_text.size(); i++) m_text[i] = (char)tolower((unsigned char)m_text[i]);
+    }
+
+private:
+    std::string m_text;
+};
+
+inline String operator+(const char* text, const String& other) {
+    return String(text) + other;
+}
+
+class HostSerial {
+public:
+    template <typename T> size_t print(const T&, int = 0) { return 0; }
+    template <typename T> size_t println(const T&, int = 0) { return 0; }
+    size_t println() { return 0; }
+    size_t printf(const char*, ...) { return 0; }
+};
+
+static HostSerial Serial;
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#endif // NATIVE_ARDUINO_H
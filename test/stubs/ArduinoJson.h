@@ -0,0 +1,6 @@
+#ifndef NATIVE_ARDUINO_JSON_H
+#define NATIVE_ARDUINO_JSON_H
+
+// Config.h includes ArduinoJson; none of the units built for the native tests use it.
+
+#endif // NATIVE_ARDUINO_JSON_H
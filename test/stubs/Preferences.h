@@ -0,0 +1,77 @@
+#ifndef NATIVE_PREFERENCES_H
+#define NATIVE_PREFERENCES_H
+
+/**
+ * @file Preferences.h
+ * @brief Host stand-in for the NVS key-value store, for the `native` test environment only.
+ *
+ * Every namespace lives in memory and is shared by all `Preferences` objects, so what one
+ * object puts another reads back, as across reboots on the target. Values are kept as text.
+ */
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+
+class Preferences {
+public:
+    Preferences() : m_open(false), m_readOnly(false) {}
+
+    bool begin(const char* name, bool readOnly = false) {
+        m_name = name;
+        m_open = true;
+        m_readOnly = readOnly;
+        return true;
+    }
+    void end() { m_open = false; }
+
+    bool isKey(const char* key) { return m_open && values().count(key) > 0; }
+    bool remove(const char* key) { return writable() && values().erase(key) > 0; }
+    bool clear() {
+        if (!writable()) return false;
+        values().clear();
+        return true;
+    }
+
+    bool getBool(const char* key, bool defaultValue = false) { return isKey(key) ? values()[key] == "1" : defaultValue; }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) {
+        return isKey(key) ? (int32_t)strtol(values()[key].c_str(), nullptr, 10) : defaultValue;
+    }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) {
+        return isKey(key) ? (uint32_t)strtoul(values()[key].c_str(), nullptr, 10) : defaultValue;
+    }
+    float getFloat(const char* key, float defaultValue = NAN) {
+        return isKey(key) ? strtof(values()[key].c_str(), nullptr) : defaultValue;
+    }
+    String getString(const char* key, const String& defaultValue = String()) {
+        return isKey(key) ? String(values()[key]) : defaultValue;
+    }
+
+    size_t putBool(const char* key, bool value) { return put(key, value ? "1" : "0"); }
+    size_t putInt(const char* key, int32_t value) { return put(key, std::to_string(value)); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, std::to_string(value)); }
+    size_t putFloat(const char* key, float value) { return put(key, std::to_string(value)); }
+    size_t putString(const char* key, const String& value) { return put(key, value.c_str()); }
+
+private:
+    typedef std::map<std::string, std::string> Namespace;
+
+    static std::map<std::string, Namespace>& store() {
+        static std::map<std::string, Namespace> namespaces;
+        return namespaces;
+    }
+    Namespace& values() { return store()[m_name]; }
+    bool writable() const { return m_open && !m_readOnly; }
+    size_t put(const char* key, const std::string& value) {
+        if (!writable()) return 0;
+        values()[key] = value;
+        return value.size();
+    }
+
+    std::string m_name;
+    bool m_open;
+    bool m_readOnly;
+};
+
+#endif // NATIVE_PREFERENCES_H
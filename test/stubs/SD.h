@@ -0,0 +1,156 @@
+#ifndef NATIVE_SD_H
+#define NATIVE_SD_H
+
+/**
+ * @file SD.h
+ * @brief Host stand-in for the SD card library, for the `native` test environment only.
+ *
+ * Files live in memory and are shared by every translation unit, so a test can write a file
+ * the unit under test then opens, and read back what it wrote. Each file also keeps a log of
+ * its writes (offset and length), so tests can check how data reaches the card. Directories
+ * are implied by the paths of the files below them and list their entries in name order.
+ */
+
+#include <Arduino.h>
+#include <time.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+struct HostFile {
+    struct Write {
+        uint32_t offset;
+        size_t length;
+    };
+    std::vector<uint8_t> data;
+    std::vector<Write> writes;
+    time_t lastWrite = 0;
+};
+
+class File {
+public:
+    File() : m_position(0), m_writable(false), m_directory(false) {}
+    File(std::shared_ptr<HostFile> file, bool writable, const std::string& path)
+        : m_file(file), m_path(path), m_position(0), m_writable(writable), m_directory(false) {}
+    File(const std::string& path, const std::vector<std::string>& entries)
+        : m_path(path), m_entries(entries), m_position(0), m_writable(false), m_directory(true) {}
+    operator bool() const { return m_file || m_directory; }
+
+    bool isDirectory() const { return m_directory; }
+    const char* path() const { return m_path.c_str(); }
+    const char* name() const {
+        size_t slash = m_path.rfind('/');
+        return m_path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    }
+    File openNextFile(const char* mode = FILE_READ);
+
+    size_t read(uint8_t* buffer, size_t length) {
+        if (!m_file || m_position >= m_file->data.size()) return 0;
+        size_t n = m_file->data.size() - m_position < length ? m_file->data.size() - m_position : length;
+        memcpy(buffer, m_file->data.data() + m_position, n);
+        m_position += n;
+        return n;
+    }
+    int read() {
+        uint8_t byte;
+        return read(&byte, 1) == 1 ? byte : -1;
+    }
+    size_t write(const uint8_t* buffer, size_t length) {
+        if (!m_file || !m_writable) return 0;
+        if (m_file->data.size() < m_position + length) m_file->data.resize(m_position + length);
+        memcpy(m_file->data.data() + m_position, buffer, length);
+        m_file->writes.push_back({ (uint32_t)m_position, length });
+        m_file->lastWrite++;
+        m_position += length;
+        return length;
+    }
+    size_t write(uint8_t byte) { return write(&byte, 1); }
+    bool seek(uint32_t position) {
+        if (!m_file || position > m_file->data.size()) return false;
+        m_position = position;
+        return true;
+    }
+    size_t position() const { return m_position; }
+    size_t size() const { return m_file ? m_file->data.size() : 0; }
+    int available() { return (int)(size() - m_position); }
+    time_t getLastWrite() { return m_file ? m_file->lastWrite : 0; }
+    void flush() {}
+    void close() {
+        m_file.reset();
+        m_directory = false;
+    }
+
+private:
+    std::shared_ptr<HostFile> m_file;
+    std::string m_path;
+    std::vector<std::string> m_entries;  // A directory's entries, the next one at m_position
+    size_t m_position;
+    bool m_writable;
+    bool m_directory;
+};
+
+class HostSD {
+public:
+    File open(const char* path, const char* mode = FILE_READ) {
+        std::map<std::string, std::shared_ptr<HostFile> >::iterator it = m_files.find(path);
+        if (mode[0] == 'r') {
+            if (it != m_files.end()) return File(it->second, false, path);
+            std::vector<std::string> entries = list(path);
+            return entries.empty() ? File() : File(path, entries);
+        }
+        if (it == m_files.end() || mode[0] == 'w') {
+            m_files[path] = std::make_shared<HostFile>(); // FILE_WRITE truncates
+        }
+        File file(m_files[path], true, path);
+        if (mode[0] == 'a') file.seek(file.size());
+        return file;
+    }
+    File open(const String& path, const char* mode = FILE_READ) { return open(path.c_str(), mode); }
+    bool exists(const char* path) { return m_files.count(path) > 0; }
+    bool exists(const String& path) { return exists(path.c_str()); }
+    bool remove(const char* path) { return m_files.erase(path) > 0; }
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool mkdir(const char*) { return true; }
+
+    // Test helpers
+    std::shared_ptr<HostFile> file(const char* path) { return m_files.count(path) ? m_files[path] : nullptr; }
+    void put(const char* path, const std::vector<uint8_t>& data) {
+        std::shared_ptr<HostFile> file = std::make_shared<HostFile>();
+        file->data = data;
+        m_files[path] = file;
+    }
+    void clear() { m_files.clear(); }
+
+private:
+    /// Paths of the files and directories directly below `path`, empty if there are none
+    std::vector<std::string> list(const std::string& path) {
+        std::string prefix = path == "/" ? path : path + "/";
+        std::vector<std::string> entries;
+        for (std::map<std::string, std::shared_ptr<HostFile> >::iterator it = m_files.lower_bound(prefix);
+             it != m_files.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+            std::string entry = it->first.substr(0, it->first.find('/', prefix.size()));
+            if (entries.empty() || entries.back() != entry) entries.push_back(entry);
+        }
+        return entries;
+    }
+
+    std::map<std::string, std::shared_ptr<HostFile> > m_files;
+};
+
+inline HostSD& hostSD() {
+    static HostSD sd; // One card for every translation unit
+    return sd;
+}
+
+inline File File::openNextFile(const char* mode) {
+    if (!m_directory || m_position >= m_entries.size()) return File();
+    return hostSD().open(m_entries[m_position++].c_str(), mode);
+}
+
+#define SD hostSD()
+
+#endif // NATIVE_SD_H
@@ -0,0 +1,8 @@
+#ifndef NATIVE_WIRE_H
+#define NATIVE_WIRE_H
+
+// Host stand-in for the I2C bus (`native` tests only): headers only need the type.
+
+class TwoWire {};
+
+#endif // NATIVE_WIRE_H
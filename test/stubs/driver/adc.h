@@ -0,0 +1,71 @@
+#ifndef NATIVE_DRIVER_ADC_H
+#define NATIVE_DRIVER_ADC_H
+
+/**
+ * @file adc.h
+ * @brief Host stand-in for the ESP-IDF continuous ADC driver, for the `native` test environment only.
+ *
+ * Only the declarations: the continuous mode is not simulated and every call fails. The
+ * toy's microphone pin has no ADC1 channel (`digitalPinToAnalogChannel()` returns -1 for it,
+ * as on the ESP32-S3), so `MicManager` polls `analogRead()`, which the Arduino stub feeds.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#define SOC_ADC_MAX_CHANNEL_NUM 10
+#define SOC_ADC_DIGI_RESULT_BYTES 4
+
+typedef enum { ADC_ATTEN_DB_0 = 0, ADC_ATTEN_DB_2_5 = 1, ADC_ATTEN_DB_6 = 2, ADC_ATTEN_DB_11 = 3 } adc_atten_t;
+typedef enum { ADC_CONV_SINGLE_UNIT_1 = 1, ADC_CONV_SINGLE_UNIT_2 = 2, ADC_CONV_BOTH_UNIT = 3 } adc_digi_convert_mode_t;
+typedef enum { ADC_DIGI_OUTPUT_FORMAT_TYPE1 = 0, ADC_DIGI_OUTPUT_FORMAT_TYPE2 = 1 } adc_digi_output_format_t;
+
+typedef struct {
+    uint32_t max_store_buf_size;
+    uint32_t conv_num_each_intr;
+    uint32_t adc1_chan_mask;
+    uint32_t adc2_chan_mask;
+} adc_digi_init_config_t;
+
+typedef struct {
+    uint8_t atten;
+    uint8_t channel;
+    uint8_t unit;
+    uint8_t bit_width;
+} adc_digi_pattern_config_t;
+
+typedef struct {
+    bool conv_limit_en;
+    uint32_t conv_limit_num;
+    uint32_t pattern_num;
+    adc_digi_pattern_config_t* adc_pattern;
+    uint32_t sample_freq_hz;
+    adc_digi_convert_mode_t conv_mode;
+    adc_digi_output_format_t format;
+} adc_digi_configuration_t;
+
+typedef struct {
+    union {
+        struct {
+            uint32_t data : 12;
+            uint32_t reserved12 : 1;
+            uint32_t channel : 4;
+            uint32_t unit : 1;
+            uint32_t reserved17_31 : 14;
+        } type2;
+        uint32_t val;
+    };
+} adc_digi_output_data_t;
+
+inline esp_err_t adc_digi_initialize(const adc_digi_init_config_t*) { return ESP_FAIL; }
+inline esp_err_t adc_digi_controller_configure(const adc_digi_configuration_t*) { return ESP_FAIL; }
+inline esp_err_t adc_digi_start() { return ESP_FAIL; }
+inline esp_err_t adc_digi_stop() { return ESP_FAIL; }
+inline esp_err_t adc_digi_deinitialize() { return ESP_FAIL; }
+inline esp_err_t adc_digi_read_bytes(uint8_t*, uint32_t, uint32_t* length, uint32_t) {
+    *length = 0;
+    return ESP_ERR_TIMEOUT;
+}
+
+#endif // NATIVE_DRIVER_ADC_H
@@ -0,0 +1,210 @@
+#ifndef NATIVE_DRIVER_I2S_H
+#define NATIVE_DRIVER_I2S_H
+
+/**
+ * @file i2s.h
+ * @brief Host stand-in for the legacy ESP-IDF I2S driver, for the `native` test environment only.
+ *
+ * The DMA buffers are a queue of `dma_buf_count * dma_buf_len` stereo frames that the "codec"
+ * plays out in real time at the configured sample rate while the driver is started. An empty
+ * queue plays silence, like `tx_desc_auto_clear`, and `i2s_write()` blocks until there is room
+ * or its timeout expires. Tests can record every frame played in `hostI2S().heard` and count
+ * driver installs and clock changes. There is one port, shared by every translation unit.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+
+typedef enum { I2S_NUM_0 = 0, I2S_NUM_MAX } i2s_port_t;
+typedef enum { I2S_MODE_MASTER = 1 << 0, I2S_MODE_SLAVE = 1 << 1, I2S_MODE_TX = 1 << 2, I2S_MODE_RX = 1 << 3 } i2s_mode_t;
+typedef enum { I2S_BITS_PER_SAMPLE_16BIT = 16, I2S_BITS_PER_SAMPLE_32BIT = 32 } i2s_bits_per_sample_t;
+typedef enum { I2S_CHANNEL_MONO = 1, I2S_CHANNEL_STEREO = 2 } i2s_channel_t;
+typedef enum { I2S_CHANNEL_FMT_RIGHT_LEFT = 0, I2S_CHANNEL_FMT_ONLY_LEFT = 3 } i2s_channel_fmt_t;
+typedef enum { I2S_COMM_FORMAT_STAND_I2S = 1, I2S_COMM_FORMAT_I2S = 1 } i2s_comm_format_t;
+
+#define I2S_PIN_NO_CHANGE (-1)
+
+typedef struct {
+    int mck_io_num;
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+typedef struct {
+    i2s_mode_t mode;
+    uint32_t sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool use_apll;
+    bool tx_desc_auto_clear;
+    int fixed_mclk;
+} i2s_config_t;
+
+struct HostI2S {
+    std::mutex lock;
+    bool installed = false;
+    bool started = false;
+    uint32_t installs = 0;          // i2s_driver_install() calls that succeeded
+    uint32_t uninstalls = 0;
+    uint32_t clockChanges = 0;      // i2s_set_clk() calls
+    uint32_t sampleRate = 0;
+    size_t capacity = 0;            // Samples the DMA buffers hold
+    std::deque<int16_t> dma;        // Samples queued and not played yet
+    bool recording = false;         // Append every played sample to `heard`
+    std::vector<int16_t> heard;
+    uint64_t playedUntilUs = 0;     // Time the playback below has been simulated up to
+
+    /// Plays out the frames due since the last call, silence once the queue is empty. Call locked.
+    void advance() {
+        uint64_t now = micros();
+        if (!started || sampleRate == 0) {
+            playedUntilUs = now;
+            return;
+        }
+        uint64_t frames = (now - playedUntilUs) * sampleRate / 1000000ULL;
+        playedUntilUs += frames * 1000000ULL / sampleRate;
+        for (uint64_t i = 0; i < frames * 2; i++) {
+            int16_t sample = 0;
+            if (!dma.empty()) {
+                sample = dma.front();
+                dma.pop_front();
+            }
+            if (recording) heard.push_back(sample);
+        }
+    }
+
+    /// Starts recording what is played from now on
+    void record() {
+        std::lock_guard<std::mutex> guard(lock);
+        advance();
+        heard.clear();
+        recording = true;
+    }
+
+    /// Stops recording and returns what was played
+    std::vector<int16_t> takeHeard() {
+        std::lock_guard<std::mutex> guard(lock);
+        advance();
+        recording = false;
+        std::vector<int16_t> played;
+        played.swap(heard);
+        return played;
+    }
+};
+
+inline HostI2S& hostI2S() {
+    static HostI2S port;
+    return port;
+}
+
+inline esp_err_t i2s_driver_install(i2s_port_t, const i2s_config_t* config, int, void*) {
+    HostI2S& port = hostI2S();
+    std::lock_guard<std::mutex> guard(port.lock);
+    if (port.installed) return ESP_ERR_INVALID_STATE;
+    port.installed = true;
+    port.installs++;
+    port.sampleRate = config->sample_rate;
+    port.capacity = (size_t)config->dma_buf_count * config->dma_buf_len * 2;
+    port.dma.clear();
+    port.started = true; // The IDF starts the driver on install
+    port.playedUntilUs = micros();
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_driver_uninstall(i2s_port_t) {
+    HostI2S& port = hostI2S();
+    std::lock_guard<std::mutex> guard(port.lock);
+    if (!port.installed) return ESP_ERR_INVALID_STATE;
+    port.installed = false;
+    port.started = false;
+    port.uninstalls++;
+    port.dma.clear();
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_set_pin(i2s_port_t, const i2s_pin_config_t*) {
+    return hostI2S().installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+inline esp_err_t i2s_start(i2s_port_t) {
+    HostI2S& port = hostI2S();
+    std::lock_guard<std::mutex> guard(port.lock);
+    if (!port.installed) return ESP_ERR_INVALID_STATE;
+    port.advance();
+    port.started = true;
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_stop(i2s_port_t) {
+    HostI2S& port = hostI2S();
+    std::lock_guard<std::mutex> guard(port.lock);
+    if (!port.installed) return ESP_ERR_INVALID_STATE;
+    port.advance();
+    port.started = false;
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_zero_dma_buffer(i2s_port_t) {
+    HostI2S& port = hostI2S();
+    std::lock_guard<std::mutex> guard(port.lock);
+    if (!port.installed) return ESP_ERR_INVALID_STATE;
+    port.advance();
+    port.dma.clear();
+    return ESP_OK;
+}
+
+/// Reprograms the clock and restarts the driver, as the IDF does; the queued samples are kept
+inline esp_err_t i2s_set_clk(i2s_port_t, uint32_t rate, uint32_t, i2s_channel_t) {
+    HostI2S& port = hostI2S();
+    std::lock_guard<std::mutex> guard(port.lock);
+    if (!port.installed) return ESP_ERR_INVALID_STATE;
+    port.advance();
+    port.sampleRate = rate;
+    port.clockChanges++;
+    port.started = true;
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_write(i2s_port_t, const void* src, size_t size, size_t* bytes_written, TickType_t ticks_to_wait) {
+    HostI2S& port = hostI2S();
+    const int16_t* samples = static_cast<const int16_t*>(src);
+    const size_t count = size / sizeof(int16_t);
+    const uint32_t start = millis();
+    size_t done = 0;
+    *bytes_written = 0;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> guard(port.lock);
+            if (!port.installed) return ESP_ERR_INVALID_STATE;
+            port.advance();
+            while (done < count && port.dma.size() < port.capacity) {
+                port.dma.push_back(samples[done++]);
+            }
+        }
+        if (done == count || (ticks_to_wait != portMAX_DELAY && millis() - start >= ticks_to_wait)) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(500)); // About 22 frames at 44.1 kHz
+    }
+    *bytes_written = done * sizeof(int16_t);
+    return ESP_OK;
+}
+
+#endif // NATIVE_DRIVER_I2S_H
@@ -0,0 +1,17 @@
+#ifndef NATIVE_ESP_HEAP_CAPS_H
+#define NATIVE_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+
+// Host stand-in for the capability allocator (`native` tests only): every region is the heap.
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+inline void* heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline void* heap_caps_realloc(void* pointer, size_t size, uint32_t) { return realloc(pointer, size); }
+inline void heap_caps_free(void* pointer) { free(pointer); }
+
+#endif // NATIVE_ESP_HEAP_CAPS_H
@@ -0,0 +1,103 @@
+#ifndef NATIVE_ESP_PARTITION_H
+#define NATIVE_ESP_PARTITION_H
+
+/**
+ * @file esp_partition.h
+ * @brief Host stand-in for the flash partition API, for the `native` test environment only.
+ *
+ * The partition table lives in memory and is shared by every translation unit. A test adds a
+ * partition with `hostPartitions().add()` and fills its bytes (erased flash is 0xFF), and
+ * the unit under test finds, reads and maps it as on the target. `clear()` empties the table.
+ */
+
+#include <string.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <esp_err.h>
+#include <esp_spi_flash.h>
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef enum { ESP_PARTITION_SUBTYPE_ANY = 0xff } esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+struct HostPartition {
+    esp_partition_t info;
+    std::vector<uint8_t> data;
+};
+
+class HostPartitions {
+public:
+    /// Adds an erased partition and returns its bytes for the test to fill
+    std::vector<uint8_t>& add(esp_partition_type_t type, uint8_t subtype, const char* label, uint32_t size) {
+        std::shared_ptr<HostPartition> partition(new HostPartition());
+        memset(&partition->info, 0, sizeof(partition->info));
+        partition->info.type = type;
+        partition->info.subtype = (esp_partition_subtype_t)subtype;
+        partition->info.address = 0x10000 * (uint32_t)(m_partitions.size() + 1);
+        partition->info.size = size;
+        strncpy(partition->info.label, label, sizeof(partition->info.label) - 1);
+        partition->data.assign(size, 0xFF);
+        m_partitions.push_back(partition);
+        return partition->data;
+    }
+    void clear() { m_partitions.clear(); }
+
+    const esp_partition_t* find(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label) {
+        for (size_t i = 0; i < m_partitions.size(); i++) {
+            const esp_partition_t& info = m_partitions[i]->info;
+            if (info.type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || info.subtype == subtype) &&
+                (!label || strcmp(info.label, label) == 0)) {
+                return &info;
+            }
+        }
+        return nullptr;
+    }
+    HostPartition* of(const esp_partition_t* info) {
+        for (size_t i = 0; i < m_partitions.size(); i++) {
+            if (&m_partitions[i]->info == info) return m_partitions[i].get();
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<std::shared_ptr<HostPartition> > m_partitions;
+};
+
+inline HostPartitions& hostPartitions() {
+    static HostPartitions partitions;
+    return partitions;
+}
+
+inline const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                       const char* label) {
+    return hostPartitions().find(type, subtype, label);
+}
+
+inline esp_err_t esp_partition_read(const esp_partition_t* info, size_t offset, void* dst, size_t size) {
+    HostPartition* partition = hostPartitions().of(info);
+    if (!partition) return ESP_ERR_INVALID_ARG;
+    if (offset > partition->data.size() || size > partition->data.size() - offset) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, partition->data.data() + offset, size);
+    return ESP_OK;
+}
+
+inline esp_err_t esp_partition_mmap(const esp_partition_t* info, size_t offset, size_t size,
+                                    spi_flash_mmap_memory_t, const void** out, spi_flash_mmap_handle_t* handle) {
+    HostPartition* partition = hostPartitions().of(info);
+    if (!partition) return ESP_ERR_INVALID_ARG;
+    if (offset > partition->data.size() || size > partition->data.size() - offset) return ESP_ERR_INVALID_SIZE;
+    *out = partition->data.data() + offset;
+    *handle = 1;
+    return ESP_OK;
+}
+
+#endif // NATIVE_ESP_PARTITION_H
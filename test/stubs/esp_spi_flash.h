@@ -0,0 +1,14 @@
+#ifndef NATIVE_ESP_SPI_FLASH_H
+#define NATIVE_ESP_SPI_FLASH_H
+
+#include <stdint.h>
+
+// Host stand-in for the flash cache mapping (`native` tests only): a mapping is the partition's
+// own memory, see esp_partition.h, so there is nothing to unmap.
+
+typedef uint32_t spi_flash_mmap_handle_t;
+typedef enum { SPI_FLASH_MMAP_DATA = 0, SPI_FLASH_MMAP_INST = 1 } spi_flash_mmap_memory_t;
+
+inline void spi_flash_munmap(spi_flash_mmap_handle_t) {}
+
+#endif // NATIVE_ESP_SPI_FLASH_H
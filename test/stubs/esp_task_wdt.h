@@ -0,0 +1,10 @@
+#ifndef NATIVE_ESP_TASK_WDT_H
+#define NATIVE_ESP_TASK_WDT_H
+
+// Host stand-in for the task watchdog (`native` tests only): there is nothing to feed.
+
+inline int esp_task_wdt_reset() {
+    return 0;
+}
+
+#endif // NATIVE_ESP_TASK_WDT_H
@@ -0,0 +1,15 @@
+#ifndef NATIVE_ESP_TIMER_H
+#define NATIVE_ESP_TIMER_H
+
+#include <stdint.h>
+#include <chrono>
+
+/**
+ * @brief Host stand-in for the ESP-IDF microsecond timer (`native` tests only).
+ */
+inline int64_t esp_timer_get_time() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // NATIVE_ESP_TIMER_H
@@ -0,0 +1,29 @@
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+#include <stdint.h>
+#include <mutex>
+
+// Host stand-in for the FreeRTOS types the units mention (`native` tests only).
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// Critical sections: one lock for the whole host process is enough for the tests
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+inline std::recursive_mutex& hostCriticalLock() {
+    static std::recursive_mutex lock;
+    return lock;
+}
+#define portENTER_CRITICAL(mux) hostCriticalLock().lock()
+#define portEXIT_CRITICAL(mux) hostCriticalLock().unlock()
+
+#endif // NATIVE_FREERTOS_H
@@ -0,0 +1,69 @@
+#ifndef NATIVE_FREERTOS_QUEUE_H
+#define NATIVE_FREERTOS_QUEUE_H
+
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "FreeRTOS.h"
+
+// Queues of fixed-size items copied in and out, as in FreeRTOS (`native` tests only).
+
+struct HostQueue {
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<std::vector<uint8_t> > items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+typedef HostQueue* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    HostQueue* queue = new HostQueue();
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+inline void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    auto room = [queue]() { return queue->items.size() < queue->length; };
+    if (ticks == portMAX_DELAY) {
+        queue->wake.wait(guard, room);
+    } else if (!queue->wake.wait_for(guard, std::chrono::milliseconds(ticks), room)) {
+        return pdFALSE;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(item);
+    queue->items.push_back(std::vector<uint8_t>(bytes, bytes + queue->itemSize));
+    queue->wake.notify_all();
+    return pdTRUE;
+}
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    std::unique_lock<std::mutex> guard(queue->lock);
+    auto ready = [queue]() { return !queue->items.empty(); };
+    if (ticks == portMAX_DELAY) {
+        queue->wake.wait(guard, ready);
+    } else if (!queue->wake.wait_for(guard, std::chrono::milliseconds(ticks), ready)) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->wake.notify_all();
+    return pdTRUE;
+}
+inline BaseType_t xQueueReset(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    queue->items.clear();
+    queue->wake.notify_all();
+    return pdPASS;
+}
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->lock);
+    return (UBaseType_t)queue->items.size();
+}
+
+#endif // NATIVE_FREERTOS_QUEUE_H
@@ -0,0 +1,49 @@
+#ifndef NATIVE_FREERTOS_SEMPHR_H
+#define NATIVE_FREERTOS_SEMPHR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "FreeRTOS.h"
+
+// Mutexes, binary and counting semaphores as one counting semaphore (`native` tests only).
+
+struct HostSemaphore {
+    std::mutex lock;
+    std::condition_variable wake;
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+typedef HostSemaphore* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t hostSemaphore(UBaseType_t max, UBaseType_t initial) {
+    HostSemaphore* semaphore = new HostSemaphore();
+    semaphore->count = initial;
+    semaphore->max = max;
+    return semaphore;
+}
+inline SemaphoreHandle_t xSemaphoreCreateMutex() { return hostSemaphore(1, 1); }
+inline SemaphoreHandle_t xSemaphoreCreateBinary() { return hostSemaphore(1, 0); }
+inline SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) { return hostSemaphore(max, initial); }
+inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) { delete semaphore; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    std::unique_lock<std::mutex> guard(semaphore->lock);
+    if (ticks == portMAX_DELAY) {
+        semaphore->wake.wait(guard, [semaphore]() { return semaphore->count > 0; });
+    } else if (!semaphore->wake.wait_for(guard, std::chrono::milliseconds(ticks), [semaphore]() { return semaphore->count > 0; })) {
+        return pdFALSE;
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->lock);
+    if (semaphore->count >= semaphore->max) return pdFALSE;
+    semaphore->count++;
+    semaphore->wake.notify_one();
+    return pdTRUE;
+}
+
+#endif // NATIVE_FREERTOS_SEMPHR_H
@@ -0,0 +1,72 @@
+#ifndef NATIVE_FREERTOS_TASK_H
+#define NATIVE_FREERTOS_TASK_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "FreeRTOS.h"
+
+// Tasks run on detached host threads. A tick is a millisecond, as on the target, and a delay
+// sleeps for its ticks. Task records are never freed, a test creates a few.
+
+struct HostTask {
+    std::mutex lock;
+    std::condition_variable wake;
+    uint32_t notified = 0;
+};
+
+typedef HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+inline HostTask*& hostCurrentTask() {
+    static thread_local HostTask* task = nullptr;
+    return task;
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+inline TickType_t xTaskGetTickCount() {
+    using namespace std::chrono;
+    return (TickType_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+#define taskYIELD() std::this_thread::yield()
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char*, uint32_t, void* parameter,
+                              UBaseType_t, TaskHandle_t* handle) {
+    HostTask* task = new HostTask();
+    if (handle) *handle = task; // Before the task runs, as on the target
+    std::thread([function, parameter, task]() {
+        hostCurrentTask() = task;
+        function(parameter);
+    }).detach();
+    return pdPASS;
+}
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack, void* parameter,
+                                          UBaseType_t priority, TaskHandle_t* handle, BaseType_t) {
+    return xTaskCreate(function, name, stack, parameter, priority, handle);
+}
+inline void vTaskDelete(TaskHandle_t) {} // Always the last call of a task function, which then returns
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return hostCurrentTask();
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (!task) return pdFALSE;
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->notified++;
+    task->wake.notify_one();
+    return pdPASS;
+}
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+    HostTask* task = hostCurrentTask();
+    if (!task) return 0;
+    std::unique_lock<std::mutex> guard(task->lock);
+    task->wake.wait_for(guard, std::chrono::milliseconds(ticks), [task]() { return task->notified > 0; });
+    uint32_t value = task->notified;
+    if (value > 0) task->notified = clear ? 0 : value - 1;
+    return value;
+}
+
+#endif // NATIVE_FREERTOS_TASK_H
@@ -0,0 +1,133 @@
+#ifndef NATIVE_MP3DEC_H
+#define NATIVE_MP3DEC_H
+
+/**
+ * @file mp3dec.h
+ * @brief Host stand-in for the Helix MP3 decoder, for the `native` test environment only.
+ *
+ * The real decoder is not built on the host. This one keeps the Helix interface and the
+ * framing of MPEG-1/2/2.5 Layer III: the sync word, the frame header, the frame length
+ * from the bitrate, sample rate and padding bit, and the samples per frame. Only the
+ * payload is synthetic, so fixtures stay small and their output is known:
+ *
+ * - byte 0 of the payload stands for `main_data_begin`: a frame that is not 0 there needs
+ *   the bit reservoir, and returns `ERR_MP3_MAINDATA_UNDERFLOW` as the first frame decoded
+ *   after `MP3InitDecoder()`;
+ * - bytes 1 and 2 are the little-endian value of every sample the frame decodes to.
+ *
+ * This lets the units that wrap Helix be tested on their ID3, sync, buffering and underflow
+ * handling. The audio quality of the real decoder is only checked on the board.
+ */
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MAX_NCHAN 2
+#define MAX_NGRAN 2
+#define MAX_NSAMP 576
+#define MAINBUF_SIZE 1940
+
+typedef void* HMP3Decoder;
+
+enum {
+    ERR_MP3_NONE = 0,
+    ERR_MP3_INDATA_UNDERFLOW = -1,
+    ERR_MP3_MAINDATA_UNDERFLOW = -2,
+    ERR_MP3_FREE_BITRATE_SYNC = -3,
+    ERR_MP3_OUT_OF_MEMORY = -4,
+    ERR_MP3_NULL_POINTER = -5,
+    ERR_MP3_INVALID_FRAMEHEADER = -6
+};
+
+typedef struct _MP3FrameInfo {
+    int bitrate;
+    int nChans;
+    int samprate;
+    int bitsPerSample;
+    int outputSamps;
+    int layer;
+    int version;
+} MP3FrameInfo;
+
+struct HostMp3Decoder {
+    MP3FrameInfo last;                  // Info of the last frame decoded
+    unsigned int frames;                // Frames seen since MP3InitDecoder()
+};
+
+/// Parses a Layer III frame header; returns the frame length in bytes, or 0 if it is not one
+inline int hostMp3ParseHeader(const unsigned char* header, MP3FrameInfo* info) {
+    static const int bitrates[2][15] = {
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 }, // MPEG-1
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 }      // MPEG-2 and 2.5
+    };
+    static const int rates[3][3] = { { 44100, 48000, 32000 }, { 22050, 24000, 16000 }, { 11025, 12000, 8000 } };
+    if (header[0] != 0xFF || (header[1] & 0xE0) != 0xE0) return 0;
+    const int versionBits = (header[1] >> 3) & 3; // 3 MPEG-1, 2 MPEG-2, 0 MPEG-2.5
+    const int layerBits = (header[1] >> 1) & 3;   // 1 Layer III
+    const int bitrateIndex = header[2] >> 4;
+    const int rateIndex = (header[2] >> 2) & 3;
+    if (versionBits == 1 || layerBits != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3) return 0;
+    const int version = versionBits == 3 ? 0 : versionBits == 2 ? 1 : 2;
+    info->bitrate = bitrates[version ? 1 : 0][bitrateIndex] * 1000;
+    info->samprate = rates[version][rateIndex];
+    info->nChans = (header[3] >> 6) == 3 ? 1 : 2;
+    info->bitsPerSample = 16;
+    info->outputSamps = (version ? 1 : 2) * MAX_NSAMP * info->nChans;
+    info->layer = 3;
+    info->version = version;
+    return (version ? 72 : 144) * info->bitrate / info->samprate + ((header[2] >> 1) & 1);
+}
+
+inline HMP3Decoder MP3InitDecoder(void) {
+    HostMp3Decoder* decoder = new HostMp3Decoder();
+    memset(decoder, 0, sizeof(*decoder));
+    return decoder;
+}
+inline void MP3FreeDecoder(HMP3Decoder decoder) { delete static_cast<HostMp3Decoder*>(decoder); }
+
+inline int MP3FindSyncWord(unsigned char* buf, int nBytes) {
+    for (int i = 0; i < nBytes - 1; i++) {
+        if (buf[i] == 0xFF && (buf[i + 1] & 0xE0) == 0xE0) return i;
+    }
+    return -1;
+}
+
+inline int MP3GetNextFrameInfo(HMP3Decoder, MP3FrameInfo* info, unsigned char* buf) {
+    return hostMp3ParseHeader(buf, info) > 0 ? ERR_MP3_NONE : ERR_MP3_INVALID_FRAMEHEADER;
+}
+
+inline void MP3GetLastFrameInfo(HMP3Decoder decoder, MP3FrameInfo* info) {
+    *info = static_cast<HostMp3Decoder*>(decoder)->last;
+}
+
+inline int MP3Decode(HMP3Decoder handle, unsigned char** inbuf, int* bytesLeft, short* outbuf, int) {
+    HostMp3Decoder* decoder = static_cast<HostMp3Decoder*>(handle);
+    if (!decoder || !inbuf || !*inbuf || !bytesLeft || !outbuf) return ERR_MP3_NULL_POINTER;
+    if (*bytesLeft < 4) return ERR_MP3_INDATA_UNDERFLOW;
+    MP3FrameInfo info;
+    const int length = hostMp3ParseHeader(*inbuf, &info);
+    if (length == 0) return ERR_MP3_INVALID_FRAMEHEADER;
+    if (*bytesLeft < length) return ERR_MP3_INDATA_UNDERFLOW;
+
+    const unsigned char* payload = *inbuf + 4;
+    *inbuf += length;
+    *bytesLeft -= length;
+    const bool warmUp = payload[0] != 0 && decoder->frames == 0;
+    decoder->frames++;
+    if (warmUp) {
+        return ERR_MP3_MAINDATA_UNDERFLOW; // The reservoir this frame refers back to was never read
+    }
+    const short value = (short)(payload[1] | payload[2] << 8);
+    for (int i = 0; i < info.outputSamps; i++) outbuf[i] = value;
+    decoder->last = info;
+    return ERR_MP3_NONE;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NATIVE_MP3DEC_H
@@ -0,0 +1,193 @@
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "AudioMixer.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the effect mixer: voices, saturation, mono and low-rate sounds, ducking and retiring.
+ */
+
+static int16_t effect[4 * MIXER_BLOCK_SAMPLES];
+
+static AudioMixer::Sound sound(int16_t value, size_t count) {
+    for (size_t i = 0; i < count; i++) effect[i] = value;
+    AudioMixer::Sound s = { effect, count, false, 0 };
+    return s;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_voice_slots() {
+    AudioMixer mixer;
+    AudioMixer::Sound empty = { effect, 0, false, 0 };
+    TEST_ASSERT_EQUAL(-1, mixer.play(empty, GAIN_UNITY));
+    AudioMixer::Sound s = sound(1000, 64);
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        TEST_ASSERT_EQUAL(v, mixer.play(s, GAIN_UNITY));
+    }
+    TEST_ASSERT_EQUAL(-1, mixer.play(s, GAIN_UNITY)); // Every slot busy
+    TEST_ASSERT_TRUE(mixer.isActive());
+}
+
+static void test_render_sums_and_saturates() {
+    AudioMixer mixer;
+    AudioMixer::Sound s = sound(20000, 64);
+    mixer.play(s, GAIN_UNITY);
+    mixer.play(s, GAIN_UNITY / 2);
+    size_t count = 64;
+    int16_t* out = mixer.render(count);
+    TEST_ASSERT_EQUAL(64, count);
+    TEST_ASSERT_EACH_EQUAL_INT16(30000, out, 64);
+    mixer.play(s, GAIN_UNITY);
+    mixer.play(s, GAIN_UNITY);
+    count = 64;
+    out = mixer.render(count);
+    TEST_ASSERT_EACH_EQUAL_INT16(32767, out, 64); // 40000 clamps, no wrap
+    TEST_ASSERT_FALSE(mixer.isActive());        // Both sounds ended with the block
+}
+
+static void test_render_is_one_block_at_most() {
+    AudioMixer mixer;
+    size_t count = 3 * MIXER_BLOCK_SAMPLES;
+    int16_t* out = mixer.render(count);
+    TEST_ASSERT_EQUAL(MIXER_BLOCK_SAMPLES, count);
+    TEST_ASSERT_EACH_EQUAL_INT16(0, out, MIXER_BLOCK_SAMPLES);
+}
+
+static void test_sound_spans_blocks() {
+    AudioMixer mixer;
+    AudioMixer::Sound s = sound(0, 100);
+    for (size_t i = 0; i < 100; i++) effect[i] = (int16_t)i;
+    mixer.play(s, GAIN_UNITY);
+    size_t count = 64;
+    int16_t* out = mixer.render(count);
+    TEST_ASSERT_EQUAL_INT16(63, out[63]);
+    count = 64;
+    out = mixer.render(count);
+    TEST_ASSERT_EQUAL_INT16(64, out[0]);
+    TEST_ASSERT_EQUAL_INT16(99, out[35]);
+    TEST_ASSERT_EACH_EQUAL_INT16(0, out + 36, 28); // Silence after the end
+    TEST_ASSERT_FALSE(mixer.isActive());
+}
+
+static void test_mono_sound_plays_on_both_channels() {
+    AudioMixer mixer;
+    for (size_t i = 0; i < 10; i++) effect[i] = (int16_t)(100 * i);
+    AudioMixer::Sound s = { effect, 10, true, 0 };
+    mixer.play(s, GAIN_UNITY);
+    size_t count = 24;
+    int16_t* out = mixer.render(count);
+    for (size_t i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL_INT16(100 * i, out[2 * i]);
+        TEST_ASSERT_EQUAL_INT16(100 * i, out[2 * i + 1]);
+    }
+    TEST_ASSERT_EACH_EQUAL_INT16(0, out + 20, 4);
+    TEST_ASSERT_FALSE(mixer.isActive());
+}
+
+static void test_low_rate_sound_is_interpolated() {
+    AudioMixer mixer;
+    const int16_t stored[] = { 0, 400, 800, -800 };
+    for (size_t i = 0; i < 4; i++) effect[i] = stored[i];
+    AudioMixer::Sound s = { effect, 4, true, 2 }; // Quarter rate, 16 output frames
+    mixer.play(s, GAIN_UNITY);
+    const int16_t expected[] = { 0, 100, 200, 300, 400, 500, 600, 700, 800, 400, 0, -400, -800, -800, -800, -800 };
+    size_t count = 20; // Split across two passes
+    int16_t* out = mixer.render(count);
+    for (size_t f = 0; f < 10; f++) {
+        TEST_ASSERT_EQUAL_INT16(expected[f], out[2 * f]);
+        TEST_ASSERT_EQUAL_INT16(expected[f], out[2 * f + 1]);
+    }
+    count = 16;
+    out = mixer.render(count);
+    for (size_t f = 10; f < 16; f++) {
+        TEST_ASSERT_EQUAL_INT16(expected[f], out[2 * (f - 10)]);
+    }
+    TEST_ASSERT_EACH_EQUAL_INT16(0, out + 12, 4);
+    TEST_ASSERT_FALSE(mixer.isActive());
+
+    AudioMixer::Sound tooSlow = { effect, 4, true, MIXER_MAX_RATE_SHIFT + 1 };
+    TEST_ASSERT_EQUAL(-1, mixer.play(tooSlow, GAIN_UNITY));
+}
+
+static void test_narration_is_ducked_and_recovers() {
+    AudioMixer mixer;
+    int16_t block[MIXER_BLOCK_SAMPLES];
+    AudioMixer::Sound s = sound(0, 4 * MIXER_BLOCK_SAMPLES);
+    mixer.play(s, GAIN_UNITY);
+    for (int b = 0; b < 4; b++) {
+        for (size_t i = 0; i < MIXER_BLOCK_SAMPLES; i++) block[i] = 10000;
+        mixer.mix(block, MIXER_BLOCK_SAMPLES);
+    }
+    TEST_ASSERT_INT_WITHIN(1, (10000 * MIXER_DUCK_GAIN) >> 15, block[MIXER_BLOCK_SAMPLES - 1]);
+    TEST_ASSERT_FALSE(mixer.isActive());
+    for (int b = 0; b < 4; b++) {
+        for (size_t i = 0; i < MIXER_BLOCK_SAMPLES; i++) block[i] = 10000;
+        mixer.mix(block, MIXER_BLOCK_SAMPLES);
+    }
+    TEST_ASSERT_EACH_EQUAL_INT16(10000, block, MIXER_BLOCK_SAMPLES);
+}
+
+static void test_stop_retires_at_the_next_block() {
+    AudioMixer mixer;
+    AudioMixer::Sound s = sound(5000, 4 * MIXER_BLOCK_SAMPLES);
+    int voice = mixer.play(s, GAIN_UNITY);
+    size_t count = 64;
+    mixer.render(count);
+    mixer.stop(voice);
+    TEST_ASSERT_TRUE(mixer.isActive()); // Only the writer task retires a voice
+    count = 64;
+    int16_t* out = mixer.render(count);
+    TEST_ASSERT_EACH_EQUAL_INT16(0, out, 64);
+    TEST_ASSERT_FALSE(mixer.isActive());
+}
+
+static void test_start_time_is_reported_once() {
+    AudioMixer mixer;
+    AudioMixer::Sound s = sound(1, 1000);
+    mixer.play(s, GAIN_UNITY);
+    TEST_ASSERT_EQUAL_UINT32(0, mixer.takeStartedUs());
+    size_t count = 64;
+    mixer.render(count);
+    TEST_ASSERT_NOT_EQUAL(0, mixer.takeStartedUs());
+    count = 64;
+    mixer.render(count);
+    TEST_ASSERT_EQUAL_UINT32(0, mixer.takeStartedUs());
+}
+
+static void test_stop_all_waits_for_the_writer() {
+    AudioMixer mixer;
+    AudioMixer::Sound s = sound(1, 4 * MIXER_BLOCK_SAMPLES);
+    for (int v = 0; v < MIXER_VOICES; v++) {
+        mixer.play(s, GAIN_UNITY);
+    }
+    std::atomic<bool> running(true);
+    std::thread writer([&]() {
+        while (running.load()) {
+            mixer.service(); // The writer task while idle
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    mixer.stopAll();
+    bool active = mixer.isActive();
+    running.store(false);
+    writer.join();
+    TEST_ASSERT_FALSE(active);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_voice_slots);
+    RUN_TEST(test_render_sums_and_saturates);
+    RUN_TEST(test_render_is_one_block_at_most);
+    RUN_TEST(test_sound_spans_blocks);
+    RUN_TEST(test_mono_sound_plays_on_both_channels);
+    RUN_TEST(test_low_rate_sound_is_interpolated);
+    RUN_TEST(test_narration_is_ducked_and_recovers);
+    RUN_TEST(test_stop_retires_at_the_next_block);
+    RUN_TEST(test_start_time_is_reported_once);
+    RUN_TEST(test_stop_all_waits_for_the_writer);
+    return UNITY_END();
+}
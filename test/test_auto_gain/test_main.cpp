@@ -0,0 +1,175 @@
+#include <unity.h>
+#include <string>
+#include "AutoGain.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the recording AGC against a model of the microphone amplifier.
+ */
+
+static const uint32_t rate = SAMPLE_RATE;
+static const size_t captureDelay = MIC_FRAME_SAMPLES; // Capture ring between the amplifier and process()
+
+/**
+ * @brief The amplifier: a switch applies `captureDelay` samples after process() asks for it, and the
+ *        input clips at the WAV range.
+ */
+struct Amplifier {
+    int level;
+    int pending;
+    size_t pendingLeft;
+    uint32_t position;          // Stream samples so far
+    uint32_t lastSwitchAt;      // Stream sample the last switch lands at
+    double energy;              // Output energy of the last run() from `measureFrom` on
+    uint32_t measured;
+};
+
+static Amplifier amplifier(AutoGain& agc) {
+    Amplifier amp = { agc.getLevel(), -1, 0, 0, 0, 0.0, 0 };
+    return amp;
+}
+
+/**
+ * @brief Feeds `ms` of a 160 Hz tone whose RMS is `speechDb` dBFS at the lowest hardware level,
+ *        in capture frames, and measures the output over the last second.
+ *
+ * @return The number of hardware switches asked for.
+ */
+static int run(AutoGain& agc, Amplifier& amp, int speechDb, uint32_t ms, bool speech = true) {
+    int16_t block[MIC_FRAME_SAMPLES];
+    const uint32_t length = ms * rate / 1000;
+    const float amplitude = sqrtf(2.0f) * 32768.0f * powf(10.0f, speechDb / 20.0f);
+    int switches = 0;
+    amp.energy = 0.0;
+    amp.measured = 0;
+    for (uint32_t t = 0; t < length; t += MIC_FRAME_SAMPLES) {
+        size_t n = length - t < MIC_FRAME_SAMPLES ? length - t : MIC_FRAME_SAMPLES;
+        for (size_t i = 0; i < n; i++) {
+            if (amp.pending >= 0 && amp.pendingLeft-- == 0) {
+                amp.level = amp.pending;
+                amp.pending = -1;
+            }
+            float v = amplitude * powf(10.0f, amp.level * MIC_GAIN_STEP_DB / 20.0f) *
+                      sinf(2.0f * (float)M_PI * 160.0f * (amp.position + i) / rate);
+            block[i] = (int16_t)(v >= 32767.0f ? 32767 : (v <= -32768.0f ? -32768 : v));
+        }
+        if (agc.process(block, n, speech, captureDelay)) {
+            amp.pending = agc.getLevel();
+            amp.pendingLeft = captureDelay;
+            amp.lastSwitchAt = amp.position + n + captureDelay;
+            switches++;
+        }
+        if (t + rate >= length) {
+            for (size_t i = 0; i < n; i++) amp.energy += (double)block[i] * block[i];
+            amp.measured += n;
+        }
+        amp.position += n;
+    }
+    return switches;
+}
+
+static float outputDb(const Amplifier& amp) {
+    return (float)(10.0 * log10(amp.energy / amp.measured / (32768.0 * 32768.0) + 1e-12));
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_db_to_gain() {
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, AutoGain::dbToGain(0));
+    TEST_ASSERT_INT_WITHIN(2, 16423, AutoGain::dbToGain(-6));
+    TEST_ASSERT_INT_WITHIN(2, 2066, AutoGain::dbToGain(-AGC_MAX_CUT_DB));
+}
+
+static void test_reset_logs_the_starting_gain() {
+    AutoGain agc;
+    TEST_ASSERT_EQUAL(MIC_GAIN_DEFAULT_LEVEL, agc.getLevel());
+    TEST_ASSERT_EQUAL(0, agc.getDigitalDb());
+    TEST_ASSERT_EQUAL_STRING("AGC dB at sample (microphone+digital): 0:50+0", agc.describe(0, 1000).c_str());
+}
+
+static void test_loud_speech_is_cut_digitally() {
+    AutoGain agc;
+    Amplifier amp = amplifier(agc);
+    TEST_ASSERT_EQUAL(0, run(agc, amp, -30, 5000)); // -20 dBFS at the default level, within the digital range
+    TEST_ASSERT_EQUAL(MIC_GAIN_DEFAULT_LEVEL, agc.getLevel());
+    TEST_ASSERT_INT_WITHIN(AGC_DEADBAND_DB, -8, agc.getDigitalDb());
+    TEST_ASSERT_FLOAT_WITHIN(AGC_DEADBAND_DB, AGC_TARGET_DBFS, outputDb(amp));
+    AutoGain::Stats stats = agc.getStats();
+    TEST_ASSERT_EQUAL_UINT32(5000 / AGC_FRAME_MS, stats.frames);
+    TEST_ASSERT_EQUAL_UINT32(stats.frames, stats.speechFrames);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.clippedFrames);
+}
+
+static void test_quiet_speech_raises_the_level_without_a_jump() {
+    AutoGain agc;
+    Amplifier amp = amplifier(agc);
+    int switches = run(agc, amp, -58, 6000); // -48 dBFS at the default level
+    TEST_ASSERT_EQUAL(1, switches);
+    TEST_ASSERT_EQUAL(MIC_GAIN_LEVELS - 1, agc.getLevel());
+    TEST_ASSERT_TRUE(amp.lastSwitchAt >= AGC_SWITCH_HOLD_MS * rate / 1000); // Held after the start
+    // The digital gain steps down by the switch on the sample the switch lands at
+    char entry[24];
+    snprintf(entry, sizeof(entry), " %u:60-10", (unsigned)amp.lastSwitchAt);
+    std::string log = agc.describe(0, amp.position).c_str();
+    TEST_ASSERT_TRUE_MESSAGE(log.find(entry) != std::string::npos, log.c_str());
+    TEST_ASSERT_EQUAL(0, agc.getDigitalDb()); // Then rose back, the target is out of reach
+}
+
+static void test_clipping_drops_the_level_at_once() {
+    AutoGain agc;
+    Amplifier amp = amplifier(agc);
+    TEST_ASSERT_EQUAL(1, run(agc, amp, -12, 100)); // Clips at the default level
+    TEST_ASSERT_EQUAL(MIC_GAIN_DEFAULT_LEVEL - 1, agc.getLevel());
+    TEST_ASSERT_TRUE(agc.getStats().clippedFrames > 0);
+}
+
+static void test_only_speech_moves_the_gain() {
+    AutoGain agc;
+    Amplifier amp = amplifier(agc);
+    TEST_ASSERT_EQUAL(0, run(agc, amp, -58, 5000, false));
+    TEST_ASSERT_EQUAL(MIC_GAIN_DEFAULT_LEVEL, agc.getLevel());
+    TEST_ASSERT_EQUAL(0, agc.getDigitalDb());
+    TEST_ASSERT_EQUAL_UINT32(0, agc.getStats().speechFrames);
+}
+
+static void test_next_stream_starts_where_the_last_ended() {
+    AutoGain agc;
+    Amplifier amp = amplifier(agc);
+    run(agc, amp, -30, 5000);
+    int8_t digital = agc.getDigitalDb();
+    agc.reset(rate);
+    TEST_ASSERT_EQUAL(MIC_GAIN_DEFAULT_LEVEL, agc.getLevel());
+    TEST_ASSERT_EQUAL(digital, agc.getDigitalDb());
+    char expected[64];
+    snprintf(expected, sizeof(expected), "AGC dB at sample (microphone+digital): 0:50%+d", digital);
+    TEST_ASSERT_EQUAL_STRING(expected, agc.describe(0, 1000).c_str());
+    Amplifier next = amplifier(agc);
+    TEST_ASSERT_EQUAL(0, run(agc, next, -30, 2000));
+    TEST_ASSERT_TRUE(agc.getStats().steps <= 1); // Nothing to relearn
+}
+
+static void test_describe_shifts_and_cuts() {
+    AutoGain agc;
+    Amplifier amp = amplifier(agc);
+    run(agc, amp, -30, 5000); // Falls in steps from the first frames on
+    std::string full = agc.describe(0, amp.position).c_str();
+    std::string skipped = agc.describe(1000, amp.position).c_str();
+    TEST_ASSERT_TRUE(full.find(" 0:50+0 ") != std::string::npos);
+    TEST_ASSERT_EQUAL(0, skipped.find("AGC dB at sample (microphone+digital): 0:50")); // Steps before the file land on 0
+    TEST_ASSERT_TRUE(skipped.find(" 0:50+0") == std::string::npos); // Replaced before the first sample
+    TEST_ASSERT_EQUAL_STRING("AGC dB at sample (microphone+digital): 0:50+0", agc.describe(0, 1).c_str());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_db_to_gain);
+    RUN_TEST(test_reset_logs_the_starting_gain);
+    RUN_TEST(test_loud_speech_is_cut_digitally);
+    RUN_TEST(test_quiet_speech_raises_the_level_without_a_jump);
+    RUN_TEST(test_clipping_drops_the_level_at_once);
+    RUN_TEST(test_only_speech_moves_the_gain);
+    RUN_TEST(test_next_stream_starts_where_the_last_ended);
+    RUN_TEST(test_describe_shifts_and_cuts);
+    return UNITY_END();
+}
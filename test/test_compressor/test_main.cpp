@@ -0,0 +1,143 @@
+#include <unity.h>
+#include <vector>
+#include "Compressor.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the playback compressor and limiter: delay, curve, ceiling, tail.
+ */
+
+static uint32_t seed = 12345;
+
+static int16_t noise() {
+    seed = seed * 1664525UL + 1013904223UL;
+    return (int16_t)(seed >> 16);
+}
+
+/**
+ * @brief Runs a signal through a stage in blocks of `block` samples.
+ */
+static std::vector<int16_t> run(Compressor& stage, const std::vector<int16_t>& in, size_t block) {
+    std::vector<int16_t> out(in);
+    for (size_t i = 0; i < out.size(); i += block) {
+        size_t n = out.size() - i < block ? out.size() - i : block;
+        stage.process(&out[i], n);
+    }
+    return out;
+}
+
+static double dbfs(int32_t level) {
+    return 20.0 * log10(level / 32768.0);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_settings_are_clamped() {
+    Compressor stage;
+    Compressor::Settings wild = { -80, -5, 0 };
+    stage.configure(wild);
+    Compressor::Settings used = stage.getSettings();
+    TEST_ASSERT_EQUAL(COMP_THRESHOLD_MIN_DB, used.thresholdDb);
+    TEST_ASSERT_EQUAL(0, used.attackMs);
+    TEST_ASSERT_EQUAL(1, used.releaseMs);
+    TEST_ASSERT_EQUAL(COMP_DELAY_SAMPLES, stage.latency());
+}
+
+static void test_quiet_audio_is_only_delayed() {
+    Compressor stage;
+    const double amplitude = 32768.0 * pow(10.0, (COMP_DEFAULT_THRESHOLD_DB - 3) / 20.0);
+    std::vector<int16_t> in(8000);
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = (int16_t)lrint(amplitude * sin(2.0 * M_PI * 440.0 * (i / 2) / AUDIO_OUTPUT_RATE));
+    }
+    std::vector<int16_t> out = run(stage, in, 150); // Blocks off the sub-block grid
+    TEST_ASSERT_EACH_EQUAL_INT16(0, &out[0], COMP_DELAY_SAMPLES);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(&in[0], &out[COMP_DELAY_SAMPLES], in.size() - COMP_DELAY_SAMPLES);
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, stage.getGain());
+}
+
+static void test_steady_level_follows_the_ratio() {
+    Compressor stage;
+    const int levelDb = -2;
+    const int16_t level = (int16_t)lrint(32768.0 * pow(10.0, levelDb / 20.0));
+    std::vector<int16_t> in(AUDIO_OUTPUT_RATE * 2); // 1 s of stereo
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = (i / 64) & 1 ? level : -level; // Square wave, constant peak
+    }
+    std::vector<int16_t> out = run(stage, in, 512);
+    int32_t peak = 0;
+    for (size_t i = out.size() - 2048; i < out.size(); i++) {
+        peak = abs(out[i]) > peak ? abs(out[i]) : peak;
+    }
+    double expected = COMP_DEFAULT_THRESHOLD_DB + (double)(levelDb - COMP_DEFAULT_THRESHOLD_DB) / COMP_RATIO;
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, (float)expected, (float)dbfs(peak));
+}
+
+static void test_ceiling_holds_on_bursts() {
+    const int attacks[] = { 0, COMP_DEFAULT_ATTACK_MS, 1000 }; // Even with the slowest attack
+    const int32_t ceiling = (int32_t)(32768.0 * pow(10.0, COMP_CEILING_DB / 20.0));
+    for (size_t a = 0; a < sizeof(attacks) / sizeof(attacks[0]); a++) {
+        Compressor stage;
+        Compressor::Settings settings = { COMP_THRESHOLD_MIN_DB, attacks[a], 150 };
+        stage.configure(settings);
+        std::vector<int16_t> in(AUDIO_OUTPUT_RATE);
+        for (size_t i = 0; i < in.size(); i++) {
+            int16_t v = noise();
+            in[i] = (i / 3000) & 1 ? v : v / 16; // Quiet, then full scale at once
+        }
+        std::vector<int16_t> out = run(stage, in, 512);
+        for (size_t i = 0; i < out.size(); i++) {
+            TEST_ASSERT_TRUE(abs(out[i]) <= ceiling);
+        }
+    }
+}
+
+static void test_gain_recovers_after_a_peak() {
+    Compressor stage;
+    std::vector<int16_t> in(AUDIO_OUTPUT_RATE * 4, 0);
+    for (size_t i = 0; i < 2048; i++) {
+        in[i] = 30000;
+    }
+    run(stage, std::vector<int16_t>(in.begin(), in.begin() + 4096), 512);
+    int32_t reduced = stage.getGain();
+    TEST_ASSERT_LESS_THAN(GAIN_UNITY / 2, reduced);
+    run(stage, std::vector<int16_t>(in.begin() + 4096, in.begin() + 8192), 512);
+    TEST_ASSERT_GREATER_THAN(reduced, stage.getGain()); // Released, not jumped
+    TEST_ASSERT_LESS_THAN(GAIN_UNITY, stage.getGain());
+    run(stage, in, 512); // Several release time constants of silence
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, stage.getGain());
+}
+
+static void test_drain_returns_the_tail() {
+    Compressor stage;
+    TEST_ASSERT_FALSE(stage.holdsAudio());
+    std::vector<int16_t> in(1000);
+    for (size_t i = 0; i < in.size(); i++) {
+        in[i] = (int16_t)(i * 3);
+    }
+    run(stage, in, 1000);
+    TEST_ASSERT_TRUE(stage.holdsAudio());
+    size_t count = 0;
+    int16_t* tail = stage.drain(count);
+    TEST_ASSERT_EQUAL(COMP_DELAY_SAMPLES, count);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(&in[in.size() - COMP_DELAY_SAMPLES], tail, COMP_DELAY_SAMPLES);
+    TEST_ASSERT_FALSE(stage.holdsAudio());
+
+    run(stage, in, 1000);
+    stage.reset();
+    TEST_ASSERT_FALSE(stage.holdsAudio());
+    tail = stage.drain(count);
+    TEST_ASSERT_EACH_EQUAL_INT16(0, tail, COMP_DELAY_SAMPLES); // Dropped, nothing left
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_settings_are_clamped);
+    RUN_TEST(test_quiet_audio_is_only_delayed);
+    RUN_TEST(test_steady_level_follows_the_ratio);
+    RUN_TEST(test_ceiling_holds_on_bursts);
+    RUN_TEST(test_gain_recovers_after_a_peak);
+    RUN_TEST(test_drain_returns_the_tail);
+    return UNITY_END();
+}
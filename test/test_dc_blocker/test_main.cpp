@@ -0,0 +1,109 @@
+#include <unity.h>
+#include "DcBlocker.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the microphone DC blocker: seeding, tracking and response.
+ */
+
+static uint32_t seed = 12345;
+
+static int16_t noise() {
+    seed = seed * 1664525UL + 1013904223UL;
+    return (int16_t)(seed >> 16);
+}
+
+/**
+ * @brief Gain in dB of the blocker on a tone over a 3000 offset, after 1 s of settling.
+ */
+static double toneGainDb(double hz) {
+    const uint32_t rate = 8000;
+    const double w = 2.0 * M_PI * hz / rate;
+    DcBlocker blocker;
+    int16_t frame[MIC_FRAME_SAMPLES];
+    double sinSum = 0.0, cosSum = 0.0;
+    for (uint32_t done = 0; done < rate * 2; done += MIC_FRAME_SAMPLES) {
+        for (size_t i = 0; i < MIC_FRAME_SAMPLES; i++) {
+            frame[i] = (int16_t)lrint(3000.0 + 8000.0 * sin(w * (done + i)));
+        }
+        blocker.process(frame, MIC_FRAME_SAMPLES);
+        for (size_t i = 0; i < MIC_FRAME_SAMPLES && done >= rate; i++) {
+            sinSum += frame[i] * sin(w * (done + i));
+            cosSum += frame[i] * cos(w * (done + i));
+        }
+    }
+    double amplitude = 2.0 * sqrt(sinSum * sinSum + cosSum * cosSum) / rate;
+    return 20.0 * log10(amplitude / 8000.0);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_first_sample_seeds_the_offset() {
+    DcBlocker blocker;
+    int16_t samples[16];
+    for (size_t i = 0; i < 16; i++) samples[i] = 1500;
+    blocker.process(samples, 16);
+    TEST_ASSERT_EACH_EQUAL_INT16(0, samples, 16); // No thump at the start of a capture
+    TEST_ASSERT_EQUAL_INT16(1500, blocker.getOffset());
+}
+
+static void test_tracks_an_offset_step() {
+    DcBlocker blocker;
+    int16_t frame[MIC_FRAME_SAMPLES];
+    int16_t last = 0;
+    for (int f = 0; f < 40; f++) {
+        for (size_t i = 0; i < MIC_FRAME_SAMPLES; i++) frame[i] = f < 2 ? 0 : -2000;
+        blocker.process(frame, MIC_FRAME_SAMPLES);
+        last = frame[MIC_FRAME_SAMPLES - 1];
+    }
+    TEST_ASSERT_INT_WITHIN(2, 0, last);
+    TEST_ASSERT_INT_WITHIN(2, -2000, blocker.getOffset());
+}
+
+static void test_output_saturates() {
+    DcBlocker blocker;
+    int16_t samples[8] = { -30000, -30000, -30000, -30000, -30000, -30000, -30000, -30000 };
+    blocker.process(samples, 8); // Offset now about -30000
+    int16_t loud[2] = { 32767, -32768 };
+    blocker.process(loud, 2);
+    TEST_ASSERT_EQUAL_INT16(32767, loud[0]);
+    TEST_ASSERT_EQUAL_INT16(-2768, loud[1]);
+}
+
+static void test_block_split_does_not_change_the_output() {
+    const size_t count = MIC_FRAME_SAMPLES * 8;
+    int16_t whole[count];
+    int16_t split[count];
+    for (size_t i = 0; i < count; i++) whole[i] = split[i] = (int16_t)((noise() >> 2) + 4000);
+    DcBlocker a;
+    DcBlocker b;
+    a.process(whole, count);
+    size_t done = 0;
+    size_t block = 1;
+    while (done < count) {
+        size_t n = count - done < block ? count - done : block;
+        b.process(split + done, n); // Partial sub-blocks carried across calls
+        done += n;
+        block = block * 7 % 61 + 1;
+    }
+    TEST_ASSERT_EQUAL_INT16_ARRAY(whole, split, count);
+    TEST_ASSERT_EQUAL_INT16(a.getOffset(), b.getOffset());
+}
+
+static void test_response() {
+    TEST_ASSERT_LESS_THAN_FLOAT(-10.0, toneGainDb(2.0));   // Drift removed
+    TEST_ASSERT_FLOAT_WITHIN(1.0, -3.0, toneGainDb(10.0)); // Corner near 10 Hz at 8 kHz
+    TEST_ASSERT_FLOAT_WITHIN(0.3, 0.0, toneGainDb(300.0)); // Speech untouched
+    TEST_ASSERT_FLOAT_WITHIN(0.3, 0.0, toneGainDb(3000.0));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_sample_seeds_the_offset);
+    RUN_TEST(test_tracks_an_offset_step);
+    RUN_TEST(test_output_saturates);
+    RUN_TEST(test_block_split_does_not_change_the_output);
+    RUN_TEST(test_response);
+    return UNITY_END();
+}
@@ -0,0 +1,89 @@
+#include <unity.h>
+#include "FormatConverter.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the PCM format and channel layout kernels.
+ */
+
+void setUp() {}
+void tearDown() {}
+
+static void test_rejects_unsupported_formats() {
+    FormatConverter format;
+    TEST_ASSERT_FALSE(format.begin(12, 2, 2));
+    TEST_ASSERT_FALSE(format.begin(16, 3, 2));
+    TEST_ASSERT_FALSE(format.begin(16, 2, 0));
+    TEST_ASSERT_TRUE(format.isPassthrough()); // The default kernel is kept
+}
+
+static void test_frame_sizes_and_passthrough() {
+    FormatConverter format;
+    TEST_ASSERT_TRUE(format.begin(24, 2, 2));
+    TEST_ASSERT_EQUAL(6, format.inputFrameBytes());
+    TEST_ASSERT_FALSE(format.isPassthrough());
+    TEST_ASSERT_TRUE(format.begin(16, 1, 2));
+    TEST_ASSERT_EQUAL(2, format.inputFrameBytes());
+    TEST_ASSERT_EQUAL(2, format.outputChannels());
+    TEST_ASSERT_FALSE(format.isPassthrough());
+    TEST_ASSERT_TRUE(format.begin(16, 1, 1));
+    TEST_ASSERT_TRUE(format.isPassthrough());
+}
+
+static void test_8bit_is_unsigned() {
+    const uint8_t in[] = { 0, 128, 255, 129 };
+    int16_t out[8];
+    FormatConverter format;
+    TEST_ASSERT_TRUE(format.begin(8, 1, 2));
+    format.convert(in, out, 4);
+    const int16_t expected[] = { -32768, -32768, 0, 0, 32512, 32512, 256, 256 };
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected, out, 8);
+}
+
+static void test_wide_samples_keep_the_top_bits() {
+    // Little-endian 24-bit 0x123456 and -1, then 32-bit 0x7FFF0001 and 0x80000000
+    const uint8_t in24[] = { 0x56, 0x34, 0x12, 0xFF, 0xFF, 0xFF };
+    const uint8_t in32[] = { 0x01, 0x00, 0xFF, 0x7F, 0x00, 0x00, 0x00, 0x80 };
+    int16_t out[2];
+    FormatConverter format;
+    TEST_ASSERT_TRUE(format.begin(24, 2, 2));
+    format.convert(in24, out, 1);
+    TEST_ASSERT_EQUAL_INT16(0x1234, out[0]);
+    TEST_ASSERT_EQUAL_INT16(-1, out[1]);
+    TEST_ASSERT_TRUE(format.begin(32, 1, 1));
+    format.convert(in32, out, 2);
+    TEST_ASSERT_EQUAL_INT16(32767, out[0]);
+    TEST_ASSERT_EQUAL_INT16(-32768, out[1]);
+}
+
+static void test_stereo_downmix_does_not_overflow() {
+    const int16_t in[] = { 32767, 32767, -32768, -32768, 1000, -3000, 3, 0 };
+    int16_t out[4];
+    FormatConverter format;
+    TEST_ASSERT_TRUE(format.begin(16, 2, 1));
+    format.convert((const uint8_t*)in, out, 4);
+    const int16_t expected[] = { 32767, -32768, -1000, 1 };
+    TEST_ASSERT_EQUAL_INT16_ARRAY(expected, out, 4);
+}
+
+static void test_unaligned_input() {
+    uint8_t raw[1 + 3 * 4];
+    const int16_t samples[] = { 100, -200, 300, -400, 500, -600 };
+    memcpy(raw + 1, samples, sizeof(samples)); // WAV data may start on any byte of a block
+    int16_t out[6];
+    FormatConverter format;
+    TEST_ASSERT_TRUE(format.begin(16, 2, 2));
+    format.convert(raw + 1, out, 3);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(samples, out, 6);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_unsupported_formats);
+    RUN_TEST(test_frame_sizes_and_passthrough);
+    RUN_TEST(test_8bit_is_unsigned);
+    RUN_TEST(test_wide_samples_keep_the_top_bits);
+    RUN_TEST(test_stereo_downmix_does_not_overflow);
+    RUN_TEST(test_unaligned_input);
+    return UNITY_END();
+}
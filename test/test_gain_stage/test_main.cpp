@@ -0,0 +1,107 @@
+#include <unity.h>
+#include "GainStage.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the Q15 volume stage: the kernel and the ramp.
+ */
+
+static uint32_t seed = 12345;
+
+static int16_t noise() {
+    seed = seed * 1664525UL + 1013904223UL;
+    return (int16_t)(seed >> 16);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_kernel_truncates_and_saturates() {
+    int16_t samples[] = { 32767, -32768, 1000, -1000, 1, -1 };
+    GainStage::scale(samples, 6, 16384); // -6 dB
+    TEST_ASSERT_EQUAL_INT16(16383, samples[0]);
+    TEST_ASSERT_EQUAL_INT16(-16384, samples[1]);
+    TEST_ASSERT_EQUAL_INT16(500, samples[2]);
+    TEST_ASSERT_EQUAL_INT16(-500, samples[3]);
+    TEST_ASSERT_EQUAL_INT16(0, samples[4]);
+    TEST_ASSERT_EQUAL_INT16(-1, samples[5]); // Arithmetic shift rounds towards minus infinity
+
+    int16_t loud[] = { -32768 };
+    GainStage::scale(loud, 1, -32768); // Out of the stage's range, still saturates
+    TEST_ASSERT_EQUAL_INT16(32767, loud[0]);
+}
+
+static void test_unity_gain_is_bypassed() {
+    GainStage gain;
+    int16_t samples[64];
+    int16_t copy[64];
+    for (size_t i = 0; i < 64; i++) samples[i] = copy[i] = noise();
+    gain.process(samples, 64);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(copy, samples, 64);
+    TEST_ASSERT_TRUE(gain.isSettled());
+}
+
+static void test_ramp_reaches_target_after_its_length() {
+    GainStage gain(4, 8);
+    gain.setTarget(0);
+    int16_t samples[32];
+    for (size_t i = 0; i < 32; i++) samples[i] = 20000;
+    gain.process(samples, 32);
+    // Four steps of 8 samples from unity to 0: 3/4, 1/2, 1/4, 0
+    TEST_ASSERT_EQUAL_INT16(15000, samples[0]);
+    TEST_ASSERT_EQUAL_INT16(15000, samples[7]);
+    TEST_ASSERT_EQUAL_INT16(10000, samples[8]);
+    TEST_ASSERT_EQUAL_INT16(5000, samples[16]);
+    TEST_ASSERT_EQUAL_INT16(0, samples[24]);
+    TEST_ASSERT_TRUE(gain.isSettled());
+}
+
+static void test_ramp_does_not_depend_on_block_split() {
+    const size_t count = 4096;
+    int16_t whole[count];
+    int16_t split[count];
+    for (size_t i = 0; i < count; i++) whole[i] = split[i] = noise();
+
+    GainStage a;
+    GainStage b;
+    a.setTarget(GainStage::volumeToGain(30));
+    b.setTarget(GainStage::volumeToGain(30));
+    a.process(whole, count);
+    size_t done = 0;
+    size_t block = 2;
+    while (done < count) {
+        size_t n = count - done < block ? count - done : block;
+        b.process(split + done, n);
+        done += n;
+        block = block * 3 % 250 + 2; // Uneven even-sized blocks
+    }
+    TEST_ASSERT_EQUAL_INT16_ARRAY(whole, split, count);
+}
+
+static void test_jump_skips_the_ramp() {
+    GainStage gain;
+    gain.jumpTo(GAIN_UNITY / 2);
+    TEST_ASSERT_TRUE(gain.isSettled());
+    int16_t samples[] = { 1000, -1000 };
+    gain.process(samples, 2);
+    TEST_ASSERT_EQUAL_INT16(500, samples[0]);
+    TEST_ASSERT_EQUAL_INT16(-500, samples[1]);
+}
+
+static void test_volume_map() {
+    TEST_ASSERT_EQUAL_INT32(0, GainStage::volumeToGain(0));
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY / 4, GainStage::volumeToGain(50));
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, GainStage::volumeToGain(100));
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, GainStage::volumeToGain(200));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_kernel_truncates_and_saturates);
+    RUN_TEST(test_unity_gain_is_bypassed);
+    RUN_TEST(test_ramp_reaches_target_after_its_length);
+    RUN_TEST(test_ramp_does_not_depend_on_block_split);
+    RUN_TEST(test_jump_skips_the_ramp);
+    RUN_TEST(test_volume_map);
+    return UNITY_END();
+}
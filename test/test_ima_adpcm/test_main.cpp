@@ -0,0 +1,250 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "ImaAdpcmDecoder.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the IMA-ADPCM block decoder against the reference algorithm.
+ *
+ * Blocks are produced by a straightforward IMA encoder and decoded both by `ImaAdpcmDecoder`
+ * and by the branchy reference decoder of the IMA recommendation; the outputs must match.
+ */
+
+static const int stepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552,
+    1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484,
+    7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385,
+    24623, 27086, 29794, 32767
+};
+static const int indexTable[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+struct Channel {
+    int predictor;
+    int index;
+};
+
+static int clampIndex(int index) {
+    return index < 0 ? 0 : (index > 88 ? 88 : index);
+}
+
+static int clampSample(int value) {
+    return value < -32768 ? -32768 : (value > 32767 ? 32767 : value);
+}
+
+static int16_t referenceDecode(uint8_t code, Channel& ch) {
+    int step = stepTable[ch.index];
+    int diff = step >> 3;
+    if (code & 4) diff += step;
+    if (code & 2) diff += step >> 1;
+    if (code & 1) diff += step >> 2;
+    ch.predictor = clampSample(code & 8 ? ch.predictor - diff : ch.predictor + diff);
+    ch.index = clampIndex(ch.index + indexTable[code]);
+    return (int16_t)ch.predictor;
+}
+
+static uint8_t encode(int16_t sample, Channel& ch) {
+    int step = stepTable[ch.index];
+    int diff = sample - ch.predictor;
+    uint8_t code = 0;
+    if (diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if (diff >= step) { code |= 4; diff -= step; }
+    if (diff >= step >> 1) { code |= 2; diff -= step >> 1; }
+    if (diff >= step >> 2) { code |= 1; }
+    referenceDecode(code, ch); // Track the decoder state
+    return code;
+}
+
+/**
+ * @brief Encodes interleaved samples into one block of the standard WAV layout.
+ */
+static std::vector<uint8_t> encodeBlock(const int16_t* in, size_t channels, size_t blockAlign, Channel* state) {
+    std::vector<uint8_t> block(blockAlign, 0);
+    const size_t frames = ImaAdpcmDecoder::framesPerBlock(channels, blockAlign);
+    for (size_t c = 0; c < channels; c++) {
+        state[c].predictor = in[c];
+        block[4 * c] = (uint8_t)(in[c] & 0xFF);
+        block[4 * c + 1] = (uint8_t)((uint16_t)in[c] >> 8);
+        block[4 * c + 2] = (uint8_t)state[c].index;
+    }
+    for (size_t f = 1; f < frames; f++) {
+        for (size_t c = 0; c < channels; c++) {
+            size_t n = f - 1;                               // Code number within the channel
+            size_t byte = 4 * channels + (n / 8) * 4 * channels + 4 * c + (n % 8) / 2;
+            uint8_t code = encode(in[f * channels + c], state[c]);
+            block[byte] |= (n & 1) ? code << 4 : code;
+        }
+    }
+    return block;
+}
+
+static std::vector<int16_t> referenceBlock(const std::vector<uint8_t>& block, size_t channels) {
+    const size_t frames = ImaAdpcmDecoder::framesPerBlock(channels, block.size());
+    std::vector<int16_t> out(frames * channels);
+    for (size_t c = 0; c < channels; c++) {
+        Channel ch = { (int16_t)(block[4 * c] | (block[4 * c + 1] << 8)), block[4 * c + 2] };
+        out[c] = (int16_t)ch.predictor;
+        for (size_t n = 0; n + 1 < frames; n++) {
+            size_t byte = 4 * channels + (n / 8) * 4 * channels + 4 * c + (n % 8) / 2;
+            uint8_t code = (n & 1) ? block[byte] >> 4 : block[byte] & 0x0F;
+            out[(n + 1) * channels + c] = referenceDecode(code, ch);
+        }
+    }
+    return out;
+}
+
+static std::vector<int16_t> tone(size_t frames, size_t channels) {
+    std::vector<int16_t> out(frames * channels);
+    for (size_t i = 0; i < frames; i++) {
+        for (size_t c = 0; c < channels; c++) {
+            double v = 12000.0 * sin(2.0 * M_PI * (440.0 + 220.0 * c) * i / 22050.0) +
+                       6000.0 * sin(2.0 * M_PI * 3100.0 * i / 22050.0);
+            out[i * channels + c] = (int16_t)lrint(v);
+        }
+    }
+    return out;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_frames_per_block() {
+    TEST_ASSERT_EQUAL(505, ImaAdpcmDecoder::framesPerBlock(1, 256));
+    TEST_ASSERT_EQUAL(505, ImaAdpcmDecoder::framesPerBlock(2, 512));
+    TEST_ASSERT_EQUAL(2041, ImaAdpcmDecoder::framesPerBlock(1, 1024));
+    TEST_ASSERT_EQUAL(0, ImaAdpcmDecoder::framesPerBlock(2, 8));
+}
+
+static void test_rejects_bad_layouts() {
+    ImaAdpcmDecoder decoder;
+    TEST_ASSERT_FALSE(decoder.begin(3, 1024));
+    TEST_ASSERT_FALSE(decoder.begin(2, 8));
+    TEST_ASSERT_FALSE(decoder.begin(2, 516 + 2));
+    TEST_ASSERT_TRUE(decoder.begin(2, 1024));
+}
+
+static void checkLayout(size_t channels, size_t blockAlign) {
+    ImaAdpcmDecoder decoder;
+    TEST_ASSERT_TRUE(decoder.begin(channels, blockAlign));
+    const size_t frames = decoder.framesPerBlock();
+    std::vector<int16_t> input = tone(frames * 4, channels);
+    Channel state[2] = { { 0, 0 }, { 0, 0 } };
+    std::vector<int16_t> out(frames * channels);
+    double signal = 0.0, error = 0.0;
+    for (size_t b = 0; b < 4; b++) {
+        const int16_t* in = input.data() + b * frames * channels;
+        std::vector<uint8_t> block = encodeBlock(in, channels, blockAlign, state);
+        TEST_ASSERT_EQUAL(frames, decoder.decodeBlock(block.data(), block.size(), out.data()));
+        std::vector<int16_t> ref = referenceBlock(block, channels);
+        TEST_ASSERT_EQUAL_INT16_ARRAY(ref.data(), out.data(), frames * channels);
+        for (size_t i = 0; i < frames * channels; i++) {
+            signal += (double)in[i] * in[i];
+            error += (double)(in[i] - out[i]) * (in[i] - out[i]);
+        }
+    }
+    TEST_ASSERT_GREATER_THAN_FLOAT(20.0, 10.0 * log10(signal / error)); // The codec itself works
+}
+
+static void test_mono_matches_reference() {
+    checkLayout(1, 256);
+    checkLayout(1, 1024);
+}
+
+static void test_stereo_matches_reference() {
+    checkLayout(2, 512);
+    checkLayout(2, 2048);
+}
+
+static void test_extremes_clamp_like_the_reference() {
+    ImaAdpcmDecoder decoder;
+    TEST_ASSERT_TRUE(decoder.begin(1, 36));
+    uint8_t block[36];
+    block[0] = 0x00;
+    block[1] = 0x7F;           // Start near full scale
+    block[2] = 80;             // Large step
+    block[3] = 0;
+    memset(block + 4, 0x77, 16); // Largest positive codes, then
+    memset(block + 20, 0xFF, 16); // largest negative codes
+    std::vector<uint8_t> copy(block, block + 36);
+    int16_t out[65];
+    TEST_ASSERT_EQUAL(65, decoder.decodeBlock(block, 36, out));
+    std::vector<int16_t> ref = referenceBlock(copy, 1);
+    TEST_ASSERT_EQUAL_INT16_ARRAY(ref.data(), out, 65);
+    TEST_ASSERT_EQUAL_INT16(32767, out[32]);
+    TEST_ASSERT_EQUAL_INT16(-32768, out[64]);
+}
+
+static void test_short_and_corrupt_blocks() {
+    ImaAdpcmDecoder decoder;
+    TEST_ASSERT_TRUE(decoder.begin(2, 512));
+    uint8_t block[512] = { 0 };
+    int16_t out[505 * 2];
+    TEST_ASSERT_EQUAL(1 + 8 * 3, decoder.decodeBlock(block, 8 + 8 * 3 + 5, out)); // Partial group dropped
+    TEST_ASSERT_EQUAL(0, decoder.decodeBlock(block, 7, out));
+    block[6] = 89; // Step index of the right channel out of range
+    TEST_ASSERT_EQUAL(0, decoder.decodeBlock(block, 512, out));
+}
+
+/**
+ * @brief Decodes an hour of 16 kHz mono story, 256-byte blocks as written by common encoders,
+ * and prints the rate in MB/s of ADPCM read and of PCM produced.
+ *
+ * Sixteen encoded blocks of the test tone are decoded in turn; the first pass over them is
+ * checked against the reference decoder.
+ */
+static void test_decode_an_hour_of_story() {
+    const size_t blockAlign = 256;
+    const uint32_t rate = 16000;
+    ImaAdpcmDecoder decoder;
+    TEST_ASSERT_TRUE(decoder.begin(1, blockAlign));
+    const size_t frames = decoder.framesPerBlock();
+    const size_t distinct = 16;
+    std::vector<int16_t> input = tone(frames * distinct, 1);
+    Channel state[1] = { { 0, 0 } };
+    std::vector<std::vector<uint8_t> > blocks;
+    std::vector<std::vector<int16_t> > refs;
+    for (size_t b = 0; b < distinct; b++) {
+        blocks.push_back(encodeBlock(input.data() + b * frames, 1, blockAlign, state));
+        refs.push_back(referenceBlock(blocks.back(), 1));
+    }
+
+    const size_t total = ((size_t)rate * 3600 + frames - 1) / frames; // Blocks in an hour
+    std::vector<int16_t> out(frames);
+    uint32_t mismatches = 0;
+    const unsigned long start = micros();
+    for (size_t b = 0; b < total; b++) {
+        const std::vector<uint8_t>& block = blocks[b % distinct];
+        decoder.decodeBlock(block.data(), block.size(), out.data());
+        if (b < distinct) {
+            mismatches += memcmp(out.data(), refs[b].data(), frames * sizeof(int16_t)) != 0;
+        }
+    }
+    const unsigned long elapsedUs = micros() - start;
+
+    const double seconds = elapsedUs > 0 ? elapsedUs / 1e6 : 1e-6;
+    const double adpcmBytes = (double)total * blockAlign;
+    const double pcmBytes = (double)total * frames * sizeof(int16_t);
+    char message[160];
+    snprintf(message, sizeof(message), "IMA-ADPCM: 1 h of 16 kHz mono in %.0f ms, %.1f MB/s read, %.1f MB/s decoded, %.0fx real time",
+             seconds * 1000.0, adpcmBytes / seconds / 1e6, pcmBytes / seconds / 1e6, 3600.0 / seconds);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+    TEST_ASSERT_GREATER_THAN_FLOAT(100.0f, (float)(3600.0 / seconds)); // Far faster than real time
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_frames_per_block);
+    RUN_TEST(test_rejects_bad_layouts);
+    RUN_TEST(test_mono_matches_reference);
+    RUN_TEST(test_stereo_matches_reference);
+    RUN_TEST(test_extremes_clamp_like_the_reference);
+    RUN_TEST(test_short_and_corrupt_blocks);
+    RUN_TEST(test_decode_an_hour_of_story);
+    return UNITY_END();
+}
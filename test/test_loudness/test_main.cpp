@@ -0,0 +1,165 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+#include "GainStage.h"
+#include "LoudnessIndex.h"
+#include "LoudnessMeter.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the BS.1770 loudness meter and of the loudness sidecar.
+ *
+ * The meter is checked against the reference of the standard, a 997 Hz sine at 0 dBFS in one
+ * channel reading -3.01 LUFS, then against both gates with tones of known level. The sidecar
+ * is written and read back through the in-memory SD card.
+ */
+
+static const double PI = 3.14159265358979323846;
+
+/// Appends `seconds` of a 997 Hz sine at `dbfs`, in the left channel or in both
+static void addTone(std::vector<int16_t>& samples, double seconds, double dbfs, bool stereo) {
+    const double amplitude = 32767.0 * pow(10.0, dbfs / 20.0);
+    const size_t frames = (size_t)(seconds * AUDIO_OUTPUT_RATE);
+    const size_t start = samples.size() / AUDIO_OUTPUT_CHANNELS;
+    for (size_t i = 0; i < frames; i++) {
+        int16_t sample = (int16_t)lround(amplitude * sin(2.0 * PI * 997.0 * (start + i) / AUDIO_OUTPUT_RATE));
+        samples.push_back(sample);
+        samples.push_back(stereo ? sample : 0);
+    }
+}
+
+static void addSilence(std::vector<int16_t>& samples, double seconds) {
+    samples.resize(samples.size() + (size_t)(seconds * AUDIO_OUTPUT_RATE) * AUDIO_OUTPUT_CHANNELS, 0);
+}
+
+/// Measures interleaved stereo samples in blocks of `blockFrames`
+static int16_t measure(LoudnessMeter& meter, const std::vector<int16_t>& samples, size_t blockFrames) {
+    meter.reset();
+    const size_t frames = samples.size() / AUDIO_OUTPUT_CHANNELS;
+    for (size_t i = 0; i < frames; i += blockFrames) {
+        meter.process(samples.data() + i * AUDIO_OUTPUT_CHANNELS, frames - i < blockFrames ? frames - i : blockFrames);
+    }
+    return meter.integrated();
+}
+
+void setUp() {
+    SD.clear();
+}
+
+void tearDown() {}
+
+static void test_full_scale_tone_reads_minus_3_lufs() {
+    std::vector<int16_t> samples;
+    addTone(samples, 5.0, 0.0, false);
+    LoudnessMeter meter;
+
+    const uint64_t start = micros();
+    const int16_t lufs = measure(meter, samples, 512);
+    const uint64_t elapsedUs = micros() - start;
+    char message[128];
+    snprintf(message, sizeof(message), "0 dBFS 997 Hz, left channel: %.2f LUFS, measured at %.0fx real time",
+             lufs / 100.0, 5.0e6 / (elapsedUs > 0 ? elapsedUs : 1));
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_INT_WITHIN(5, -301, lufs); // BS.1770 reference, within 0.05 LU
+    TEST_ASSERT_EQUAL_INT16(32767, meter.peak());
+    TEST_ASSERT_EQUAL_INT16(lufs, measure(meter, samples, 333)); // Any block size, same reading
+
+    samples.clear();
+    addTone(samples, 5.0, 0.0, true);
+    TEST_ASSERT_INT_WITHIN(5, 0, measure(meter, samples, 512)); // Both channels add up
+}
+
+static void test_level_changes_track_one_for_one() {
+    LoudnessMeter meter;
+    for (int dbfs = -10; dbfs >= -60; dbfs -= 10) {
+        std::vector<int16_t> samples;
+        addTone(samples, 3.0, dbfs, false);
+        TEST_ASSERT_INT_WITHIN(5, dbfs * 100 - 301, measure(meter, samples, 512));
+    }
+}
+
+static void test_gates_drop_silence_and_quiet_passages() {
+    LoudnessMeter meter;
+    std::vector<int16_t> samples;
+    addSilence(samples, 5.0);
+    TEST_ASSERT_EQUAL_INT16(LOUDNESS_SILENT, measure(meter, samples, 512)); // Nothing above -70 LUFS
+
+    // Absolute gate: twenty seconds of silence are dropped. The 47 gating blocks inside the
+    // tone pass, and so do the three that straddle its end, holding 3/4, 1/2 and 1/4 of it.
+    const int16_t toneThenNothing = (int16_t)lround(100.0 * (-23.01 + 10.0 * log10(48.5 / 50.0)));
+    samples.clear();
+    addTone(samples, 5.0, -20.0, false);
+    addSilence(samples, 20.0);
+    TEST_ASSERT_INT_WITHIN(5, toneThenNothing, measure(meter, samples, 512));
+
+    // Relative gate: a passage 20 LU down is more than 10 LU below the gated mean, dropped
+    samples.clear();
+    addTone(samples, 5.0, -20.0, false);
+    addTone(samples, 10.0, -40.0, false);
+    TEST_ASSERT_INT_WITHIN(5, toneThenNothing, measure(meter, samples, 512));
+
+    // A passage 6 LU down is within the relative gate and lowers the mean by its energy
+    samples.clear();
+    addTone(samples, 5.0, -20.0, false);
+    addTone(samples, 5.0, -26.0, false);
+    const double expected = -23.01 + 10.0 * log10((1.0 + pow(10.0, -0.6)) / 2.0);
+    TEST_ASSERT_INT_WITHIN(5, (int)lround(expected * 100.0), measure(meter, samples, 512));
+}
+
+static void test_sidecar_round_trip() {
+    std::vector<uint8_t> audio(4000, 0x11);
+    SD.put("/story.wav", audio);
+    File file = SD.open("/story.wav");
+    LoudnessIndex saved;
+    TEST_ASSERT_TRUE(saved.save("/story.wav.lnd", file, -800, 20000));
+    TEST_ASSERT_EQUAL(24, SD.file("/story.wav.lnd")->data.size());
+
+    LoudnessIndex loaded;
+    TEST_ASSERT_TRUE(loaded.load("/story.wav.lnd", file));
+    TEST_ASSERT_EQUAL_INT16(-800, loaded.integrated());
+    TEST_ASSERT_EQUAL_INT16(20000, loaded.peak());
+    TEST_ASSERT_INT_WITHIN(2, (int32_t)lround(GAIN_UNITY * pow(10.0, -10.0 / 20.0)), loaded.gain()); // 10 dB cut
+    file.close();
+
+    // A rewritten file no longer matches its sidecar and plays at unity until measured again
+    SD.file("/story.wav")->lastWrite = 42;
+    file = SD.open("/story.wav");
+    TEST_ASSERT_FALSE(loaded.load("/story.wav.lnd", file));
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, loaded.gain());
+    file.close();
+
+    // A torn or corrupted record is refused
+    file = SD.open("/story.wav");
+    TEST_ASSERT_TRUE(saved.save("/story.wav.lnd", file, -800, 20000));
+    SD.file("/story.wav.lnd")->data[6] ^= 0x01;
+    TEST_ASSERT_FALSE(loaded.load("/story.wav.lnd", file));
+    SD.file("/story.wav.lnd")->data.resize(20);
+    TEST_ASSERT_FALSE(loaded.load("/story.wav.lnd", file));
+    TEST_ASSERT_FALSE(loaded.load("/missing.wav.lnd", file));
+    file.close();
+}
+
+static void test_gain_only_cuts_and_is_bounded() {
+    SD.put("/story.wav", std::vector<uint8_t>(100, 0));
+    File file = SD.open("/story.wav");
+    LoudnessIndex index;
+    index.save("/story.wav.lnd", file, LOUDNESS_TARGET_LUFS * 100 - 600, 1000); // Quieter than the target
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, index.gain());
+    index.save("/story.wav.lnd", file, LOUDNESS_SILENT, 0);
+    TEST_ASSERT_EQUAL_INT32(GAIN_UNITY, index.gain());
+    index.save("/story.wav.lnd", file, 300, 32767); // 21 dB over the target, cut by the maximum only
+    TEST_ASSERT_INT_WITHIN(2, (int32_t)lround(GAIN_UNITY * pow(10.0, -LOUDNESS_MAX_CUT_DB / 20.0)), index.gain());
+    file.close();
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_scale_tone_reads_minus_3_lufs);
+    RUN_TEST(test_level_changes_track_one_for_one);
+    RUN_TEST(test_gates_drop_silence_and_quiet_passages);
+    RUN_TEST(test_sidecar_round_trip);
+    RUN_TEST(test_gain_only_cuts_and_is_bounded);
+    return UNITY_END();
+}
@@ -0,0 +1,189 @@
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+#include "Mp3Decoder.h"
+#include "WAVFileReader.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the streaming MP3 decoder and of MP3 playback in the reader.
+ *
+ * Helix is replaced on the host by a stand-in that keeps real MPEG Layer III framing and
+ * decodes each frame to a constant value carried in its payload (see the stub mp3dec.h), so
+ * every sample heard tells which frame it came from. The fixtures are built here.
+ */
+
+static const int STEREO_FRAME_SAMPLES = 2 * 576 * 2; // MPEG-1, two granules of 576, stereo
+
+static i2s_pin_config_t pins() {
+    i2s_pin_config_t config;
+    config.mck_io_num = I2S_PIN_NO_CHANGE;
+    config.bck_io_num = 26;
+    config.ws_io_num = 25;
+    config.data_out_num = 22;
+    config.data_in_num = I2S_PIN_NO_CHANGE;
+    return config;
+}
+
+static I2SManager engine(pins(), AUDIO_OUTPUT_RATE);
+
+/**
+ * Appends one Layer III frame: MPEG-1 128 kbps at 44.1 kHz stereo by default, or MPEG-2
+ * 64 kbps at 22.05 kHz mono. `reservoir` is the main_data_begin stand-in.
+ */
+static void putFrame(std::vector<uint8_t>& out, int16_t value, bool padded = false, uint8_t reservoir = 0,
+                     bool mpeg2Mono = false) {
+    const uint8_t header[4] = { 0xFF, (uint8_t)(mpeg2Mono ? 0xF3 : 0xFB),
+                                (uint8_t)((mpeg2Mono ? 0x80 : 0x90) | (padded ? 0x02 : 0x00)),
+                                (uint8_t)(mpeg2Mono ? 0xC0 : 0x00) };
+    const size_t length = (mpeg2Mono ? 72 * 64000 / 22050 : 144 * 128000 / 44100) + (padded ? 1 : 0);
+    const size_t start = out.size();
+    out.insert(out.end(), header, header + 4);
+    out.push_back(reservoir);
+    out.push_back((uint8_t)value);
+    out.push_back((uint8_t)((uint16_t)value >> 8));
+    out.resize(start + length, 0x55);
+}
+
+/// Decodes a stream fed `chunk` bytes at a time; returns the value of every frame decoded
+static std::vector<int16_t> decodeInChunks(Mp3Decoder& mp3, const std::vector<uint8_t>& stream, size_t chunk,
+                                           int& skipped) {
+    std::vector<int16_t> values;
+    std::vector<int16_t> pcm(Mp3Decoder::maxFrameSamples());
+    size_t fed = 0;
+    skipped = 0;
+    while (true) {
+        int samples = mp3.decodeFrame(pcm.data());
+        if (samples > 0) {
+            TEST_ASSERT_EQUAL(STEREO_FRAME_SAMPLES, samples);
+            for (int i = 1; i < samples; i++) TEST_ASSERT_EQUAL_INT16(pcm[0], pcm[i]);
+            values.push_back(pcm[0]);
+        } else if (samples < 0) {
+            skipped++;
+        } else if (fed < stream.size()) {
+            size_t space;
+            uint8_t* dst = mp3.inputSpace(space);
+            size_t count = std::min(std::min(space, chunk), stream.size() - fed);
+            memcpy(dst, stream.data() + fed, count);
+            mp3.inputCommit(count);
+            fed += count;
+        } else {
+            return values;
+        }
+    }
+}
+
+void setUp() {
+    SD.clear();
+}
+
+void tearDown() {}
+
+static void test_frames_decode_across_small_refills() {
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 12; i++) putFrame(stream, (int16_t)(100 + i), i % 3 == 2);
+    Mp3Decoder mp3;
+    TEST_ASSERT_TRUE(mp3.begin());
+    int skipped;
+    std::vector<int16_t> values = decodeInChunks(mp3, stream, 100, skipped); // Every frame arrives split
+
+    TEST_ASSERT_EQUAL(12, values.size());
+    for (int i = 0; i < 12; i++) TEST_ASSERT_EQUAL_INT16(100 + i, values[i]);
+    TEST_ASSERT_EQUAL(0, skipped);
+    TEST_ASSERT_EQUAL(0, mp3.bufferedBytes());
+    TEST_ASSERT_EQUAL_UINT32(12, mp3.getStats().frames);
+}
+
+static void test_incomplete_frame_waits_for_input() {
+    std::vector<uint8_t> stream;
+    putFrame(stream, 7);
+    Mp3Decoder mp3;
+    mp3.begin();
+    std::vector<int16_t> pcm(Mp3Decoder::maxFrameSamples());
+    size_t space;
+    memcpy(mp3.inputSpace(space), stream.data(), 200);
+    mp3.inputCommit(200);
+    TEST_ASSERT_EQUAL(0, mp3.decodeFrame(pcm.data()));
+    TEST_ASSERT_EQUAL(200, mp3.bufferedBytes()); // Kept whole for the next call
+
+    memcpy(mp3.inputSpace(space), stream.data() + 200, stream.size() - 200);
+    mp3.inputCommit(stream.size() - 200);
+    TEST_ASSERT_EQUAL(STEREO_FRAME_SAMPLES, mp3.decodeFrame(pcm.data()));
+    TEST_ASSERT_EQUAL_INT16(7, pcm[0]);
+}
+
+static void test_probe_skips_garbage_and_false_syncs() {
+    const uint8_t garbage[] = { 0x00, 0x12, 0xFF, 0xE0, 0x34, 0xFF, 0xFF, 0x01 }; // 0xFFE0 is not Layer III
+    std::vector<uint8_t> stream(garbage, garbage + sizeof(garbage));
+    putFrame(stream, 1, false, 0, true);
+    Mp3Decoder mp3;
+    mp3.begin();
+    size_t space;
+    memcpy(mp3.inputSpace(space), stream.data(), stream.size());
+    mp3.inputCommit(stream.size());
+
+    int sampleRate = 0;
+    int channels = 0;
+    TEST_ASSERT_TRUE(mp3.probe(sampleRate, channels));
+    TEST_ASSERT_EQUAL(22050, sampleRate);
+    TEST_ASSERT_EQUAL(1, channels);
+    TEST_ASSERT_EQUAL(stream.size() - sizeof(garbage), mp3.bufferedBytes()); // Dropped up to the frame
+
+    std::vector<int16_t> pcm(Mp3Decoder::maxFrameSamples());
+    TEST_ASSERT_EQUAL(576, mp3.decodeFrame(pcm.data())); // MPEG-2: one granule, mono
+    TEST_ASSERT_EQUAL_INT16(1, pcm[575]);
+}
+
+static void test_reservoir_warm_up_and_corrupt_frames_are_skipped() {
+    std::vector<uint8_t> stream;
+    putFrame(stream, 1, false, 0x20); // Refers back to a reservoir that was never read
+    putFrame(stream, 2, false, 0x20);
+    const uint8_t corrupt[] = { 0xFF, 0xE0, 0x00, 0x00 };
+    stream.insert(stream.end(), corrupt, corrupt + sizeof(corrupt));
+    putFrame(stream, 3);
+    Mp3Decoder mp3;
+    mp3.begin();
+    int skipped;
+    std::vector<int16_t> values = decodeInChunks(mp3, stream, 512, skipped);
+
+    TEST_ASSERT_EQUAL(2, values.size());
+    TEST_ASSERT_EQUAL_INT16(2, values[0]);
+    TEST_ASSERT_EQUAL_INT16(3, values[1]);
+    TEST_ASSERT_EQUAL(2, skipped); // The warm-up frame and the corrupt header
+
+    mp3.reset(); // A rewind warms the reservoir up again
+    values = decodeInChunks(mp3, stream, 512, skipped);
+    TEST_ASSERT_EQUAL(2, values.size());
+}
+
+static void test_reader_plays_mp3_behind_an_id3_tag() {
+    std::vector<uint8_t> file = { 'I', 'D', '3', 4, 0, 0, 0, 0, 3, 33 }; // Sync-safe size: 417 bytes
+    putFrame(file, 1337); // A tag body that decodes as a frame unless it is skipped
+    const int frames = 20;
+    for (int i = 0; i < frames; i++) putFrame(file, (int16_t)(1000 + i), i % 2 == 1);
+    SD.put("/response.mp3", file);
+
+    WAVFileReader reader("/response.mp3", &engine);
+    TEST_ASSERT_TRUE(reader.open());
+    TEST_ASSERT_EQUAL(44100, reader.getSampleRate());
+    std::vector<int16_t> pcm(frames * STEREO_FRAME_SAMPLES + 4096);
+    size_t samples = reader.decodeAll(pcm.data(), pcm.size());
+
+    TEST_ASSERT_EQUAL(frames * STEREO_FRAME_SAMPLES, samples); // Nothing from the tag
+    TEST_ASSERT_EQUAL_INT16(1000, pcm[0]);
+    for (int i = 0; i < frames; i++) {
+        TEST_ASSERT_EQUAL_INT16(1000 + i, pcm[i * STEREO_FRAME_SAMPLES]);
+        TEST_ASSERT_EQUAL_INT16(1000 + i, pcm[(i + 1) * STEREO_FRAME_SAMPLES - 1]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(frames, reader.getDecodeStats().frames);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_frames_decode_across_small_refills);
+    RUN_TEST(test_incomplete_frame_waits_for_input);
+    RUN_TEST(test_probe_skips_garbage_and_false_syncs);
+    RUN_TEST(test_reservoir_warm_up_and_corrupt_frames_are_skipped);
+    RUN_TEST(test_reader_plays_mp3_behind_an_id3_tag);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+#include <unity.h>
+#include <vector>
+#include "NoiseSuppressor.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the recording noise suppressor: reconstruction, suppression, tail.
+ */
+
+static const uint32_t rate = SAMPLE_RATE;
+
+/**
+ * @brief `seconds` of white noise at `noiseLevel` peak, with a 440 Hz tone from `toneFrom` on.
+ */
+static std::vector<int16_t> recording(float seconds, float noiseLevel, float toneLevel, size_t toneFrom) {
+    std::vector<int16_t> samples((size_t)(seconds * rate));
+    uint32_t seed = 12345;
+    for (size_t n = 0; n < samples.size(); n++) {
+        seed = seed * 1664525UL + 1013904223UL;
+        float v = (int16_t)(seed >> 16) * (noiseLevel / 32768.0f);
+        if (n >= toneFrom) {
+            v += toneLevel * sinf(2.0f * (float)M_PI * 440.0f * n / rate);
+        }
+        samples[n] = (int16_t)v;
+    }
+    return samples;
+}
+
+static std::vector<int16_t> run(NoiseSuppressor& stage, const std::vector<int16_t>& in, size_t block) {
+    std::vector<int16_t> out(in);
+    for (size_t i = 0; i < out.size(); i += block) {
+        size_t n = out.size() - i < block ? out.size() - i : block;
+        stage.process(&out[i], n);
+    }
+    return out;
+}
+
+static double energy(const std::vector<int16_t>& s, size_t from, size_t to) {
+    double sum = 0.0;
+    for (size_t n = from; n < to; n++) sum += (double)s[n] * s[n];
+    return sum;
+}
+
+/**
+ * @brief Energy of the 440 Hz component of `s` over [from, to), tone phase of input sample `n - delay`.
+ */
+static double tone(const std::vector<int16_t>& s, size_t from, size_t to, size_t delay) {
+    double sinSum = 0.0, cosSum = 0.0;
+    for (size_t n = from; n < to; n++) {
+        double w = 2.0 * M_PI * 440.0 * (n - delay) / rate;
+        sinSum += s[n] * sin(w);
+        cosSum += s[n] * cos(w);
+    }
+    return 2.0 * (sinSum * sinSum + cosSum * cosSum) / (to - from);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_nothing_to_subtract_is_only_delayed() {
+    NoiseSuppressor* stage = new NoiseSuppressor();
+    std::vector<int16_t> in = recording(1.0f, 0.0f, 8000.0f, rate / 2); // Silence while learning
+    std::vector<int16_t> out = run(*stage, in, MIC_FRAME_SAMPLES);
+    const size_t delay = stage->latency();
+    TEST_ASSERT_EQUAL(NOISE_FFT_SIZE, delay);
+    for (size_t n = delay; n < out.size(); n++) {
+        TEST_ASSERT_INT_WITHIN(1, in[n - delay], out[n]);
+    }
+    delete stage;
+}
+
+static void test_learns_then_suppresses_the_noise() {
+    NoiseSuppressor* stage = new NoiseSuppressor();
+    TEST_ASSERT_TRUE(stage->isLearning());
+    std::vector<int16_t> in = recording(2.0f, 1500.0f, 3000.0f, rate / 2);
+    std::vector<int16_t> out = run(*stage, in, MIC_FRAME_SAMPLES);
+    TEST_ASSERT_FALSE(stage->isLearning());
+    const size_t delay = stage->latency();
+
+    // Noise alone, after learning and before the tone reaches the output
+    double quietDb = 10.0 * log10(energy(out, rate * 2 / 5, rate / 2) / energy(in, rate * 2 / 5 - delay, rate / 2 - delay));
+    TEST_ASSERT_LESS_THAN_FLOAT(-8.0f, (float)quietDb);
+
+    // Tone kept, SNR improved
+    const size_t from = rate, to = 2 * rate;
+    double toneIn = tone(in, from - delay, to - delay, 0), toneOut = tone(out, from, to, delay);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, (float)(10.0 * log10(toneOut / toneIn)));
+    double snrIn = 10.0 * log10(toneIn / (energy(in, from - delay, to - delay) - toneIn));
+    double snrOut = 10.0 * log10(toneOut / (energy(out, from, to) - toneOut));
+    TEST_ASSERT_GREATER_THAN_FLOAT((float)snrIn + 6.0f, (float)snrOut);
+    delete stage;
+}
+
+static void test_block_length_does_not_matter() {
+    std::vector<int16_t> in = recording(1.0f, 1500.0f, 3000.0f, rate / 2);
+    NoiseSuppressor* whole = new NoiseSuppressor();
+    std::vector<int16_t> reference = run(*whole, in, MIC_FRAME_SAMPLES);
+    const size_t blocks[] = { 1, 37, 1000 };
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        whole->reset(rate);
+        std::vector<int16_t> out = run(*whole, in, blocks[b]);
+        TEST_ASSERT_EQUAL_INT16_ARRAY(&reference[0], &out[0], reference.size());
+    }
+    delete whole;
+}
+
+static void test_drain_returns_the_tail() {
+    NoiseSuppressor* stage = new NoiseSuppressor();
+    std::vector<int16_t> in = recording(1.0f, 0.0f, 8000.0f, rate / 2);
+    run(*stage, in, MIC_FRAME_SAMPLES);
+    size_t count = 0;
+    int16_t* tail = stage->drain(count);
+    TEST_ASSERT_EQUAL(stage->latency(), count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_INT_WITHIN(1, in[in.size() - count + i], tail[i]);
+    }
+    delete stage;
+}
+
+static void test_reset_starts_a_new_profile() {
+    NoiseSuppressor* stage = new NoiseSuppressor();
+    run(*stage, recording(0.5f, 1500.0f, 0.0f, 0), MIC_FRAME_SAMPLES);
+    TEST_ASSERT_FALSE(stage->isLearning());
+    NoiseSuppressor::Stats stats = stage->getStats();
+    TEST_ASSERT_EQUAL_UINT32(rate / 2 / NOISE_HOP_SAMPLES, stats.frames);
+    TEST_ASSERT_EQUAL_UINT32(NOISE_HOP_SAMPLES * 10000ULL * NOISE_CPU_BUDGET_PERCENT / rate, stats.budgetUs);
+
+    // The old profile is forgotten: a tone over silence now passes unchanged
+    stage->reset(rate);
+    TEST_ASSERT_TRUE(stage->isLearning());
+    TEST_ASSERT_EQUAL_UINT32(0, stage->getStats().frames);
+    std::vector<int16_t> in = recording(1.0f, 0.0f, 8000.0f, rate / 2);
+    std::vector<int16_t> out = run(*stage, in, MIC_FRAME_SAMPLES);
+    for (size_t n = stage->latency(); n < out.size(); n++) {
+        TEST_ASSERT_INT_WITHIN(1, in[n - stage->latency()], out[n]);
+    }
+    delete stage;
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_nothing_to_subtract_is_only_delayed);
+    RUN_TEST(test_learns_then_suppresses_the_noise);
+    RUN_TEST(test_block_length_does_not_matter);
+    RUN_TEST(test_drain_returns_the_tail);
+    RUN_TEST(test_reset_starts_a_new_profile);
+    return UNITY_END();
+}
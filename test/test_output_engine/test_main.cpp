@@ -0,0 +1,165 @@
+#include <unity.h>
+#include <vector>
+#include "I2SManager.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the persistent output engine against the simulated I2S driver.
+ *
+ * The writer task runs on a host thread and the driver plays its DMA buffers out in real time,
+ * so each test waits for its audio to be heard. One engine serves every test, as on the toy.
+ */
+
+static const int16_t LEVEL = 1000; // Below the compressor threshold, played unchanged
+
+static i2s_pin_config_t pins() {
+    i2s_pin_config_t config;
+    config.mck_io_num = I2S_PIN_NO_CHANGE;
+    config.bck_io_num = 26;
+    config.ws_io_num = 25;
+    config.data_out_num = 22;
+    config.data_in_num = I2S_PIN_NO_CHANGE;
+    return config;
+}
+
+static I2SManager engine(pins(), AUDIO_OUTPUT_RATE);
+
+/// Queues `frames` stereo frames at LEVEL, waiting for room in the ring
+static void queueTone(size_t frames) {
+    std::vector<int16_t> tone(frames * AUDIO_OUTPUT_CHANNELS, LEVEL);
+    size_t queued = 0;
+    while (queued < tone.size()) {
+        queued += engine.writeBlock(tone.data() + queued, tone.size() - queued);
+        if (queued < tone.size()) delay(1);
+    }
+}
+
+/// Waits until the writer task has taken everything from the ring
+static void waitQueued() {
+    while (engine.ring().readAvailable() > 0) delay(1);
+}
+
+/// Waits until the ring is empty and the DMA buffers have been heard twice over
+static void waitPlayed() {
+    waitQueued();
+    delay(2 * 1000 * I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN / engine.getSampleRate() + 20);
+}
+
+/// Frames heard at LEVEL, or on its way there while fading in
+static size_t framesHeard(const std::vector<int16_t>& heard) {
+    size_t samples = 0;
+    for (size_t i = 0; i < heard.size(); i++) {
+        if (heard[i] > 0 && heard[i] <= LEVEL) samples++;
+    }
+    return samples / AUDIO_OUTPUT_CHANNELS;
+}
+
+/// Longest run of silent frames between the first and the last frame heard
+static size_t longestGap(const std::vector<int16_t>& heard) {
+    size_t first = 0;
+    size_t last = heard.size();
+    while (first < last && heard[first] == 0) first++;
+    while (last > first && heard[last - 1] == 0) last--;
+    size_t longest = 0;
+    size_t run = 0;
+    for (size_t i = first; i < last; i++) {
+        run = heard[i] == 0 ? run + 1 : 0;
+        if (run > longest) longest = run;
+    }
+    return longest / AUDIO_OUTPUT_CHANNELS;
+}
+
+void setUp() {
+    engine.begin(); // Only the first call installs the driver
+}
+
+void tearDown() {
+    engine.stop();
+    engine.setSampleRate(AUDIO_OUTPUT_RATE);
+}
+
+static void test_driver_is_installed_once_across_tracks() {
+    const int rates[] = { AUDIO_OUTPUT_RATE, 22050, AUDIO_OUTPUT_RATE, 22050 };
+    const uint32_t clockChanges = hostI2S().clockChanges;
+    hostI2S().record();
+    for (int track = 0; track < 4; track++) {
+        TEST_ASSERT_TRUE(engine.setSampleRate(rates[track]));
+        engine.markTrackStart();
+        engine.resume();
+        queueTone(rates[track] / 50); // 20 ms
+        waitPlayed();
+        engine.stop();
+        engine.begin();
+    }
+    std::vector<int16_t> heard = hostI2S().takeHeard();
+
+    TEST_ASSERT_EQUAL_UINT32(1, hostI2S().installs);
+    TEST_ASSERT_EQUAL_UINT32(0, hostI2S().uninstalls);
+    TEST_ASSERT_EQUAL_UINT32(clockChanges + 3, hostI2S().clockChanges); // The first track kept the rate
+    TEST_ASSERT_EQUAL(22050, engine.getSampleRate());
+    TEST_ASSERT_EQUAL(2 * AUDIO_OUTPUT_RATE / 50 + 2 * 22050 / 50, framesHeard(heard)); // Every track, whole
+}
+
+static void test_retune_while_stopped_keeps_the_driver_stopped() {
+    engine.stop();
+    const uint32_t clockChanges = hostI2S().clockChanges;
+    TEST_ASSERT_TRUE(engine.setSampleRate(32000));
+    TEST_ASSERT_EQUAL_UINT32(clockChanges + 1, hostI2S().clockChanges);
+    TEST_ASSERT_FALSE(hostI2S().started); // i2s_set_clk restarted it, the engine stopped it again
+    TEST_ASSERT_TRUE(engine.setSampleRate(32000));
+    TEST_ASSERT_EQUAL_UINT32(clockChanges + 1, hostI2S().clockChanges); // Same rate, not reprogrammed
+    TEST_ASSERT_FALSE(engine.setSampleRate(0));
+
+    engine.resume();
+    TEST_ASSERT_TRUE(hostI2S().started);
+    TEST_ASSERT_EQUAL_UINT32(1, hostI2S().installs);
+}
+
+static void test_track_is_heard_whole() {
+    const size_t frames = AUDIO_OUTPUT_RATE / 10;
+    hostI2S().record();
+    engine.markTrackStart();
+    queueTone(frames);
+    waitPlayed();
+    std::vector<int16_t> heard = hostI2S().takeHeard();
+
+    TEST_ASSERT_EQUAL(frames, framesHeard(heard)); // Including the compressor's delayed tail
+    TEST_ASSERT_GREATER_THAN(0, engine.getFirstSampleLatencyUs());
+}
+
+static void test_short_dry_spell_inserts_no_silence() {
+    const size_t frames = AUDIO_OUTPUT_RATE / 10;
+    const uint32_t underruns = engine.getUnderrunFrames();
+    hostI2S().record();
+    queueTone(frames);
+    waitQueued();
+    delay(5); // The DMA buffers still hold about 40 ms
+    queueTone(frames);
+    waitQueued();
+    std::vector<int16_t> heard = hostI2S().takeHeard(); // Before the DMA buffers run dry
+    waitPlayed();
+
+    TEST_ASSERT_EQUAL_UINT32(underruns, engine.getUnderrunFrames()); // Nothing was heard missing
+    TEST_ASSERT_EQUAL(0, longestGap(heard)); // The compressor kept its look-ahead
+}
+
+static void test_tail_is_heard_once_the_stream_ends() {
+    const size_t frames = AUDIO_OUTPUT_RATE / 10;
+    hostI2S().record();
+    queueTone(frames);
+    waitQueued();
+    TEST_ASSERT_TRUE(engine.compressor().holdsAudio()); // Not drained while the DMA buffers play
+    waitPlayed();
+    TEST_ASSERT_FALSE(engine.compressor().holdsAudio());
+    TEST_ASSERT_EQUAL(frames, framesHeard(hostI2S().takeHeard()));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_driver_is_installed_once_across_tracks);
+    RUN_TEST(test_retune_while_stopped_keeps_the_driver_stopped);
+    RUN_TEST(test_track_is_heard_whole);
+    RUN_TEST(test_short_dry_spell_inserts_no_silence);
+    RUN_TEST(test_tail_is_heard_once_the_stream_ends);
+    return UNITY_END();
+}
@@ -0,0 +1,172 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "WAVFileReader.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native benchmark of the block playback pipeline against the old per-sample path.
+ *
+ * The block pipeline is timed through `decodeStep()`, the reader's fill stage without the
+ * task around it, and the per-sample path as the old reader task ran it: one `readSample()`,
+ * one single-sample hand-off and one `vTaskDelay(1)` per sample. Both report samples/s against
+ * the 88200 samples/s of 44.1 kHz stereo. A last case plays a story through the output engine
+ * and the simulated I2S driver in real time and checks that nothing is heard missing.
+ */
+
+static const int16_t LEVEL = 1000; // Below the compressor threshold, played unchanged
+static const uint32_t REAL_TIME = AUDIO_OUTPUT_RATE * AUDIO_OUTPUT_CHANNELS; // Samples/s to keep up
+
+static i2s_pin_config_t pins() {
+    i2s_pin_config_t config;
+    config.mck_io_num = I2S_PIN_NO_CHANGE;
+    config.bck_io_num = 26;
+    config.ws_io_num = 25;
+    config.data_out_num = 22;
+    config.data_in_num = I2S_PIN_NO_CHANGE;
+    return config;
+}
+
+static I2SManager engine(pins(), AUDIO_OUTPUT_RATE);
+
+static void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void put16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+/// Writes a 16-bit stereo PCM file at AUDIO_OUTPUT_RATE; `level` 0 fills it with a ramp instead
+static void putStory(const char* path, size_t frames, int16_t level) {
+    std::vector<uint8_t> file;
+    const uint32_t dataBytes = (uint32_t)(frames * 4);
+    file.insert(file.end(), { 'R', 'I', 'F', 'F' });
+    put32(file, 36 + dataBytes);
+    file.insert(file.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+    put32(file, 16);
+    put16(file, WAVE_FORMAT_PCM);
+    put16(file, 2);
+    put32(file, AUDIO_OUTPUT_RATE);
+    put32(file, AUDIO_OUTPUT_RATE * 4);
+    put16(file, 4);
+    put16(file, 16);
+    file.insert(file.end(), { 'd', 'a', 't', 'a' });
+    put32(file, dataBytes);
+    for (size_t i = 0; i < frames * 2; i++) {
+        put16(file, (uint16_t)(level ? level : (int16_t)(i * 7)));
+    }
+    SD.put(path, file);
+}
+
+/// Prints and returns the samples/s of a path
+static uint32_t report(const char* path, uint32_t samples, uint64_t elapsedUs) {
+    char message[128];
+    uint32_t rate = (uint32_t)((uint64_t)samples * 1000000ULL / (elapsedUs > 0 ? elapsedUs : 1));
+    snprintf(message, sizeof(message), "%s: %u samples/s, %.2fx real time at 44.1 kHz stereo", path,
+             rate, (double)rate / REAL_TIME);
+    TEST_MESSAGE(message);
+    return rate;
+}
+
+/// Frames heard at LEVEL, or on its way there while fading in
+static size_t framesHeard(const std::vector<int16_t>& heard) {
+    size_t samples = 0;
+    for (size_t i = 0; i < heard.size(); i++) {
+        if (heard[i] > 0 && heard[i] <= LEVEL) samples++;
+    }
+    return samples / AUDIO_OUTPUT_CHANNELS;
+}
+
+void setUp() {
+    SD.clear();
+}
+
+void tearDown() {}
+
+static void test_block_pipeline_outruns_real_time() {
+    const size_t frames = AUDIO_OUTPUT_RATE * 10;
+    putStory("/story.wav", frames, 0);
+    WAVFileReader reader("/story.wav", &engine);
+    TEST_ASSERT_TRUE(reader.open());
+    I2SManager::PlaybackRing* ring = new I2SManager::PlaybackRing();
+
+    uint32_t samples = 0;
+    bool exact = true;
+    const uint64_t start = micros();
+    while (reader.decodeStep(*ring)) {
+        size_t available = ring->readAvailable();
+        while (available > 0) {
+            size_t span = available;
+            const int16_t* data = ring->peek(span);
+            for (size_t i = 0; i < span; i++) {
+                exact = exact && data[i] == (int16_t)((samples + i) * 7);
+            }
+            samples += span;
+            ring->consume(span);
+            available -= span;
+        }
+    }
+    const uint64_t elapsedUs = micros() - start;
+    delete ring;
+
+    uint32_t rate = report("Block pipeline", samples, elapsedUs);
+    TEST_ASSERT_EQUAL_UINT32(frames * 2, samples);
+    TEST_ASSERT_TRUE(exact);
+    TEST_ASSERT_GREATER_THAN(10 * REAL_TIME, rate); // CPU to spare for the DSP and the SD card
+}
+
+static void test_per_sample_path_falls_behind_real_time() {
+    const size_t count = 250;
+    putStory("/story.wav", count, 0);
+    WAVFileReader reader("/story.wav", &engine);
+    TEST_ASSERT_TRUE(reader.open());
+    I2SManager::PlaybackRing* ring = new I2SManager::PlaybackRing();
+
+    uint32_t samples = 0;
+    int16_t sample;
+    const uint64_t start = micros();
+    while (samples < count && reader.readSample(sample)) {
+        ring->write(&sample, 1); // One hand-off per sample, as writeSample() did
+        ring->consume(1);
+        vTaskDelay(1);           // The old reader task yielded after every sample
+        samples++;
+    }
+    const uint64_t elapsedUs = micros() - start;
+    delete ring;
+
+    uint32_t rate = report("Per-sample path", samples, elapsedUs);
+    TEST_ASSERT_EQUAL_UINT32(count, samples);
+    TEST_ASSERT_LESS_THAN(REAL_TIME, rate); // Capped near 1000 samples/s by the tick delay
+}
+
+static void test_story_plays_without_underruns() {
+    const size_t frames = AUDIO_OUTPUT_RATE / 2; // Several times the playback ring
+    putStory("/story.wav", frames, LEVEL);
+    WAVFileReader reader("/story.wav", &engine);
+    TEST_ASSERT_TRUE(reader.open());
+    engine.begin();
+    const uint32_t underruns = engine.getUnderrunFrames();
+
+    hostI2S().record();
+    engine.markTrackStart();
+    engine.resume();
+    reader.startPlayback();
+    while (reader.getPlaybackState() != WAVFileReader::STOPPED) delay(1);
+    while (engine.ring().readAvailable() > 0) delay(1);
+    delay(2 * 1000 * I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN / AUDIO_OUTPUT_RATE + 20); // The DMA buffers, twice
+    std::vector<int16_t> heard = hostI2S().takeHeard();
+    engine.stop();
+
+    TEST_ASSERT_EQUAL_UINT32(underruns, engine.getUnderrunFrames());
+    TEST_ASSERT_EQUAL(frames, framesHeard(heard));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_block_pipeline_outruns_real_time);
+    RUN_TEST(test_per_sample_path_falls_behind_real_time);
+    RUN_TEST(test_story_plays_without_underruns);
+    return UNITY_END();
+}
@@ -0,0 +1,142 @@
+#include <unity.h>
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include "MicManager.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the pre-trigger ring handover in MicManager.
+ *
+ * The capture task runs on a host thread. The ADC DMA driver is not simulated, so it polls
+ * `analogRead()`, which the frame delivery and the handover share with DMA capture. The
+ * microphone reads a square wave that flips every `EDGE_SPACING` readings, a full-range step
+ * the DC blocker lets through. Steps exactly `EDGE_SPACING` samples apart through the whole
+ * stream read by the consumer show that no sample was lost or repeated at the handover.
+ */
+
+static const uint32_t RATE = 8000;
+static const size_t KEEP = PRETRIGGER_MS * RATE / 1000;
+static const size_t EDGE_SPACING = 100; // Not a divisor of MIC_FRAME_SAMPLES, so edges move across frames
+
+static std::atomic<uint32_t> readings(0);
+
+static int squareWave(uint8_t pin) {
+    return (readings++ / EDGE_SPACING) & 1 ? (1 << MIC_RESOLUTION) - 1 : 0;
+}
+
+static MicManager mic;
+
+/// Reads everything queued in the capture ring into `out`
+static void drain(std::vector<int16_t>& out) {
+    MicManager::CaptureRing& ring = mic.captureRing();
+    size_t count = ring.readAvailable();
+    size_t start = out.size();
+    out.resize(start + count);
+    TEST_ASSERT_EQUAL(count, ring.read(out.data() + start, count));
+}
+
+/// Positions of the flips of the square wave: steps of more than half the recording range
+static std::vector<size_t> edges(const std::vector<int16_t>& samples) {
+    std::vector<size_t> found;
+    for (size_t i = 1; i < samples.size(); i++) {
+        if (abs((int32_t)samples[i] - samples[i - 1]) > (WAV_RESOLUTION_MAX - WAV_RESOLUTION_MIN) / 2) found.push_back(i);
+    }
+    return found;
+}
+
+/// True if every edge is EDGE_SPACING samples after the previous one
+static bool evenlySpaced(const std::vector<size_t>& found) {
+    for (size_t i = 1; i < found.size(); i++) {
+        if (found[i] - found[i - 1] != EDGE_SPACING) {
+            char message[96];
+            snprintf(message, sizeof(message), "Edge %u is %u samples after the previous one", (unsigned)i,
+                     (unsigned)(found[i] - found[i - 1]));
+            TEST_MESSAGE(message);
+            return false;
+        }
+    }
+    return true;
+}
+
+void setUp() {
+    readings = 0;
+    hostAnalogSource() = squareWave;
+    mic.begin();
+}
+
+void tearDown() {
+    mic.stopCapture();
+}
+
+static void test_armed_ring_holds_only_the_newest_samples() {
+    TEST_ASSERT_TRUE(mic.startCapture(RATE));
+    TEST_ASSERT_FALSE(mic.getCaptureStats().dma); // GPIO38 has no ADC1 channel
+    mic.setPreTrigger(KEEP);
+    delay(1500); // Three times the pre-trigger, no consumer
+
+    MicManager::CaptureStats stats = mic.getCaptureStats();
+    const size_t queued = mic.captureRing().readAvailable();
+    TEST_ASSERT_GREATER_THAN(2 * KEEP, readings.load());
+    TEST_ASSERT_LESS_OR_EQUAL(KEEP, queued);
+    TEST_ASSERT_GREATER_OR_EQUAL(KEEP - MIC_FRAME_SAMPLES, queued);
+    TEST_ASSERT_LESS_OR_EQUAL(KEEP, stats.preTriggerSamples);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.droppedSamples);
+}
+
+static void test_handover_keeps_every_sample_in_order() {
+    TEST_ASSERT_TRUE(mic.startCapture(RATE));
+    mic.setPreTrigger(KEEP);
+    delay(1000);
+
+    mic.setPreTrigger(0); // Returns once the capture task has let go of the consumer side
+    TEST_ASSERT_EQUAL_UINT32(0, mic.getCaptureStats().preTriggerSamples);
+    std::vector<int16_t> heard;
+    drain(heard);
+    const size_t held = heard.size();
+    const uint32_t start = millis();
+    while (millis() - start < 500) {
+        drain(heard);
+        delay(5);
+    }
+    mic.stopCapture();
+    drain(heard);
+
+    char message[128];
+    snprintf(message, sizeof(message), "%u samples held at the handover, %u read in all", (unsigned)held,
+             (unsigned)heard.size());
+    TEST_MESSAGE(message);
+    TEST_ASSERT_GREATER_OR_EQUAL(KEEP - MIC_FRAME_SAMPLES, held);
+    TEST_ASSERT_EQUAL_UINT32(0, mic.getCaptureStats().droppedSamples);
+    std::vector<size_t> found = edges(heard);
+    TEST_ASSERT_GREATER_THAN(heard.size() / EDGE_SPACING - 2, found.size());
+    TEST_ASSERT_TRUE(evenlySpaced(found));
+}
+
+static void test_rearming_after_a_recording_trims_again() {
+    TEST_ASSERT_TRUE(mic.startCapture(RATE));
+    mic.setPreTrigger(KEEP);
+    delay(700);
+    mic.setPreTrigger(0);
+    std::vector<int16_t> heard;
+    drain(heard); // The recording takes what was held
+
+    mic.setPreTrigger(KEEP); // Armed again while capture keeps running
+    delay(1000);
+    const size_t queued = mic.captureRing().readAvailable();
+    TEST_ASSERT_LESS_OR_EQUAL(KEEP, queued);
+    TEST_ASSERT_GREATER_OR_EQUAL(KEEP - MIC_FRAME_SAMPLES, queued);
+
+    mic.setPreTrigger(0);
+    drain(heard);
+    mic.stopCapture();
+    TEST_ASSERT_EQUAL_UINT32(0, mic.getCaptureStats().droppedSamples);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_armed_ring_holds_only_the_newest_samples);
+    RUN_TEST(test_handover_keeps_every_sample_in_order);
+    RUN_TEST(test_rearming_after_a_recording_trims_again);
+    return UNITY_END();
+}
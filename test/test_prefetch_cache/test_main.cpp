@@ -0,0 +1,180 @@
+#include <unity.h>
+#include <vector>
+#include "PrefetchCache.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the PSRAM read-ahead cache: hits, LRU eviction, window protection and file keys.
+ *
+ * The fill task runs on a host thread; each test waits until it has nothing left to read.
+ */
+
+static const uint32_t BLOCK = PREFETCH_BLOCK_BYTES;
+static const uint32_t POOL_BLOCKS = PREFETCH_CACHE_BYTES / PREFETCH_BLOCK_BYTES;
+
+static std::vector<uint8_t> pattern(size_t size, uint8_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) data[i] = (uint8_t)(i * 7 + (i >> 14) + seed);
+    return data;
+}
+
+/// Byte rate whose PREFETCH_AHEAD_MS window is `blocks` blocks long
+static uint32_t rateFor(uint32_t blocks) {
+    return (uint32_t)((uint64_t)blocks * BLOCK * 1000 / PREFETCH_AHEAD_MS);
+}
+
+/// Waits until the fill task has read nothing for 50 ms, returns the blocks read ahead
+static uint32_t settle(PrefetchCache& cache) {
+    uint32_t fills = cache.getStats().fills;
+    uint32_t quietSince = millis();
+    uint32_t start = millis();
+    while (millis() - quietSince < 50 && millis() - start < 5000) {
+        delay(5);
+        uint32_t now = cache.getStats().fills;
+        if (now != fills) {
+            fills = now;
+            quietSince = millis();
+        }
+    }
+    return fills;
+}
+
+/// True if `size` bytes at `offset` are served entirely from the cache and match the file
+static bool cached(PrefetchCache& cache, int stream, const std::vector<uint8_t>& file, uint32_t offset, size_t size) {
+    std::vector<uint8_t> buffer(size);
+    return cache.read(stream, offset, buffer.data(), size) == size &&
+           memcmp(buffer.data(), file.data() + offset, size) == 0;
+}
+
+void setUp() {
+    SD.clear();
+}
+
+void tearDown() {}
+
+static void test_window_is_read_ahead_and_hits() {
+    std::vector<uint8_t> file = pattern(6 * BLOCK + 1000, 1);
+    SD.put("/story.wav", file);
+    PrefetchCache cache;
+    TEST_ASSERT_TRUE(cache.begin());
+    int stream = cache.attach("/story.wav", 44, file.size(), rateFor(16));
+    TEST_ASSERT_GREATER_OR_EQUAL(0, stream);
+    TEST_ASSERT_EQUAL_UINT32(7, settle(cache)); // Up to the end of the file, the last block short
+    TEST_ASSERT_EQUAL_UINT32(7, cache.getStats().cachedBlocks);
+
+    TEST_ASSERT_TRUE(cached(cache, stream, file, 44, BLOCK));                  // Across a block boundary
+    TEST_ASSERT_TRUE(cached(cache, stream, file, 6 * BLOCK, 1000));            // Short last block
+    std::vector<uint8_t> buffer(2000);
+    TEST_ASSERT_EQUAL(1000, cache.read(stream, 6 * BLOCK, buffer.data(), 2000)); // Nothing past the end
+    PrefetchCache::Stats stats = cache.getStats();
+    TEST_ASSERT_EQUAL_UINT32(2, stats.hits);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.misses);
+    cache.detach(stream);
+}
+
+static void test_windows_are_never_evicted() {
+    const uint32_t aBlocks = POOL_BLOCKS / 2;
+    const uint32_t bBlocks = POOL_BLOCKS * 3 / 4;
+    std::vector<uint8_t> a = pattern(aBlocks * BLOCK, 2);
+    std::vector<uint8_t> b = pattern((bBlocks + 8) * BLOCK, 3);
+    SD.put("/a.wav", a);
+    SD.put("/b.wav", b);
+    PrefetchCache cache;
+    cache.begin();
+    int sa = cache.attach("/a.wav", 0, a.size(), rateFor(aBlocks));
+    settle(cache);
+    int sb = cache.attach("/b.wav", 0, b.size(), rateFor(bBlocks));
+
+    // Both windows together are larger than the pool: B only gets the blocks A leaves
+    TEST_ASSERT_EQUAL_UINT32(POOL_BLOCKS, settle(cache));
+    TEST_ASSERT_EQUAL_UINT32(POOL_BLOCKS, cache.getStats().cachedBlocks);
+    TEST_ASSERT_TRUE(cached(cache, sb, b, 0, 64));
+    TEST_ASSERT_FALSE(cached(cache, sb, b, (bBlocks - 1) * BLOCK, 64));
+    TEST_ASSERT_TRUE(cached(cache, sa, a, 0, a.size())); // The first window attached stays whole
+    cache.detach(sa);
+    cache.detach(sb);
+}
+
+static void test_least_recently_used_is_evicted_first() {
+    const uint32_t aBlocks = POOL_BLOCKS / 2;
+    const uint32_t bBlocks = POOL_BLOCKS * 3 / 4;
+    std::vector<uint8_t> a = pattern(aBlocks * BLOCK, 4);
+    std::vector<uint8_t> b = pattern(bBlocks * BLOCK, 5);
+    SD.put("/a.wav", a);
+    SD.put("/b.wav", b);
+    PrefetchCache cache;
+    cache.begin();
+    int sa = cache.attach("/a.wav", 0, a.size(), rateFor(aBlocks));
+    settle(cache);
+    for (uint32_t i = aBlocks; i-- > 0;) {
+        TEST_ASSERT_TRUE(cached(cache, sa, a, i * BLOCK, 16)); // Block 0 is used last
+    }
+
+    // A's blocks leave their window: B fills the free half, then takes the ones used longest ago
+    cache.detach(sa);
+    int sb = cache.attach("/b.wav", 0, b.size(), rateFor(bBlocks));
+    TEST_ASSERT_EQUAL_UINT32(aBlocks + bBlocks, settle(cache));
+    TEST_ASSERT_TRUE(cached(cache, sb, b, 0, b.size()));
+    cache.detach(sb);
+
+    const uint32_t kept = POOL_BLOCKS - bBlocks;
+    sa = cache.attach("/a.wav", 0, a.size(), rateFor(1));
+    TEST_ASSERT_TRUE(cached(cache, sa, a, 0, 16));                      // Used last, kept
+    TEST_ASSERT_TRUE(cached(cache, sa, a, (kept - 1) * BLOCK, 16));     // Oldest one kept
+    std::vector<uint8_t> miss(16);
+    TEST_ASSERT_EQUAL(0, cache.read(sa, kept * BLOCK, miss.data(), 16)); // Evicted
+    cache.detach(sa);
+}
+
+static void test_rewritten_file_never_hits_stale_blocks() {
+    std::vector<uint8_t> first = pattern(3 * BLOCK, 6);
+    SD.put("/response.mp3", first);
+    PrefetchCache cache;
+    cache.begin();
+    int stream = cache.attach("/response.mp3", 0, first.size(), rateFor(8));
+    settle(cache);
+    TEST_ASSERT_TRUE(cached(cache, stream, first, 0, 3 * BLOCK));
+    cache.detach(stream);
+
+    // Same path and size, new content: the modification time changes the key
+    std::vector<uint8_t> second = pattern(3 * BLOCK, 7);
+    SD.put("/response.mp3", second);
+    SD.file("/response.mp3")->lastWrite = 42;
+    stream = cache.attach("/response.mp3", 0, second.size(), rateFor(8));
+    uint8_t buffer[64];
+    size_t early = cache.read(stream, 0, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_MEMORY(second.data(), buffer, early); // Whatever is already cached is new
+    settle(cache);
+    TEST_ASSERT_TRUE(cached(cache, stream, second, 0, 3 * BLOCK));
+
+    // Replaying the unchanged file costs no SD reads
+    cache.detach(stream);
+    uint32_t fills = cache.getStats().fills;
+    stream = cache.attach("/response.mp3", 0, second.size(), rateFor(8));
+    TEST_ASSERT_TRUE(cached(cache, stream, second, 0, 3 * BLOCK));
+    TEST_ASSERT_EQUAL_UINT32(fills, settle(cache));
+    cache.detach(stream);
+}
+
+static void test_destructor_waits_for_the_fill_task() {
+    std::vector<uint8_t> file = pattern(POOL_BLOCKS * BLOCK, 8);
+    SD.put("/long.wav", file);
+    for (int round = 0; round < 20; round++) {
+        PrefetchCache* cache = new PrefetchCache();
+        cache->begin();
+        cache->attach("/long.wav", 0, file.size(), rateFor(POOL_BLOCKS));
+        delete cache; // While the task reads into the pool
+    }
+    PrefetchCache idle;
+    TEST_ASSERT_FALSE(idle.getStats().fills); // Never started, nothing to wait for
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_window_is_read_ahead_and_hits);
+    RUN_TEST(test_windows_are_never_evicted);
+    RUN_TEST(test_least_recently_used_is_evicted_first);
+    RUN_TEST(test_rewritten_file_never_hits_stale_blocks);
+    RUN_TEST(test_destructor_waits_for_the_fill_task);
+    return UNITY_END();
+}
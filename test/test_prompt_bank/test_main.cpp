@@ -0,0 +1,265 @@
+#include <unity.h>
+#include <stdio.h>
+#include <algorithm>
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "PromptPlayer.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the prompt bank format shared by `scripts/pack_prompts.py` and `PromptPlayer`.
+ *
+ * The layout is written twice, once as `struct` formats in the script and once as the
+ * `BankHeader`/`BankEntry` structs of the player, and nothing else ties them together. These
+ * tests read the constants and the formats out of the script, pack a bank with them and map it
+ * through the host partition table; when Python is available they also run the script itself
+ * on a scratch project and load the bank it writes.
+ */
+
+static const std::string TEST_FILE = __FILE__;
+static const std::string ROOT = TEST_FILE.substr(0, TEST_FILE.rfind("/test/"));
+
+static std::string readText(const std::string& path) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+static void writeText(const std::string& path, const std::string& text) {
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out << text;
+}
+
+/// Value assigned to `name` at the start of a line of the script, up to the comment
+static std::string scriptValue(const std::string& script, const std::string& name) {
+    size_t at = script.find("\n" + name + " = ");
+    if (at == std::string::npos) return "";
+    at += name.size() + 4;
+    std::string value = script.substr(at, script.find_first_of("#\n", at) - at);
+    while (!value.empty() && value[value.size() - 1] == ' ') value.erase(value.size() - 1);
+    return value;
+}
+
+/// The format string of a `struct.Struct("...")` value, with `%d` replaced by NAME_MAX
+static std::string structFormat(const std::string& value, int nameMax) {
+    size_t open = value.find('"');
+    std::string format = value.substr(open + 1, value.find('"', open + 1) - open - 1);
+    size_t percent = format.find("%d");
+    if (percent != std::string::npos) format.replace(percent, 2, std::to_string(nameMax));
+    return format;
+}
+
+/**
+ * Packs little-endian fields like Python's `struct.pack()`: `I`, `H` and `B` take the next
+ * number, `<n>s` the next string, zero padded. Only the codes the bank uses are known.
+ */
+static std::vector<uint8_t> pack(const std::string& format, const std::vector<uint32_t>& numbers,
+                                 const std::vector<std::string>& strings = std::vector<std::string>()) {
+    std::vector<uint8_t> out;
+    size_t number = 0;
+    size_t text = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < format.size(); i++) {
+        char code = format[i];
+        if (code == '<') continue;
+        if (code >= '0' && code <= '9') {
+            count = count * 10 + (code - '0');
+            continue;
+        }
+        size_t bytes = code == 'I' ? 4 : code == 'H' ? 2 : code == 'B' ? 1 : 0;
+        if (code == 's') {
+            std::string value = strings.at(text++);
+            value.resize(count, '\0');
+            out.insert(out.end(), value.begin(), value.end());
+        } else {
+            TEST_ASSERT_TRUE_MESSAGE(bytes > 0, "Unknown struct code in pack_prompts.py");
+            uint32_t value = numbers.at(number++);
+            for (size_t b = 0; b < bytes; b++) out.push_back((uint8_t)(value >> (8 * b)));
+        }
+        count = 0;
+    }
+    return out;
+}
+
+struct Script {
+    uint32_t magic;
+    uint32_t version;
+    int nameMax;
+    std::string header;                 // struct format of the bank header
+    std::string entry;                  // struct format of an index entry
+};
+
+static Script readScript() {
+    std::string text = readText(ROOT + "/scripts/pack_prompts.py");
+    TEST_ASSERT_TRUE_MESSAGE(!text.empty(), "scripts/pack_prompts.py not found");
+    Script script;
+    script.magic = (uint32_t)strtoul(scriptValue(text, "BANK_MAGIC").c_str(), nullptr, 0);
+    script.version = (uint32_t)strtoul(scriptValue(text, "BANK_VERSION").c_str(), nullptr, 0);
+    script.nameMax = atoi(scriptValue(text, "NAME_MAX").c_str());
+    script.header = structFormat(scriptValue(text, "HEADER"), script.nameMax);
+    script.entry = structFormat(scriptValue(text, "ENTRY"), script.nameMax);
+    return script;
+}
+
+static uint32_t fnv1a(const std::string& padded, uint32_t hash) {
+    for (size_t i = 0; i < padded.size(); i++) {
+        hash ^= (uint8_t)padded[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+/// Packs prompts of `samples` samples each, valued by their index, as the script lays them out
+static std::vector<uint8_t> packBank(const Script& script, const std::vector<std::string>& names,
+                                     const std::vector<size_t>& samples) {
+    const size_t headerSize = pack(script.header, std::vector<uint32_t>(8, 0)).size();
+    const size_t entrySize = pack(script.entry, std::vector<uint32_t>(2, 0), std::vector<std::string>(1)).size();
+    const size_t dataStart = (headerSize + entrySize * names.size() + 3) & ~(size_t)3;
+    std::vector<uint8_t> entries;
+    std::vector<uint8_t> body;
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string padded = names[i];
+        padded.resize(script.nameMax, '\0');
+        hash = fnv1a(padded, hash);
+        std::vector<uint8_t> entry = pack(script.entry, { (uint32_t)(dataStart + body.size()), (uint32_t)samples[i] },
+                                          { padded });
+        entries.insert(entries.end(), entry.begin(), entry.end());
+        for (size_t s = 0; s < samples[i]; s++) {
+            std::vector<uint8_t> sample = pack("<H", { (uint32_t)(uint16_t)(100 * (i + 1) + s) });
+            body.insert(body.end(), sample.begin(), sample.end());
+        }
+        body.resize((body.size() + 3) & ~(size_t)3, 0);
+    }
+    entries.resize(dataStart - headerSize, 0);
+    std::vector<uint8_t> bank = pack(script.header, { script.magic, script.version, (uint32_t)names.size(), hash,
+                                                      (uint32_t)(dataStart + body.size()), 1, PROMPT_RATE_SHIFT, 0 });
+    bank.insert(bank.end(), entries.begin(), entries.end());
+    bank.insert(bank.end(), body.begin(), body.end());
+    return bank;
+}
+
+/// Replaces the partition table with one prompt partition holding `bank`
+static void flash(const std::vector<uint8_t>& bank) {
+    hostPartitions().clear();
+    std::vector<uint8_t>& partition = hostPartitions().add(ESP_PARTITION_TYPE_DATA, PROMPT_PARTITION_SUBTYPE,
+                                                           PROMPT_PARTITION_LABEL, 0x10000);
+    std::copy(bank.begin(), bank.end(), partition.begin());
+}
+
+void setUp() {
+    hostPartitions().clear();
+}
+
+void tearDown() {}
+
+static void test_script_constants_match_the_player() {
+    Script script = readScript();
+    TEST_ASSERT_EQUAL_UINT32(PROMPT_BANK_MAGIC, script.magic);
+    TEST_ASSERT_EQUAL_UINT32(PROMPT_BANK_VERSION, script.version);
+    TEST_ASSERT_EQUAL(PROMPT_NAME_MAX, script.nameMax);
+    TEST_ASSERT_EQUAL_STRING("<IHHIIBBH", script.header.c_str()); // Update the structs and the version together
+}
+
+static void test_bank_packed_by_the_script_layout_is_mapped() {
+    Script script = readScript();
+    std::vector<std::string> names = { "boot_chime", "battery_low", "recording_started" };
+    flash(packBank(script, names, { 5, 6, 4 }));
+
+    PromptPlayer prompts(nullptr);
+    TEST_ASSERT_TRUE(prompts.begin());
+    TEST_ASSERT_EQUAL(3, prompts.count());
+    for (int i = 0; i < 3; i++) TEST_ASSERT_EQUAL(i, prompts.find(names[i].c_str()));
+    TEST_ASSERT_EQUAL(-1, prompts.find("missing"));
+
+    AudioMixer::Sound sound;
+    TEST_ASSERT_TRUE(prompts.getSound(1, sound));
+    TEST_ASSERT_EQUAL(6, sound.count);
+    TEST_ASSERT_TRUE(sound.mono);
+    TEST_ASSERT_EQUAL(PROMPT_RATE_SHIFT, sound.rateShift);
+    for (int s = 0; s < 6; s++) TEST_ASSERT_EQUAL_INT16(200 + s, sound.samples[s]);
+    TEST_ASSERT_FALSE(prompts.getSound(3, sound));
+    prompts.end();
+}
+
+static void test_foreign_or_damaged_banks_are_refused() {
+    Script script = readScript();
+    PromptPlayer prompts(nullptr);
+    TEST_ASSERT_FALSE(prompts.begin()); // No partition
+
+    flash(std::vector<uint8_t>()); // Erased flash
+    TEST_ASSERT_FALSE(prompts.begin());
+
+    Script older = script;
+    older.version = script.version - 1;
+    flash(packBank(older, { "boot_chime" }, { 4 }));
+    TEST_ASSERT_FALSE(prompts.begin());
+
+    std::vector<uint8_t> renamed = packBank(script, { "boot_chime" }, { 4 });
+    size_t headerSize = pack(script.header, std::vector<uint32_t>(8, 0)).size();
+    renamed[headerSize] = 'B'; // A name that does not hash to the header
+    flash(renamed);
+    TEST_ASSERT_FALSE(prompts.begin());
+    TEST_ASSERT_FALSE(prompts.isReady());
+}
+
+static void test_bank_written_by_the_script_is_mapped() {
+    if (system("python3 --version > /dev/null 2>&1") != 0) {
+        TEST_MESSAGE("python3 not found, the script was not run");
+        return;
+    }
+    char scratch[] = "/tmp/prompt_bankXXXXXX";
+    TEST_ASSERT_NOT_NULL(mkdtemp(scratch));
+    const std::string project = scratch;
+    TEST_ASSERT_EQUAL(0, system(("mkdir -p " + project + "/scripts " + project + "/src " + project + "/include " +
+                                 project + "/prompts").c_str()));
+    writeText(project + "/scripts/pack_prompts.py", readText(ROOT + "/scripts/pack_prompts.py"));
+    writeText(project + "/src/Config.h", readText(ROOT + "/src/Config.h"));
+
+    // Two prompts, 16-bit mono at the bank rate, so the script stores their samples unchanged
+    const char* names[] = { "a_chime", "b_low" };
+    for (int p = 0; p < 2; p++) {
+        const uint32_t rate = AUDIO_OUTPUT_RATE >> PROMPT_RATE_SHIFT;
+        std::vector<uint32_t> fmt = { 1, 1, rate, rate * 2, 2, 16 };
+        std::vector<uint8_t> wav = pack("<4sI4s4sI", { 36 + 2 * 10, 16 }, { "RIFF", "WAVE", "fmt " });
+        std::vector<uint8_t> body = pack("<HHIIHH", fmt);
+        std::vector<uint8_t> data = pack("<4sI", { 2 * 10 }, { "data" });
+        wav.insert(wav.end(), body.begin(), body.end());
+        wav.insert(wav.end(), data.begin(), data.end());
+        for (int s = 0; s < 10; s++) {
+            std::vector<uint8_t> sample = pack("<H", { (uint32_t)(uint16_t)(1000 * (p + 1) - s) });
+            wav.insert(wav.end(), sample.begin(), sample.end());
+        }
+        writeText(project + "/prompts/" + names[p] + ".wav", std::string(wav.begin(), wav.end()));
+    }
+    TEST_ASSERT_EQUAL(0, system(("python3 " + project + "/scripts/pack_prompts.py " + project +
+                                 "/prompts.bin > /dev/null").c_str()));
+    std::string bin = readText(project + "/prompts.bin");
+    std::string index = readText(project + "/include/PromptIndex.h");
+    TEST_ASSERT_EQUAL(0, system(("rm -rf " + project).c_str()));
+
+    flash(std::vector<uint8_t>(bin.begin(), bin.end()));
+    PromptPlayer prompts(nullptr);
+    TEST_ASSERT_TRUE(prompts.begin());
+    TEST_ASSERT_EQUAL(2, prompts.count());
+    TEST_ASSERT_EQUAL(1, prompts.find("b_low"));
+    AudioMixer::Sound sound;
+    TEST_ASSERT_TRUE(prompts.getSound(1, sound));
+    TEST_ASSERT_EQUAL(10, sound.count);
+    for (int s = 0; s < 10; s++) TEST_ASSERT_EQUAL_INT16(2000 - s, sound.samples[s]);
+    TEST_ASSERT_TRUE(index.find("constexpr uint16_t B_LOW = 1;") != std::string::npos);
+    prompts.end();
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_script_constants_match_the_player);
+    RUN_TEST(test_bank_packed_by_the_script_layout_is_mapped);
+    RUN_TEST(test_foreign_or_damaged_banks_are_refused);
+    RUN_TEST(test_bank_written_by_the_script_is_mapped);
+    return UNITY_END();
+}
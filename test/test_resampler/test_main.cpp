@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <vector>
+#include "Resampler.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the polyphase resampler: rate, level, channels and streaming.
+ */
+
+static std::vector<int16_t> tone(uint32_t rate, double hz, size_t frames, size_t channels, size_t toneChannel) {
+    std::vector<int16_t> out(frames * channels, 0);
+    for (size_t i = 0; i < frames; i++) {
+        out[i * channels + toneChannel] = (int16_t)lrint(16000.0 * sin(2.0 * M_PI * hz * i / rate));
+    }
+    return out;
+}
+
+/**
+ * @brief Runs a whole signal through a resampler in blocks of varied size.
+ */
+static std::vector<int16_t> convert(Resampler& resampler, const std::vector<int16_t>& in, size_t channels) {
+    std::vector<int16_t> out;
+    int16_t block[512 * 2];
+    size_t done = 0;
+    size_t size = 1;
+    const size_t frames = in.size() / channels;
+    for (;;) {
+        size_t n = frames - done < size ? frames - done : size;
+        size_t consumed = 0;
+        size_t made = resampler.process(in.data() + done * channels, n, consumed, block, 512);
+        out.insert(out.end(), block, block + made * channels);
+        done += consumed;
+        size = size * 5 % 397 + 1;
+        if (done == frames && made < 512) {
+            break; // Input used up and the output was not the limit
+        }
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(resampler.outputFramesFor(frames) * channels, out.size());
+    return out;
+}
+
+/**
+ * @brief Level in dB and residue in dB of the fitted tone, over the middle of a signal.
+ */
+static void fitTone(const std::vector<int16_t>& x, size_t channels, size_t channel, double hz, uint32_t rate,
+                    double& levelDb, double& residueDb) {
+    const size_t frames = x.size() / channels;
+    double s = 0.0, c = 0.0, energy = 0.0;
+    size_t n = 0;
+    for (size_t i = frames / 4; i < frames * 3 / 4; i++, n++) {
+        double v = x[i * channels + channel];
+        s += v * sin(2.0 * M_PI * hz * i / rate);
+        c += v * cos(2.0 * M_PI * hz * i / rate);
+        energy += v * v;
+    }
+    double amplitude = 2.0 * sqrt(s * s + c * c) / n;
+    double toneEnergy = amplitude * amplitude / 2.0 * n;
+    levelDb = 20.0 * log10(amplitude / 16000.0);
+    residueDb = 10.0 * log10((energy - toneEnergy > 1.0 ? energy - toneEnergy : 1.0) / toneEnergy);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_bypassed_when_not_upsampling() {
+    Resampler resampler;
+    TEST_ASSERT_FALSE(resampler.begin(44100, 44100, 2));
+    TEST_ASSERT_FALSE(resampler.begin(48000, 44100, 2));
+    TEST_ASSERT_FALSE(resampler.begin(16000, 44100, 3));
+    TEST_ASSERT_EQUAL(100, resampler.outputFramesFor(100));
+    TEST_ASSERT_TRUE(resampler.begin(16000, 44100, 2));
+    TEST_ASSERT_TRUE(resampler.isActive());
+}
+
+static void test_rate_is_exact() {
+    const uint32_t rates[] = { 8000, 11025, 16000, 22050, 32000 };
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        Resampler resampler;
+        resampler.begin(rates[r], 44100, 1);
+        std::vector<int16_t> in(rates[r] * 3, 100); // 3 s
+        std::vector<int16_t> out = convert(resampler, in, 1);
+        // All of it comes out but the filter's look-ahead, with no drift
+        TEST_ASSERT_INT_WITHIN(RESAMPLER_TAPS * 44100 / rates[r], 44100 * 3 - (RESAMPLER_TAPS / 2) * 44100 / rates[r], out.size());
+    }
+}
+
+static void test_tone_keeps_its_level() {
+    Resampler resampler;
+    resampler.begin(16000, 44100, 1);
+    std::vector<int16_t> out = convert(resampler, tone(16000, 1000.0, 16000, 1, 0), 1);
+    double level, residue;
+    fitTone(out, 1, 0, 1000.0, 44100, level, residue);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 0.0, level);
+    TEST_ASSERT_LESS_THAN_FLOAT(-50.0, residue); // Images and interpolation error
+}
+
+static void test_stereo_channels_stay_apart() {
+    Resampler resampler;
+    resampler.begin(22050, 44100, 2);
+    std::vector<int16_t> out = convert(resampler, tone(22050, 440.0, 22050, 2, 0), 2);
+    double level, residue;
+    fitTone(out, 2, 0, 440.0, 44100, level, residue);
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 0.0, level);
+    int peak = 0;
+    for (size_t i = 1; i < out.size(); i += 2) peak = abs(out[i]) > peak ? abs(out[i]) : peak;
+    TEST_ASSERT_EQUAL(0, peak); // Right stays silent
+}
+
+static void test_block_split_does_not_change_the_output() {
+    std::vector<int16_t> in = tone(11025, 700.0, 5000, 1, 0);
+    Resampler a;
+    Resampler b;
+    a.begin(11025, 44100, 1);
+    b.begin(11025, 44100, 1);
+    std::vector<int16_t> whole(a.outputFramesFor(in.size()));
+    size_t consumed = 0;
+    whole.resize(a.process(in.data(), in.size(), consumed, whole.data(), whole.size()));
+    TEST_ASSERT_EQUAL(in.size(), consumed);
+    std::vector<int16_t> split = convert(b, in, 1);
+    TEST_ASSERT_EQUAL(whole.size(), split.size());
+    TEST_ASSERT_EQUAL_INT16_ARRAY(whole.data(), split.data(), whole.size());
+}
+
+static void test_first_output_lines_up_with_first_input() {
+    Resampler resampler;
+    resampler.begin(8000, 44100, 1);
+    std::vector<int16_t> in(400, 0);
+    in[0] = 20000;
+    std::vector<int16_t> out = convert(resampler, in, 1);
+    size_t peak = 0;
+    for (size_t i = 0; i < out.size(); i++) peak = abs(out[i]) > abs(out[peak]) ? i : peak;
+    TEST_ASSERT_LESS_OR_EQUAL(1, peak);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_bypassed_when_not_upsampling);
+    RUN_TEST(test_rate_is_exact);
+    RUN_TEST(test_tone_keeps_its_level);
+    RUN_TEST(test_stereo_channels_stay_apart);
+    RUN_TEST(test_block_split_does_not_change_the_output);
+    RUN_TEST(test_first_output_lines_up_with_first_input);
+    return UNITY_END();
+}
@@ -0,0 +1,379 @@
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "ImaAdpcmDecoder.h"
+#include "RiffParser.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the RIFF chunk walker and its header cache, a fuzz loop over random
+ * and truncated chunk lists, and the open rate with and without the cache.
+ */
+
+typedef std::vector<uint8_t> Bytes;
+
+static void put32(Bytes& b, uint32_t v) {
+    for (int i = 0; i < 4; i++) b.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void put16(Bytes& b, uint16_t v) {
+    b.push_back((uint8_t)v);
+    b.push_back((uint8_t)(v >> 8));
+}
+
+static void chunk(Bytes& b, const char* id, const Bytes& body, uint32_t size) {
+    b.insert(b.end(), id, id + 4);
+    put32(b, size);
+    b.insert(b.end(), body.begin(), body.end());
+    if (body.size() & 1) b.push_back(0);
+}
+
+static void chunk(Bytes& b, const char* id, const Bytes& body) {
+    chunk(b, id, body, (uint32_t)body.size());
+}
+
+static Bytes fmt(uint16_t channels, uint32_t rate) {
+    Bytes f;
+    put16(f, WAVE_FORMAT_PCM);
+    put16(f, channels);
+    put32(f, rate);
+    put32(f, rate * channels * 2);
+    put16(f, channels * 2);
+    put16(f, 16);
+    return f;
+}
+
+/**
+ * @brief Wraps chunks in a RIFF/WAVE header; `riffSize` overrides the size field.
+ */
+static Bytes wave(const Bytes& chunks, int64_t riffSize = -1) {
+    Bytes b;
+    const char riff[] = "RIFF";
+    const char id[] = "WAVE";
+    b.insert(b.end(), riff, riff + 4);
+    put32(b, riffSize < 0 ? (uint32_t)(chunks.size() + 4) : (uint32_t)riffSize);
+    b.insert(b.end(), id, id + 4);
+    b.insert(b.end(), chunks.begin(), chunks.end());
+    return b;
+}
+
+static bool parsePut(const char* path, const Bytes& bytes, RiffParser::WavInfo& info) {
+    SD.put(path, bytes);
+    File file = SD.open(path);
+    return RiffParser::parse(file, info);
+}
+
+void setUp() {
+    SD.clear();
+}
+void tearDown() {}
+
+static void test_canonical_header() {
+    Bytes c;
+    chunk(c, "fmt ", fmt(2, 44100));
+    chunk(c, "data", Bytes(4000, 1));
+    RiffParser::WavInfo info;
+    TEST_ASSERT_TRUE(parsePut("/a.wav", wave(c), info));
+    TEST_ASSERT_EQUAL_UINT16(WAVE_FORMAT_PCM, info.formatTag);
+    TEST_ASSERT_EQUAL_UINT16(2, info.channels);
+    TEST_ASSERT_EQUAL_UINT32(44100, info.sampleRate);
+    TEST_ASSERT_EQUAL_UINT16(4, info.blockAlign);
+    TEST_ASSERT_EQUAL_UINT16(16, info.bitsPerSample);
+    TEST_ASSERT_EQUAL_UINT32(44, info.dataOffset);
+    TEST_ASSERT_EQUAL_UINT32(4000, info.dataSize);
+    TEST_ASSERT_FALSE(info.hasLoop);
+}
+
+static void test_other_chunks_are_skipped() {
+    Bytes c;
+    chunk(c, "LIST", Bytes(27, 'x')); // Odd size, padded
+    chunk(c, "fmt ", fmt(1, 16000));
+    chunk(c, "fact", Bytes(4, 0));
+    chunk(c, "data", Bytes(100, 1));
+    chunk(c, "id3 ", Bytes(10, 0)); // After the data
+    RiffParser::WavInfo info;
+    TEST_ASSERT_TRUE(parsePut("/b.wav", wave(c), info));
+    TEST_ASSERT_EQUAL_UINT32(16000, info.sampleRate);
+    TEST_ASSERT_EQUAL_UINT32(12 + 8 + 28 + 8 + 16 + 8 + 4 + 8, info.dataOffset);
+    TEST_ASSERT_EQUAL_UINT32(100, info.dataSize);
+}
+
+static void test_truncated_data_is_clamped() {
+    Bytes c;
+    chunk(c, "fmt ", fmt(2, 44100));
+    chunk(c, "data", Bytes(1000, 1), 100000); // Copy cut short
+    RiffParser::WavInfo info;
+    TEST_ASSERT_TRUE(parsePut("/c.wav", wave(c, 100036), info));
+    TEST_ASSERT_EQUAL_UINT32(1000, info.dataSize);
+}
+
+static void test_unfinished_recording_plays_to_the_end() {
+    Bytes c;
+    chunk(c, "fmt ", fmt(1, 8000));
+    chunk(c, "data", Bytes(), 0);
+    c.resize(c.size() + 3000, 7); // Written, but the sizes were never patched
+    RiffParser::WavInfo info;
+    TEST_ASSERT_TRUE(parsePut("/d.wav", wave(c, 0), info));
+    TEST_ASSERT_EQUAL_UINT32(44, info.dataOffset);
+    TEST_ASSERT_EQUAL_UINT32(3000, info.dataSize);
+}
+
+static void test_chunk_past_the_end_stops_the_walk() {
+    Bytes c;
+    chunk(c, "fmt ", fmt(1, 8000));
+    chunk(c, "LIST", Bytes(10, 0), 5000); // Runs past the end, hides the data chunk
+    chunk(c, "data", Bytes(100, 1));
+    RiffParser::WavInfo info;
+    TEST_ASSERT_FALSE(parsePut("/e.wav", wave(c), info));
+}
+
+static void test_invalid_files_are_rejected() {
+    Bytes c;
+    chunk(c, "data", Bytes(100, 1));
+    RiffParser::WavInfo info;
+    TEST_ASSERT_FALSE(parsePut("/f.wav", wave(c), info)); // No fmt
+    Bytes twice;
+    chunk(twice, "fmt ", fmt(1, 8000));
+    chunk(twice, "data", Bytes(10, 1));
+    chunk(twice, "data", Bytes(10, 1));
+    TEST_ASSERT_FALSE(parsePut("/g.wav", wave(twice), info));
+    Bytes zero;
+    chunk(zero, "fmt ", fmt(0, 8000));
+    chunk(zero, "data", Bytes(10, 1));
+    TEST_ASSERT_FALSE(parsePut("/h.wav", wave(zero), info));
+    TEST_ASSERT_FALSE(parsePut("/i.wav", Bytes(8, 0), info));
+}
+
+static void test_smpl_loop() {
+    Bytes smpl(36, 0);
+    smpl[28] = 1; // One loop
+    put32(smpl, 0);
+    put32(smpl, 0);
+    put32(smpl, 100); // Start
+    put32(smpl, 899); // End, inclusive
+    put32(smpl, 0);
+    put32(smpl, 0);
+    Bytes c;
+    chunk(c, "fmt ", fmt(1, 8000));
+    chunk(c, "smpl", smpl);
+    chunk(c, "data", Bytes(2000, 1)); // 1000 frames
+    RiffParser::WavInfo info;
+    TEST_ASSERT_TRUE(parsePut("/j.wav", wave(c), info));
+    TEST_ASSERT_TRUE(info.hasLoop);
+    TEST_ASSERT_EQUAL_UINT32(100, info.loopStart);
+    TEST_ASSERT_EQUAL_UINT32(899, info.loopEnd);
+
+    Bytes shortData;
+    chunk(shortData, "fmt ", fmt(1, 8000));
+    chunk(shortData, "smpl", smpl);
+    chunk(shortData, "data", Bytes(1000, 1)); // 500 frames, the loop ends past them
+    TEST_ASSERT_TRUE(parsePut("/k.wav", wave(shortData), info));
+    TEST_ASSERT_FALSE(info.hasLoop);
+}
+
+static void test_cache_hits_until_the_file_changes() {
+    Bytes c;
+    chunk(c, "fmt ", fmt(2, 44100));
+    chunk(c, "data", Bytes(400, 1));
+    Bytes mono;
+    chunk(mono, "fmt ", fmt(1, 44100));
+    chunk(mono, "data", Bytes(400, 1));
+    RiffParser::WavInfo info;
+
+    SD.put("/cache.wav", wave(c));
+    File file = SD.open("/cache.wav");
+    TEST_ASSERT_TRUE(RiffParser::open(file, "/cache.wav", info));
+    TEST_ASSERT_EQUAL_UINT16(2, info.channels);
+
+    SD.file("/cache.wav")->data = wave(mono); // Same size and time: the cache answers
+    TEST_ASSERT_TRUE(RiffParser::open(file, "/cache.wav", info));
+    TEST_ASSERT_EQUAL_UINT16(2, info.channels);
+
+    RiffParser::invalidate("/cache.wav");
+    TEST_ASSERT_TRUE(RiffParser::open(file, "/cache.wav", info));
+    TEST_ASSERT_EQUAL_UINT16(1, info.channels);
+
+    SD.file("/cache.wav")->data = wave(c);
+    SD.file("/cache.wav")->lastWrite++; // Rewritten: walked again
+    TEST_ASSERT_TRUE(RiffParser::open(file, "/cache.wav", info));
+    TEST_ASSERT_EQUAL_UINT16(2, info.channels);
+}
+
+static void test_cache_replaces_the_least_recently_used() {
+    Bytes c;
+    chunk(c, "fmt ", fmt(2, 44100));
+    chunk(c, "data", Bytes(400, 1));
+    char path[16];
+    RiffParser::WavInfo info;
+    for (int i = 0; i <= RIFF_CACHE_SLOTS; i++) {
+        snprintf(path, sizeof(path), "/lru%d.wav", i);
+        SD.put(path, wave(c));
+        File file = SD.open(path);
+        TEST_ASSERT_TRUE(RiffParser::open(file, path, info));
+    }
+    // The first file was evicted: a changed header is seen without invalidate()
+    Bytes mono;
+    chunk(mono, "fmt ", fmt(1, 44100));
+    chunk(mono, "data", Bytes(400, 1));
+    SD.file("/lru0.wav")->data = wave(mono);
+    File first = SD.open("/lru0.wav");
+    TEST_ASSERT_TRUE(RiffParser::open(first, "/lru0.wav", info));
+    TEST_ASSERT_EQUAL_UINT16(1, info.channels);
+    // The last one is still cached
+    snprintf(path, sizeof(path), "/lru%d.wav", RIFF_CACHE_SLOTS);
+    SD.file(path)->data = wave(mono);
+    File last = SD.open(path);
+    TEST_ASSERT_TRUE(RiffParser::open(last, path, info));
+    TEST_ASSERT_EQUAL_UINT16(2, info.channels);
+}
+
+static uint32_t fuzzSeed = 12345;
+
+static uint32_t fuzzRandom(uint32_t range) {
+    fuzzSeed = fuzzSeed * 1664525UL + 1013904223UL;
+    return (fuzzSeed >> 8) % range;
+}
+
+/// Checks what parse() promises about a header it accepted
+static bool consistent(const RiffParser::WavInfo& info, size_t fileSize) {
+    if (info.channels == 0 || info.blockAlign == 0 || info.sampleRate == 0 || info.sampleRate > 384000) {
+        return false;
+    }
+    if (info.dataOffset < 12 || (uint64_t)info.dataOffset + info.dataSize > fileSize) {
+        return false; // Audio outside the file
+    }
+    if (info.hasLoop && (info.loopStart > info.loopEnd ||
+                         (info.formatTag == WAVE_FORMAT_PCM && info.loopEnd >= info.dataSize / info.blockAlign))) {
+        return false; // Loop outside the audio
+    }
+    return true;
+}
+
+/// A random chunk list: real and unknown ids, sizes that may lie, odd lengths, random bodies
+static Bytes randomChunks() {
+    static const char* ids[] = { "fmt ", "data", "LIST", "smpl", "fact", "cue ", "JUNK", "\0\0\0\0" };
+    Bytes c;
+    const uint32_t count = 1 + fuzzRandom(8);
+    for (uint32_t i = 0; i < count; i++) {
+        const char* id = ids[fuzzRandom(8)];
+        Bytes body;
+        if (memcmp(id, "fmt ", 4) == 0 && fuzzRandom(4) != 0) {
+            body = fmt((uint16_t)fuzzRandom(3), fuzzRandom(4) ? 22050 : fuzzRandom(500000));
+        } else if (memcmp(id, "smpl", 4) == 0 && fuzzRandom(2) != 0) {
+            body.assign(36, 0);
+            body[28] = (uint8_t)fuzzRandom(2);
+            for (int w = 0; w < 6; w++) put32(body, fuzzRandom(3000));
+        } else {
+            body.resize(fuzzRandom(300));
+            for (size_t b = 0; b < body.size(); b++) body[b] = (uint8_t)fuzzRandom(256);
+        }
+        uint32_t size = (uint32_t)body.size();
+        switch (fuzzRandom(6)) {
+            case 0: size = fuzzRandom(1000); break;      // Any size
+            case 1: size = 0xFFFFFFF0UL + fuzzRandom(16); break; // Wraps the position
+            default: break;                              // Honest
+        }
+        chunk(c, id, body, size);
+    }
+    return c;
+}
+
+static void test_fuzz_random_and_truncated_chunk_lists() {
+    RiffParser::WavInfo info;
+    uint32_t accepted = 0;
+    for (int round = 0; round < 20000; round++) {
+        int64_t riffSize = -1;
+        switch (fuzzRandom(4)) {
+            case 0: riffSize = 0; break;                 // Never patched
+            case 1: riffSize = fuzzRandom(2000); break;  // Any size
+            default: break;
+        }
+        Bytes file = wave(randomChunks(), riffSize);
+        if (fuzzRandom(2)) {
+            file.resize(fuzzRandom((uint32_t)file.size() + 1)); // Cut anywhere, the RIFF header too
+        }
+        if (parsePut("/fuzz.wav", file, info)) {
+            accepted++;
+            TEST_ASSERT_TRUE_MESSAGE(consistent(info, file.size()), "Accepted header points outside the file");
+        }
+    }
+
+    // A typical file cut at every length
+    Bytes c;
+    chunk(c, "fmt ", fmt(2, 44100));
+    chunk(c, "LIST", Bytes(37, 'i'));
+    chunk(c, "data", Bytes(400, 1));
+    const Bytes whole = wave(c);
+    for (size_t length = 0; length <= whole.size(); length++) {
+        Bytes cut(whole.begin(), whole.begin() + length);
+        if (parsePut("/cut.wav", cut, info)) {
+            accepted++;
+            TEST_ASSERT_TRUE(consistent(info, length));
+            TEST_ASSERT_EQUAL_UINT32(length - info.dataOffset, info.dataSize); // Clamped to what is there
+        }
+    }
+    char message[64];
+    snprintf(message, sizeof(message), "Fuzz: %u headers accepted, all consistent", accepted);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_GREATER_THAN(100, accepted); // The loop reached the paths past the checks
+}
+
+/**
+ * @brief Opens a typical story segment again and again with the chunk walk and through the
+ * cache and prints the opens per second of both, as `RiffParser::benchmark()` does on the board.
+ *
+ * The host card is in memory, so the walk costs no SD latency here; on the board each
+ * chunk header is a card read and the gap is far wider.
+ */
+static void test_open_rate_with_and_without_the_cache() {
+    Bytes list;
+    chunk(list, "INFO", Bytes(120, 'i'));
+    Bytes c;
+    chunk(c, "fmt ", fmt(2, 44100));
+    chunk(c, "LIST", list);
+    chunk(c, "fact", Bytes(4, 0));
+    chunk(c, "data", Bytes(64 * 1024, 1));
+    SD.put("/Stories/1.wav", wave(c));
+    const int rounds = 20000;
+    RiffParser::WavInfo info;
+
+    bool ok = true;
+    unsigned long start = micros();
+    for (int r = 0; r < rounds; r++) {
+        File file = SD.open("/Stories/1.wav");
+        ok = ok && RiffParser::parse(file, info);
+    }
+    const unsigned long walkUs = micros() - start;
+
+    RiffParser::invalidate("/Stories/1.wav");
+    start = micros();
+    for (int r = 0; r < rounds; r++) {
+        File file = SD.open("/Stories/1.wav");
+        ok = ok && RiffParser::open(file, "/Stories/1.wav", info); // The first one walks
+    }
+    const unsigned long cachedUs = micros() - start;
+
+    char message[128];
+    snprintf(message, sizeof(message), "RiffParser: %u opens/s with the chunk walk, %u opens/s cached",
+             (unsigned)(rounds * 1000000ULL / (walkUs > 0 ? walkUs : 1)),
+             (unsigned)(rounds * 1000000ULL / (cachedUs > 0 ? cachedUs : 1)));
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL_UINT32(12 + (8 + 16) + (8 + 128) + (8 + 4) + 8, info.dataOffset); // Found through the cache
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_canonical_header);
+    RUN_TEST(test_other_chunks_are_skipped);
+    RUN_TEST(test_truncated_data_is_clamped);
+    RUN_TEST(test_unfinished_recording_plays_to_the_end);
+    RUN_TEST(test_chunk_past_the_end_stops_the_walk);
+    RUN_TEST(test_invalid_files_are_rejected);
+    RUN_TEST(test_smpl_loop);
+    RUN_TEST(test_cache_hits_until_the_file_changes);
+    RUN_TEST(test_cache_replaces_the_least_recently_used);
+    RUN_TEST(test_fuzz_random_and_truncated_chunk_lists);
+    RUN_TEST(test_open_rate_with_and_without_the_cache);
+    return UNITY_END();
+}
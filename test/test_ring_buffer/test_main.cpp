@@ -0,0 +1,228 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <freertos/queue.h>
+#include "AudioRingBuffer.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the SPSC audio ring: spans, wrap-around, two real threads and throughput.
+ */
+
+static const size_t BLOCK_SAMPLES = 2048;  // One 4 KB playback block, as AUDIO_BLOCK_SIZE
+static const size_t TRANSFER_SAMPLES = 16 * 1024 * 1024; // 32 MB, about 3 minutes of 44.1 kHz stereo
+
+static uint64_t nowUs() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/// Prints the rate of a transfer and returns it in samples/s
+static double report(const char* path, uint64_t elapsedUs) {
+    double rate = (double)TRANSFER_SAMPLES * 1e6 / (elapsedUs > 0 ? elapsedUs : 1);
+    char message[128];
+    snprintf(message, sizeof(message), "%s: %.1f M samples/s, %.0f MB/s", path, rate / 1e6, rate * 2 / 1e6);
+    TEST_MESSAGE(message);
+    return rate;
+}
+
+/// Samples `first`.. of a transfer, as the SD card would return them
+static void fill(int16_t* block, size_t first, size_t count) {
+    for (size_t i = 0; i < count; i++) block[i] = (int16_t)(first + i);
+}
+
+/// Checks a received block against fill(), as the I2S driver would take it
+static uint32_t check(const int16_t* block, size_t first, size_t count) {
+    uint32_t errors = 0;
+    for (size_t i = 0; i < count; i++) errors += block[i] != (int16_t)(first + i);
+    return errors;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_reserve_is_clamped_to_free_and_contiguous_space() {
+    AudioRingBuffer<int16_t, 16> ring;
+    size_t count = 20;
+    ring.reserve(count);
+    TEST_ASSERT_EQUAL(16, count);
+    ring.commit(12);
+    TEST_ASSERT_EQUAL(12, ring.readAvailable());
+    TEST_ASSERT_EQUAL(4, ring.writeAvailable());
+
+    count = 8;
+    ring.peek(count);
+    TEST_ASSERT_EQUAL(8, count);
+    ring.consume(8);
+
+    count = 16;
+    int16_t* span = ring.reserve(count);
+    TEST_ASSERT_EQUAL(4, count); // Up to the end of the storage, not past the wrap
+    ring.commit(count);
+    count = 16;
+    int16_t* wrapped = ring.reserve(count);
+    TEST_ASSERT_EQUAL(8, count); // Then from the start
+    TEST_ASSERT_TRUE(wrapped < span);
+}
+
+static void test_full_and_empty() {
+    AudioRingBuffer<uint8_t, 8> ring;
+    const uint8_t data[10] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    TEST_ASSERT_EQUAL(8, ring.write(data, 10));
+    size_t count = 1;
+    ring.reserve(count);
+    TEST_ASSERT_EQUAL(0, count);
+
+    uint8_t out[10];
+    TEST_ASSERT_EQUAL(8, ring.read(out, 10));
+    TEST_ASSERT_EQUAL_MEMORY(data, out, 8);
+    count = 1;
+    ring.peek(count);
+    TEST_ASSERT_EQUAL(0, count);
+}
+
+static void test_copies_across_the_wrap() {
+    AudioRingBuffer<int16_t, 16> ring;
+    int16_t in[11];
+    int16_t out[11];
+    int16_t next = 0;
+    int16_t expect = 0;
+    for (int round = 0; round < 50; round++) {
+        for (size_t i = 0; i < 11; i++) in[i] = next++;
+        TEST_ASSERT_EQUAL(11, ring.write(in, 11));
+        TEST_ASSERT_EQUAL(11, ring.read(out, 11));
+        for (size_t i = 0; i < 11; i++) TEST_ASSERT_EQUAL_INT16(expect++, out[i]);
+    }
+    TEST_ASSERT_EQUAL(550, ring.writePosition());
+    TEST_ASSERT_EQUAL(550, ring.readPosition());
+}
+
+static void test_reset_empties_the_ring() {
+    AudioRingBuffer<int32_t, 4> ring;
+    const int32_t data[3] = { 1, 2, 3 };
+    ring.write(data, 3);
+    ring.reset();
+    TEST_ASSERT_EQUAL(0, ring.readAvailable());
+    TEST_ASSERT_EQUAL(4, ring.writeAvailable());
+    size_t count = 4;
+    ring.peek(count);
+    TEST_ASSERT_EQUAL(0, count); // The cached head went too
+}
+
+static void test_producer_and_consumer_threads() {
+    static AudioRingBuffer<uint32_t, 1024> ring;
+    const uint32_t total = 2000000;
+    std::thread producer([&]() {
+        uint32_t value = 0;
+        size_t want = 1;
+        while (value < total) {
+            size_t count = want < total - value ? want : total - value;
+            uint32_t* span = ring.reserve(count);
+            for (size_t i = 0; i < count; i++) span[i] = value++;
+            ring.commit(count);
+            want = want % 300 + 7;
+        }
+    });
+    uint32_t expect = 0;
+    uint32_t errors = 0;
+    size_t want = 5;
+    while (expect < total) {
+        size_t count = want;
+        const uint32_t* span = ring.peek(count);
+        for (size_t i = 0; i < count; i++) {
+            if (span[i] != expect++) errors++;
+        }
+        ring.consume(count);
+        want = want % 500 + 3;
+    }
+    producer.join();
+    TEST_ASSERT_EQUAL_UINT32(0, errors);
+    TEST_ASSERT_EQUAL(0, ring.readAvailable());
+}
+
+/**
+ * @brief Times the same two-thread transfer through the ring and through the double-buffered
+ * block queues it replaced (two 4 KB blocks passed back and forth through a free and a filled
+ * FreeRTOS queue), with a 4 KB block filled and checked on each side.
+ */
+static void test_transfer_rate_against_the_block_queues() {
+    static AudioRingBuffer<int16_t, 16384> ring;
+    static int16_t blocks[2][BLOCK_SAMPLES];
+    QueueHandle_t freeBlocks = xQueueCreate(2, sizeof(uint8_t));
+    QueueHandle_t filledBlocks = xQueueCreate(2, sizeof(uint8_t));
+    for (uint8_t i = 0; i < 2; i++) xQueueSend(freeBlocks, &i, 0);
+
+    // Old path: a block travels through the filled queue and comes back through the free one
+    uint32_t queueErrors = 0;
+    uint64_t start = nowUs();
+    std::thread reader([&]() {
+        uint8_t index;
+        for (size_t done = 0; done < TRANSFER_SAMPLES; done += BLOCK_SAMPLES) {
+            xQueueReceive(freeBlocks, &index, portMAX_DELAY);
+            fill(blocks[index], done, BLOCK_SAMPLES);
+            xQueueSend(filledBlocks, &index, portMAX_DELAY);
+        }
+    });
+    uint8_t index;
+    for (size_t done = 0; done < TRANSFER_SAMPLES; done += BLOCK_SAMPLES) {
+        xQueueReceive(filledBlocks, &index, portMAX_DELAY);
+        queueErrors += check(blocks[index], done, BLOCK_SAMPLES);
+        xQueueSend(freeBlocks, &index, portMAX_DELAY);
+    }
+    reader.join();
+    double queueRate = report("Block queues", nowUs() - start);
+    vQueueDelete(freeBlocks);
+    vQueueDelete(filledBlocks);
+
+    // Ring: each side works on its span in place and never waits on a lock
+    uint32_t ringErrors = 0;
+    start = nowUs();
+    std::thread producer([&]() {
+        size_t done = 0;
+        while (done < TRANSFER_SAMPLES) {
+            size_t count = BLOCK_SAMPLES;
+            int16_t* span = ring.reserve(count);
+            if (count < BLOCK_SAMPLES) {
+                std::this_thread::yield(); // Less than a block free, as the reader task waits
+                continue;
+            }
+            fill(span, done, count);
+            ring.commit(count);
+            done += count;
+        }
+    });
+    size_t done = 0;
+    while (done < TRANSFER_SAMPLES) {
+        size_t count = BLOCK_SAMPLES;
+        const int16_t* span = ring.peek(count);
+        if (count == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        ringErrors += check(span, done, count);
+        ring.consume(count);
+        done += count;
+    }
+    producer.join();
+    double ringRate = report("Ring", nowUs() - start);
+
+    char message[64];
+    snprintf(message, sizeof(message), "Ring: %.2fx the block queues", ringRate / queueRate);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, queueErrors);
+    TEST_ASSERT_EQUAL_UINT32(0, ringErrors);
+    TEST_ASSERT_GREATER_THAN_FLOAT(100.0f * 88200.0f, (float)ringRate); // 100x 44.1 kHz stereo
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_reserve_is_clamped_to_free_and_contiguous_space);
+    RUN_TEST(test_full_and_empty);
+    RUN_TEST(test_copies_across_the_wrap);
+    RUN_TEST(test_reset_empties_the_ring);
+    RUN_TEST(test_producer_and_consumer_threads);
+    RUN_TEST(test_transfer_rate_against_the_block_queues);
+    return UNITY_END();
+}
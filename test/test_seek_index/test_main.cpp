@@ -0,0 +1,196 @@
+#include <unity.h>
+#include <vector>
+#include "ImaAdpcmDecoder.h"
+#include "Mp3Decoder.h"
+#include "SeekIndex.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the seek index and of the sector-aligned read length.
+ */
+
+static SeekIndex::Layout layout(uint16_t formatTag, uint16_t channels, uint32_t dataOffset, uint32_t dataSize,
+                                uint16_t blockAlign, uint32_t framesPerBlock) {
+    SeekIndex::Layout l = { formatTag, channels, 44100, dataOffset, dataSize, blockAlign, framesPerBlock };
+    return l;
+}
+
+/**
+ * @brief Writes an MP3 of 128 kbit/s MPEG-1 frames at 44.1 kHz, padded every other frame,
+ *        after `lead` bytes and followed by an ID3v1 tag.
+ *
+ * @return The data offset of every frame.
+ */
+static std::vector<uint32_t> putMp3(const char* path, size_t frames, uint32_t lead) {
+    std::vector<uint8_t> data(lead, 0);
+    std::vector<uint32_t> offsets;
+    for (size_t f = 0; f < frames; f++) {
+        bool padded = f & 1;
+        offsets.push_back((uint32_t)(data.size() - lead));
+        size_t length = 417 + padded;
+        size_t start = data.size();
+        data.resize(start + length, 0x55);
+        data[start] = 0xFF;
+        data[start + 1] = 0xFB;
+        data[start + 2] = padded ? 0x92 : 0x90;
+        data[start + 3] = 0xC4;
+    }
+    const char tag[] = "TAG";
+    data.insert(data.end(), tag, tag + 3);
+    data.resize(data.size() + 125, 0);
+    SD.put(path, data);
+    return offsets;
+}
+
+void setUp() {
+    SD.clear();
+}
+void tearDown() {}
+
+/**
+ * @brief Reads a data chunk the way the reader does, checking every read is whole frames.
+ *
+ * @return The number of reads that ended on a sector boundary of the file.
+ */
+static size_t streamReads(uint32_t dataOffset, uint32_t dataSize, uint16_t blockAlign, size_t want) {
+    uint32_t pos = 0;
+    size_t aligned = 0;
+    while (pos < dataSize) {
+        size_t bytes = dataSize - pos < want ? dataSize - pos : want;
+        bytes = SeekIndex::sectorRead(dataOffset + pos, bytes, blockAlign);
+        TEST_ASSERT_GREATER_THAN(0, bytes);
+        TEST_ASSERT_EQUAL(0, bytes % blockAlign);
+        pos += bytes;
+        if ((dataOffset + pos) % AUDIO_SECTOR_SIZE == 0) aligned++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(dataSize, pos);
+    return aligned;
+}
+
+static void test_short_reads_are_kept() {
+    TEST_ASSERT_EQUAL(400, SeekIndex::sectorRead(44, 400, 4));
+    TEST_ASSERT_EQUAL(AUDIO_SECTOR_SIZE, SeekIndex::sectorRead(46, AUDIO_SECTOR_SIZE, 4));
+}
+
+static void test_reads_end_on_a_sector() {
+    TEST_ASSERT_EQUAL(AUDIO_BLOCK_SIZE - 44, SeekIndex::sectorRead(44, AUDIO_BLOCK_SIZE, 4));
+    TEST_ASSERT_EQUAL(AUDIO_BLOCK_SIZE, SeekIndex::sectorRead(AUDIO_BLOCK_SIZE, AUDIO_BLOCK_SIZE, 4));
+    // A canonical 44-byte header: every read after the first ends on a sector
+    const uint32_t size = 100 * AUDIO_BLOCK_SIZE;
+    TEST_ASSERT_EQUAL(100, streamReads(44, size, 4, AUDIO_BLOCK_SIZE));
+}
+
+static void test_odd_data_offset_keeps_whole_frames() {
+    // Data 2 bytes off a 4-byte boundary (a LIST chunk with an odd text length before it):
+    // a stereo read may not end on the sector, it must end on a frame
+    TEST_ASSERT_EQUAL(AUDIO_BLOCK_SIZE - 48, SeekIndex::sectorRead(46, AUDIO_BLOCK_SIZE, 4));
+    streamReads(46, 100 * AUDIO_BLOCK_SIZE, 4, AUDIO_BLOCK_SIZE);
+    streamReads(46, 100 * AUDIO_BLOCK_SIZE + 36, 4, AUDIO_BLOCK_SIZE);
+    streamReads(62, 77777 * 4, 4, AUDIO_BLOCK_SIZE / 2 + 4);
+    TEST_ASSERT_EQUAL(100, streamReads(46, 100 * AUDIO_BLOCK_SIZE, 2, AUDIO_BLOCK_SIZE)); // Mono stays aligned
+}
+
+static void test_pcm_blocks_are_frames() {
+    SD.put("/a.wav", std::vector<uint8_t>(44 + 4000));
+    File audio = SD.open("/a.wav");
+    SeekIndex index;
+    TEST_ASSERT_FALSE(index.isValid());
+    TEST_ASSERT_TRUE(index.build(audio, layout(WAVE_FORMAT_PCM, 2, 44, 4000, 4, 1)));
+    TEST_ASSERT_EQUAL_UINT32(1000, index.totalFrames());
+    uint32_t offset, start;
+    index.locate(500, offset, start);
+    TEST_ASSERT_EQUAL_UINT32(2000, offset);
+    TEST_ASSERT_EQUAL_UINT32(500, start);
+    index.locate(5000, offset, start); // Clamped to the end
+    TEST_ASSERT_EQUAL_UINT32(4000, offset);
+    TEST_ASSERT_EQUAL_UINT32(1000, start);
+    TEST_ASSERT_FALSE(index.build(audio, layout(WAVE_FORMAT_PCM, 2, 44, 4000, 0, 1)));
+    TEST_ASSERT_FALSE(index.isValid());
+}
+
+static void test_adpcm_blocks_and_short_tail() {
+    SD.put("/b.wav", std::vector<uint8_t>(60 + 3 * 1024 + 100));
+    File audio = SD.open("/b.wav");
+    SeekIndex index;
+    TEST_ASSERT_TRUE(index.build(audio, layout(WAVE_FORMAT_IMA_ADPCM, 1, 60, 3 * 1024 + 100, 1024, 2041)));
+    TEST_ASSERT_EQUAL_UINT32(3 * 2041 + 1 + 24 * 8, index.totalFrames()); // Header sample plus 8 per word
+    uint32_t offset, start;
+    index.locate(2 * 2041 + 5, offset, start);
+    TEST_ASSERT_EQUAL_UINT32(2 * 1024, offset);
+    TEST_ASSERT_EQUAL_UINT32(2 * 2041, start);
+}
+
+static void test_mp3_seek_points() {
+    std::vector<uint32_t> offsets = putMp3("/c.mp3", 100, 10);
+    File audio = SD.open("/c.mp3");
+    SeekIndex index;
+    TEST_ASSERT_TRUE(index.build(audio, layout(WAVE_FORMAT_MPEGLAYER3, 2, 10, (uint32_t)audio.size() - 10, 0, 0)));
+    TEST_ASSERT_EQUAL_UINT32(1152, index.layout().framesPerBlock);
+    TEST_ASSERT_EQUAL_UINT32(100 * 1152, index.totalFrames()); // The ID3v1 tag ends the walk
+    uint32_t offset, start;
+    index.locate(50 * 1152 + 3, offset, start);
+    TEST_ASSERT_EQUAL_UINT32(offsets[SEEK_MP3_POINT_FRAMES], offset);
+    TEST_ASSERT_EQUAL_UINT32(SEEK_MP3_POINT_FRAMES * 1152, start);
+    index.locate((SEEK_MP3_POINT_FRAMES + 1) * 1152, offset, start); // Preroll reaches the previous point
+    TEST_ASSERT_EQUAL_UINT32(0, offset);
+    TEST_ASSERT_EQUAL_UINT32(0, start);
+    index.locate(0xFFFFFFFF, offset, start);
+    TEST_ASSERT_EQUAL_UINT32(offsets[2 * SEEK_MP3_POINT_FRAMES], offset);
+
+    SD.put("/d.mp3", std::vector<uint8_t>(500, 0x55));
+    File noise = SD.open("/d.mp3");
+    TEST_ASSERT_FALSE(index.build(noise, layout(WAVE_FORMAT_MPEGLAYER3, 2, 0, 500, 0, 0)));
+}
+
+static void test_sidecar_round_trip() {
+    std::vector<uint32_t> offsets = putMp3("/e.mp3", 200, 0);
+    File audio = SD.open("/e.mp3");
+    SeekIndex built;
+    TEST_ASSERT_TRUE(built.build(audio, layout(WAVE_FORMAT_MPEGLAYER3, 2, 0, (uint32_t)audio.size(), 0, 0)));
+    TEST_ASSERT_TRUE(built.save("/e.mp3" SEEK_INDEX_EXTENSION));
+
+    SeekIndex loaded;
+    TEST_ASSERT_TRUE(loaded.load("/e.mp3" SEEK_INDEX_EXTENSION, audio));
+    TEST_ASSERT_EQUAL_UINT32(built.totalFrames(), loaded.totalFrames());
+    TEST_ASSERT_EQUAL_UINT16(WAVE_FORMAT_MPEGLAYER3, loaded.layout().formatTag);
+    uint32_t offset, start;
+    loaded.locate(150 * 1152, offset, start);
+    TEST_ASSERT_EQUAL_UINT32(offsets[3 * SEEK_MP3_POINT_FRAMES], offset);
+    TEST_ASSERT_EQUAL_UINT32(3 * SEEK_MP3_POINT_FRAMES * 1152, start);
+}
+
+static void test_stale_or_damaged_sidecar_is_rejected() {
+    SD.put("/f.wav", std::vector<uint8_t>(44 + 4000));
+    File audio = SD.open("/f.wav");
+    SeekIndex index;
+    TEST_ASSERT_FALSE(index.load("/f.wav" SEEK_INDEX_EXTENSION, audio)); // No sidecar yet
+    TEST_ASSERT_TRUE(index.build(audio, layout(WAVE_FORMAT_PCM, 2, 44, 4000, 4, 1)));
+    TEST_ASSERT_TRUE(index.save("/f.wav" SEEK_INDEX_EXTENSION));
+    TEST_ASSERT_TRUE(index.load("/f.wav" SEEK_INDEX_EXTENSION, audio));
+
+    SD.file("/f.wav")->lastWrite++; // Rewritten in place, same size
+    TEST_ASSERT_FALSE(index.load("/f.wav" SEEK_INDEX_EXTENSION, audio));
+    TEST_ASSERT_FALSE(index.isValid());
+
+    SD.put("/f.wav", std::vector<uint8_t>(44 + 8000));
+    File grown = SD.open("/f.wav");
+    TEST_ASSERT_TRUE(index.build(grown, layout(WAVE_FORMAT_PCM, 2, 44, 8000, 4, 1)));
+    TEST_ASSERT_TRUE(index.save("/f.wav" SEEK_INDEX_EXTENSION));
+    SD.file("/f.wav" SEEK_INDEX_EXTENSION)->data[0] ^= 1; // Bad magic
+    TEST_ASSERT_FALSE(index.load("/f.wav" SEEK_INDEX_EXTENSION, grown));
+    SD.file("/f.wav" SEEK_INDEX_EXTENSION)->data.resize(20); // Truncated
+    TEST_ASSERT_FALSE(index.load("/f.wav" SEEK_INDEX_EXTENSION, grown));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_short_reads_are_kept);
+    RUN_TEST(test_reads_end_on_a_sector);
+    RUN_TEST(test_odd_data_offset_keeps_whole_frames);
+    RUN_TEST(test_pcm_blocks_are_frames);
+    RUN_TEST(test_adpcm_blocks_and_short_tail);
+    RUN_TEST(test_mp3_seek_points);
+    RUN_TEST(test_sidecar_round_trip);
+    RUN_TEST(test_stale_or_damaged_sidecar_is_rejected);
+    return UNITY_END();
+}
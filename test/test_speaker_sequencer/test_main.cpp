@@ -0,0 +1,147 @@
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+#include "SpeakerManager.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the playback sequencer: queued segments splice with no silence between them.
+ *
+ * A SpeakerManager runs its sequencer task on a host thread and plays through the output
+ * engine and the simulated I2S driver in real time. Each test queues segments, records what
+ * the driver plays and measures the longest silence between the first and the last frame heard.
+ */
+
+static const int16_t LEVEL = 1000; // Below the compressor threshold, played unchanged
+static const size_t SEGMENT_FRAMES = AUDIO_OUTPUT_RATE / 5;
+
+static i2s_pin_config_t pins() {
+    i2s_pin_config_t config;
+    config.mck_io_num = I2S_PIN_NO_CHANGE;
+    config.bck_io_num = 26;
+    config.ws_io_num = 25;
+    config.data_out_num = 22;
+    config.data_in_num = I2S_PIN_NO_CHANGE;
+    return config;
+}
+
+static I2SManager engine(pins(), AUDIO_OUTPUT_RATE);
+static SpeakerManager speaker(nullptr, nullptr, nullptr, nullptr, &engine, nullptr);
+
+static void put32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void put16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+/// Writes a 16-bit stereo PCM segment at LEVEL
+static void putSegment(const char* path, size_t frames, uint32_t rate) {
+    std::vector<uint8_t> file;
+    const uint32_t dataBytes = (uint32_t)(frames * 4);
+    file.insert(file.end(), { 'R', 'I', 'F', 'F' });
+    put32(file, 36 + dataBytes);
+    file.insert(file.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' });
+    put32(file, 16);
+    put16(file, WAVE_FORMAT_PCM);
+    put16(file, 2);
+    put32(file, rate);
+    put32(file, rate * 4);
+    put16(file, 4);
+    put16(file, 16);
+    file.insert(file.end(), { 'd', 'a', 't', 'a' });
+    put32(file, dataBytes);
+    for (size_t i = 0; i < frames * 2; i++) put16(file, (uint16_t)LEVEL);
+    SD.put(path, file);
+}
+
+/// Waits out `frames` of audio, then until the ring is empty and the DMA buffers were heard twice over
+static void waitPlayed(size_t frames) {
+    delay(1000 * frames / AUDIO_OUTPUT_RATE);
+    while (speaker.queueLength() > 0 || engine.ring().readAvailable() > 0) delay(1);
+    delay(2 * 1000 * I2S_DMA_BUF_COUNT * I2S_DMA_BUF_LEN / AUDIO_OUTPUT_RATE + 20);
+}
+
+/// Frames heard at LEVEL, or on its way there while fading in
+static size_t framesHeard(const std::vector<int16_t>& heard) {
+    size_t samples = 0;
+    for (size_t i = 0; i < heard.size(); i++) {
+        if (heard[i] > 0 && heard[i] <= LEVEL) samples++;
+    }
+    return samples / AUDIO_OUTPUT_CHANNELS;
+}
+
+/**
+ * Longest run of silent frames among the first `frames` after the first frame heard. The tests
+ * stop in the last segment, before the stream ends and the compressor writes its tail out late.
+ */
+static size_t longestGap(const std::vector<int16_t>& heard, size_t frames) {
+    size_t first = 0;
+    while (first < heard.size() && heard[first] == 0) first++;
+    const size_t last = std::min(heard.size(), first + frames * AUDIO_OUTPUT_CHANNELS);
+    size_t longest = 0;
+    size_t run = 0;
+    for (size_t i = first; i < last; i++) {
+        run = heard[i] == 0 ? run + 1 : 0;
+        if (run > longest) longest = run;
+    }
+    return longest / AUDIO_OUTPUT_CHANNELS;
+}
+
+/// Prints the gap measured at the splices
+static void report(const char* splice, size_t gapFrames) {
+    char message[128];
+    snprintf(message, sizeof(message), "%s: longest silence at the splices %u frames (%u us)", splice,
+             (unsigned)gapFrames, (unsigned)(gapFrames * 1000000ULL / AUDIO_OUTPUT_RATE));
+    TEST_MESSAGE(message);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_queued_segments_splice_without_silence() {
+    const char* paths[] = { "/Stories/1.wav", "/Stories/2.wav", "/Stories/3.wav" };
+    for (int i = 0; i < 3; i++) putSegment(paths[i], SEGMENT_FRAMES, AUDIO_OUTPUT_RATE);
+
+    const uint32_t underruns = engine.getUnderrunFrames();
+    hostI2S().record();
+    for (int i = 0; i < 3; i++) TEST_ASSERT_TRUE(speaker.enqueue(paths[i]));
+    waitPlayed(3 * SEGMENT_FRAMES);
+    std::vector<int16_t> heard = hostI2S().takeHeard();
+
+    const size_t gap = longestGap(heard, 2 * SEGMENT_FRAMES + SEGMENT_FRAMES / 2); // Both splices
+    report("Same rate", gap);
+    TEST_ASSERT_EQUAL(0, gap);
+    TEST_ASSERT_EQUAL_UINT32(underruns, engine.getUnderrunFrames()); // The writer never starved at a splice
+    TEST_ASSERT_EQUAL_UINT32(0, engine.getLastGapFrames());
+    TEST_ASSERT_EQUAL(3 * SEGMENT_FRAMES, framesHeard(heard)); // Every segment, whole
+}
+
+static void test_resampled_segment_splices_without_silence() {
+    putSegment("/Stories/4.wav", SEGMENT_FRAMES, AUDIO_OUTPUT_RATE);
+    putSegment("/Stories/5.wav", SEGMENT_FRAMES / 2, AUDIO_OUTPUT_RATE / 2); // Resampled by its reader
+    putSegment("/Stories/6.wav", SEGMENT_FRAMES, AUDIO_OUTPUT_RATE);
+
+    hostI2S().record();
+    TEST_ASSERT_TRUE(speaker.enqueue("/Stories/4.wav"));
+    TEST_ASSERT_TRUE(speaker.enqueue("/Stories/5.wav"));
+    TEST_ASSERT_TRUE(speaker.enqueue("/Stories/6.wav"));
+    waitPlayed(3 * SEGMENT_FRAMES);
+    std::vector<int16_t> heard = hostI2S().takeHeard();
+
+    const size_t gap = longestGap(heard, 2 * SEGMENT_FRAMES + SEGMENT_FRAMES / 2); // Both splices
+    report("Resampled", gap);
+    TEST_ASSERT_EQUAL(0, gap);
+    TEST_ASSERT_EQUAL(AUDIO_OUTPUT_RATE, engine.getSampleRate()); // No retune for a lower rate
+}
+
+int main(int argc, char** argv) {
+    speaker.begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_queued_segments_splice_without_silence);
+    RUN_TEST(test_resampled_segment_splices_without_silence);
+    return UNITY_END();
+}
@@ -0,0 +1,64 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "AudioMixer.h"
+#include "Compressor.h"
+#include "NoiseSuppressor.h"
+#include "VoiceDetector.h"
+#include "AutoGain.h"
+#include "GainStage.h"
+#include "DcBlocker.h"
+
+/**
+ * @file test_main.cpp
+ * @brief On-board cost of the audio DSP stages, printed to the serial monitor.
+ *
+ * Run with `pio test -e esp32-s3-dsp-test`. Each case runs one stage's `benchmark()` on the
+ * board, where its cost against the audio clock means something; the firmware itself no
+ * longer runs them at boot. Their behaviour is covered on the host by `pio test -e native`.
+ */
+
+void setUp() {}
+void tearDown() {}
+
+static void test_mixer_cost() {
+    AudioMixer::benchmark(); // Cost of a block at 1, 4 and 8 voices
+}
+
+static void test_compressor_cost() {
+    Compressor::benchmark(); // Ceiling on loud noise, transparency and cost per block
+}
+
+static void test_noise_suppressor_cost() {
+    NoiseSuppressor::benchmark(); // SNR gained on a tone in noise and cost per frame
+}
+
+static void test_voice_detector_cost() {
+    VoiceDetector::benchmark(); // Accuracy on a labelled recording and cost per frame
+}
+
+static void test_auto_gain_cost() {
+    AutoGain::benchmark(); // Levels reached on a synthetic voice, switches and cost per sample
+}
+
+static void test_gain_stage_cost() {
+    GainStage::benchmark(); // Samples/s of the volume kernel
+}
+
+static void test_dc_blocker_cost() {
+    DcBlocker::benchmark(); // Samples/s and frequency response of the microphone high-pass
+}
+
+void setup() {
+    delay(2000); // Let the test runner open the serial port
+    UNITY_BEGIN();
+    RUN_TEST(test_mixer_cost);
+    RUN_TEST(test_compressor_cost);
+    RUN_TEST(test_noise_suppressor_cost);
+    RUN_TEST(test_voice_detector_cost);
+    RUN_TEST(test_auto_gain_cost);
+    RUN_TEST(test_gain_stage_cost);
+    RUN_TEST(test_dc_blocker_cost);
+    UNITY_END();
+}
+
+void loop() {}
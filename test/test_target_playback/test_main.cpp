@@ -0,0 +1,113 @@
+#include <Arduino.h>
+#include <unity.h>
+#include "SDCardManager.h"
+#include "SpeakerManager.h"
+
+/**
+ * @file test_main.cpp
+ * @brief On-board check of the playback pipeline: gapless segment splices and no underruns.
+ *
+ * Run with `pio test -e esp32-s3-playback-test` on a board with an SD card and the speaker
+ * connected. The suite writes its own test segments to `TEST_FOLDER`, plays them through a
+ * `SpeakerManager` and reads the output engine's counters: every splice of the queue must be
+ * sample accurate (`getLastGapFrames()` 0) and the double-buffered reader must keep the ring
+ * fed (`getUnderrunFrames()` unchanged), also while another task writes to the card.
+ */
+
+#define TEST_FOLDER "/PlaybackTest"
+
+static SDCardManager sdCard;
+static i2s_pin_config_t pins;
+static I2SManager* output = nullptr;
+static SpeakerManager* speaker = nullptr;
+
+/**
+ * @brief Writes a tone segment with the recording writer.
+ */
+static void writeTone(const char* name, short channels, int rate, int seconds, float hz) {
+    WAVFileWriter writer(name, channels, rate, 0, TEST_FOLDER);
+    int16_t block[512];
+    const size_t frames = 512 / channels;
+    for (uint32_t done = 0; done < (uint32_t)rate * seconds; done += frames) {
+        for (size_t i = 0; i < frames; i++) {
+            int16_t v = (int16_t)(8000.0f * sinf(2.0f * PI * hz * (done + i) / rate));
+            for (short c = 0; c < channels; c++) block[i * channels + c] = v;
+        }
+        writer.writeFrames(block, frames);
+    }
+    writer.close();
+}
+
+/**
+ * @brief Waits `ms` while playback runs, returning the largest splice gap seen.
+ */
+static uint32_t playFor(uint32_t ms) {
+    uint32_t worstGap = 0;
+    uint32_t until = millis() + ms;
+    while ((int32_t)(millis() - until) < 0) {
+        uint32_t gap = output->getLastGapFrames();
+        if (gap > worstGap) worstGap = gap;
+        delay(10);
+    }
+    return worstGap;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_segments_splice_without_a_gap() {
+    speaker->startPlayback(TEST_FOLDER "/a.wav");
+    playFor(500); // The first segment starts from an idle engine
+    uint32_t underruns = output->getUnderrunFrames();
+    TEST_ASSERT_TRUE(speaker->enqueue(TEST_FOLDER "/b.wav")); // Another format: resampled and expanded
+    TEST_ASSERT_TRUE(speaker->enqueue(TEST_FOLDER "/a.wav"));
+    TEST_ASSERT_EQUAL(2, speaker->queueLength());
+    uint32_t worstGap = playFor(2500 + 2000 + 3000 + 500);
+    TEST_ASSERT_EQUAL(0, speaker->queueLength());
+    TEST_ASSERT_EQUAL_UINT32(0, worstGap);
+    TEST_ASSERT_EQUAL_UINT32(underruns, output->getUnderrunFrames());
+}
+
+static void test_card_writes_do_not_underrun() {
+    speaker->startPlayback(TEST_FOLDER "/a.wav");
+    playFor(300);
+    uint32_t underruns = output->getUnderrunFrames();
+    static uint8_t chunk[AUDIO_BLOCK_SIZE];
+    memset(chunk, 0x55, sizeof(chunk));
+    File file = SD.open(TEST_FOLDER "/load.bin", FILE_WRITE);
+    TEST_ASSERT_TRUE((bool)file);
+    uint32_t until = millis() + 2500;
+    while ((int32_t)(millis() - until) < 0) {
+        file.write(chunk, sizeof(chunk)); // Competes with the reader task for the card
+        file.flush();
+    }
+    file.close();
+    SD.remove(TEST_FOLDER "/load.bin");
+    playFor(500);
+    TEST_ASSERT_EQUAL_UINT32(underruns, output->getUnderrunFrames());
+}
+
+void setup() {
+    delay(2000); // Let the test runner open the serial port
+    sdCard.begin();
+    SD.mkdir(TEST_FOLDER);
+    writeTone("a", 2, AUDIO_OUTPUT_RATE, 3, 440.0f);
+    writeTone("b", 1, 22050, 2, 660.0f);
+    memset(&pins, 0, sizeof(pins));
+    pins.bck_io_num = I2S_BCLK_PIN;
+    pins.ws_io_num = I2S_SD_MODE_PIN;
+    pins.data_out_num = I2S_DIN_PIN;
+    pins.data_in_num = I2S_PIN_NO_CHANGE;
+    output = new I2SManager(pins, I2S_DEFAULT_SAMPLE_RATE);
+    speaker = new SpeakerManager(nullptr, nullptr, nullptr, nullptr, output);
+    speaker->begin();
+    speaker->setVolume(20);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_segments_splice_without_a_gap);
+    RUN_TEST(test_card_writes_do_not_underrun);
+    UNITY_END();
+    speaker->stopPlayback();
+}
+
+void loop() {}
@@ -0,0 +1,150 @@
+#include <unity.h>
+#include <vector>
+#include "VoiceDetector.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the voice activity detector: framing, onset, hangover, hiss, floor.
+ */
+
+static const uint32_t rate = SAMPLE_RATE;
+static const size_t frame = (size_t)rate * VAD_FRAME_MS / 1000;
+static uint32_t seed = 12345;
+static uint32_t position = 0;
+
+static float white(float peak) {
+    seed = seed * 1664525UL + 1013904223UL;
+    return (int16_t)(seed >> 16) * (peak / 32768.0f);
+}
+
+enum Kind { SILENCE, VOICED, HISS };
+
+/**
+ * @brief Feeds `ms` of background noise (peak `noise`) plus a voiced sound or hiss at `level`
+ *        peak, in capture frames, and returns the decision after each analysis frame.
+ */
+static std::vector<bool> feed(VoiceDetector& vad, uint32_t ms, Kind kind, float level, float noise = 100.0f) {
+    std::vector<bool> decisions;
+    std::vector<int16_t> block(MIC_FRAME_SAMPLES);
+    size_t total = (size_t)ms * rate / 1000;
+    float previous = 0.0f;
+    for (size_t done = 0; done < total; done += block.size()) {
+        size_t n = total - done < block.size() ? total - done : block.size();
+        for (size_t i = 0; i < n; i++, position++) {
+            float v = white(noise);
+            if (kind == VOICED) {
+                for (int h = 1; h <= 5; h++) {
+                    v += level / 2.3f / h * sinf(2.0f * (float)M_PI * 180.0f * h * position / rate);
+                }
+            } else if (kind == HISS) {
+                float hiss = white(level / 2);
+                v += hiss - previous; // High-passed noise
+                previous = hiss;
+            }
+            block[i] = (int16_t)v;
+        }
+        const int16_t* samples = &block[0];
+        while (n > 0) {
+            size_t taken = vad.process(samples, n);
+            samples += taken;
+            n -= taken;
+            if (position - n == 0 || (position - n) % frame == 0) {
+                decisions.push_back(vad.isSpeech());
+            }
+        }
+    }
+    return decisions;
+}
+
+static size_t count(const std::vector<bool>& decisions) {
+    size_t speech = 0;
+    for (size_t i = 0; i < decisions.size(); i++) speech += decisions[i];
+    return speech;
+}
+
+void setUp() {
+    position = 0;
+}
+void tearDown() {}
+
+static void test_process_stops_at_the_frame_end() {
+    VoiceDetector vad;
+    int16_t samples[MIC_FRAME_SAMPLES] = { 0 };
+    TEST_ASSERT_EQUAL(frame, vad.frameSamples());
+    TEST_ASSERT_EQUAL(frame, vad.process(samples, MIC_FRAME_SAMPLES));
+    TEST_ASSERT_EQUAL(7, vad.process(samples, 7));
+    TEST_ASSERT_EQUAL(frame - 7, vad.process(samples, MIC_FRAME_SAMPLES));
+    TEST_ASSERT_EQUAL_UINT32(2, vad.getStats().frames);
+    vad.reset(16000);
+    TEST_ASSERT_EQUAL(16000 * VAD_FRAME_MS / 1000, vad.frameSamples());
+    TEST_ASSERT_EQUAL_UINT32(0, vad.getStats().frames);
+}
+
+static void test_background_is_not_speech() {
+    VoiceDetector vad;
+    std::vector<bool> decisions = feed(vad, 3000, SILENCE, 0.0f);
+    TEST_ASSERT_EQUAL(0, count(decisions));
+    TEST_ASSERT_EQUAL_UINT32(0, vad.getStats().onsets);
+}
+
+static void test_onset_and_hangover() {
+    VoiceDetector vad;
+    feed(vad, 500, SILENCE, 0.0f);
+    std::vector<bool> speech = feed(vad, 400, VOICED, 1800.0f);
+    // Speech is declared on the VAD_ONSET_FRAMES-th voiced frame and held to the end
+    for (size_t f = 0; f < speech.size(); f++) {
+        TEST_ASSERT_EQUAL(f + 1 >= VAD_ONSET_FRAMES, speech[f]);
+    }
+    std::vector<bool> after = feed(vad, 1000, SILENCE, 0.0f);
+    const size_t hangover = VAD_HANGOVER_MS / VAD_FRAME_MS;
+    for (size_t f = 0; f < after.size(); f++) {
+        TEST_ASSERT_EQUAL(f < hangover, after[f]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, vad.getStats().onsets);
+}
+
+static void test_short_pause_is_kept() {
+    VoiceDetector vad;
+    feed(vad, 500, SILENCE, 0.0f);
+    feed(vad, 250, VOICED, 1800.0f);
+    std::vector<bool> pause = feed(vad, 120, SILENCE, 0.0f);
+    feed(vad, 250, VOICED, 1800.0f);
+    TEST_ASSERT_EQUAL(pause.size(), count(pause));
+    TEST_ASSERT_EQUAL_UINT32(1, vad.getStats().onsets); // One utterance
+}
+
+static void test_quiet_voice_is_speech_quiet_hiss_is_not() {
+    VoiceDetector vad;
+    feed(vad, 500, SILENCE, 0.0f);
+    std::vector<bool> hiss = feed(vad, 300, HISS, 500.0f); // Between VAD_ENERGY_DB and VAD_STRONG_DB, high ZCR
+    TEST_ASSERT_EQUAL(0, count(hiss));
+    feed(vad, 500, SILENCE, 0.0f);
+    std::vector<bool> voice = feed(vad, 300, VOICED, 600.0f); // Same band, low ZCR
+    TEST_ASSERT_GREATER_THAN(voice.size() / 2, count(voice));
+    feed(vad, 1000, SILENCE, 0.0f);
+    std::vector<bool> loud = feed(vad, 300, HISS, 4000.0f); // Above VAD_STRONG_DB, whatever the ZCR
+    TEST_ASSERT_GREATER_THAN(loud.size() / 2, count(loud));
+}
+
+static void test_floor_follows_a_slow_background_rise() {
+    VoiceDetector vad;
+    std::vector<bool> decisions;
+    for (int step = 0; step <= 40; step++) { // 100 to 400 peak (+12 dB) over 8 s
+        std::vector<bool> part = feed(vad, 200, SILENCE, 0.0f, 100.0f * powf(4.0f, step / 40.0f));
+        decisions.insert(decisions.end(), part.begin(), part.end());
+    }
+    TEST_ASSERT_EQUAL(0, count(decisions));
+    std::vector<bool> speech = feed(vad, 400, VOICED, 7200.0f, 400.0f); // Still heard over it
+    TEST_ASSERT_GREATER_THAN(speech.size() / 2, count(speech));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_process_stops_at_the_frame_end);
+    RUN_TEST(test_background_is_not_speech);
+    RUN_TEST(test_onset_and_hangover);
+    RUN_TEST(test_short_pause_is_kept);
+    RUN_TEST(test_quiet_voice_is_speech_quiet_hiss_is_not);
+    RUN_TEST(test_floor_follows_a_slow_background_rise);
+    return UNITY_END();
+}
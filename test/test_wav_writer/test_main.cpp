@@ -0,0 +1,175 @@
+#include <unity.h>
+#include <stdio.h>
+#include "RiffParser.h"
+#include "WAVFileWriter.h"
+
+/**
+ * @file test_main.cpp
+ * @brief Native tests of the WAV writer: header, sector-aligned block writes, duration limit, comment
+ * and the rate of an hour-long recording.
+ */
+
+static const char* PATH = "/rec/take.wav";
+
+static uint32_t word(const HostFile& file, size_t offset) {
+    uint32_t value;
+    memcpy(&value, file.data.data() + offset, 4);
+    return value;
+}
+
+static int16_t sample(const HostFile& file, size_t index) {
+    int16_t value;
+    memcpy(&value, file.data.data() + 44 + index * 2, 2);
+    return value;
+}
+
+void setUp() {
+    SD.clear();
+}
+
+void tearDown() {}
+
+static void test_header_is_patched_on_close() {
+    WAVFileWriter writer("take", 1, 8000, 0, "/rec");
+    int16_t block[100];
+    for (int i = 0; i < 100; i++) block[i] = (int16_t)(i * 3 - 150);
+    TEST_ASSERT_EQUAL(100, writer.writeFrames(block, 100));
+    writer.close();
+
+    std::shared_ptr<HostFile> file = SD.file(PATH);
+    TEST_ASSERT_NOT_NULL(file.get());
+    TEST_ASSERT_EQUAL(44 + 200, file->data.size());
+    TEST_ASSERT_EQUAL_MEMORY("RIFF", file->data.data(), 4);
+    TEST_ASSERT_EQUAL_UINT32(36 + 200, word(*file, 4));
+    TEST_ASSERT_EQUAL_MEMORY("WAVEfmt ", file->data.data() + 8, 8);
+    TEST_ASSERT_EQUAL_UINT32(8000, word(*file, 24));
+    TEST_ASSERT_EQUAL_UINT32(16000, word(*file, 28));
+    TEST_ASSERT_EQUAL_MEMORY("data", file->data.data() + 36, 4);
+    TEST_ASSERT_EQUAL_UINT32(200, word(*file, 40));
+    for (int i = 0; i < 100; i++) TEST_ASSERT_EQUAL_INT16(block[i], sample(*file, i));
+}
+
+static void test_blocks_start_on_sector_boundaries() {
+    WAVFileWriter writer("take", 2, 16000, 0, "/rec");
+    int16_t block[2 * 333];
+    int16_t left[500];
+    int16_t right[500];
+    for (int i = 0; i < 2 * 333; i++) block[i] = (int16_t)i;
+    for (int i = 0; i < 500; i++) {
+        left[i] = (int16_t)i;
+        right[i] = (int16_t)-i;
+    }
+    for (int round = 0; round < 10; round++) {
+        writer.writeFrames(block, 333);       // Buffered, uneven sizes
+        writer.writeFrames(left, right, 500); // Interleaved into the buffer
+        writer.writeFrame(7, -7);
+    }
+    size_t big = 3 * AUDIO_BLOCK_SIZE / 4;
+    int16_t* whole = new int16_t[big * 2];
+    memset(whole, 0, big * 2 * sizeof(int16_t));
+    writer.writeFrames(whole, big);           // Whole blocks may go straight to the card
+    delete[] whole;
+    writer.close();
+
+    std::shared_ptr<HostFile> file = SD.file(PATH);
+    const std::vector<HostFile::Write>& writes = file->writes;
+    TEST_ASSERT_GREATER_THAN(4, writes.size());
+    TEST_ASSERT_EQUAL_UINT32(0, writes.front().offset);  // Initial header
+    TEST_ASSERT_EQUAL_UINT32(0, writes.back().offset);   // Patched header
+    for (size_t i = 1; i + 1 < writes.size(); i++) {
+        if (i + 2 < writes.size()) {
+            TEST_ASSERT_EQUAL_UINT32(0, (writes[i].offset + writes[i].length) % AUDIO_SECTOR_SIZE); // Every block but the last ends on a sector
+        }
+        if (i > 1) {
+            TEST_ASSERT_EQUAL_UINT32(0, writes[i].offset % AUDIO_SECTOR_SIZE);
+        }
+    }
+    const uint32_t frames = 10 * (333 + 500 + 1) + big;
+    TEST_ASSERT_EQUAL_UINT32(frames * 4, word(*file, 40));
+    TEST_ASSERT_EQUAL(44 + frames * 4, file->data.size());
+    TEST_ASSERT_EQUAL_INT16(333 * 2 - 1, sample(*file, 333 * 2 - 1));
+    TEST_ASSERT_EQUAL_INT16(0, sample(*file, 333 * 2));    // First interleaved frame, left
+    TEST_ASSERT_EQUAL_INT16(-1, sample(*file, 333 * 2 + 3)); // Second frame, right
+}
+
+static void test_duration_limit() {
+    WAVFileWriter writer("take", 1, 100, 2, "/rec"); // 200 frames at most
+    int16_t block[150] = { 0 };
+    TEST_ASSERT_EQUAL(150, writer.writeFrames(block, 150));
+    TEST_ASSERT_EQUAL(50, writer.writeFrames(block, 150));
+    TEST_ASSERT_EQUAL(0, writer.writeFrames(block, 150));
+    writer.writeFrame(1, 1);
+    TEST_ASSERT_EQUAL(200, writer.getFramesWritten());
+    writer.close();
+    TEST_ASSERT_EQUAL_UINT32(400, word(*SD.file(PATH), 40));
+}
+
+static void test_comment_follows_the_samples() {
+    WAVFileWriter writer("take", 1, 8000, 0, "/rec");
+    int16_t block[100] = { 0 };
+    writer.writeFrames(block, 100);
+    writer.setComment("0:50+0 12480:60-13"); // 19 bytes with its zero, padded to 20
+    writer.close();
+
+    std::shared_ptr<HostFile> file = SD.file(PATH);
+    const size_t list = 4 + 8 + 20;
+    TEST_ASSERT_EQUAL(44 + 200 + 8 + list, file->data.size());
+    TEST_ASSERT_EQUAL_UINT32(36 + 200 + 8 + list, word(*file, 4)); // RIFF covers the comment
+    TEST_ASSERT_EQUAL_UINT32(200, word(*file, 40));                 // data does not
+    TEST_ASSERT_EQUAL_MEMORY("LIST", file->data.data() + 244, 4);
+    TEST_ASSERT_EQUAL_UINT32(list, word(*file, 248));
+    TEST_ASSERT_EQUAL_MEMORY("INFOICMT", file->data.data() + 252, 8);
+    TEST_ASSERT_EQUAL_UINT32(19, word(*file, 260));
+    TEST_ASSERT_EQUAL_STRING("0:50+0 12480:60-13", (const char*)file->data.data() + 264);
+    TEST_ASSERT_EQUAL(0, file->data.back()); // Pad byte
+
+    File reader = SD.open(PATH);
+    RiffParser::WavInfo info;
+    TEST_ASSERT_TRUE(RiffParser::parse(reader, info)); // Readers skip the comment
+    TEST_ASSERT_EQUAL_UINT32(44, info.dataOffset);
+    TEST_ASSERT_EQUAL_UINT32(200, info.dataSize);
+}
+
+/**
+ * @brief Writes an hour of 16 kHz mono in capture frames, past the old 16-bit frame counter,
+ * and prints the MB/s reaching the (in-memory) card.
+ */
+static void test_write_an_hour_of_recording() {
+    const uint32_t rate = 16000;
+    const uint64_t frames = (uint64_t)rate * 3600;
+    int16_t block[MIC_FRAME_SAMPLES];
+    for (size_t i = 0; i < MIC_FRAME_SAMPLES; i++) block[i] = (int16_t)(i * 97);
+    WAVFileWriter writer("take", 1, rate, 0, "/rec");
+
+    const unsigned long start = micros();
+    uint64_t written = 0;
+    while (written < frames) {
+        written += writer.writeFrames(block, MIC_FRAME_SAMPLES);
+    }
+    writer.close();
+    const unsigned long elapsedUs = micros() - start;
+
+    const double seconds = elapsedUs > 0 ? elapsedUs / 1e6 : 1e-6;
+    const double bytes = (double)frames * sizeof(int16_t);
+    char message[128];
+    snprintf(message, sizeof(message), "WAVFileWriter: 1 h of 16 kHz mono in %.0f ms, %.1f MB/s, %.0fx real time",
+             seconds * 1000.0, bytes / seconds / 1e6, 3600.0 / seconds);
+    TEST_MESSAGE(message);
+
+    std::shared_ptr<HostFile> file = SD.file(PATH);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)(frames * 2), word(*file, 40)); // No counter wrapped
+    TEST_ASSERT_EQUAL(44 + frames * 2, file->data.size());
+    TEST_ASSERT_EQUAL_INT16(block[5], sample(*file, frames - MIC_FRAME_SAMPLES + 5));
+    TEST_ASSERT_GREATER_THAN_FLOAT(100.0f, (float)(3600.0 / seconds));
+    SD.clear(); // 115 MB
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_header_is_patched_on_close);
+    RUN_TEST(test_blocks_start_on_sector_boundaries);
+    RUN_TEST(test_duration_limit);
+    RUN_TEST(test_comment_follows_the_samples);
+    RUN_TEST(test_write_an_hour_of_recording);
+    return UNITY_END();
+}